@@ -0,0 +1,486 @@
+#pragma once
+#include <JuceHeader.h>
+#include "SyntaktParameterTable.h"
+
+// ==========================================
+// Controller decoder
+// ==========================================
+// Controllers as Syntakt parameter values: a plain CC parameter right away,
+// an NRPN one once its number (99/98) and value (6, then 38) are in.
+class ControllerDecoder
+{
+public:
+    ControllerDecoder()
+    {
+        ccToParameter.fill(-1);
+
+        for (size_t i = 0; i < numSyntaktParameters; ++i)
+            if (syntaktParameters[i].isCC && juce::isPositiveAndBelow(syntaktParameters[i].ccNumber, 128))
+                ccToParameter[(size_t) syntaktParameters[i].ccNumber] = (int) i;
+    }
+
+    // Calls found(parameterIndex, value) for each complete value
+    template <typename Found>
+    void decode(int midiChannel, int controller, int value, Found&& found) noexcept
+    {
+        if (!juce::isPositiveAndBelow(midiChannel - 1, 16) || !juce::isPositiveAndBelow(controller, 128))
+            return;
+
+        auto& nrpn = nrpnInput[(size_t) (midiChannel - 1)];
+
+        switch (controller)
+        {
+            case 99: nrpn.msb = value; nrpn.valueMsb = -1; return;
+            case 98: nrpn.lsb = value; nrpn.valueMsb = -1; return;
+            case 6:  nrpn.valueMsb = value; return;
+
+            case 38:
+                if (nrpn.valueMsb >= 0)
+                    if (const int index = findNrpn(nrpn.msb, nrpn.lsb); index >= 0)
+                        found(index, (nrpn.valueMsb << 7) | value);
+                return;
+
+            default: break;
+        }
+
+        if (const int index = ccToParameter[(size_t) controller]; index >= 0)
+            found(index, value);
+    }
+
+private:
+    static int findNrpn(int msb, int lsb) noexcept
+    {
+        for (size_t i = 0; i < numSyntaktParameters; ++i)
+            if (!syntaktParameters[i].isCC && syntaktParameters[i].nrpnMsb == msb && syntaktParameters[i].nrpnLsb == lsb)
+                return (int) i;
+
+        return -1;
+    }
+
+    struct NrpnInput
+    {
+        int msb = -1, lsb = -1, valueMsb = -1;
+    };
+
+    std::array<int, 128> ccToParameter;
+    std::array<NrpnInput, 16> nrpnInput {};
+};
+
+// ==========================================
+// Automation clip
+// ==========================================
+// Recorded parameter values, one lane per destination (output, MIDI channel,
+// Syntakt parameter), positioned in clock ticks from the start of a loop.
+// A lane is a byte stream of events, each its tick and value as the
+// difference to the previous event's, varint encoded (the value zigzagged
+// first), so a gesture moving a step per tick costs two bytes an event.
+//
+// A clip is built on the message thread (by AutomationRecorder, or read
+// from a MIDI file) and doesn't change once the engine plays it. Playback
+// keeps one Cursor per lane that has the lane's next event decoded: a tick
+// compares one position per lane, and only decodes the events that are due.
+//
+// originTick: the transport position (in ticks since Start) the loop is
+// aligned to; the loop repeats every getLength() ticks either side of it.
+class AutomationClip
+{
+public:
+    static constexpr int ticksPerQuarter = 96;   // 4 per MIDI clock pulse
+    static constexpr int ticksPerBar = 4 * ticksPerQuarter;
+    static constexpr int maxLanes = 512;
+    static constexpr int maxOutputs = 4;   // ModulationEngine::maxOutputs
+
+    struct Destination
+    {
+        int output = 0;
+        int midiChannel = 1;        // 1-16
+        int parameterIndex = 0;     // into syntaktParameters
+
+        int getKey() const noexcept
+        {
+            return (output * 16 + midiChannel - 1) * (int) numSyntaktParameters + parameterIndex;
+        }
+    };
+
+    struct Lane
+    {
+        Destination destination;
+        std::vector<juce::uint8> events;
+        int numEvents = 0;
+
+        // last event, for the next difference
+        juce::int64 lastTick = 0;
+        int lastValue = 0;
+    };
+
+    // Playback position in one lane (engine thread)
+    struct Cursor
+    {
+        size_t offset = 0;           // of the event after the next one
+        juce::int64 nextTick = 0;    // end: std::numeric_limits max
+        int nextValue = 0;
+        int value = -1;              // last one played, -1 before any
+    };
+
+    AutomationClip(juce::int64 loopOriginTick, juce::int64 lengthTicks)
+        : originTick(loopOriginTick), length(juce::jmax((juce::int64) 1, lengthTicks))
+    {
+    }
+
+    // ==========================================
+    // Building (message thread)
+    // ==========================================
+    // Values of a destination in tick order (relative to the origin); an
+    // earlier one is taken as at the previous tick. False for a destination
+    // outside the outputs, channels or parameter table, and for a new one
+    // once maxLanes destinations are in.
+    bool add(const Destination& destination, juce::int64 tick, int value)
+    {
+        if (destination.midiChannel < 1 || destination.midiChannel > 16
+            || !juce::isPositiveAndBelow(destination.parameterIndex, (int) numSyntaktParameters)
+            || !juce::isPositiveAndBelow(destination.output, maxOutputs))
+            return false;
+
+        auto found = laneIndex.find(destination.getKey());
+
+        if (found == laneIndex.end())
+        {
+            if ((int) lanes.size() == maxLanes)
+                return false;
+
+            found = laneIndex.emplace(destination.getKey(), (int) lanes.size()).first;
+            lanes.push_back({ destination });
+        }
+
+        auto& lane = lanes[(size_t) found->second];
+        tick = juce::jmax(tick, lane.lastTick);
+
+        writeVarint(lane.events, (juce::uint64) (tick - lane.lastTick));
+        writeVarint(lane.events, zigzag(value - lane.lastValue));
+
+        lane.lastTick = tick;
+        lane.lastValue = value;
+        ++lane.numEvents;
+        return true;
+    }
+
+    // Long enough for every event, in whole bars
+    void setLength(juce::int64 lengthTicks) noexcept
+    {
+        for (const auto& lane : lanes)
+            lengthTicks = juce::jmax(lengthTicks, lane.lastTick + 1);
+
+        length = juce::jmax((juce::int64) 1, (lengthTicks + ticksPerBar - 1) / ticksPerBar) * ticksPerBar;
+    }
+
+    juce::int64 getOrigin() const noexcept   { return originTick; }
+    juce::int64 getLength() const noexcept   { return length; }
+    int getNumLanes() const noexcept         { return (int) lanes.size(); }
+    const Lane& getLane(int index) const     { return lanes[(size_t) index]; }
+
+    size_t getNumBytes() const noexcept
+    {
+        size_t bytes = 0;
+
+        for (const auto& lane : lanes)
+            bytes += lane.events.size();
+
+        return bytes;
+    }
+
+    // ==========================================
+    // Playback (engine thread)
+    // ==========================================
+    // To the start of the loop; the value played last is kept
+    void rewind(int index, Cursor& cursor) const noexcept
+    {
+        cursor.offset = 0;
+        cursor.nextTick = 0;
+        cursor.nextValue = 0;
+        decodeNext(lanes[(size_t) index], cursor);
+    }
+
+    // Plays every event up to and including loopTick; true if that changed
+    // the lane's value
+    bool advance(int index, Cursor& cursor, juce::int64 loopTick) const noexcept
+    {
+        if (cursor.nextTick > loopTick)
+            return false;
+
+        const auto& lane = lanes[(size_t) index];
+        const int previous = cursor.value;
+
+        while (cursor.nextTick <= loopTick)
+        {
+            cursor.value = cursor.nextValue;
+            decodeNext(lane, cursor);
+        }
+
+        return cursor.value != previous;
+    }
+
+    // Transport position in ticks to the position in the loop
+    juce::int64 toLoopTick(juce::int64 transportTick) const noexcept
+    {
+        const auto offset = (transportTick - originTick) % length;
+        return offset < 0 ? offset + length : offset;
+    }
+
+    // ==========================================
+    // MIDI files (message thread)
+    // ==========================================
+    // Track n holds output n's lanes, each value as the parameter's CC or
+    // NRPN (99/98/6/38); the tracks end with the loop
+    juce::MidiFile toMidiFile() const
+    {
+        int numOutputs = 1;
+
+        for (const auto& lane : lanes)
+            numOutputs = juce::jmax(numOutputs, lane.destination.output + 1);
+
+        std::vector<juce::MidiMessageSequence> tracks((size_t) numOutputs);
+
+        for (int i = 0; i < getNumLanes(); ++i)
+        {
+            const auto& destination = lanes[(size_t) i].destination;
+            const auto& param = syntaktParameters[destination.parameterIndex];
+            const int channel = destination.midiChannel;
+            auto& track = tracks[(size_t) destination.output];
+
+            Cursor cursor;
+            rewind(i, cursor);
+
+            while (cursor.nextTick != std::numeric_limits<juce::int64>::max())
+            {
+                const auto time = (double) cursor.nextTick;
+                const int value = cursor.nextValue;
+                decodeNext(lanes[(size_t) i], cursor);
+
+                if (param.isCC)
+                {
+                    track.addEvent(juce::MidiMessage::controllerEvent(channel, param.ccNumber, value & 0x7f), time);
+                }
+                else
+                {
+                    track.addEvent(juce::MidiMessage::controllerEvent(channel, 99, param.nrpnMsb), time);
+                    track.addEvent(juce::MidiMessage::controllerEvent(channel, 98, param.nrpnLsb), time);
+                    track.addEvent(juce::MidiMessage::controllerEvent(channel, 6, (value >> 7) & 0x7f), time);
+                    track.addEvent(juce::MidiMessage::controllerEvent(channel, 38, value & 0x7f), time);
+                }
+            }
+        }
+
+        juce::MidiFile file;
+        file.setTicksPerQuarterNote(ticksPerQuarter);
+
+        for (auto& track : tracks)
+        {
+            // stable: NRPN groups stay together
+            track.sort();
+            track.addEvent(juce::MidiMessage::endOfTrack(), (double) length);
+            file.addTrack(track);
+        }
+
+        return file;
+    }
+
+    // nullptr for SMPTE timed files and files without any controller the
+    // parameter table knows. The tracks that have such controllers go to
+    // the outputs in order (a tempo or name only track takes none); the
+    // parameter changes that don't fit, on tracks past maxOutputs or in
+    // lanes past maxLanes, are left out and counted in numDropped.
+    static std::unique_ptr<AutomationClip> fromMidiFile(const juce::MidiFile& file, int& numDropped)
+    {
+        numDropped = 0;
+        const int fileTicksPerQuarter = file.getTimeFormat();
+
+        if (fileTicksPerQuarter <= 0)
+            return nullptr;
+
+        auto clip = std::make_unique<AutomationClip>(0, ticksPerBar);
+        juce::int64 endTick = 0;
+        int output = 0;
+
+        for (int t = 0; t < file.getNumTracks(); ++t)
+        {
+            ControllerDecoder decoder;
+            bool hasParameters = false;
+
+            for (const auto* event : *file.getTrack(t))
+            {
+                const auto& message = event->message;
+                const auto tick = (juce::int64) std::llround(message.getTimeStamp() * ticksPerQuarter / fileTicksPerQuarter);
+
+                if (message.isEndOfTrackMetaEvent())
+                    endTick = juce::jmax(endTick, tick);
+
+                if (!message.isController())
+                    continue;
+
+                decoder.decode(message.getChannel(), message.getControllerNumber(), message.getControllerValue(),
+                               [&](int parameterIndex, int value)
+                               {
+                                   hasParameters = true;
+
+                                   if (!clip->add({ output, message.getChannel(), parameterIndex }, tick, value))
+                                       ++numDropped;
+                               });
+            }
+
+            if (hasParameters)
+                ++output;
+        }
+
+        if (clip->getNumLanes() == 0)
+            return nullptr;
+
+        clip->setLength(endTick);
+        return clip;
+    }
+
+private:
+    static void writeVarint(std::vector<juce::uint8>& bytes, juce::uint64 value)
+    {
+        while (value >= 0x80)
+        {
+            bytes.push_back((juce::uint8) (value | 0x80));
+            value >>= 7;
+        }
+
+        bytes.push_back((juce::uint8) value);
+    }
+
+    static juce::uint64 readVarint(const std::vector<juce::uint8>& bytes, size_t& offset) noexcept
+    {
+        juce::uint64 value = 0;
+
+        for (int shift = 0; offset < bytes.size() && shift < 64; shift += 7)
+        {
+            const auto byte = bytes[offset++];
+            value |= (juce::uint64) (byte & 0x7f) << shift;
+
+            if ((byte & 0x80) == 0)
+                break;
+        }
+
+        return value;
+    }
+
+    static juce::uint64 zigzag(int value) noexcept
+    {
+        return (juce::uint64) (((juce::uint32) value << 1) ^ (juce::uint32) (value >> 31));
+    }
+
+    static int unzigzag(juce::uint64 value) noexcept
+    {
+        return (int) (value >> 1) ^ -(int) (value & 1);
+    }
+
+    static void decodeNext(const Lane& lane, Cursor& cursor) noexcept
+    {
+        if (cursor.offset >= lane.events.size())
+        {
+            cursor.nextTick = std::numeric_limits<juce::int64>::max();
+            return;
+        }
+
+        cursor.nextTick += (juce::int64) readVarint(lane.events, cursor.offset);
+        cursor.nextValue += unzigzag(readVarint(lane.events, cursor.offset));
+    }
+
+    juce::int64 originTick = 0;
+    juce::int64 length = ticksPerBar;
+
+    std::vector<Lane> lanes;
+    std::map<int, int> laneIndex;   // destination key to lane
+};
+
+// ==========================================
+// Automation recorder
+// ==========================================
+// Values the engine sent or received while recording, handed over from the
+// engine thread through a fixed queue and turned into an AutomationClip on
+// the message thread. The loop starts at the bar of the first value and
+// ends at the bar in which recording stopped.
+class AutomationRecorder
+{
+public:
+    static constexpr int capacity = 8192;
+
+    // ---- Message thread ----
+    void start()
+    {
+        drain();
+        clip.reset();
+        numDropped.store(0, std::memory_order_relaxed);
+        armed.store(true, std::memory_order_release);
+    }
+
+    // Takes what the engine queued: a few times a second while recording
+    void drain()
+    {
+        fifo.read(fifo.getNumReady()).forEach([this](int index)
+        {
+            const auto& event = events[(size_t) index];
+
+            if (clip == nullptr)
+            {
+                const auto origin = event.tick - (event.tick % AutomationClip::ticksPerBar + AutomationClip::ticksPerBar)
+                                                     % AutomationClip::ticksPerBar;
+                clip = std::make_unique<AutomationClip>(origin, AutomationClip::ticksPerBar);
+            }
+
+            if (!clip->add(event.destination, event.tick - clip->getOrigin(), event.value))
+                numDropped.fetch_add(1, std::memory_order_relaxed);
+        });
+    }
+
+    // endTick: transport position when recording stopped. nullptr if nothing
+    // was recorded.
+    std::unique_ptr<AutomationClip> stop(juce::int64 endTick)
+    {
+        armed.store(false, std::memory_order_release);
+        drain();
+
+        if (clip != nullptr)
+            clip->setLength(endTick - clip->getOrigin());
+
+        return std::move(clip);
+    }
+
+    bool isRecording() const noexcept   { return armed.load(std::memory_order_relaxed); }
+
+    // full queue or too many lanes
+    int getNumDropped() const noexcept  { return numDropped.load(std::memory_order_relaxed); }
+
+    // ---- Engine thread ----
+    bool isArmed() const noexcept   { return armed.load(std::memory_order_acquire); }
+
+    void record(const AutomationClip::Destination& destination, juce::int64 tick, int value) noexcept
+    {
+        const auto scope = fifo.write(1);
+
+        if (scope.blockSize1 + scope.blockSize2 == 0)
+        {
+            numDropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+
+        events[(size_t) (scope.blockSize1 > 0 ? scope.startIndex1 : scope.startIndex2)] = { destination, tick, value };
+    }
+
+private:
+    struct Event
+    {
+        AutomationClip::Destination destination;
+        juce::int64 tick = 0;
+        int value = 0;
+    };
+
+    juce::AbstractFifo fifo { capacity };
+    std::array<Event, capacity> events {};
+
+    std::unique_ptr<AutomationClip> clip;   // message thread
+    std::atomic<bool> armed { false };
+    std::atomic<int> numDropped { 0 };
+};
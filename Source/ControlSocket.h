@@ -0,0 +1,504 @@
+#pragma once
+#include <JuceHeader.h>
+#include "ModulationEngine.h"
+#include "EngineTelemetry.h"
+
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <poll.h>
+#include <unistd.h>
+
+// ==========================================
+// Control socket
+// ==========================================
+// Local control endpoint of the engine process, for show-control software:
+// a Unix datagram socket (getPath()) speaking a compact binary protocol.
+// One datagram is one batch of operations. A batch is checked as a whole
+// and either rejected or applied as one settings snapshot plus LFO
+// start/stop, which a single tick takes up, run right away rather than at
+// the next deadline (see EngineHost::controlReceived).
+//
+// Datagram, little endian:
+//   0   'M' 'Z'   magic
+//   2   u8        version (1)
+//   3   u8        number of operations, 1 to maxOps
+//   4   u32       sequence number, echoed in the reply
+//   8   8 bytes per operation: u8 Op, u8 route index, u16 zero, f32 value
+//
+// A sender that bound its own address gets a reply once the batch has been
+// handed to the engine or rejected:
+//   0   'M' 'Z', u8 version, u8 Result
+//   4   u32       sequence number
+//   8   u32       index of the offending operation (0 when accepted)
+//
+// The time from a datagram being received to the first message it causes
+// being handed to an output port is kept in the engine telemetry (control
+// round trip).
+//
+// A receive thread blocks on the socket (close() wakes it through an
+// eventfd), so an idle socket costs no wake-ups. It decodes each datagram,
+// replies, and queues the batch twice: for the engine, whose tick takes it
+// up through takeControl() without the message thread in between, and for
+// the owner, which picks it up with nextBatch() on its message thread to
+// follow the settings the engine now runs. onBatchReceived is called once
+// both are queued.
+class ControlSocket : public ModulationEngine::ControlSource,
+                      private juce::Thread
+{
+public:
+    static constexpr int version = 1;
+    static constexpr int maxOps = 64;
+    static constexpr int headerSize = 8;
+    static constexpr int opSize = 8;
+    static constexpr int queueSize = 32;
+
+    enum class Op : juce::uint8
+    {
+        start          = 0x01,   // LFO from its start phase
+        stop           = 0x02,
+        retrigger      = 0x03,   // back to the start phase, running
+        resume         = 0x04,   // clock master: Continue; otherwise start from where it stopped
+        songPosition   = 0x05,   // clock master, stopped: position for Continue, in sixteenths
+
+        rate           = 0x10,   // Hz, when not synced
+        depth          = 0x11,   // 0..1
+        shape          = 0x12,   // 1 sine, 2 triangle, 3 square, 4 saw, 5 random
+        sync           = 0x13,   // 0 free, 1 MIDI clock, 2 clock master
+        division       = 0x14,   // 1..8 (see ModulationEngine::cyclesPerBeat)
+        noteRestart    = 0x15,   // 0/1
+        noteChannel    = 0x16,   // Note-On channel restarting the LFO, 0 = none
+        tempo          = 0x17,   // clock master BPM
+
+        routeChannel   = 0x20,   // MIDI channel, 0 = route off
+        routeOutput    = 0x21,   // output slot
+        routeParameter = 0x22,   // index into syntaktParameters
+        routeBipolar   = 0x23,   // 0/1
+        routeInvert    = 0x24,   // 0/1
+        routeOneShot   = 0x25,   // 0/1
+        routeAmount    = 0x26,   // -1..1
+
+        egSource       = 0x30,   // Note channel triggering the EG, 0 = EG off
+        egChannel      = 0x31,   // MIDI channel
+        egParameter    = 0x32,   // index into syntaktParameters, -1 = none
+        egAttack       = 0x33,   // ms
+        egHold         = 0x34,   // ms
+        egDecay        = 0x35,   // ms
+        egSustain      = 0x36,   // 0..1
+        egRelease      = 0x37,   // ms
+        egVelocity     = 0x38,   // 0..1
+        egAmount       = 0x39    // -1..1
+    };
+
+    enum class Result : juce::uint8
+    {
+        applied,
+        malformed,       // header, size or version
+        unknownOp,
+        badValue,        // out of range, or not whole for an integer
+        busy             // queue full, nothing applied
+    };
+
+    struct Operation
+    {
+        Op op = Op::start;
+        int index = 0;
+        float value = 0.0f;
+    };
+
+    struct Batch
+    {
+        std::array<Operation, maxOps> ops {};
+        int numOps = 0;
+        juce::uint32 sequence = 0;
+        double receivedMs = 0.0;   // Time::getMillisecondCounterHiRes()
+
+        sockaddr_un sender {};
+        socklen_t senderLength = 0;
+    };
+
+    explicit ControlSocket(EngineTelemetry& t)
+        : juce::Thread("Control socket"), telemetry(t)
+    {
+    }
+
+    ~ControlSocket() override
+    {
+        close();
+    }
+
+    // $XDG_RUNTIME_DIR/modztakt-control, or /tmp/modztakt-control.<uid>
+    static juce::String getPath()
+    {
+        const auto runtimeDir = juce::SystemStats::getEnvironmentVariable("XDG_RUNTIME_DIR", {});
+
+        if (juce::File::isAbsolutePath(runtimeDir))
+            return juce::File(runtimeDir).getChildFile("modztakt-control").getFullPathName();
+
+        return "/tmp/modztakt-control." + juce::String((int) getuid());
+    }
+
+    // ---- Message thread ----
+    // Only the engine process opens it (it's the one owner of the segment,
+    // so a socket file left behind is stale)
+    bool open()
+    {
+        close();
+
+        const auto path = getPath();
+        sockaddr_un address {};
+        address.sun_family = AF_UNIX;
+
+        if ((size_t) path.getNumBytesAsUTF8() >= sizeof(address.sun_path))
+            return false;
+
+        path.copyToUTF8(address.sun_path, sizeof(address.sun_path));
+
+        fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+        wakeFd = eventfd(0, EFD_CLOEXEC);
+
+        if (fd < 0 || wakeFd < 0)
+        {
+            closeDescriptors();
+            return false;
+        }
+
+        unlink(address.sun_path);
+
+        if (bind(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0)
+        {
+            closeDescriptors();
+            return false;
+        }
+
+        chmod(address.sun_path, S_IRUSR | S_IWUSR);
+        boundPath = path;
+
+        startThread();
+        return true;
+    }
+
+    void close()
+    {
+        signalThreadShouldExit();
+
+        if (wakeFd >= 0)
+        {
+            const juce::uint64 one = 1;
+            [[maybe_unused]] const auto written = write(wakeFd, &one, sizeof(one));
+        }
+
+        stopThread(1000);
+
+        if (fd >= 0)
+            unlink(boundPath.toRawUTF8());
+
+        closeDescriptors();
+    }
+
+    bool isOpen() const noexcept   { return fd >= 0; }
+
+    // Receive thread: a batch is waiting for the engine and nextBatch()
+    std::function<void()> onBatchReceived;
+
+    // ModulationEngine::ControlSource (engine thread)
+    bool takeControl(ModulationEngine::Settings& settings, ModulationEngine::LfoRequest& lfoRequest,
+                     int& songPosition, double& issuedMs) noexcept override
+    {
+        int start1, size1, start2, size2;
+        engineQueue.prepareToRead(1, start1, size1, start2, size2);
+
+        if (size1 == 0)
+            return false;
+
+        const auto& batch = engineBatches[(size_t) start1];
+        apply(batch, settings, lfoRequest, songPosition);
+        issuedMs = batch.receivedMs;
+
+        engineQueue.finishedRead(1);
+        return true;
+    }
+
+    bool nextBatch(Batch& out) noexcept
+    {
+        int start1, size1, start2, size2;
+        queue.prepareToRead(1, start1, size1, start2, size2);
+
+        if (size1 == 0)
+            return false;
+
+        out = batches[(size_t) start1];
+        queue.finishedRead(1);
+        return true;
+    }
+
+    // Any thread
+    void reply(const Batch& batch, Result result, int operationIndex = 0) const noexcept
+    {
+        if (fd < 0 || batch.senderLength <= (socklen_t) sizeof(sa_family_t))
+            return;
+
+        std::array<juce::uint8, 12> bytes {};
+        bytes[0] = 'M';
+        bytes[1] = 'Z';
+        bytes[2] = (juce::uint8) version;
+        bytes[3] = (juce::uint8) result;
+
+        for (int i = 0; i < 4; ++i)
+        {
+            bytes[(size_t) (4 + i)] = (juce::uint8) (batch.sequence >> (8 * i));
+            bytes[(size_t) (8 + i)] = (juce::uint8) ((juce::uint32) operationIndex >> (8 * i));
+        }
+
+        sendto(fd, bytes.data(), bytes.size(), MSG_DONTWAIT,
+               reinterpret_cast<const sockaddr*>(&batch.sender), batch.senderLength);
+    }
+
+    // Applies a decoded batch to settings; the last start, stop, retrigger
+    // or resume in it wins. songPosition is only set by a songPosition op.
+    static void apply(const Batch& batch, ModulationEngine::Settings& settings,
+                      ModulationEngine::LfoRequest& lfoRequest, int& songPosition) noexcept
+    {
+        using LfoRequest = ModulationEngine::LfoRequest;
+
+        for (int i = 0; i < batch.numOps; ++i)
+        {
+            const auto& operation = batch.ops[(size_t) i];
+            const double value = operation.value;
+            const int whole = (int) operation.value;
+            auto& route = settings.routes[(size_t) juce::jlimit(0, ModulationEngine::maxRoutes - 1, operation.index)];
+            auto& eg = settings.eg;
+
+            switch (operation.op)
+            {
+                case Op::start:
+                case Op::retrigger:       lfoRequest = LfoRequest::start; break;
+                case Op::stop:            lfoRequest = LfoRequest::stop; break;
+                case Op::resume:          lfoRequest = LfoRequest::resume; break;
+                case Op::songPosition:    songPosition = whole; break;
+
+                case Op::rate:            settings.rateHz = value; break;
+                case Op::depth:           settings.depth = value; break;
+                case Op::shape:           settings.shapeId = whole; break;
+                case Op::sync:
+                    settings.syncEnabled = whole == 1;
+                    settings.clockMaster = whole == 2;
+                    break;
+                case Op::division:        settings.divisionId = whole; break;
+                case Op::noteRestart:     settings.noteRestartEnabled = whole != 0; break;
+                case Op::noteChannel:     settings.noteRestartChannel = whole; break;
+                case Op::tempo:           settings.masterBpm = value; break;
+
+                case Op::routeChannel:    route.midiChannel = whole; break;
+                case Op::routeOutput:     route.output = whole; break;
+                case Op::routeParameter:  route.parameterIndex = whole; break;
+                case Op::routeBipolar:    route.bipolar = whole != 0; break;
+                case Op::routeInvert:     route.invertPhase = whole != 0; break;
+                case Op::routeOneShot:    route.oneShot = whole != 0; break;
+                case Op::routeAmount:     route.amount = value; break;
+
+                case Op::egSource:        eg.noteSourceChannel = whole == 0 ? 17 : whole; break;
+                case Op::egChannel:       eg.outChannel = whole; break;
+                case Op::egParameter:     eg.outParamIndex = whole; break;
+                case Op::egAttack:        eg.attackMs = value; break;
+                case Op::egHold:          eg.holdMs = value; break;
+                case Op::egDecay:         eg.decayMs = value; break;
+                case Op::egSustain:       eg.sustainLevel = value; break;
+                case Op::egRelease:       eg.releaseMs = value; break;
+                case Op::egVelocity:      eg.velocityAmount = value; break;
+                case Op::egAmount:        settings.egAmount = value; break;
+            }
+        }
+    }
+
+private:
+    // ---- Receive thread ----
+    void run() override
+    {
+        std::array<juce::uint8, headerSize + maxOps * opSize> buffer {};
+        Batch batch;
+
+        while (!threadShouldExit())
+        {
+            std::array<pollfd, 2> pfds {{ { fd, POLLIN, 0 }, { wakeFd, POLLIN, 0 } }};
+
+            if (poll(pfds.data(), (nfds_t) pfds.size(), -1) <= 0 || (pfds[0].revents & POLLIN) == 0)
+                continue;
+
+            batch.senderLength = sizeof(batch.sender);
+            const auto size = recvfrom(fd, buffer.data(), buffer.size(), MSG_TRUNC,
+                                       reinterpret_cast<sockaddr*>(&batch.sender), &batch.senderLength);
+            batch.receivedMs = juce::Time::getMillisecondCounterHiRes();
+
+            if (size < 0)
+                continue;
+
+            int badOperation = 0;
+            const int received = size > (ssize_t) buffer.size() ? -1 : (int) size;   // truncated: too many ops
+            const auto result = decode(buffer.data(), received, batch, badOperation);
+
+            if (result != Result::applied)
+            {
+                telemetry.controlRejected();
+                reply(batch, result, badOperation);
+                continue;
+            }
+
+            // both queues or neither; only this thread writes them, so the
+            // space found stays there
+            if (engineQueue.getFreeSpace() == 0 || queue.getFreeSpace() == 0)
+            {
+                telemetry.controlRejected();
+                reply(batch, Result::busy);
+                continue;
+            }
+
+            push(engineQueue, engineBatches, batch);
+            push(queue, batches, batch);
+
+            telemetry.controlApplied();
+            reply(batch, Result::applied);
+
+            if (onBatchReceived)
+                onBatchReceived();
+        }
+    }
+
+    static void push(juce::AbstractFifo& fifo, std::array<Batch, queueSize>& entries, const Batch& batch) noexcept
+    {
+        int start1, size1, start2, size2;
+        fifo.prepareToWrite(1, start1, size1, start2, size2);
+
+        entries[(size_t) start1] = batch;
+        fifo.finishedWrite(1);
+    }
+
+    void closeDescriptors() noexcept
+    {
+        if (fd >= 0)
+            ::close(fd);
+
+        if (wakeFd >= 0)
+            ::close(wakeFd);
+
+        fd = -1;
+        wakeFd = -1;
+    }
+
+    static Result decode(const juce::uint8* data, int size, Batch& batch, int& badOperation) noexcept
+    {
+        batch.numOps = 0;
+        batch.sequence = size >= headerSize ? juce::ByteOrder::littleEndianInt(data + 4) : 0;
+
+        if (size < headerSize || data[0] != 'M' || data[1] != 'Z' || data[2] != version)
+            return Result::malformed;
+
+        const int numOps = data[3];
+
+        if (numOps < 1 || numOps > maxOps || size != headerSize + numOps * opSize)
+            return Result::malformed;
+
+        for (int i = 0; i < numOps; ++i)
+        {
+            const auto* bytes = data + headerSize + i * opSize;
+            const auto bits = juce::ByteOrder::littleEndianInt(bytes + 4);
+
+            auto& operation = batch.ops[(size_t) i];
+            operation.op = (Op) bytes[0];
+            operation.index = bytes[1];
+            std::memcpy(&operation.value, &bits, sizeof(float));
+
+            badOperation = i;
+
+            if (!isKnown(operation.op))
+                return Result::unknownOp;
+
+            if (!isValid(operation))
+                return Result::badValue;
+        }
+
+        badOperation = 0;
+        batch.numOps = numOps;
+        return Result::applied;
+    }
+
+    static bool isKnown(Op op) noexcept
+    {
+        const int code = (int) op;
+
+        return (code >= (int) Op::start && code <= (int) Op::songPosition)
+            || (code >= (int) Op::rate && code <= (int) Op::tempo)
+            || (code >= (int) Op::routeChannel && code <= (int) Op::routeAmount)
+            || (code >= (int) Op::egSource && code <= (int) Op::egAmount);
+    }
+
+    static bool isValid(const Operation& operation) noexcept
+    {
+        const float v = operation.value;
+
+        if (!std::isfinite(v))
+            return false;
+
+        const bool whole = v == std::floor(v);
+        const int lastParameter = (int) numSyntaktParameters - 1;
+        auto inRange = [v](double low, double high)    { return v >= low && v <= high; };
+        auto wholeIn = [v, whole](int low, int high)   { return whole && v >= (float) low && v <= (float) high; };
+
+        // route operations name one
+        if ((int) operation.op >= (int) Op::routeChannel && (int) operation.op <= (int) Op::routeAmount
+            && !juce::isPositiveAndBelow(operation.index, ModulationEngine::maxRoutes))
+            return false;
+
+        switch (operation.op)
+        {
+            case Op::start:
+            case Op::stop:
+            case Op::retrigger:
+            case Op::resume:          return true;
+            case Op::songPosition:    return wholeIn(0, 0x3fff);
+
+            case Op::rate:            return inRange(0.01, 100.0);
+            case Op::depth:           return inRange(0.0, 1.0);
+            case Op::shape:           return wholeIn(1, 5);
+            case Op::sync:            return wholeIn(0, 2);
+            case Op::division:        return wholeIn(1, 8);
+            case Op::noteRestart:     return wholeIn(0, 1);
+            case Op::noteChannel:     return wholeIn(0, 16);
+            case Op::tempo:           return inRange(MidiClockGenerator::minBpm, MidiClockGenerator::maxBpm);
+
+            case Op::routeChannel:    return wholeIn(0, 16);
+            case Op::routeOutput:     return wholeIn(0, ModulationEngine::maxOutputs - 1);
+            case Op::routeParameter:  return wholeIn(0, lastParameter);
+            case Op::routeBipolar:
+            case Op::routeInvert:
+            case Op::routeOneShot:    return wholeIn(0, 1);
+            case Op::routeAmount:     return inRange(-1.0, 1.0);
+
+            case Op::egSource:        return wholeIn(0, 16);
+            case Op::egChannel:       return wholeIn(1, 16);
+            case Op::egParameter:     return wholeIn(-1, lastParameter);
+            case Op::egAttack:
+            case Op::egHold:
+            case Op::egDecay:
+            case Op::egRelease:       return inRange(0.0, 60000.0);
+            case Op::egSustain:
+            case Op::egVelocity:      return inRange(0.0, 1.0);
+            case Op::egAmount:        return inRange(-1.0, 1.0);
+        }
+
+        return false;
+    }
+
+    EngineTelemetry& telemetry;
+    int fd = -1;
+    int wakeFd = -1;    // written by close()
+    juce::String boundPath;
+
+    juce::AbstractFifo engineQueue { queueSize };       // receive -> engine
+    std::array<Batch, queueSize> engineBatches {};
+    juce::AbstractFifo queue { queueSize };             // receive -> message thread
+    std::array<Batch, queueSize> batches {};
+
+    JUCE_DECLARE_NON_COPYABLE(ControlSocket)
+};
@@ -73,6 +73,42 @@ inline std::unique_ptr<juce::Drawable> loadOffSvg()
                               BinaryData::checkbox_off_svgSize);
 }
 
+// ==========================================
+// Shared LED drawables
+// ==========================================
+// Every LED toggle uses one of five SVGs. They are parsed once, on first use,
+// and kept for the lifetime of the process; DrawableButton copies what it is
+// given, so buttons only pay for a cheap clone instead of an XML + SVG parse.
+// Message thread only.
+class LedDrawables
+{
+    public:
+        static const LedDrawables& get()
+        {
+            static const LedDrawables instance;
+            return instance;
+        }
+
+        const juce::Drawable* getOff() const noexcept   { return off.get(); }
+
+        const juce::Drawable* getOn (SetupUI::LedColour c) const noexcept
+        {
+            return on[(size_t) c].get();
+        }
+
+    private:
+        LedDrawables()
+            : off (loadOffSvg())
+        {
+            for (auto c : { SetupUI::LedColour::Red, SetupUI::LedColour::Green,
+                            SetupUI::LedColour::Orange, SetupUI::LedColour::Purple })
+                on[(size_t) c] = loadSvgFromBinary (getOnSvgData (c), getOnSvgSize (c));
+        }
+
+        std::unique_ptr<juce::Drawable> off;
+        std::array<std::unique_ptr<juce::Drawable>, 4> on;
+};
+
 // ==========================================
 // Image based toggle button
 // ==========================================
@@ -81,22 +117,16 @@ class LedToggleButton : public juce::DrawableButton
     public:
         LedToggleButton (const juce::String& name,
                          SetupUI::LedColour colour)
-            : juce::DrawableButton (name, juce::DrawableButton::ImageStretched),
-              offDrawable (loadOffSvg()),
-              onDrawable  (loadSvgFromBinary (getOnSvgData (colour),
-                                              getOnSvgSize (colour)))
+            : juce::DrawableButton (name, juce::DrawableButton::ImageStretched)
         {
-            jassert (offDrawable && onDrawable);
+            const auto& drawables = LedDrawables::get();
+            jassert (drawables.getOff() != nullptr && drawables.getOn (colour) != nullptr);
 
             setClickingTogglesState (true);
 
-            setImages (offDrawable.get(), nullptr, nullptr, nullptr,
-                       onDrawable.get(),  nullptr, nullptr, nullptr);
+            setImages (drawables.getOff(),     nullptr, nullptr, nullptr,
+                       drawables.getOn (colour), nullptr, nullptr, nullptr);
         }
-
-    private:
-        std::unique_ptr<juce::Drawable> offDrawable;
-        std::unique_ptr<juce::Drawable> onDrawable;
 };
 
 // ==========================================
@@ -0,0 +1,120 @@
+#pragma once
+#include <JuceHeader.h>
+#include "SyntaktParameterTable.h"
+
+// ==========================================
+// Device shadow state
+// ==========================================
+// What the device on the output port should currently hold: the last value
+// transmitted for every (channel, CC/NRPN parameter), or unknown. The engine
+// consults it before each send, so a value the device already has never
+// goes out twice, whichever source produced it and however often the LFO
+// was restarted. Entries are only written once the port has taken the
+// message, and the whole register is forgotten when the output changes or
+// the port reports dropped bytes: the device's state is unknown then.
+//
+// Optionally seeded from the MIDI input. The Syntakt echoes its CC/NRPNs
+// when a knob is turned, which keeps the register in step with edits made
+// on the device itself.
+class DeviceShadow
+{
+public:
+    static constexpr int numChannels = 16;
+    static constexpr int unknown = -1;
+
+    DeviceShadow()
+    {
+        ccToParameter.fill(-1);
+
+        for (size_t i = 0; i < numSyntaktParameters; ++i)
+            if (syntaktParameters[i].isCC && juce::isPositiveAndBelow(syntaktParameters[i].ccNumber, 128))
+                ccToParameter[(size_t) syntaktParameters[i].ccNumber] = (int) i;
+
+        clear();
+    }
+
+    // ---- Engine thread ----
+    int get(int midiChannel, size_t parameterIndex) const noexcept
+    {
+        return values[(size_t) (midiChannel - 1)][parameterIndex].load(std::memory_order_relaxed);
+    }
+
+    void set(int midiChannel, size_t parameterIndex, int value) noexcept
+    {
+        values[(size_t) (midiChannel - 1)][parameterIndex].store(value, std::memory_order_relaxed);
+    }
+
+    void clear() noexcept
+    {
+        for (auto& channel : values)
+            for (auto& v : channel)
+                v.store(unknown, std::memory_order_relaxed);
+    }
+
+    // Tick start: honours invalidate()
+    void applyInvalidation() noexcept
+    {
+        if (invalidateRequested.exchange(false, std::memory_order_acquire))
+            clear();
+    }
+
+    // ---- Any thread ----
+    // The device may have changed behind the port's back (e.g. a JACK
+    // connection moved): forgotten at the start of the next tick.
+    void invalidate() noexcept   { invalidateRequested.store(true, std::memory_order_release); }
+
+    void setSeedingEnabled(bool shouldSeed) noexcept   { seeding.store(shouldSeed, std::memory_order_relaxed); }
+
+    // ---- MIDI input thread (the device's source only) ----
+    // A controller received from the device: a plain CC parameter, or part
+    // of an NRPN (99/98 select, 6/38 value; the value lands with CC 38).
+    void seedFromInput(int midiChannel, int controller, int value) noexcept
+    {
+        if (!seeding.load(std::memory_order_relaxed)
+            || !juce::isPositiveAndBelow(midiChannel - 1, numChannels)
+            || !juce::isPositiveAndBelow(controller, 128))
+            return;
+
+        auto& nrpn = nrpnInput[(size_t) (midiChannel - 1)];
+
+        switch (controller)
+        {
+            case 99: nrpn.msb = value; nrpn.valueMsb = -1; break;
+            case 98: nrpn.lsb = value; nrpn.valueMsb = -1; break;
+            case 6:  nrpn.valueMsb = value; break;
+
+            case 38:
+                if (nrpn.valueMsb >= 0)
+                    if (const int index = findNrpn(nrpn.msb, nrpn.lsb); index >= 0)
+                        set(midiChannel, (size_t) index, (nrpn.valueMsb << 7) | value);
+                break;
+
+            default: break;
+        }
+
+        if (const int index = ccToParameter[(size_t) controller]; index >= 0)
+            set(midiChannel, (size_t) index, value);
+    }
+
+private:
+    static int findNrpn(int msb, int lsb) noexcept
+    {
+        for (size_t i = 0; i < numSyntaktParameters; ++i)
+            if (!syntaktParameters[i].isCC && syntaktParameters[i].nrpnMsb == msb && syntaktParameters[i].nrpnLsb == lsb)
+                return (int) i;
+
+        return -1;
+    }
+
+    struct NrpnInput
+    {
+        int msb = -1, lsb = -1, valueMsb = -1;
+    };
+
+    std::array<std::array<std::atomic<int>, numSyntaktParameters>, numChannels> values;
+    std::array<int, 128> ccToParameter;
+    std::array<NrpnInput, numChannels> nrpnInput {};   // input thread only
+
+    std::atomic<bool> invalidateRequested { false };
+    std::atomic<bool> seeding { false };
+};
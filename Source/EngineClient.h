@@ -0,0 +1,487 @@
+#pragma once
+#include <JuceHeader.h>
+#include "SharedControlSurface.h"
+#include "MidiMonitorWindow.h"
+#include "EngineTrace.h"
+
+// ==========================================
+// Engine client
+// ==========================================
+// A front-end's handle on the engine process. Calls that used to go to the
+// engine and the device manager become commands; what the UI shows comes
+// from the last Status the engine published, with the device lists turned
+// back into juce::MidiDeviceInfo so the selectors are filled as before.
+//
+// update() is called from the UI timer. It picks up a new status, and copies
+// the probes the scope is attached to, and the monitor events, into local
+// rings, so ScopeModalComponent and MidiMonitorWindow read them the way they
+// did from an engine in the same process.
+//
+// With no engine running, the client starts one (this executable with
+// --daemon) and attaches once it's up; the same happens if the engine dies.
+// An engine that was just started has no settings yet and gets this
+// front-end's, and the device choices it knew of if it had been attached to
+// a previous one. An engine that was already running keeps its own:
+// onSettingsChanged hands them to the UI, as it does whenever another
+// front-end changes them.
+class EngineClient
+{
+public:
+    static constexpr double launchRetryMs = 3000.0;
+
+    EngineClient()
+    {
+        connect();
+    }
+
+    // ---- Message thread ----
+    // UI timer. Returns false while there's no engine to talk to.
+    bool update()
+    {
+        if (surface != nullptr && !surface->isEngineRunning())
+        {
+            surface.reset();
+
+            if (onConnectionChanged)
+                onConnectionChanged();
+        }
+
+        if (surface == nullptr && !connect())
+            return false;
+
+        SharedControlSurface::Status newStatus;
+
+        if (!surface->readStatus(newStatus))
+            return true;
+
+        const bool devicesChanged = newStatus.devicesRevision != status.devicesRevision || !synced;
+        const bool settingsChanged = newStatus.settingsRevision > 0
+                                     && newStatus.settingsRevision != status.settingsRevision
+                                     && newStatus.settingsSender != (int) getpid();
+        const bool backendFailed = newStatus.backendFailures != status.backendFailures && synced;
+        const bool automationFailed = newStatus.automationFailures != status.automationFailures && synced;
+        const bool presetsFailed = newStatus.presetFailures != status.presetFailures && synced;
+
+        if (!synced)
+            sync(newStatus);
+
+        status = newStatus;
+
+        if (devicesChanged)
+            rebuildDeviceLists();
+
+        if (settingsChanged && onSettingsChanged)
+            onSettingsChanged(status.settings);
+
+        if (devicesChanged && onDevicesChanged)
+            onDevicesChanged();
+
+        if (backendFailed && onBackendFailed)
+            onBackendFailed();
+
+        if (automationFailed && onAutomationFailed)
+            onAutomationFailed();
+
+        if (presetsFailed && onPresetsFailed)
+            onPresetsFailed();
+
+        forwardProbes();
+
+        #if JUCE_DEBUG
+        forwardMonitor();
+        #endif
+
+        return true;
+    }
+
+    bool isConnected() const noexcept   { return surface != nullptr && synced; }
+
+    // The engine's telemetry (a local, idle one while not connected). It
+    // changes with the engine: drop references to it on onConnectionChanged.
+    EngineTelemetry& getTelemetry() noexcept   { return surface != nullptr ? surface->getTelemetry() : offlineTelemetry; }
+
+    // ---- Engine ----
+    void publishSettings(const ModulationEngine::Settings& newSettings)
+    {
+        settings = newSettings;
+        hasSettings = true;
+
+        // held back until it's known whether the engine has its own
+        if (!isConnected())
+            return;
+
+        Command command;
+        command.kind = Command::setSettings;
+        command.settings = settings;
+        send(command);
+    }
+
+    void startLfo()
+    {
+        status.lfoActive = true;
+        send(Command::startLfo);
+    }
+
+    void stopLfo()
+    {
+        status.lfoActive = false;
+        send(Command::stopLfo);
+    }
+
+    bool isLfoActive() const noexcept   { return status.lfoActive; }
+    double getCurrentBpm() const noexcept   { return status.bpm; }
+
+    void setNoteOffStop(bool shouldStop)
+    {
+        status.noteOffStop = shouldStop;
+        send(Command::noteOffStop, 0, shouldStop ? 1 : 0);
+    }
+
+    bool getNoteOffStop() const noexcept   { return status.noteOffStop; }
+
+    void setRealtimeSettings(const RealtimeSettings& newSettings)
+    {
+        status.realtime = newSettings;
+
+        Command command;
+        command.kind = Command::setRealtime;
+        command.realtime = newSettings;
+        send(command);
+    }
+
+    const RealtimeSettings& getRealtimeSettings() const noexcept   { return status.realtime; }
+
+    // Traces this front-end's threads along with the engine process. When
+    // stopped, the front-end's trace is written to the file first and the
+    // engine merges its own into it (empty file: both dropped).
+    void startTrace()
+    {
+        status.traceEnabled = true;
+        EngineTrace::start();
+        send(Command::startTrace);
+    }
+
+    void stopTrace(const juce::File& file)
+    {
+        status.traceEnabled = false;
+        EngineTrace::stop();
+
+        if (file != juce::File())
+        {
+            file.deleteFile();
+            juce::FileOutputStream out(file);
+
+            if (out.openedOk())
+                EngineTrace::writeJson(out, 2, "Window");
+        }
+
+        sendPath(Command::stopTrace, file);
+    }
+
+    bool isTraceEnabled() const noexcept   { return status.traceEnabled; }
+
+    // Automation, kept by the engine process; files are read and written
+    // by it too. Failures are reported through onAutomationFailed.
+    void setAutomationRecording(bool shouldRecord)
+    {
+        status.automationRecording = shouldRecord;
+        send(Command::recordAutomation, 0, shouldRecord ? 1 : 0);
+    }
+
+    void setAutomationPlaying(bool shouldPlay)
+    {
+        status.automationPlaying = shouldPlay;
+        send(Command::playAutomation, 0, shouldPlay ? 1 : 0);
+    }
+
+    void exportAutomation(const juce::File& file)   { sendPath(Command::exportAutomation, file); }
+    void importAutomation(const juce::File& file)   { sendPath(Command::importAutomation, file); }
+
+    bool isAutomationRecording() const noexcept   { return status.automationRecording; }
+    bool isAutomationPlaying() const noexcept     { return status.automationPlaying; }
+    int getAutomationLanes() const noexcept       { return status.automationLanes; }
+    int getAutomationBars() const noexcept        { return status.automationBars; }
+
+    // Presets, kept and saved by the engine process. A recall comes back
+    // as settings (onSettingsChanged) once the engine has them; failures are
+    // reported through onPresetsFailed.
+    void storePreset(int slot, const juce::String& name)
+    {
+        Command command;
+        command.kind = Command::storePreset;
+        command.slot = slot;
+        name.copyToUTF8(command.path.data(), command.path.size());
+        send(command);
+    }
+
+    void clearPreset(int slot)   { send(Command::clearPreset, slot); }
+
+    void recallPreset(int slot, ModulationEngine::SwitchPoint at, bool resetPhases)
+    {
+        send(Command::recallPreset, slot, (int) at | (resetPhases ? Command::resetPhasesFlag : 0));
+    }
+
+    void exportPresets(const juce::File& file)   { sendPath(Command::exportPresets, file); }
+    void importPresets(const juce::File& file)   { sendPath(Command::importPresets, file); }
+
+    // empty for an unused slot
+    juce::String getPresetName(int slot) const   { return juce::String::fromUTF8(status.presetNames[(size_t) slot].data()); }
+    int getActivePreset() const noexcept         { return status.activePreset; }
+
+    // Ends the engine process, and the modulation with it
+    void quitEngine()   { send(Command::quit); }
+
+    // Scope rings, fed by update()
+    EngineProbes::Set probes;
+
+    #if JUCE_DEBUG
+    void setMonitor(MidiMonitorSink* m) noexcept   { monitor = m; }
+
+    // Last Note-On that restarted the LFO, packed as (channel << 8) | note, or -1
+    int takeRestartNote() noexcept
+    {
+        if (status.restartNote == shownRestartNote)
+            return -1;
+
+        shownRestartNote = status.restartNote;
+        return shownRestartNote;
+    }
+    #endif
+
+    // ---- Devices (as MidiDeviceManager) ----
+    const juce::Array<juce::MidiDeviceInfo>& getOutputs() const noexcept   { return outputs; }
+    const juce::Array<juce::MidiDeviceInfo>& getInputs() const noexcept    { return inputs; }
+
+    void selectOutput(const juce::MidiDeviceInfo& device, int slot = 0)   { sendDevice(Command::selectOutput, device, slot); }
+    void selectInput(const juce::MidiDeviceInfo& device, int slot = 0)    { sendDevice(Command::selectInput, device, slot); }
+
+    const juce::MidiDeviceInfo& getSelectedOutput(int slot = 0) const noexcept   { return selectedOutputs[(size_t) slot]; }
+    const juce::MidiDeviceInfo& getSelectedInput(int slot = 0) const noexcept    { return selectedInputs[(size_t) slot]; }
+
+    int getNumOutputSlots() const noexcept   { return status.numOutputSlots; }
+    int getNumInputSlots() const noexcept    { return status.numInputSlots; }
+
+    void setInputRoles(int slot, int roles)
+    {
+        status.inputRoles[(size_t) slot] = roles;
+        send(Command::inputRoles, slot, roles);
+    }
+
+    int getInputRoles(int slot) const noexcept   { return status.inputRoles[(size_t) slot]; }
+
+    void setThruOutput(int slot)
+    {
+        status.thruOutput = slot;
+        send(Command::thruOutput, 0, slot);
+    }
+
+    int getThruOutput() const noexcept   { return status.thruOutput; }
+
+    void setThruKinds(int kinds)
+    {
+        status.thruKinds = kinds;
+        send(Command::thruKinds, 0, kinds);
+    }
+
+    int getThruKinds() const noexcept   { return status.thruKinds; }
+
+    // JACK without a server running is reported through onBackendFailed
+    void setBackend(MidiDeviceManager::Backend backend)   { send(Command::backend, 0, (int) backend); }
+
+    MidiDeviceManager::Backend getBackend() const noexcept   { return (MidiDeviceManager::Backend) status.backend; }
+    bool isEngineDrivenByJack() const noexcept               { return status.engineDrivenByJack; }
+
+    // ---- Message thread callbacks ----
+    std::function<void()> onDevicesChanged;                                     // lists or selections
+    std::function<void(const ModulationEngine::Settings&)> onSettingsChanged;   // set by the engine or another front-end
+    std::function<void()> onBackendFailed;
+    std::function<void()> onAutomationFailed;                                   // export or import
+    std::function<void()> onPresetsFailed;                                      // export, import or recall
+    std::function<void()> onConnectionChanged;                                  // engine found or gone (getTelemetry() changes)
+
+private:
+    using Command = SharedControlSurface::Command;
+
+    bool connect()
+    {
+        surface = SharedControlSurface::attach();
+
+        if (surface == nullptr)
+        {
+            launchEngine();
+            return false;
+        }
+
+        synced = false;
+        send(Command::hello);
+
+        if (onConnectionChanged)
+            onConnectionChanged();
+
+        return true;
+    }
+
+    // Another front-end may be starting one too: only one of them gets the segment
+    void launchEngine()
+    {
+        const double nowMs = juce::Time::getMillisecondCounterHiRes();
+
+        if (nowMs - lastLaunchMs < launchRetryMs)
+            return;
+
+        lastLaunchMs = nowMs;
+        juce::File::getSpecialLocation(juce::File::currentExecutableFile).startAsProcess("--daemon");
+    }
+
+    // First status from a (new) engine
+    void sync(const SharedControlSurface::Status& engineStatus)
+    {
+        synced = true;
+
+        if (engineStatus.settingsRevision > 0)
+            return;
+
+        // a fresh engine: this front-end's settings, and what the previous
+        // engine had been told
+        if (hasSettings)
+            publishSettings(settings);
+
+        if (status.devicesRevision == 0)
+            return;
+
+        send(Command::noteOffStop, 0, status.noteOffStop ? 1 : 0);
+
+        if (status.backend != engineStatus.backend)
+            send(Command::backend, 0, status.backend);
+
+        setRealtimeSettings(status.realtime);
+
+        for (int slot = 0; slot < MidiDeviceManager::maxOutputs; ++slot)
+            sendDevice(Command::selectOutput, status.selectedOutputs[(size_t) slot].toInfo(), slot);
+
+        for (int slot = 0; slot < MidiDeviceManager::maxInputs; ++slot)
+        {
+            sendDevice(Command::selectInput, status.selectedInputs[(size_t) slot].toInfo(), slot);
+            send(Command::inputRoles, slot, status.inputRoles[(size_t) slot]);
+        }
+
+        send(Command::thruOutput, 0, status.thruOutput);
+        send(Command::thruKinds, 0, status.thruKinds);
+    }
+
+    void send(Command::Kind kind, int slot = 0, int value = 0)
+    {
+        Command command;
+        command.kind = kind;
+        command.slot = slot;
+        command.value = value;
+        send(command);
+    }
+
+    void send(const Command& command)
+    {
+        // a full ring means the engine isn't taking commands; nothing to wait for
+        if (surface != nullptr)
+            surface->send(command);
+    }
+
+    void sendDevice(Command::Kind kind, const juce::MidiDeviceInfo& device, int slot)
+    {
+        Command command;
+        command.kind = kind;
+        command.slot = slot;
+        command.device = SharedControlSurface::Device::from(device);
+        send(command);
+    }
+
+    void sendPath(Command::Kind kind, const juce::File& file)
+    {
+        Command command;
+        command.kind = kind;
+        file.getFullPathName().copyToUTF8(command.path.data(), command.path.size());
+        send(command);
+    }
+
+    void rebuildDeviceLists()
+    {
+        outputs.clearQuick();
+        inputs.clearQuick();
+
+        for (int i = 0; i < status.numOutputs; ++i)
+            outputs.add(status.outputs[(size_t) i].toInfo());
+
+        for (int i = 0; i < status.numInputs; ++i)
+            inputs.add(status.inputs[(size_t) i].toInfo());
+
+        for (int slot = 0; slot < MidiDeviceManager::maxOutputs; ++slot)
+            selectedOutputs[(size_t) slot] = status.selectedOutputs[(size_t) slot].toInfo();
+
+        for (int slot = 0; slot < MidiDeviceManager::maxInputs; ++slot)
+            selectedInputs[(size_t) slot] = status.selectedInputs[(size_t) slot].toInfo();
+    }
+
+    // Probes the scope has attached locally are asked for from the engine
+    void forwardProbes()
+    {
+        for (int p = 0; p < EngineProbes::numProbes; ++p)
+        {
+            const auto id = (EngineProbes::Id) p;
+            auto& feed = surface->getProbeFeed(id);
+            auto& cursor = probeCursors[(size_t) p];
+
+            if (!probes.isAttached(id))
+            {
+                cursor = feed.ring.getNumWritten();
+                continue;
+            }
+
+            feed.want();
+            feed.ring.read(cursor, [this, id](const EngineProbes::Sample& sample)
+            {
+                probes.push(id, sample.timeMs, sample.value);
+            });
+        }
+    }
+
+    #if JUCE_DEBUG
+    void forwardMonitor()
+    {
+        auto& feed = surface->getMonitorFeed();
+
+        if (monitor == nullptr)
+        {
+            monitorCursor = feed.ring.getNumWritten();
+            return;
+        }
+
+        feed.want();
+        feed.ring.read(monitorCursor, [this](const SharedControlSurface::MonitorEvent& e)
+        {
+            if (e.size > 0)
+                monitor->pushEvent(juce::MidiMessage(e.bytes.data(), e.size), e.incoming);
+        });
+    }
+
+    MidiMonitorSink* monitor = nullptr;
+    int shownRestartNote = -1;
+    juce::uint64 monitorCursor = 0;
+    #endif
+
+    std::unique_ptr<SharedControlSurface> surface;
+    bool synced = false;
+    double lastLaunchMs = -launchRetryMs;
+
+    SharedControlSurface::Status status;   // last published, with this front-end's changes since
+    ModulationEngine::Settings settings;   // last sent
+    bool hasSettings = false;
+
+    juce::Array<juce::MidiDeviceInfo> outputs, inputs;
+    std::array<juce::MidiDeviceInfo, MidiDeviceManager::maxOutputs> selectedOutputs;
+    std::array<juce::MidiDeviceInfo, MidiDeviceManager::maxInputs> selectedInputs;
+
+    std::array<juce::uint64, EngineProbes::numProbes> probeCursors {};
+
+    EngineTelemetry offlineTelemetry;
+
+    JUCE_DECLARE_NON_COPYABLE(EngineClient)
+};
@@ -0,0 +1,402 @@
+#pragma once
+#include <JuceHeader.h>
+#include "EngineHost.h"
+#include "SharedControlSurface.h"
+#include "ControlSocket.h"
+#include "EngineTrace.h"
+
+// ==========================================
+// Engine daemon
+// ==========================================
+// The engine process (started with --daemon): one EngineHost, driven
+// through the shared control surface instead of a window, so closing or
+// crashing a front-end never stops the modulation, and any number of them
+// can attach.
+//
+// A command thread sleeps on the segment's semaphore and hands whatever
+// front-ends posted to the message thread, which applies it to the host the
+// way the controls used to, then publishes the resulting Status. While at
+// least one front-end is attached, a timer also publishes the status (tempo,
+// LFO state) and copies the probes and monitor events front-ends read into
+// the segment. With none attached only the engine and the command thread
+// run.
+//
+// On its first start the daemon opens the first output and input, as the
+// window did; front-ends change that through commands.
+//
+// Show-control software drives it through the control socket instead: the
+// engine takes each batch up as one snapshot straight from the socket's
+// receive thread, so a busy message thread (a preset save, a device scan)
+// doesn't hold it up. The message thread follows afterwards, and front-ends
+// are sent the resulting settings like any other change.
+class EngineDaemon : private juce::Thread,
+                     private juce::AsyncUpdater,
+                     private juce::Timer
+{
+public:
+    static constexpr int publishHz = 30;
+
+    explicit EngineDaemon(std::unique_ptr<SharedControlSurface> controlSurface)
+        : juce::Thread("Engine commands"),
+          surface(std::move(controlSurface)),
+          host(surface->getTelemetry())
+    {
+        auto& devices = host.getDevices();
+        devices.onDevicesChanged = [this] { devicesChanged(); };
+
+        host.start();
+
+        if (devices.getOutputs().size() > 0)
+            devices.selectOutput(devices.getOutputs()[0]);
+
+        // first input (third in debug builds) if present
+        #if JUCE_DEBUG
+            const int defaultInput = 2;
+        #else
+            const int defaultInput = 0;
+        #endif
+
+        if (devices.getInputs().size() > 0)
+            devices.selectInput(devices.getInputs()[juce::jmin(defaultInput, devices.getInputs().size() - 1)]);
+
+        devicesChanged();
+        startThread();
+
+        controlSocket.onBatchReceived = [this]
+        {
+            host.controlReceived();
+            triggerAsyncUpdate();
+        };
+
+        if (controlSocket.open())
+            host.setControlSource(&controlSocket);
+        else
+            DBG("Control socket unavailable: " << ControlSocket::getPath());
+    }
+
+    ~EngineDaemon() override
+    {
+        controlSocket.close();
+        host.setControlSource(nullptr);
+
+        signalThreadShouldExit();
+        surface->wakeWaiter();
+        stopThread(1000);
+
+        cancelPendingUpdate();
+        stopTimer();
+
+        #if JUCE_DEBUG
+        // a tick may still be inside monitorForwarder
+        const auto token = host.getEngine().setMonitor(nullptr);
+
+        while (!host.getEngine().isRetired(token))
+            juce::Thread::yield();
+        #endif
+    }
+
+    // Called on the message thread for a quit command
+    std::function<void()> onQuit;
+
+private:
+    // ---- Command thread ----
+    void run() override
+    {
+        while (!threadShouldExit())
+            if (surface->waitForCommand() && !threadShouldExit())
+                triggerAsyncUpdate();
+    }
+
+    // ---- Message thread ----
+    void handleAsyncUpdate() override
+    {
+        SharedControlSurface::Command command;
+
+        while (surface->nextCommand(command))
+            apply(command);
+
+        while (controlSocket.nextBatch(batch))
+            followBatch(batch);
+
+        publishStatus();
+
+        if (!isTimerRunning() && surface->getNumClients() > 0)
+            startTimerHz(publishHz);
+    }
+
+    void apply(const SharedControlSurface::Command& command)
+    {
+        using Command = SharedControlSurface::Command;
+        auto& devices = host.getDevices();
+
+        switch (command.kind)
+        {
+            case Command::hello:
+                break;
+
+            case Command::setSettings:
+                host.publishSettings(command.settings);
+                ++status.settingsRevision;
+                status.settingsSender = command.sender;
+                break;
+
+            case Command::startLfo:     host.startLfo(); break;
+            case Command::stopLfo:      host.stopLfo(); break;
+            case Command::noteOffStop:  host.setNoteOffStop(command.value != 0); break;
+
+            case Command::selectOutput:
+                devices.selectOutput(command.device.toInfo(), command.slot);
+                ++status.devicesRevision;
+                break;
+
+            case Command::selectInput:
+                devices.selectInput(command.device.toInfo(), command.slot);
+                ++status.devicesRevision;
+                break;
+
+            case Command::inputRoles:
+                if (juce::isPositiveAndBelow(command.slot, MidiDeviceManager::maxInputs))
+                    devices.setInputRoles(command.slot, command.value);
+                break;
+
+            case Command::thruOutput:   devices.setThruOutput(command.value); break;
+            case Command::thruKinds:    devices.setThruKinds(command.value); break;
+
+            case Command::backend:
+                if (!devices.setBackend((MidiDeviceManager::Backend) command.value))
+                    ++status.backendFailures;
+                break;
+
+            case Command::setRealtime:  host.setRealtimeSettings(command.realtime); break;
+            case Command::startTrace:   EngineTrace::start(); break;
+
+            case Command::stopTrace:
+            {
+                EngineTrace::stop();
+                const juce::String path = juce::String::fromUTF8(command.path.data());
+
+                // with the front-end's own trace, if it wrote one there first
+                if (juce::File::isAbsolutePath(path))
+                    EngineTrace::mergeJson(juce::File(path), 1, "Engine");
+
+                break;
+            }
+
+            case Command::recordAutomation:   host.setAutomationRecording(command.value != 0); break;
+            case Command::playAutomation:     host.setAutomationPlaying(command.value != 0); break;
+
+            case Command::exportAutomation:
+            case Command::importAutomation:
+            {
+                const juce::String path = juce::String::fromUTF8(command.path.data());
+                const bool done = juce::File::isAbsolutePath(path)
+                               && (command.kind == Command::exportAutomation ? host.exportAutomation(juce::File(path))
+                                                                             : host.importAutomation(juce::File(path)));
+                if (!done)
+                    ++status.automationFailures;
+                break;
+            }
+
+            case Command::storePreset:
+                host.storePreset(command.slot, juce::String::fromUTF8(command.path.data()));
+                break;
+
+            case Command::clearPreset:  host.clearPreset(command.slot); break;
+
+            case Command::recallPreset:
+            {
+                const auto at = (ModulationEngine::SwitchPoint) juce::jlimit(0, 2, command.value & 0xff);
+
+                if (!host.recallPreset(command.slot, at, (command.value & Command::resetPhasesFlag) != 0))
+                {
+                    ++status.presetFailures;
+                    break;
+                }
+
+                // not sent by any front-end: all of them show it
+                ++status.settingsRevision;
+                status.settingsSender = 0;
+                break;
+            }
+
+            case Command::exportPresets:
+            case Command::importPresets:
+            {
+                const juce::String path = juce::String::fromUTF8(command.path.data());
+                const bool done = juce::File::isAbsolutePath(path)
+                               && (command.kind == Command::exportPresets ? host.exportPresets(juce::File(path))
+                                                                          : host.importPresets(juce::File(path)));
+                if (!done)
+                    ++status.presetFailures;
+                break;
+            }
+
+            case Command::quit:
+                if (onQuit)
+                    onQuit();
+                break;
+        }
+    }
+
+    // The engine took the batch up already (and the sender has its reply):
+    // the same edits to the host's settings, for the status
+    void followBatch(const ControlSocket::Batch& controlBatch)
+    {
+        auto settings = host.getSettings();
+        auto lfoRequest = ModulationEngine::LfoRequest::none;
+        int songPosition = -1;
+        ControlSocket::apply(controlBatch, settings, lfoRequest, songPosition);
+        host.controlApplied(settings);
+
+        // not sent by any front-end: all of them show it
+        ++status.settingsRevision;
+        status.settingsSender = 0;
+    }
+
+    void devicesChanged()
+    {
+        ++status.devicesRevision;
+        publishStatus();
+    }
+
+    void publishStatus()
+    {
+        auto& devices = host.getDevices();
+        const auto& outputs = devices.getOutputs();
+        const auto& inputs = devices.getInputs();
+
+        status.settings = host.getSettings();
+
+        status.numOutputs = juce::jmin(outputs.size(), SharedControlSurface::maxDevices);
+        status.numInputs = juce::jmin(inputs.size(), SharedControlSurface::maxDevices);
+
+        for (int i = 0; i < status.numOutputs; ++i)
+            status.outputs[(size_t) i] = SharedControlSurface::Device::from(outputs[i]);
+
+        for (int i = 0; i < status.numInputs; ++i)
+            status.inputs[(size_t) i] = SharedControlSurface::Device::from(inputs[i]);
+
+        for (int slot = 0; slot < MidiDeviceManager::maxOutputs; ++slot)
+            status.selectedOutputs[(size_t) slot] = SharedControlSurface::Device::from(devices.getSelectedOutput(slot));
+
+        for (int slot = 0; slot < MidiDeviceManager::maxInputs; ++slot)
+        {
+            status.selectedInputs[(size_t) slot] = SharedControlSurface::Device::from(devices.getSelectedInput(slot));
+            status.inputRoles[(size_t) slot] = devices.getInputRoles(slot);
+        }
+
+        status.numOutputSlots = devices.getNumOutputSlots();
+        status.numInputSlots = devices.getNumInputSlots();
+        status.thruOutput = devices.getThruOutput();
+        status.thruKinds = devices.getThruKinds();
+        status.backend = (int) devices.getBackend();
+        status.engineDrivenByJack = devices.isEngineDrivenByJack();
+
+        status.realtime = host.getRealtimeSettings();
+        status.lfoActive = host.getEngine().isLfoActive();
+        status.noteOffStop = host.getNoteOffStop();
+        status.bpm = host.getCurrentBpm();
+        status.traceEnabled = EngineTrace::isEnabled();
+
+        const auto* automation = host.getAutomation();
+        status.automationRecording = host.isAutomationRecording();
+        status.automationPlaying = host.isAutomationPlaying();
+        status.automationLanes = automation != nullptr ? automation->getNumLanes() : 0;
+        status.automationBars = automation != nullptr ? (int) (automation->getLength() / AutomationClip::ticksPerBar) : 0;
+
+        if (status.presetsRevision != host.getPresetsRevision() + 1)
+        {
+            const auto& presets = host.getPresets();
+
+            for (int slot = 0; slot < PresetBank::numSlots; ++slot)
+            {
+                auto& name = status.presetNames[(size_t) slot];
+                name.fill(0);
+
+                if (presets.isUsed(slot))
+                    presets.get(slot).name.copyToUTF8(name.data(), name.size());
+            }
+
+            // 0 stays "never published", so front-ends see the first bank
+            status.presetsRevision = host.getPresetsRevision() + 1;
+        }
+
+        status.activePreset = host.getActivePreset();
+
+        #if JUCE_DEBUG
+        const int restartNote = host.getEngine().takeRestartNote();
+
+        if (restartNote >= 0)
+            status.restartNote = restartNote;
+        #endif
+
+        surface->publishStatus(status);
+    }
+
+    // While front-ends are attached
+    void timerCallback() override
+    {
+        const bool anyClient = surface->getNumClients() > 0;
+
+        forwardProbes(anyClient);
+
+        #if JUCE_DEBUG
+        host.getEngine().setMonitor(anyClient && surface->getMonitorFeed().isWanted() ? &monitorForwarder : nullptr);
+        #endif
+
+        publishStatus();
+
+        if (!anyClient)
+            stopTimer();
+    }
+
+    // Engine probes are attached while a front-end reads them
+    void forwardProbes(bool anyClient)
+    {
+        for (int p = 0; p < EngineProbes::numProbes; ++p)
+        {
+            const auto id = (EngineProbes::Id) p;
+            auto& ring = host.getEngine().probes[id];
+            auto& feed = surface->getProbeFeed(id);
+            const bool wanted = anyClient && feed.isWanted();
+
+            if (wanted && !ring.isAttached())
+                ring.attach();
+            else if (!wanted && ring.isAttached())
+                ring.detach();
+
+            ring.drain([&feed](const EngineProbes::Sample& sample) { feed.ring.push(sample); });
+        }
+    }
+
+    #if JUCE_DEBUG
+    // Engine thread: into the segment's monitor ring
+    struct MonitorForwarder : public MidiMonitorSink
+    {
+        explicit MonitorForwarder(SharedControlSurface& s) : surface(s) {}
+
+        void pushEvent(const juce::MidiMessage& msg, bool isIncoming) override
+        {
+            SharedControlSurface::MonitorEvent e;
+            e.size = juce::jmin(msg.getRawDataSize(), (int) e.bytes.size());
+            std::copy_n(msg.getRawData(), e.size, e.bytes.begin());
+            e.incoming = isIncoming;
+
+            surface.getMonitorFeed().ring.push(e);
+        }
+
+        SharedControlSurface& surface;
+    };
+    #endif
+
+    std::unique_ptr<SharedControlSurface> surface;
+    EngineHost host;
+    SharedControlSurface::Status status;
+
+    ControlSocket controlSocket { surface->getTelemetry() };
+    ControlSocket::Batch batch;
+
+    #if JUCE_DEBUG
+    MonitorForwarder monitorForwarder { *surface };
+    #endif
+};
@@ -0,0 +1,393 @@
+#pragma once
+#include <JuceHeader.h>
+#include "MidiInput.h"
+#include "EngineThread.h"
+#include "MidiDeviceManager.h"
+#include "PresetBank.h"
+
+// ==========================================
+// Engine host
+// ==========================================
+// Everything that makes the modulation happen, without a window: the engine
+// and its thread, the MIDI ports and the clock. The engine process owns one
+// (see EngineDaemon.h); front-ends only reach it through the shared control
+// surface.
+//
+// Notes and CCs from the merged input, and transport from the clock master,
+// are posted to the engine from the MIDI input threads. The clock handler
+// is connected while the settings ask for sync. As clock master the engine
+// makes the clock itself, and start/stop drive its transport.
+//
+// Automation is recorded and replaced here: the recorder is drained a few
+// times a second while armed, and the clip it makes (or one imported from a
+// MIDI file) is kept until the engine is done with the one before.
+//
+// The preset bank is loaded when the host starts and saved after every
+// change; recalling a preset merges it into the settings and hands them to
+// the engine as one switch.
+static_assert (ModulationEngine::maxInputSources == MergedMidiInput::maxSources);
+
+class EngineHost : private MidiClockListener,
+                   private MergedMidiInput::Listener,
+                   private juce::Timer
+{
+public:
+    explicit EngineHost(EngineTelemetry& t)
+        : telemetry(t)
+    {
+        midiClock.setListener(this);
+
+        midiDevices.setInputListener(this);
+        midiDevices.onInputChanged = [this] { updateClockState(); };
+        midiDevices.onEngineDriverChanged = [this](bool jackDrivesEngine)
+        {
+            if (jackDrivesEngine)
+                engineThread.stopThread(1000);
+            else
+                engineThread.start(realtimeSettings);
+        };
+    }
+
+    ~EngineHost() override
+    {
+        stopTimer();
+        engineThread.stopThread(1000);
+        midiClock.stop();
+    }
+
+    // ---- Message thread ----
+    // Lists the devices and starts ticking
+    void start()
+    {
+        midiDevices.start();
+        presets.load(PresetBank::getDefaultFile());
+        engine.publishSettings(settings);
+        engineThread.start(realtimeSettings);
+    }
+
+    void publishSettings(const ModulationEngine::Settings& newSettings)
+    {
+        const bool syncChanged = newSettings.syncEnabled != settings.syncEnabled
+                              || newSettings.clockMaster != settings.clockMaster;
+
+        settings = newSettings;
+        engine.publishSettings(settings);
+
+        if (syncChanged)
+            updateClockState();
+    }
+
+    const ModulationEngine::Settings& getSettings() const noexcept   { return settings; }
+
+    // Control batches (see ControlSocket) go to the engine straight from
+    // the socket's receive thread; nullptr for none. Returns once no tick
+    // can still be using the previous source.
+    void setControlSource(ModulationEngine::ControlSource* source)
+    {
+        const auto token = engine.setControlSource(source);
+
+        while (!engine.isRetired(token))
+            juce::Thread::yield();
+    }
+
+    // Message thread, after a batch was handed to the engine: the settings
+    // it edited, taken as the host's own without publishing them again
+    void controlApplied(const ModulationEngine::Settings& newSettings)
+    {
+        const bool syncChanged = newSettings.syncEnabled != settings.syncEnabled
+                              || newSettings.clockMaster != settings.clockMaster;
+        settings = newSettings;
+
+        // a retrigger leaves the tempo detection alone
+        if (syncChanged)
+            updateClockState();
+    }
+
+    // Control socket receive thread: a batch is waiting, and the tick that
+    // takes it up runs right away rather than at the next deadline
+    void controlReceived() noexcept
+    {
+        engine.requestTick();
+        engineThread.tickNow();
+    }
+
+    void startLfo()
+    {
+        if (settings.clockMaster)
+        {
+            engine.postClockTransport(ModulationEngine::ClockTransport::start);
+            return;
+        }
+
+        // clock may still be needed for sync
+        updateClockState();
+        engine.startLfo();
+    }
+
+    void stopLfo()
+    {
+        if (settings.clockMaster)
+            engine.postClockTransport(ModulationEngine::ClockTransport::stop);
+        else
+            engine.stopLfo();
+    }
+
+    // Note-Off stops the LFO (with restart on Note-On)
+    void setNoteOffStop(bool shouldStop) noexcept   { noteOffStopArmed.store(shouldStop, std::memory_order_relaxed); }
+    bool getNoteOffStop() const noexcept            { return noteOffStopArmed.load(std::memory_order_relaxed); }
+
+    // Under JACK the settings are kept for when the engine thread takes over
+    // again. The output sender threads take them too.
+    void setRealtimeSettings(const RealtimeSettings& newSettings)
+    {
+        realtimeSettings = newSettings;
+        midiDevices.setRealtimeSettings(realtimeSettings);
+
+        if (!midiDevices.isEngineDrivenByJack())
+            engineThread.start(realtimeSettings);
+    }
+
+    const RealtimeSettings& getRealtimeSettings() const noexcept   { return realtimeSettings; }
+
+    double getCurrentBpm() const noexcept
+    {
+        return settings.clockMaster ? juce::jlimit(MidiClockGenerator::minBpm, MidiClockGenerator::maxBpm, settings.masterBpm)
+                                    : midiClock.getCurrentBPM();
+    }
+
+    // ---- Presets ----
+    void storePreset(int slot, const juce::String& name)
+    {
+        if (!juce::isPositiveAndBelow(slot, PresetBank::numSlots))
+            return;
+
+        presets.store(slot, name, settings);
+        activePreset = slot;
+        presetsChanged();
+    }
+
+    void clearPreset(int slot)
+    {
+        if (!presets.isUsed(slot))
+            return;
+
+        presets.clear(slot);
+
+        if (activePreset == slot)
+            activePreset = -1;
+
+        presetsChanged();
+    }
+
+    // Swapped in at the switch point; the LFO phases go on unless reset.
+    // false for an empty slot.
+    bool recallPreset(int slot, ModulationEngine::SwitchPoint at, bool resetPhases)
+    {
+        if (!presets.isUsed(slot))
+            return false;
+
+        settings = PresetBank::recall(presets.get(slot).settings, settings);
+        engine.switchSettings(settings, at, resetPhases);
+        activePreset = slot;
+        return true;
+    }
+
+    bool exportPresets(const juce::File& file) const   { return presets.exportJson(file); }
+
+    // Replaces the whole bank; false (bank unchanged) if the file doesn't parse
+    bool importPresets(const juce::File& file)
+    {
+        if (!presets.importJson(file))
+            return false;
+
+        activePreset = -1;
+        presetsChanged();
+        return true;
+    }
+
+    const PresetBank& getPresets() const noexcept   { return presets; }
+    int getActivePreset() const noexcept            { return activePreset; }
+
+    // bumped by every change to the bank
+    juce::uint64 getPresetsRevision() const noexcept   { return presetsRevision; }
+
+    // ---- Automation ----
+    // Stopping keeps what was recorded, looped to the bar the transport is
+    // in, in place of the clip there was; nothing recorded keeps the old one
+    void setAutomationRecording(bool shouldRecord)
+    {
+        auto& recorder = engine.getAutomationRecorder();
+
+        if (shouldRecord == recorder.isRecording())
+            return;
+
+        if (shouldRecord)
+        {
+            recorder.start();
+            startTimerHz(drainHz);
+            return;
+        }
+
+        if (auto recorded = recorder.stop(engine.getTransportTick()))
+            replaceAutomation(std::move(recorded));
+    }
+
+    // The clip stays ours either way: no need to wait for the engine
+    void setAutomationPlaying(bool shouldPlay)
+    {
+        automationPlaying = shouldPlay;
+        engine.setAutomationClip(shouldPlay ? automation.get() : nullptr);
+    }
+
+    // Type 1 MIDI file, one track per output; false if it couldn't be written
+    bool exportAutomation(const juce::File& file) const
+    {
+        if (automation == nullptr)
+            return false;
+
+        file.deleteFile();
+        juce::FileOutputStream out(file);
+
+        return out.openedOk() && automation->toMidiFile().writeTo(out, 1);
+    }
+
+    // false if the file couldn't be read or holds no parameter changes, and
+    // if some of them were left out (see AutomationClip::fromMidiFile); the
+    // ones that fit still play then
+    bool importAutomation(const juce::File& file)
+    {
+        juce::FileInputStream in(file);
+        juce::MidiFile midiFile;
+
+        if (!in.openedOk() || !midiFile.readFrom(in))
+            return false;
+
+        int numDropped = 0;
+        auto imported = AutomationClip::fromMidiFile(midiFile, numDropped);
+
+        if (imported == nullptr)
+            return false;
+
+        replaceAutomation(std::move(imported));
+        return numDropped == 0;
+    }
+
+    bool isAutomationRecording() const noexcept   { return engine.getAutomationRecorder().isRecording(); }
+    bool isAutomationPlaying() const noexcept     { return automationPlaying; }
+    const AutomationClip* getAutomation() const noexcept   { return automation.get(); }
+
+    ModulationEngine& getEngine() noexcept        { return engine; }
+    MidiDeviceManager& getDevices() noexcept      { return midiDevices; }
+
+private:
+    static constexpr int drainHz = 10;
+
+    // While recording, or while a replaced clip may still be in use
+    void timerCallback() override
+    {
+        auto& recorder = engine.getAutomationRecorder();
+
+        if (recorder.isRecording())
+            recorder.drain();
+
+        freeRetiredClips();
+
+        if (!recorder.isRecording() && retiredClips.empty())
+            stopTimer();
+    }
+
+    void replaceAutomation(std::unique_ptr<AutomationClip> clip)
+    {
+        const auto token = engine.setAutomationClip(automationPlaying ? clip.get() : nullptr);
+
+        if (automation != nullptr)
+            retiredClips.push_back({ token, std::move(automation) });
+
+        automation = std::move(clip);
+        freeRetiredClips();
+
+        if (!retiredClips.empty())
+            startTimerHz(drainHz);
+    }
+
+    void presetsChanged()
+    {
+        ++presetsRevision;
+
+        if (!presets.save(PresetBank::getDefaultFile()))
+            DBG("Presets couldn't be saved: " << PresetBank::getDefaultFile().getFullPathName());
+    }
+
+    void freeRetiredClips()
+    {
+        retiredClips.erase(std::remove_if(retiredClips.begin(), retiredClips.end(),
+                                          [this](const RetiredClip& r) { return engine.isRetired(r.token); }),
+                           retiredClips.end());
+    }
+
+    // The merged input feeds the handler from the clock master input
+    // (under JACK: from the client's input port). It is disconnected, with
+    // no input thread left inside it, before its history is reset.
+    void updateClockState()
+    {
+        midiDevices.setClockHandler(nullptr);
+        midiClock.stop();
+
+        if (settings.syncEnabled && !settings.clockMaster)
+            midiDevices.setClockHandler(&midiClock);
+    }
+
+    // MIDI input thread: atomics only (clock is parsed by MidiClockHandler)
+    void handleMergedEvent(int source, const juce::MidiMessage& msg, double) override
+    {
+        if (msg.isNoteOn())
+        {
+            engine.postNoteOn(msg.getChannel(), msg.getNoteNumber(), msg.getFloatVelocity());
+        }
+        else if (msg.isNoteOff())
+        {
+            engine.postNoteOff(msg.getChannel());
+
+            if (noteOffStopArmed.load(std::memory_order_relaxed))
+                engine.postLfoStop();
+        }
+        else if (msg.isController())
+        {
+            // matrix source (ModulationMatrix::Source::inputCc), device echo
+            engine.postControlChange(msg.getChannel(), msg.getControllerNumber(), msg.getControllerValue(), source);
+        }
+    }
+
+    // MIDI transport (MIDI input thread): applied by the next engine tick
+    void handleMidiStart() override   { engine.postTransportStart(); }
+    void handleMidiStop() override    { engine.postTransportStop(); }
+    void handleMidiContinue() override   { engine.postTransportContinue(); }
+    void handleMidiClock(double timeMs) override   { engine.postClockPulse(timeMs); }
+
+    EngineTelemetry& telemetry;
+    MidiClockHandler midiClock;
+
+    ModulationEngine engine { telemetry, [this] { return midiClock.getCurrentBPM(); } };
+    EngineThread engineThread { engine, telemetry };
+
+    // output/input ports and hot-plug (destroyed before the engine)
+    MidiDeviceManager midiDevices { engine, telemetry };
+
+    ModulationEngine::Settings settings;
+    RealtimeSettings realtimeSettings;
+    std::atomic<bool> noteOffStopArmed { false };
+
+    struct RetiredClip
+    {
+        juce::uint64 token;
+        std::unique_ptr<AutomationClip> clip;
+    };
+
+    std::unique_ptr<AutomationClip> automation;
+    std::vector<RetiredClip> retiredClips;
+    bool automationPlaying = false;
+
+    PresetBank presets;
+    int activePreset = -1;
+    juce::uint64 presetsRevision = 0;
+};
@@ -0,0 +1,136 @@
+#pragma once
+#include <JuceHeader.h>
+
+// ==========================================
+// Engine probes
+// ==========================================
+// Every value the engine computes (LFO routes, EG, clock BPM) can be tapped
+// through a probe: a single-producer/single-consumer ring of timestamped
+// samples. The engine thread pushes one sample per tick into each attached
+// probe; a visualizer attaches, then drains whatever accumulated since its
+// last refresh, so it sees every sample regardless of its own frame rate.
+//
+// Unattached probes cost the engine one relaxed load. A full ring drops the
+// newest sample and counts it, it never blocks the producer.
+namespace EngineProbes
+{
+    enum class Id
+    {
+        route1,
+        route2,
+        route3,
+        eg,
+        bpm,
+        numProbes
+    };
+
+    static constexpr int numProbes = (int) Id::numProbes;
+
+    struct Info
+    {
+        const char* name;
+        float minValue, maxValue; // natural range, for display scaling
+    };
+
+    inline Info getInfo(Id id) noexcept
+    {
+        switch (id)
+        {
+            case Id::route1: return { "Route 1", -1.0f, 1.0f };
+            case Id::route2: return { "Route 2", -1.0f, 1.0f };
+            case Id::route3: return { "Route 3", -1.0f, 1.0f };
+            case Id::eg:     return { "EG",       0.0f, 1.0f };
+            case Id::bpm:    return { "BPM",      0.0f, 300.0f };
+            default:         return { "",        -1.0f, 1.0f };
+        }
+    }
+
+    inline Id routeProbe(int routeIndex) noexcept
+    {
+        return (Id) ((int) Id::route1 + routeIndex);
+    }
+
+    struct Sample
+    {
+        double timeMs;
+        float value;
+    };
+
+    class Ring
+    {
+    public:
+        static constexpr int capacity = 2048; // ~20 s at 100 Hz
+
+        // ---- Producer (engine thread) ----
+        void push(double timeMs, float value) noexcept
+        {
+            if (!attached.load(std::memory_order_acquire))
+                return;
+
+            int start1, size1, start2, size2;
+            fifo.prepareToWrite(1, start1, size1, start2, size2);
+
+            if (size1 == 0)
+            {
+                dropped.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+
+            samples[(size_t) start1] = { timeMs, value };
+            fifo.finishedWrite(1);
+        }
+
+        // ---- Consumer ----
+        // Discards anything left from a previous session, then starts collecting.
+        void attach() noexcept
+        {
+            fifo.finishedRead(fifo.getNumReady());
+            attached.store(true, std::memory_order_release);
+        }
+
+        void detach() noexcept
+        {
+            attached.store(false, std::memory_order_release);
+        }
+
+        bool isAttached() const noexcept   { return attached.load(std::memory_order_relaxed); }
+
+        // Calls fn(const Sample&) for every sample pushed since the last drain.
+        template <typename Fn>
+        int drain(Fn&& fn)
+        {
+            int start1, size1, start2, size2;
+            fifo.prepareToRead(fifo.getNumReady(), start1, size1, start2, size2);
+
+            for (int i = 0; i < size1; ++i)
+                fn(samples[(size_t) (start1 + i)]);
+
+            for (int i = 0; i < size2; ++i)
+                fn(samples[(size_t) (start2 + i)]);
+
+            fifo.finishedRead(size1 + size2);
+            return size1 + size2;
+        }
+
+        juce::uint64 getNumDropped() const noexcept   { return dropped.load(std::memory_order_relaxed); }
+
+    private:
+        juce::AbstractFifo fifo { capacity };
+        std::array<Sample, capacity> samples {};
+        std::atomic<bool> attached { false };
+        std::atomic<juce::uint64> dropped { 0 };
+    };
+
+    class Set
+    {
+    public:
+        void push(Id id, double timeMs, float value) noexcept   { rings[(size_t) id].push(timeMs, value); }
+
+        bool isAttached(Id id) const noexcept                   { return rings[(size_t) id].isAttached(); }
+
+        Ring& operator[](Id id) noexcept                        { return rings[(size_t) id]; }
+
+    private:
+        std::array<Ring, numProbes> rings;
+    };
+}
@@ -0,0 +1,487 @@
+#pragma once
+#include <JuceHeader.h>
+
+// ==========================================
+// Engine telemetry
+// ==========================================
+// Counters and histograms written by the modulation engine and MIDI input
+// callbacks. Every write is a relaxed atomic add/store, so publishing is
+// wait-free and never perturbs the tick it measures. The UI reads them
+// through snapshot() and diffs consecutive snapshots to get rates.
+
+// HDR-style histogram: log2 octaves split into 8 linear sub-buckets,
+// values recorded in whole microseconds (~12% resolution up to ~71 min).
+class TelemetryHistogram
+{
+public:
+    static constexpr int subBucketBits = 3;
+    static constexpr int subBuckets    = 1 << subBucketBits;
+    static constexpr int numBuckets    = (32 - subBucketBits + 1) * subBuckets;
+
+    void record (double micros) noexcept
+    {
+        const auto v = (juce::uint32) juce::jlimit (0.0, 4294967295.0, micros);
+
+        buckets[(size_t) bucketFor (v)].fetch_add (1, std::memory_order_relaxed);
+        count.fetch_add (1, std::memory_order_relaxed);
+        sum.fetch_add (v, std::memory_order_relaxed);
+
+        auto prevMax = max.load (std::memory_order_relaxed);
+        while (v > prevMax && ! max.compare_exchange_weak (prevMax, v, std::memory_order_relaxed)) {}
+    }
+
+    void reset() noexcept
+    {
+        for (auto& b : buckets)
+            b.store (0, std::memory_order_relaxed);
+
+        count.store (0, std::memory_order_relaxed);
+        sum.store (0, std::memory_order_relaxed);
+        max.store (0, std::memory_order_relaxed);
+    }
+
+    juce::uint64 getCount() const noexcept   { return count.load (std::memory_order_relaxed); }
+    juce::uint32 getMax() const noexcept     { return max.load (std::memory_order_relaxed); }
+
+    double getMean() const noexcept
+    {
+        const auto n = getCount();
+        return n > 0 ? (double) sum.load (std::memory_order_relaxed) / (double) n : 0.0;
+    }
+
+    // Upper bound of the bucket holding the given percentile (0..100)
+    double getPercentile (double percentile) const noexcept
+    {
+        const auto n = getCount();
+        if (n == 0)
+            return 0.0;
+
+        const auto target = (juce::uint64) std::ceil ((double) n * juce::jlimit (0.0, 100.0, percentile) / 100.0);
+        juce::uint64 seen = 0;
+
+        for (int i = 0; i < numBuckets; ++i)
+        {
+            seen += buckets[(size_t) i].load (std::memory_order_relaxed);
+            if (seen >= juce::jmax ((juce::uint64) 1, target))
+                return juce::jmin ((double) bucketUpperBound (i), (double) getMax());
+        }
+
+        return (double) getMax();
+    }
+
+    static int bucketFor (juce::uint32 v) noexcept
+    {
+        if (v < (juce::uint32) subBuckets)
+            return (int) v;
+
+        const int shift = juce::findHighestSetBit (v) - subBucketBits;
+        const int sub   = (int) ((v >> shift) & (juce::uint32) (subBuckets - 1));
+        return (shift + 1) * subBuckets + sub;
+    }
+
+    static juce::uint64 bucketLowerBound (int bucket) noexcept
+    {
+        if (bucket < subBuckets)
+            return (juce::uint64) bucket;
+
+        const int shift = bucket / subBuckets - 1;
+        const int sub   = bucket % subBuckets;
+        return (juce::uint64) (subBuckets + sub) << shift;
+    }
+
+    static juce::uint64 bucketUpperBound (int bucket) noexcept
+    {
+        return bucket + 1 < numBuckets ? bucketLowerBound (bucket + 1) - 1
+                                       : (juce::uint64) 0xffffffff;
+    }
+
+private:
+    std::array<std::atomic<juce::uint32>, numBuckets> buckets {};
+    std::atomic<juce::uint64> count { 0 };
+    std::atomic<juce::uint64> sum { 0 };
+    std::atomic<juce::uint32> max { 0 };
+};
+
+// Outcome of each realtime deployment setting for one thread, written once
+// by that thread when it starts (see RealtimeSupport.h).
+struct RealtimeStatus
+{
+    enum Result : int
+    {
+        notRequested = 0,
+        applied,
+        failed
+    };
+
+    std::atomic<int> scheduling { notRequested };  // SCHED_FIFO
+    std::atomic<int> affinity { notRequested };    // CPU pinning
+    std::atomic<int> memoryLock { notRequested };  // mlockall
+    std::atomic<int> prefault { notRequested };    // stack + state touched
+    std::atomic<int> priority { 0 };
+    std::atomic<int> cpuCore { -1 };
+
+    void clear() noexcept
+    {
+        scheduling.store (notRequested, std::memory_order_relaxed);
+        affinity.store (notRequested, std::memory_order_relaxed);
+        memoryLock.store (notRequested, std::memory_order_relaxed);
+        prefault.store (notRequested, std::memory_order_relaxed);
+        priority.store (0, std::memory_order_relaxed);
+        cpuCore.store (-1, std::memory_order_relaxed);
+    }
+
+    static const char* toString (int result) noexcept
+    {
+        switch (result)
+        {
+            case applied: return "ok";
+            case failed:  return "FAILED";
+            default:      return "off";
+        }
+    }
+};
+
+// Time::getMillisecondCounterHiRes() stamps of each startup phase, 0 until
+// reached. Kept by each window (they describe its own start, not the
+// engine's), written and read on its message thread only.
+struct StartupTimes
+{
+    double initialiseMs = 0.0;     // JUCEApplication::initialise() entered
+    double windowBuiltMs = 0.0;    // main component constructed
+    double firstPaintMs = 0.0;     // first frame painted
+    double devicesListedMs = 0.0;  // MIDI device boxes populated
+
+    // ms from initialise() to a phase, negative if either isn't known yet
+    double elapsed (double phaseMs) const noexcept
+    {
+        return (initialiseMs > 0.0 && phaseMs > 0.0) ? phaseMs - initialiseMs : -1.0;
+    }
+};
+
+class EngineTelemetry
+{
+public:
+    static constexpr int maxPorts    = 4;
+    static constexpr int numChannels = 16;
+    static constexpr double nominalTickMs = 10.0; // 100 Hz engine timer
+
+    // ---- Engine tick ----
+    // Call at the very start of a tick; returns the start time for tickEnd().
+    double tickBegin() noexcept
+    {
+        const double now = juce::Time::getMillisecondCounterHiRes();
+        const double prev = lastTickStartMs.exchange (now, std::memory_order_relaxed);
+
+        ticks.fetch_add (1, std::memory_order_relaxed);
+
+        if (prev > 0.0)
+        {
+            const double intervalMs = now - prev;
+            tickInterval.record (intervalMs * 1000.0);
+            tickJitter.record (std::abs (intervalMs - nominalTickMs) * 1000.0);
+        }
+
+        return now;
+    }
+
+    void tickEnd (double tickStartMs) noexcept
+    {
+        tickCompute.record ((juce::Time::getMillisecondCounterHiRes() - tickStartMs) * 1000.0);
+    }
+
+    // ---- Output ----
+    void messageSent (int port, int midiChannel, int numBytes) noexcept
+    {
+        if (! juce::isPositiveAndBelow (port, maxPorts)
+            || ! juce::isPositiveAndBelow (midiChannel - 1, numChannels))
+            return;
+
+        auto& c = ports[(size_t) port].channels[(size_t) (midiChannel - 1)];
+        c.messages.fetch_add (1, std::memory_order_relaxed);
+        c.bytes.fetch_add ((juce::uint64) numBytes, std::memory_order_relaxed);
+    }
+
+    // bytes a port couldn't get onto the wire (see MidiOutputPort::flush())
+    void outputDropped (int numBytes) noexcept
+    {
+        if (numBytes > 0)
+            outputBytesDropped.fetch_add ((juce::uint64) numBytes, std::memory_order_relaxed);
+    }
+
+    // ---- Output sender threads (see QueuedOutputPort) ----
+    // time from the end of a tick to the port having written it
+    void outputWritten (int port, double latencyMicros) noexcept
+    {
+        if (juce::isPositiveAndBelow (port, maxPorts))
+            portLatency[(size_t) port].record (latencyMicros);
+    }
+
+    // packets still queued for a port when a tick ends
+    void outputBacklog (int port, int packets) noexcept
+    {
+        if (! juce::isPositiveAndBelow (port, maxPorts))
+            return;
+
+        backlog[(size_t) port].store (packets, std::memory_order_relaxed);
+
+        auto& peak = backlogMax[(size_t) port];
+        auto prevMax = peak.load (std::memory_order_relaxed);
+        while (packets > prevMax && ! peak.compare_exchange_weak (prevMax, packets, std::memory_order_relaxed)) {}
+    }
+
+    void suppressedByThreshold() noexcept  { suppressedThreshold.fetch_add (1, std::memory_order_relaxed); }
+    void suppressedByRateLimit() noexcept  { suppressedRateLimit.fetch_add (1, std::memory_order_relaxed); }
+    void suppressedByShadow() noexcept     { suppressedShadow.fetch_add (1, std::memory_order_relaxed); }
+
+    // destinations whose UpdateSchedule wasn't due this tick
+    void deferredBySchedule() noexcept  { scheduleDeferred.fetch_add (1, std::memory_order_relaxed); }
+
+    // updates per second the schedules ask for, against one per tick for every destination
+    void updateBudget (double plannedHz, double nominalHz) noexcept
+    {
+        budgetPlannedHz.store (plannedHz, std::memory_order_relaxed);
+        budgetNominalHz.store (nominalHz, std::memory_order_relaxed);
+    }
+
+    // sources folded into a destination another source already drives (sends saved)
+    void contributionsMerged (int count) noexcept  { mergedContributions.fetch_add ((juce::uint64) count, std::memory_order_relaxed); }
+
+    // ---- Engine thread sleep (see EngineThread) ----
+    // every return from a wait, whether to tick or not
+    void engineWokeUp() noexcept   { engineWakeups.fetch_add (1, std::memory_order_relaxed); }
+    void engineIdle (bool isIdle) noexcept   { engineAsleep.store (isIdle, std::memory_order_relaxed); }
+
+    // ---- Input ----
+    void inputReceived() noexcept  { inputEvents.fetch_add (1, std::memory_order_relaxed); }
+    void inputDropped() noexcept   { inputDrops.fetch_add (1, std::memory_order_relaxed); }
+    void inputReordered() noexcept { inputReorders.fetch_add (1, std::memory_order_relaxed); }
+
+    // ---- Thru (see QueuedOutputPort) ----
+    // time from the input callback handing the message over to it being written
+    void thruForwarded (double latencyMicros) noexcept
+    {
+        thruMessages.fetch_add (1, std::memory_order_relaxed);
+        thruLatency.record (latencyMicros);
+    }
+
+    void thruDropped() noexcept    { thruDrops.fetch_add (1, std::memory_order_relaxed); }
+
+    // ---- Clock master (see MidiClockGenerator) ----
+    // sender thread: how far past its due time a scheduled message was written
+    void clockWritten (double lateMicros) noexcept
+    {
+        clockMessages.fetch_add (1, std::memory_order_relaxed);
+        clockJitter.record (lateMicros);
+    }
+
+    void clockDropped() noexcept   { clockDrops.fetch_add (1, std::memory_order_relaxed); }
+
+    // ---- Control batches (see ControlSocket) ----
+    void controlApplied() noexcept   { controlBatches.fetch_add (1, std::memory_order_relaxed); }
+    void controlRejected() noexcept  { controlRejects.fetch_add (1, std::memory_order_relaxed); }
+
+    // engine thread: from a batch's arrival to the first message it caused being sent
+    void controlRoundTrip (double latencyMicros) noexcept   { controlLatency.record (latencyMicros); }
+
+    // ==========================================
+    // Reader side (UI thread)
+    // ==========================================
+    struct ChannelTotals
+    {
+        juce::uint64 messages = 0;
+        juce::uint64 bytes = 0;
+    };
+
+    struct Snapshot
+    {
+        double timeMs = 0.0;
+        juce::uint64 ticks = 0;
+        juce::uint64 suppressedThreshold = 0;
+        juce::uint64 suppressedRateLimit = 0;
+        juce::uint64 suppressedShadow = 0;
+        juce::uint64 mergedContributions = 0;
+        juce::uint64 scheduleDeferred = 0;
+        double budgetPlannedHz = 0.0;
+        double budgetNominalHz = 0.0;
+        juce::uint64 inputEvents = 0;
+        juce::uint64 inputDrops = 0;
+        juce::uint64 inputReorders = 0;
+        juce::uint64 engineWakeups = 0;
+        bool engineIdle = false;
+        juce::uint64 thruMessages = 0;
+        juce::uint64 thruDrops = 0;
+        juce::uint64 clockMessages = 0;
+        juce::uint64 clockDrops = 0;
+        juce::uint64 controlBatches = 0;
+        juce::uint64 controlRejects = 0;
+        juce::uint64 outputBytesDropped = 0;
+        std::array<std::array<ChannelTotals, numChannels>, maxPorts> ports {};
+        std::array<int, maxPorts> backlog {};
+        std::array<int, maxPorts> backlogMax {};
+
+        ChannelTotals portTotals (int port) const noexcept
+        {
+            ChannelTotals t;
+            for (const auto& c : ports[(size_t) port])
+            {
+                t.messages += c.messages;
+                t.bytes    += c.bytes;
+            }
+            return t;
+        }
+    };
+
+    Snapshot snapshot() const noexcept
+    {
+        Snapshot s;
+        s.timeMs              = juce::Time::getMillisecondCounterHiRes();
+        s.ticks               = ticks.load (std::memory_order_relaxed);
+        s.suppressedThreshold = suppressedThreshold.load (std::memory_order_relaxed);
+        s.suppressedRateLimit = suppressedRateLimit.load (std::memory_order_relaxed);
+        s.suppressedShadow    = suppressedShadow.load (std::memory_order_relaxed);
+        s.mergedContributions = mergedContributions.load (std::memory_order_relaxed);
+        s.scheduleDeferred    = scheduleDeferred.load (std::memory_order_relaxed);
+        s.budgetPlannedHz     = budgetPlannedHz.load (std::memory_order_relaxed);
+        s.budgetNominalHz     = budgetNominalHz.load (std::memory_order_relaxed);
+        s.inputEvents         = inputEvents.load (std::memory_order_relaxed);
+        s.inputDrops          = inputDrops.load (std::memory_order_relaxed);
+        s.inputReorders       = inputReorders.load (std::memory_order_relaxed);
+        s.engineWakeups       = engineWakeups.load (std::memory_order_relaxed);
+        s.engineIdle          = engineAsleep.load (std::memory_order_relaxed);
+        s.thruMessages        = thruMessages.load (std::memory_order_relaxed);
+        s.thruDrops           = thruDrops.load (std::memory_order_relaxed);
+        s.clockMessages       = clockMessages.load (std::memory_order_relaxed);
+        s.clockDrops          = clockDrops.load (std::memory_order_relaxed);
+        s.controlBatches      = controlBatches.load (std::memory_order_relaxed);
+        s.controlRejects      = controlRejects.load (std::memory_order_relaxed);
+        s.outputBytesDropped  = outputBytesDropped.load (std::memory_order_relaxed);
+
+        for (size_t p = 0; p < (size_t) maxPorts; ++p)
+        {
+            for (size_t ch = 0; ch < (size_t) numChannels; ++ch)
+            {
+                s.ports[p][ch].messages = ports[p].channels[ch].messages.load (std::memory_order_relaxed);
+                s.ports[p][ch].bytes    = ports[p].channels[ch].bytes.load (std::memory_order_relaxed);
+            }
+
+            s.backlog[p]    = backlog[p].load (std::memory_order_relaxed);
+            s.backlogMax[p] = backlogMax[p].load (std::memory_order_relaxed);
+        }
+
+        return s;
+    }
+
+    void reset() noexcept
+    {
+        ticks.store (0, std::memory_order_relaxed);
+        lastTickStartMs.store (0.0, std::memory_order_relaxed);
+        suppressedThreshold.store (0, std::memory_order_relaxed);
+        suppressedRateLimit.store (0, std::memory_order_relaxed);
+        suppressedShadow.store (0, std::memory_order_relaxed);
+        mergedContributions.store (0, std::memory_order_relaxed);
+        scheduleDeferred.store (0, std::memory_order_relaxed);
+        inputEvents.store (0, std::memory_order_relaxed);
+        inputDrops.store (0, std::memory_order_relaxed);
+        inputReorders.store (0, std::memory_order_relaxed);
+        engineWakeups.store (0, std::memory_order_relaxed);
+        thruMessages.store (0, std::memory_order_relaxed);
+        thruDrops.store (0, std::memory_order_relaxed);
+        clockMessages.store (0, std::memory_order_relaxed);
+        clockDrops.store (0, std::memory_order_relaxed);
+        controlBatches.store (0, std::memory_order_relaxed);
+        controlRejects.store (0, std::memory_order_relaxed);
+        outputBytesDropped.store (0, std::memory_order_relaxed);
+
+        for (auto& p : ports)
+        {
+            for (auto& c : p.channels)
+            {
+                c.messages.store (0, std::memory_order_relaxed);
+                c.bytes.store (0, std::memory_order_relaxed);
+            }
+        }
+
+        for (size_t p = 0; p < (size_t) maxPorts; ++p)
+        {
+            backlog[p].store (0, std::memory_order_relaxed);
+            backlogMax[p].store (0, std::memory_order_relaxed);
+            portLatency[p].reset();
+        }
+
+        tickInterval.reset();
+        tickJitter.reset();
+        tickCompute.reset();
+        thruLatency.reset();
+        clockJitter.reset();
+        controlLatency.reset();
+    }
+
+    // ---- Port names ----
+    // Kept as plain characters so the whole object can live in the engine's
+    // shared memory segment (see SharedControlSurface.h); written on the
+    // engine process' message thread
+    void setPortName (int port, const juce::String& name) noexcept
+    {
+        if (juce::isPositiveAndBelow (port, maxPorts))
+            name.copyToUTF8 (portNames[(size_t) port].data(), portNames[(size_t) port].size());
+    }
+
+    juce::String getPortName (int port) const
+    {
+        return juce::isPositiveAndBelow (port, maxPorts) ? juce::String::fromUTF8 (portNames[(size_t) port].data())
+                                                         : juce::String();
+    }
+
+    TelemetryHistogram tickInterval; // time between tick starts
+    TelemetryHistogram tickJitter;   // |interval - nominal|
+    TelemetryHistogram tickCompute;  // time spent inside a tick
+
+    std::array<TelemetryHistogram, maxPorts> portLatency; // tick end to written, per queued port
+    TelemetryHistogram thruLatency;  // input callback to written
+    TelemetryHistogram clockJitter;  // scheduled clock message due to written
+    TelemetryHistogram controlLatency; // control batch received to its first message sent
+
+    RealtimeStatus engineRealtime;   // engine thread deployment (not cleared by reset())
+    std::array<RealtimeStatus, maxPorts> portRealtime; // queued ports' sender threads (not cleared by reset())
+
+private:
+    struct ChannelCounters
+    {
+        std::atomic<juce::uint64> messages { 0 };
+        std::atomic<juce::uint64> bytes { 0 };
+    };
+
+    struct PortCounters
+    {
+        std::array<ChannelCounters, numChannels> channels;
+    };
+
+    std::atomic<juce::uint64> ticks { 0 };
+    std::atomic<double> lastTickStartMs { 0.0 };
+
+    std::atomic<juce::uint64> suppressedThreshold { 0 };
+    std::atomic<juce::uint64> suppressedRateLimit { 0 };
+    std::atomic<juce::uint64> suppressedShadow { 0 };
+    std::atomic<juce::uint64> mergedContributions { 0 };
+    std::atomic<juce::uint64> scheduleDeferred { 0 };
+    std::atomic<double> budgetPlannedHz { 0.0 };
+    std::atomic<double> budgetNominalHz { 0.0 };
+
+    std::atomic<juce::uint64> inputEvents { 0 };
+    std::atomic<juce::uint64> inputDrops { 0 };
+    std::atomic<juce::uint64> inputReorders { 0 };   // merged input restamped to keep its order
+    std::atomic<juce::uint64> engineWakeups { 0 };
+    std::atomic<bool> engineAsleep { false };
+    std::atomic<juce::uint64> thruMessages { 0 };
+    std::atomic<juce::uint64> thruDrops { 0 };
+    std::atomic<juce::uint64> clockMessages { 0 };
+    std::atomic<juce::uint64> clockDrops { 0 };
+    std::atomic<juce::uint64> controlBatches { 0 };
+    std::atomic<juce::uint64> controlRejects { 0 };
+    std::atomic<juce::uint64> outputBytesDropped { 0 };
+
+    std::array<PortCounters, maxPorts> ports;
+    std::array<std::array<char, 64>, maxPorts> portNames {};
+    std::array<std::atomic<int>, maxPorts> backlog {};
+    std::array<std::atomic<int>, maxPorts> backlogMax {};
+};
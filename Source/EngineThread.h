@@ -0,0 +1,247 @@
+#pragma once
+#include <JuceHeader.h>
+#include "ModulationEngine.h"
+#include "RealtimeSupport.h"
+
+#if JUCE_LINUX
+ #include <time.h>
+ #include <semaphore.h>
+#endif
+
+// ==========================================
+// Engine thread
+// ==========================================
+// Drives ModulationEngine::tick() at tickRateHz on absolute deadlines, so a
+// late tick doesn't push every following one back. Realtime settings are
+// applied from inside the thread when it starts; changing them restarts it.
+//
+// When the engine has nothing to emit (ModulationEngine::isIdle()) the
+// thread doesn't set another deadline: it blocks until the engine's next
+// requestTick() (UI command, MIDI input) wakes it, and restarts the
+// deadlines from then. No timer runs meanwhile; telemetry counts every
+// wake-up, so an idle engine shows none.
+//
+// tickNow() cuts the wait for the next deadline short (control commands):
+// the tick runs at once and the following deadlines count from it. The LFO
+// gets that one tick early, and the tick jitter telemetry shows it.
+class EngineThread : public juce::Thread,
+                     private ModulationEngine::WakeUp,
+                     private juce::Thread::Listener
+{
+public:
+    EngineThread(ModulationEngine& e, EngineTelemetry& t)
+        : juce::Thread("Modulation engine"), engine(e), telemetry(t)
+    {
+       #if JUCE_LINUX
+        sem_init(&wakeUpSemaphore, 0, 0);
+       #endif
+
+        addListener(this);
+        engine.setWakeUp(this);
+    }
+
+    ~EngineThread() override
+    {
+        engine.setWakeUp(nullptr);
+        stopThread(1000);
+        removeListener(this);
+
+       #if JUCE_LINUX
+        sem_destroy(&wakeUpSemaphore);
+       #endif
+    }
+
+    // Message thread: (re)starts the engine with the given deployment settings
+    void start(const RealtimeSettings& newSettings)
+    {
+        stopThread(1000);
+
+        realtimeSettings = newSettings;
+        RealtimeSupport::applyMemoryLock(realtimeSettings.enabled, telemetry.engineRealtime);
+
+        startThread();
+    }
+
+    const RealtimeSettings& getRealtimeSettings() const noexcept   { return realtimeSettings; }
+
+    // Any thread, after what the tick should take up was posted. A thread
+    // asleep while idle is woken by the engine's requestTick() instead.
+    void tickNow() noexcept
+    {
+        if (!waitingForDeadline.exchange(false))
+            return;
+
+       #if JUCE_LINUX
+        sem_post(&wakeUpSemaphore);
+       #else
+        notify();
+       #endif
+    }
+
+private:
+    void run() override
+    {
+        auto& status = telemetry.engineRealtime;
+
+        RealtimeSupport::applyToCurrentThread(realtimeSettings, status);
+
+        if (realtimeSettings.enabled)
+        {
+            RealtimeSupport::prefaultStack();
+            engine.prefault();
+            status.prefault.store(RealtimeStatus::applied, std::memory_order_relaxed);
+        }
+        else
+        {
+            status.prefault.store(RealtimeStatus::notRequested, std::memory_order_relaxed);
+        }
+
+        const auto periodNs = (juce::int64) (1.0e9 / ModulationEngine::tickRateHz);
+
+       #if JUCE_LINUX
+        timespec deadline {};
+        clock_gettime(CLOCK_MONOTONIC, &deadline);
+
+        while (!threadShouldExit())
+        {
+            engine.tick(juce::Time::getMillisecondCounterHiRes());
+
+            if (sleepWhileIdle())
+            {
+                clock_gettime(CLOCK_MONOTONIC, &deadline);
+                continue;
+            }
+
+            deadline.tv_nsec += (long) periodNs;
+
+            while (deadline.tv_nsec >= 1000000000L)
+            {
+                deadline.tv_nsec -= 1000000000L;
+                ++deadline.tv_sec;
+            }
+
+            // fell more than a tick behind (e.g. suspended): resync instead of bursting
+            timespec now {};
+            clock_gettime(CLOCK_MONOTONIC, &now);
+
+            if (now.tv_sec > deadline.tv_sec + 1)
+                deadline = now;
+
+            if (waitForDeadline(deadline))
+                clock_gettime(CLOCK_MONOTONIC, &deadline);
+
+            telemetry.engineWokeUp();
+        }
+       #else
+        const double periodMs = (double) periodNs * 1.0e-6;
+        double deadlineMs = juce::Time::getMillisecondCounterHiRes();
+
+        while (!threadShouldExit())
+        {
+            engine.tick(juce::Time::getMillisecondCounterHiRes());
+
+            if (sleepWhileIdle())
+            {
+                deadlineMs = juce::Time::getMillisecondCounterHiRes();
+                continue;
+            }
+
+            deadlineMs += periodMs;
+            const double nowMs = juce::Time::getMillisecondCounterHiRes();
+
+            if (nowMs - deadlineMs > 1000.0)
+                deadlineMs = nowMs;
+
+            if (deadlineMs > nowMs)
+            {
+                waitingForDeadline.store(true);
+                wait(juce::jmax(0, (int) (deadlineMs - nowMs)));
+
+                // cut short by tickNow()
+                if (!waitingForDeadline.exchange(false))
+                    deadlineMs = juce::Time::getMillisecondCounterHiRes();
+            }
+
+            telemetry.engineWokeUp();
+        }
+       #endif
+    }
+
+   #if JUCE_LINUX
+    // Returns true if tickNow() cut the wait short. A tickNow() that lands
+    // as the deadline passes has its post taken here, so the next wait
+    // isn't cut short by it.
+    bool waitForDeadline(const timespec& deadline)
+    {
+        waitingForDeadline.store(true);
+
+        int result;
+        while ((result = sem_clockwait(&wakeUpSemaphore, CLOCK_MONOTONIC, &deadline)) != 0 && errno == EINTR) {}
+
+        if (result == 0)
+            return true;
+
+        if (waitingForDeadline.exchange(false))
+            return false;
+
+        while (sem_wait(&wakeUpSemaphore) != 0 && errno == EINTR) {}
+        return true;
+    }
+   #endif
+
+    // Returns true after having slept. A request that lands between the
+    // idle check and the wait either sees the flag and posts, or leaves
+    // the engine busy for the second check.
+    bool sleepWhileIdle()
+    {
+        if (!engine.isIdle())
+            return false;
+
+        sleeping.store(true);
+
+        // a request raced in: take the flag back unless its waker already did
+        if (!engine.isIdle() && sleeping.exchange(false))
+            return false;
+
+        telemetry.engineIdle(true);
+
+       #if JUCE_LINUX
+        while (sem_wait(&wakeUpSemaphore) != 0 && errno == EINTR) {}
+       #else
+        while (sleeping.load() && !threadShouldExit())
+            wait(-1);
+       #endif
+
+        telemetry.engineIdle(false);
+        telemetry.engineWokeUp();
+        return true;
+    }
+
+    // ModulationEngine::WakeUp: any thread. Only the request that finds
+    // the thread asleep posts, so a busy engine costs an atomic exchange.
+    void wake() noexcept override
+    {
+        if (!sleeping.exchange(false))
+            return;
+
+       #if JUCE_LINUX
+        sem_post(&wakeUpSemaphore);
+       #else
+        notify();
+       #endif
+    }
+
+    // juce::Thread::Listener: stopThread() has to get past the wait too
+    void exitSignalSent() override   { wake(); }
+
+    ModulationEngine& engine;
+    EngineTelemetry& telemetry;
+    RealtimeSettings realtimeSettings;
+
+    std::atomic<bool> sleeping { false };
+    std::atomic<bool> waitingForDeadline { false };
+
+   #if JUCE_LINUX
+    sem_t wakeUpSemaphore;
+   #endif
+};
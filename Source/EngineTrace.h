@@ -0,0 +1,248 @@
+#pragma once
+#include <JuceHeader.h>
+
+// ==========================================
+// Engine trace recorder
+// ==========================================
+// Records begin/end/instant events into preallocated per-thread rings and
+// exports them as Chrome trace-event JSON (open with ui.perfetto.dev or
+// chrome://tracing). When tracing is off every call site costs one relaxed
+// load and a predictable branch; the recording path is kept out of line.
+//
+// Event names must be string literals (only the pointer is stored).
+namespace EngineTrace
+{
+    static constexpr int maxThreads    = 8;
+    static constexpr int eventsPerRing = 1 << 16; // ~1.5 MB per thread, oldest overwritten
+    static constexpr int noArg         = std::numeric_limits<int>::min();
+
+    struct Event
+    {
+        const char* name;
+        double timeUs;
+        int arg;
+        char phase; // 'B', 'E' or 'i'
+    };
+
+    struct Ring
+    {
+        std::unique_ptr<Event[]> events;
+        std::atomic<juce::uint32> written { 0 };
+        char threadName[48] {};
+    };
+
+    struct State
+    {
+        std::atomic<bool> enabled { false };
+        std::atomic<int> numClaimed { 0 };
+        std::array<Ring, maxThreads> rings;
+        std::atomic<juce::uint32> generation { 0 };
+    };
+
+    inline State& state()
+    {
+        static State s;
+        return s;
+    }
+
+    inline bool isEnabled() noexcept
+    {
+        return state().enabled.load (std::memory_order_relaxed);
+    }
+
+    // ---- Recording path (only reached while tracing) ----
+    inline Ring* claimRing() noexcept
+    {
+        auto& s = state();
+        const int index = s.numClaimed.fetch_add (1, std::memory_order_relaxed);
+
+        if (index >= maxThreads)
+            return nullptr;
+
+        auto& ring = s.rings[(size_t) index];
+        const char* name = nullptr;
+
+        if (juce::MessageManager::existsAndIsCurrentThread())
+            name = "Message thread";
+        else if (auto* t = juce::Thread::getCurrentThread())
+            name = t->getThreadName().toRawUTF8();
+
+        if (name != nullptr && *name != 0)
+            juce::CharPointer_UTF8 (ring.threadName).writeWithDestByteLimit (juce::CharPointer_UTF8 (name),
+                                                                           sizeof (ring.threadName));
+        else
+            std::snprintf (ring.threadName, sizeof (ring.threadName), "Thread %d", index + 1);
+
+        return &ring;
+    }
+
+    [[gnu::noinline]] inline void record (const char* name, char phase, int arg) noexcept
+    {
+        thread_local Ring* ring = nullptr;
+        thread_local juce::uint32 ringGeneration = 0;
+
+        auto& s = state();
+        const auto generation = s.generation.load (std::memory_order_acquire);
+
+        if (ring == nullptr || ringGeneration != generation)
+        {
+            ring = claimRing();
+            ringGeneration = generation;
+        }
+
+        if (ring == nullptr || ring->events == nullptr)
+            return;
+
+        const auto index = ring->written.load (std::memory_order_relaxed);
+        ring->events[index & (eventsPerRing - 1)] = { name, juce::Time::getMillisecondCounterHiRes() * 1000.0, arg, phase };
+        ring->written.store (index + 1, std::memory_order_release);
+    }
+
+    // ---- Call sites ----
+    inline void begin (const char* name, int arg = noArg) noexcept    { if (isEnabled()) record (name, 'B', arg); }
+    inline void end (const char* name) noexcept                       { if (isEnabled()) record (name, 'E', noArg); }
+    inline void instant (const char* name, int arg = noArg) noexcept  { if (isEnabled()) record (name, 'i', arg); }
+
+    struct Scope
+    {
+        explicit Scope (const char* n, int arg = noArg) noexcept
+            : name (isEnabled() ? n : nullptr)
+        {
+            if (name != nullptr)
+                record (name, 'B', arg);
+        }
+
+        ~Scope() noexcept
+        {
+            if (name != nullptr)
+                record (name, 'E', noArg);
+        }
+
+        const char* name;
+
+        JUCE_DECLARE_NON_COPYABLE (Scope)
+    };
+
+    // ==========================================
+    // Control (message thread)
+    // ==========================================
+    inline void start()
+    {
+        auto& s = state();
+
+        if (s.enabled.load())
+            return;
+
+        for (auto& r : s.rings)
+        {
+            if (r.events == nullptr)
+                r.events.reset (new Event[(size_t) eventsPerRing]);
+
+            r.written.store (0, std::memory_order_relaxed);
+            r.threadName[0] = 0;
+        }
+
+        s.numClaimed.store (0, std::memory_order_relaxed);
+        s.generation.fetch_add (1, std::memory_order_release); // threads re-claim a ring
+        s.enabled.store (true, std::memory_order_release);
+    }
+
+    inline void stop()
+    {
+        state().enabled.store (false, std::memory_order_release);
+
+        // let in-flight record() calls on other threads land before reading
+        juce::Thread::sleep (20);
+    }
+
+    // ==========================================
+    // Export
+    // ==========================================
+    // Each process writes its events under its own pid. Times come from the
+    // monotonic millisecond counter, which all processes on the machine
+    // share, so a window's trace merged into the engine's lines up with it.
+    static constexpr const char* header = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    static constexpr const char* footer = "\n]}\n";
+
+    inline void writeEvents (juce::OutputStream& out, int pid, const char* processName, bool& first)
+    {
+        auto& s = state();
+        const int numRings = juce::jmin (s.numClaimed.load(), maxThreads);
+
+        auto separator = [&]
+        {
+            if (! first)
+                out << ",\n";
+            first = false;
+        };
+
+        separator();
+        out << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":" << pid
+            << ",\"args\":{\"name\":" << juce::JSON::toString (juce::String (processName)) << "}}";
+
+        for (int t = 0; t < numRings; ++t)
+        {
+            const auto& ring = s.rings[(size_t) t];
+
+            separator();
+            out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" << pid << ",\"tid\":" << (t + 1)
+                << ",\"args\":{\"name\":" << juce::JSON::toString (juce::String (ring.threadName)) << "}}";
+
+            if (ring.events == nullptr)
+                continue;
+
+            const auto written = ring.written.load (std::memory_order_acquire);
+            const auto count   = juce::jmin (written, (juce::uint32) eventsPerRing);
+
+            for (auto i = written - count; i != written; ++i)
+            {
+                const auto& e = ring.events[i & (eventsPerRing - 1)];
+
+                separator();
+                out << "{\"name\":\"" << e.name << "\",\"ph\":\"" << juce::String::charToString (e.phase)
+                    << "\",\"ts\":" << juce::String (e.timeUs, 3)
+                    << ",\"pid\":" << pid << ",\"tid\":" << (t + 1);
+
+                if (e.phase == 'i')
+                    out << ",\"s\":\"t\"";
+
+                if (e.arg != noArg)
+                    out << ",\"args\":{\"v\":" << e.arg << "}";
+
+                out << "}";
+            }
+        }
+    }
+
+    inline void writeJson (juce::OutputStream& out, int pid = 1, const char* processName = "Engine")
+    {
+        bool first = true;
+
+        out << header;
+        writeEvents (out, pid, processName, first);
+        out << footer;
+    }
+
+    // Writes this process's trace into file, keeping the events of another
+    // process's trace already written there (by writeJson)
+    inline bool mergeJson (const juce::File& file, int pid, const char* processName)
+    {
+        const auto existing = file.loadFileAsString();
+        const auto otherEvents = existing.startsWith (header) && existing.endsWith (footer)
+                                   ? existing.substring ((int) std::strlen (header), existing.length() - (int) std::strlen (footer))
+                                   : juce::String();
+
+        file.deleteFile();
+        juce::FileOutputStream out (file);
+
+        if (! out.openedOk())
+            return false;
+
+        bool first = otherEvents.isEmpty();
+
+        out << header << otherEvents;
+        writeEvents (out, pid, processName, first);
+        out << footer;
+        return true;
+    }
+}
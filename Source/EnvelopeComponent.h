@@ -2,7 +2,9 @@
 
 #include <JuceHeader.h>
 #include "SyntaktParameterTable.h"
+#include "EnvelopeGenerator.h"
 #include "Cosmetic.h"
+#include "EngineTrace.h"
 
 class EnvelopeComponent : public juce::Component
 {
@@ -23,8 +25,6 @@ public:
         noteSourceEgChannelLabel.setText("Note Source", juce::dontSendNotification);
         addAndMakeVisible(noteSourceEgChannelLabel);
 
-        egEnabled = false;
-
         for (int ch = 1; ch <= 16; ++ch)
             noteSourceEgChannelBox.addItem("Ch " + juce::String(ch), ch);
 
@@ -34,12 +34,7 @@ public:
 
         addAndMakeVisible(noteSourceEgChannelBox);
 
-        noteSourceEgChannelBox.onChange = [this]()
-        {
-            const int id = noteSourceEgChannelBox.getSelectedId();
-            noteSourceEgChannel.store(id, std::memory_order_relaxed);
-            egEnabled.store(id != 17, std::memory_order_relaxed);
-        };
+        noteSourceEgChannelBox.onChange = [this]() { settingsChanged(); };
 
         // ---- MIDI Channel ----
         midiChannelLabel.setText("Dest. Channel", juce::dontSendNotification);
@@ -50,10 +45,7 @@ public:
             midiChannelBox.addItem("Ch " + juce::String(ch), ch);
         midiChannelBox.setSelectedId(1);
 
-        midiChannelBox.onChange = [this]()
-        {
-            egOutChannel = (midiChannelBox.getSelectedId());
-        };
+        midiChannelBox.onChange = [this]() { settingsChanged(); };
 
         // ---- Destination ----
         destinationLabel.setText("Dest. CC", juce::dontSendNotification);
@@ -66,12 +58,7 @@ public:
         populateEgDestinationBox();
         destinationBox.setSelectedItemIndex(15, juce::dontSendNotification);
 
-        egOutParamsId = (destinationBox.getSelectedId() - 1);
-
-        destinationBox.onChange = [this]()
-        {
-            egOutParamsId = (destinationBox.getSelectedId() - 1);
-        };
+        destinationBox.onChange = [this]() { settingsChanged(); };
 
         setupSlider(attackSlider, attackLabel, "Attack", juce::Slider::LinearHorizontal);
 
@@ -134,6 +121,7 @@ public:
             }
 
             attackSlider.updateText();
+            settingsChanged();
         };
 
         addAndMakeVisible(*attackFast);
@@ -199,6 +187,8 @@ public:
             if (decayLinear->getToggleState())      decayCurveMode = CurveShape::Linear;
             else if (decayExpo->getToggleState())   decayCurveMode = CurveShape::Exponential;
             else if (decayLog->getToggleState())    decayCurveMode = CurveShape::Logarithmic;
+
+            settingsChanged();
         };
 
         decayLinear->onClick = updateDecayCurve;
@@ -296,6 +286,8 @@ public:
                     releaseSlider.setLookAndFeel(&lookGreen);
                 }
             }
+
+            settingsChanged();
         };
 
         releaseLinear->onClick = updateReleaseCurve;
@@ -337,6 +329,7 @@ public:
                 releaseSlider.setLookAndFeel(&lookGreen);
             }
             releaseSlider.updateText();
+            settingsChanged();
         };
 
         setupSlider(velocityAmountSlider, velocityAmountLabel, "Vel. Amount", juce::Slider::LinearHorizontal);
@@ -355,6 +348,8 @@ public:
 
     void resized() override
     {
+        const EngineTrace::Scope trace("EnvelopeComponent::resized");
+
         if (getWidth() <= 0 || getHeight() <= 0)
             return;
 
@@ -528,74 +523,71 @@ public:
         resized();
     }
 
-    bool isEgEnabled() const noexcept
-    {
-        return egEnabled;
-    }
+    // Called on the message thread whenever a control changes
+    std::function<void(const EnvelopeGenerator::Settings&)> onSettingsChanged;
 
-    int selectedEgOutChannel() const noexcept
+    // Snapshot of the controls for the engine thread
+    EnvelopeGenerator::Settings getSettings() const
     {
-        return egOutChannel;
-    }
+        EnvelopeGenerator::Settings s;
 
-    int selectedEgOutParamsId() const noexcept
-    {
-        return egOutParamsId;
-    }
+        s.noteSourceChannel = noteSourceEgChannelBox.getSelectedId();
+        s.outChannel        = midiChannelBox.getSelectedId();
+        s.outParamIndex     = destinationBox.getSelectedId() - 1;
 
-    bool tick(double& outMidiValue)
-    {
-        if (!egEnabled)
-            return false;
-
-        const double nowMs = juce::Time::getMillisecondCounterHiRes();
-
-        if (!advanceEnvelope(
-                eg,
-                nowMs,
-                attackMsFromSlider(attackSlider.getValue()),
-                holdSliderToMs(holdSlider.getValue()),           // convert to ms
-                decaySliderToMs(decaySlider.getValue()),
-                sustainSlider.getValue(),
-                releaseSliderToMs(releaseSlider.getValue()),
-                velocityAmountSlider.getValue()
-                )
-            )
-            return false;
-
-        outMidiValue = juce::jlimit(0.0, 1.0, eg.currentValue);
-
-        return true;
-    }
+        s.attackMs       = attackMsFromSlider(attackSlider.getValue());
+        s.holdMs         = holdSliderToMs(holdSlider.getValue());
+        s.decayMs        = decaySliderToMs(decaySlider.getValue());
+        s.sustainLevel   = sustainSlider.getValue();
+        s.releaseMs      = releaseSliderToMs(releaseSlider.getValue());
+        s.velocityAmount = velocityAmountSlider.getValue();
 
-    void noteOn(int ch, int note, float velocity)
-    {
-        if (ch == noteSourceEgChannel.load(std::memory_order_relaxed))
-        {
-            const double now = juce::Time::getMillisecondCounterHiRes();
-            
-            // Store velocity and reset peak computation flag
-            eg.velocity = juce::jlimit(0.0, 1.0, velocity / 127.0);
-            eg.attackPeakComputed = false; // Reset flag so peak will be computed on first tick
-            
-            eg.stage = EnvelopeState::Stage::Attack;
-            eg.stageStartMs = now;
-            eg.stageStartValue = eg.currentValue;
-            eg.noteHeld = true;
-        }     
+        s.attackMode   = attackMode;
+        s.decayCurve   = decayCurveMode;
+        s.releaseCurve = releaseCurveMode;
+
+        return s;
     }
 
-    void noteOff(int ch, int note)
+    // Shows settings made elsewhere (the engine, another front-end) without
+    // calling onSettingsChanged. Only times are stored: a release beyond
+    // the slider's range comes back in Long mode.
+    void setSettings(const EnvelopeGenerator::Settings& s)
     {
-        if (ch == noteSourceEgChannel.load(std::memory_order_relaxed))
-        {
-            const double now = juce::Time::getMillisecondCounterHiRes();
-
-            eg.stage = EnvelopeState::Stage::Release;
-            eg.stageStartMs = now;
-            eg.stageStartValue = eg.currentValue;
-            eg.noteHeld = false;
-        }
+        noteSourceEgChannelBox.setSelectedId(s.noteSourceChannel, juce::dontSendNotification);
+        midiChannelBox.setSelectedId(s.outChannel, juce::dontSendNotification);
+        destinationBox.setSelectedId(s.outParamIndex + 1, juce::dontSendNotification);
+
+        attackMode = s.attackMode;
+        attackFast->setToggleState(attackMode == AttackMode::Fast, juce::dontSendNotification);
+        attackLong->setToggleState(attackMode == AttackMode::Long, juce::dontSendNotification);
+        attackSnap->setToggleState(attackMode == AttackMode::Snap, juce::dontSendNotification);
+        attackSlider.setLookAndFeel(attackMode == AttackMode::Long ? &lookOrange : &lookGreen);
+        attackSlider.setValue(s.attackMs / attackMsFromSlider(1.0), juce::dontSendNotification);
+
+        holdSlider.setValue(s.holdMs / holdSliderToMs(1.0), juce::dontSendNotification);
+        decaySlider.setValue(s.decayMs / decaySliderToMs(1.0), juce::dontSendNotification);
+        sustainSlider.setValue(s.sustainLevel, juce::dontSendNotification);
+
+        releaseLongMode = s.releaseMs > releaseSlider.getMaximum() * 1000.0;
+        releaseLong->setToggleState(releaseLongMode, juce::dontSendNotification);
+        releaseSlider.setLookAndFeel(releaseLongMode ? &lookDarkGreen : &lookGreen);
+        releaseSlider.setValue(s.releaseMs / releaseSliderToMs(1.0), juce::dontSendNotification);
+
+        velocityAmountSlider.setValue(s.velocityAmount, juce::dontSendNotification);
+
+        decayCurveMode = s.decayCurve;
+        decayLinear->setToggleState(decayCurveMode == CurveShape::Linear, juce::dontSendNotification);
+        decayExpo->setToggleState(decayCurveMode == CurveShape::Exponential, juce::dontSendNotification);
+        decayLog->setToggleState(decayCurveMode == CurveShape::Logarithmic, juce::dontSendNotification);
+
+        releaseCurveMode = s.releaseCurve;
+        releaseLinear->setToggleState(releaseCurveMode == CurveShape::Linear, juce::dontSendNotification);
+        releaseExpo->setToggleState(releaseCurveMode == CurveShape::Exponential, juce::dontSendNotification);
+        releaseLog->setToggleState(releaseCurveMode == CurveShape::Logarithmic, juce::dontSendNotification);
+
+        attackSlider.updateText();
+        releaseSlider.updateText();
     }
 
 private:
@@ -604,12 +596,6 @@ private:
     // ---- Group ----
     juce::GroupComponent egGroup;
 
-    std::atomic<int> noteSourceEgChannel { 17 }; // default OFF
-    std::atomic<bool> egEnabled { false };
-
-    int egOutChannel;
-    int egOutParamsId;
-
     // ---- Routing ----
     juce::Label   noteSourceEgChannelLabel;
     juce::ComboBox noteSourceEgChannelBox; // source channel for Note-On listening
@@ -638,12 +624,7 @@ private:
 
     juce::Slider attackSlider, holdSlider, decaySlider, sustainSlider, releaseSlider, velocityAmountSlider;
 
-    enum class AttackMode
-    {
-        Fast,
-        Long,
-        Snap
-    };
+    using AttackMode = EnvelopeGenerator::AttackMode;
 
     AttackMode attackMode = AttackMode::Fast;
 
@@ -666,12 +647,7 @@ private:
     std::unique_ptr<juce::MidiInputCallback> noteInputCallback;
 
     // EG curves
-    enum class CurveShape
-    {
-        Linear,
-        Exponential,
-        Logarithmic
-    };
+    using CurveShape = EnvelopeGenerator::CurveShape;
 
     CurveShape decayCurveMode   = CurveShape::Exponential; // default
     CurveShape releaseCurveMode = CurveShape::Exponential;
@@ -684,244 +660,6 @@ private:
 
     bool releaseLongMode = false;
 
-    //EG state 
-    struct EnvelopeState
-    {
-        enum class Stage
-        {
-            Idle,
-            Attack,
-            Hold,
-            Decay,
-            Sustain,
-            Release
-        };
-
-        Stage stage = Stage::Idle;
-        double currentValue = 0.0;
-
-        double stageStartMs = 0.0;
-        double stageStartValue = 0.0;
-
-        bool noteHeld = false;
-
-        //Velocity to EG
-        double velocity = 1.0;       // normalized 0..1
-        double attackPeak = 1.0;     // computed per note
-        bool attackPeakComputed = false;
-    };
-
-    EnvelopeState eg;
-
-    struct EgRoute
-    {
-        int midiChannel = 1;
-        int parameterIndex = -1; // index into syntaktParameters
-    };
-
-    // Compute attack peak based on velocity and velocity amount
-    inline double computeAttackPeak(double velocity, double velAmount) const
-    {
-        // velAmount = 0 → peak is always 1.0 (no velocity sensitivity)
-        // velAmount = 1 → peak follows velocity exactly
-        return juce::jlimit(0.0, 1.0,
-            juce::jmap(velAmount, 0.0, 1.0, 1.0, velocity));
-    }
-
-    //EG tick function
-    bool advanceEnvelope(
-                        EnvelopeState& eg,
-                        double nowMs,
-                        double attackMs,
-                        double holdMs,
-                        double decayMs,
-                        double sustainLevel,
-                        double releaseMs,
-                        double velocityAmount)
-    {
-        constexpr double epsilon = 0.001; // 1 microsecond threshold
-
-        auto elapsed = nowMs - eg.stageStartMs;
-
-        switch (eg.stage)
-        {
-            case EnvelopeState::Stage::Idle:
-                eg.currentValue = 0.0;
-                return false;
-
-            case EnvelopeState::Stage::Attack:
-            {
-                // Compute attack peak once at the start of Attack stage
-                if (!eg.attackPeakComputed)
-                {
-                    eg.attackPeak = computeAttackPeak(eg.velocity, velocityAmount);
-                    eg.attackPeakComputed = true;
-                }
-                
-                if (attackMs <= epsilon)
-                {
-                    eg.currentValue = eg.attackPeak;
-                }
-                else
-                {
-                    double t = juce::jlimit(0.0, 1.0, elapsed / attackMs);
-
-                    if (attackMode == AttackMode::Snap)
-                    {
-                        constexpr double snapAmount = 6.0;
-                        t = 1.0 - std::exp(-snapAmount * t);
-                    }
-
-                    eg.currentValue = eg.stageStartValue + (eg.attackPeak - eg.stageStartValue) * t;
-                }
-
-                // Check if we've reached the peak
-                if (elapsed >= attackMs || eg.currentValue >= (eg.attackPeak - 0.0001))
-                {
-                    eg.currentValue = eg.attackPeak;
-                    eg.stageStartMs = nowMs;
-                    eg.stageStartValue = eg.attackPeak;
-
-                    // Check if hold time is meaningful
-                    if (holdMs > epsilon)
-                        eg.stage = EnvelopeState::Stage::Hold;
-                    else
-                        eg.stage = EnvelopeState::Stage::Decay;
-                }
-                return true;
-            }
-
-            case EnvelopeState::Stage::Hold:
-            {
-                // Hold at attack peak value
-                eg.currentValue = eg.attackPeak;
-
-                if (elapsed >= holdMs)
-                {
-                    eg.stage = EnvelopeState::Stage::Decay;
-                    eg.stageStartMs = nowMs;
-                    eg.stageStartValue = eg.attackPeak; // Start decay from actual peak
-                }
-                return true;
-            }
-
-            case EnvelopeState::Stage::Decay:
-            {
-                // Calculate actual sustain level relative to attack peak
-                // sustainLevel is 0..1 from slider, scale it to 0..attackPeak
-                const double actualSustainLevel = sustainLevel * eg.attackPeak;
-                
-                if (decayMs <= epsilon)
-                {
-                    eg.currentValue = actualSustainLevel;
-                    eg.stage = EnvelopeState::Stage::Sustain;
-                }
-                else
-                {
-                    const double t = juce::jlimit(0.0, 1.0, elapsed / decayMs);
-
-                    double kDecay = 0.0;
-
-                    if (decayCurveMode == CurveShape::Exponential)
-                    {
-                        kDecay = 0.30;
-                    }
-                    else if (decayCurveMode == CurveShape::Logarithmic)
-                    {
-                        kDecay = 0.45;
-                    }
-
-                    const double shapedT = shapeCurve(t, decayCurveMode, kDecay);
-
-                    eg.currentValue = eg.stageStartValue + (actualSustainLevel - eg.stageStartValue) * shapedT;
-
-                    if (elapsed >= decayMs)
-                    {
-                        eg.currentValue = actualSustainLevel;
-                        eg.stage = EnvelopeState::Stage::Sustain;
-                        eg.stageStartMs = nowMs;
-                        eg.stageStartValue = actualSustainLevel;
-                    }
-                }
-
-                return true;
-            }
-
-            case EnvelopeState::Stage::Sustain:
-            {
-                // Sustain at level relative to attack peak
-                eg.currentValue = sustainLevel * eg.attackPeak;
-
-                if (!eg.noteHeld)
-                {
-                    eg.stage = EnvelopeState::Stage::Release;
-                    eg.stageStartMs = nowMs;
-                    eg.stageStartValue = eg.currentValue;
-                }
-                return true;
-            }
-
-            case EnvelopeState::Stage::Release:
-            {
-                if (releaseMs <= epsilon)
-                {
-                    eg.currentValue = 0.0;
-                    eg.stage = EnvelopeState::Stage::Idle;
-                }
-                else
-                {
-                    const double t = juce::jlimit(0.0, 1.0, elapsed / releaseMs);
-
-                    double kRelease = 0.0;
-
-                    if (releaseCurveMode == CurveShape::Exponential)
-                    {
-                        kRelease = 0.35;
-                    }
-                    else if (releaseCurveMode == CurveShape::Logarithmic)
-                    {
-                        kRelease = 0.50;
-                    }
-
-                    const double shapedT = shapeCurve(t, releaseCurveMode, kRelease);
-
-                    eg.currentValue = eg.stageStartValue * (1.0 - shapedT);
-
-                    if (elapsed >= releaseMs || eg.currentValue <= 0.0001)
-                    {
-                        eg.currentValue = 0.0;
-                        eg.stage = EnvelopeState::Stage::Idle;
-                    }
-                }
-
-                return true;
-            }
-        }
-
-        return false;
-    }
-
-    inline double shapeCurve(double t, CurveShape mode, double k)
-    {
-        t = juce::jlimit(0.0, 1.0, t);
-
-        if (mode == CurveShape::Linear || k <= 0.0)
-            return t;
-
-          const double p = 1.0 + 5.0 * k;
-
-        if (mode == CurveShape::Exponential)
-        {
-            // Slow start, fast end
-            return std::pow(t, p);
-        }
-        else // Logarithmic
-        {
-            // Fast start, slow end
-            return 1.0 - std::pow(1.0 - t, p);
-        }
-    }
-
     // Convert attack slider value to milliseconds based on mode
     double attackMsFromSlider(double sliderValue) const
     {
@@ -975,6 +713,12 @@ private:
         return seconds * 1000.0;
     }
 
+    void settingsChanged()
+    {
+        if (onSettingsChanged)
+            onSettingsChanged(getSettings());
+    }
+
     // ==== Helpers =====================================================
     void setupSlider(juce::Slider& slider, juce::Label& label, const juce::String& name, const juce::Slider::SliderStyle& style)
     {
@@ -1099,6 +843,8 @@ private:
             }
 
         label.setJustificationType(juce::Justification::centredLeft);
+        slider.onValueChange = [this]() { settingsChanged(); };
+
         label.attachToComponent(&slider, false); // semantic link only
 
     }
@@ -0,0 +1,339 @@
+#pragma once
+#include <JuceHeader.h>
+
+// ==========================================
+// Envelope generator (engine side)
+// ==========================================
+// AHDSR state machine driven by the modulation engine tick. EnvelopeComponent
+// owns the controls and publishes a Settings snapshot; this class never
+// touches the UI, so it can run on the engine thread.
+class EnvelopeGenerator
+{
+public:
+    enum class AttackMode
+    {
+        Fast,
+        Long,
+        Snap
+    };
+
+    // EG curves
+    enum class CurveShape
+    {
+        Linear,
+        Exponential,
+        Logarithmic
+    };
+
+    struct Settings
+    {
+        int noteSourceChannel = 17;  // 1-16, 17 = off
+        int outChannel = 1;
+        int outParamIndex = -1;      // index into syntaktParameters
+
+        // times already converted to ms (attack/release modes applied)
+        double attackMs = 0.5;
+        double holdMs = 0.0;
+        double decayMs = 1.0;
+        double sustainLevel = 0.0;
+        double releaseMs = 5.0;
+        double velocityAmount = 0.0;
+
+        AttackMode attackMode = AttackMode::Fast;
+        CurveShape decayCurve = CurveShape::Exponential;
+        CurveShape releaseCurve = CurveShape::Exponential;
+
+        bool isEnabled() const noexcept   { return noteSourceChannel != 17; }
+    };
+
+    void setSettings(const Settings& newSettings) noexcept
+    {
+        settings = newSettings;
+    }
+
+    const Settings& getSettings() const noexcept   { return settings; }
+
+    bool isEnabled() const noexcept   { return settings.isEnabled(); }
+
+    // Changes from tick to tick (sustain holds still until the note-off)
+    bool isMoving() const noexcept
+    {
+        return isEnabled()
+            && eg.stage != EnvelopeState::Stage::Idle
+            && !(eg.stage == EnvelopeState::Stage::Sustain && eg.noteHeld);
+    }
+
+    bool tick(double nowMs, double& outMidiValue)
+    {
+        if (!isEnabled())
+            return false;
+
+        if (!advanceEnvelope(eg, nowMs))
+            return false;
+
+        outMidiValue = juce::jlimit(0.0, 1.0, eg.currentValue);
+
+        return true;
+    }
+
+    void noteOn(int ch, int note, float velocity, double nowMs)
+    {
+        juce::ignoreUnused(note);
+
+        if (ch == settings.noteSourceChannel)
+        {
+            // Store velocity and reset peak computation flag
+            eg.velocity = juce::jlimit(0.0, 1.0, velocity / 127.0);
+            eg.attackPeakComputed = false; // Reset flag so peak will be computed on first tick
+
+            eg.stage = EnvelopeState::Stage::Attack;
+            eg.stageStartMs = nowMs;
+            eg.stageStartValue = eg.currentValue;
+            eg.noteHeld = true;
+        }
+    }
+
+    void noteOff(int ch, double nowMs)
+    {
+        if (ch == settings.noteSourceChannel)
+        {
+            eg.stage = EnvelopeState::Stage::Release;
+            eg.stageStartMs = nowMs;
+            eg.stageStartValue = eg.currentValue;
+            eg.noteHeld = false;
+        }
+    }
+
+private:
+    //EG state
+    struct EnvelopeState
+    {
+        enum class Stage
+        {
+            Idle,
+            Attack,
+            Hold,
+            Decay,
+            Sustain,
+            Release
+        };
+
+        Stage stage = Stage::Idle;
+        double currentValue = 0.0;
+
+        double stageStartMs = 0.0;
+        double stageStartValue = 0.0;
+
+        bool noteHeld = false;
+
+        //Velocity to EG
+        double velocity = 1.0;       // normalized 0..1
+        double attackPeak = 1.0;     // computed per note
+        bool attackPeakComputed = false;
+    };
+
+    Settings settings;
+    EnvelopeState eg;
+
+    // Compute attack peak based on velocity and velocity amount
+    inline double computeAttackPeak(double velocity, double velAmount) const
+    {
+        // velAmount = 0 → peak is always 1.0 (no velocity sensitivity)
+        // velAmount = 1 → peak follows velocity exactly
+        return juce::jlimit(0.0, 1.0,
+            juce::jmap(velAmount, 0.0, 1.0, 1.0, velocity));
+    }
+
+    //EG tick function
+    bool advanceEnvelope(EnvelopeState& eg, double nowMs)
+    {
+        constexpr double epsilon = 0.001; // 1 microsecond threshold
+
+        const double attackMs       = settings.attackMs;
+        const double holdMs         = settings.holdMs;
+        const double decayMs        = settings.decayMs;
+        const double sustainLevel   = settings.sustainLevel;
+        const double releaseMs      = settings.releaseMs;
+        const double velocityAmount = settings.velocityAmount;
+
+        auto elapsed = nowMs - eg.stageStartMs;
+
+        switch (eg.stage)
+        {
+            case EnvelopeState::Stage::Idle:
+                eg.currentValue = 0.0;
+                return false;
+
+            case EnvelopeState::Stage::Attack:
+            {
+                // Compute attack peak once at the start of Attack stage
+                if (!eg.attackPeakComputed)
+                {
+                    eg.attackPeak = computeAttackPeak(eg.velocity, velocityAmount);
+                    eg.attackPeakComputed = true;
+                }
+
+                if (attackMs <= epsilon)
+                {
+                    eg.currentValue = eg.attackPeak;
+                }
+                else
+                {
+                    double t = juce::jlimit(0.0, 1.0, elapsed / attackMs);
+
+                    if (settings.attackMode == AttackMode::Snap)
+                    {
+                        constexpr double snapAmount = 6.0;
+                        t = 1.0 - std::exp(-snapAmount * t);
+                    }
+
+                    eg.currentValue = eg.stageStartValue + (eg.attackPeak - eg.stageStartValue) * t;
+                }
+
+                // Check if we've reached the peak
+                if (elapsed >= attackMs || eg.currentValue >= (eg.attackPeak - 0.0001))
+                {
+                    eg.currentValue = eg.attackPeak;
+                    eg.stageStartMs = nowMs;
+                    eg.stageStartValue = eg.attackPeak;
+
+                    // Check if hold time is meaningful
+                    if (holdMs > epsilon)
+                        eg.stage = EnvelopeState::Stage::Hold;
+                    else
+                        eg.stage = EnvelopeState::Stage::Decay;
+                }
+                return true;
+            }
+
+            case EnvelopeState::Stage::Hold:
+            {
+                // Hold at attack peak value
+                eg.currentValue = eg.attackPeak;
+
+                if (elapsed >= holdMs)
+                {
+                    eg.stage = EnvelopeState::Stage::Decay;
+                    eg.stageStartMs = nowMs;
+                    eg.stageStartValue = eg.attackPeak; // Start decay from actual peak
+                }
+                return true;
+            }
+
+            case EnvelopeState::Stage::Decay:
+            {
+                // Calculate actual sustain level relative to attack peak
+                // sustainLevel is 0..1 from slider, scale it to 0..attackPeak
+                const double actualSustainLevel = sustainLevel * eg.attackPeak;
+
+                if (decayMs <= epsilon)
+                {
+                    eg.currentValue = actualSustainLevel;
+                    eg.stage = EnvelopeState::Stage::Sustain;
+                }
+                else
+                {
+                    const double t = juce::jlimit(0.0, 1.0, elapsed / decayMs);
+
+                    double kDecay = 0.0;
+
+                    if (settings.decayCurve == CurveShape::Exponential)
+                    {
+                        kDecay = 0.30;
+                    }
+                    else if (settings.decayCurve == CurveShape::Logarithmic)
+                    {
+                        kDecay = 0.45;
+                    }
+
+                    const double shapedT = shapeCurve(t, settings.decayCurve, kDecay);
+
+                    eg.currentValue = eg.stageStartValue + (actualSustainLevel - eg.stageStartValue) * shapedT;
+
+                    if (elapsed >= decayMs)
+                    {
+                        eg.currentValue = actualSustainLevel;
+                        eg.stage = EnvelopeState::Stage::Sustain;
+                        eg.stageStartMs = nowMs;
+                        eg.stageStartValue = actualSustainLevel;
+                    }
+                }
+
+                return true;
+            }
+
+            case EnvelopeState::Stage::Sustain:
+            {
+                // Sustain at level relative to attack peak
+                eg.currentValue = sustainLevel * eg.attackPeak;
+
+                if (!eg.noteHeld)
+                {
+                    eg.stage = EnvelopeState::Stage::Release;
+                    eg.stageStartMs = nowMs;
+                    eg.stageStartValue = eg.currentValue;
+                }
+                return true;
+            }
+
+            case EnvelopeState::Stage::Release:
+            {
+                if (releaseMs <= epsilon)
+                {
+                    eg.currentValue = 0.0;
+                    eg.stage = EnvelopeState::Stage::Idle;
+                }
+                else
+                {
+                    const double t = juce::jlimit(0.0, 1.0, elapsed / releaseMs);
+
+                    double kRelease = 0.0;
+
+                    if (settings.releaseCurve == CurveShape::Exponential)
+                    {
+                        kRelease = 0.35;
+                    }
+                    else if (settings.releaseCurve == CurveShape::Logarithmic)
+                    {
+                        kRelease = 0.50;
+                    }
+
+                    const double shapedT = shapeCurve(t, settings.releaseCurve, kRelease);
+
+                    eg.currentValue = eg.stageStartValue * (1.0 - shapedT);
+
+                    if (elapsed >= releaseMs || eg.currentValue <= 0.0001)
+                    {
+                        eg.currentValue = 0.0;
+                        eg.stage = EnvelopeState::Stage::Idle;
+                    }
+                }
+
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    inline double shapeCurve(double t, CurveShape mode, double k)
+    {
+        t = juce::jlimit(0.0, 1.0, t);
+
+        if (mode == CurveShape::Linear || k <= 0.0)
+            return t;
+
+          const double p = 1.0 + 5.0 * k;
+
+        if (mode == CurveShape::Exponential)
+        {
+            // Slow start, fast end
+            return std::pow(t, p);
+        }
+        else // Logarithmic
+        {
+            // Fast start, slow end
+            return 1.0 - std::pow(1.0 - t, p);
+        }
+    }
+};
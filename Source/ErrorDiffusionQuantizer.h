@@ -0,0 +1,99 @@
+#pragma once
+#include <JuceHeader.h>
+
+// ==========================================
+// Coarse throttle quantizer
+// ==========================================
+// Used per destination when the change threshold is 2 steps or more. The
+// plain "skip until it moved by N" throttle always trails the curve by up to
+// N steps, sends at uneven intervals wherever rounding lets the integer
+// delta reach N, and never sends a peak that lies within N of the last send.
+//
+// Here every send is planned from the current slope: the value is held for
+// as many ticks as the curve needs to travel N steps (the old throttle's
+// rate), and what is sent is the curve's value at the middle of that hold,
+// so the error swings around zero instead of trailing. The rounding error of
+// each send is carried into the next one. A change of direction emits the
+// extreme just passed, so peaks and troughs always reach the device, and
+// drifting a full step from what was sent (square edges, phase restarts, a
+// slope that changed) sends at once.
+struct ErrorDiffusionQuantizer
+{
+    static constexpr int nothing = -1;
+    static constexpr int maxHoldTicks = 50;
+    static constexpr double maxGapMs = 50.0;
+
+    // Called on every tick the destination is evaluated. Returns the value to
+    // send now, or nothing.
+    int process(double value, double nowMs, double step, int minValue, int maxValue) noexcept
+    {
+        // first evaluation, or the source paused: start over
+        const bool fresh = lastEvalMs < 0.0 || nowMs - lastEvalMs > maxGapMs;
+        const double slope = fresh ? 0.0 : value - lastValue;   // per tick
+        const double previous = lastValue;
+
+        lastEvalMs = nowMs;
+        lastValue = value;
+
+        if (fresh)
+        {
+            direction = 0;
+            carry = 0.0;
+            return emit(value, value, step * 0.5, slope, minValue, maxValue);
+        }
+
+        if (std::abs(value - sentValue) > step * 0.5 + 0.5)
+            return emitCentred(value, step, slope, minValue, maxValue);
+
+        const int newDirection = slope > 0.0 ? 1 : (slope < 0.0 ? -1 : direction);
+
+        // peak or trough at the previous evaluation: the next send is due
+        // once the curve is half a step away from it
+        if (direction != 0 && newDirection != direction)
+        {
+            direction = newDirection;
+            carry = 0.0;
+            return emit(previous, previous, step * 0.5, slope, minValue, maxValue);
+        }
+
+        direction = newDirection;
+
+        if (--ticksLeft > 0)
+            return nothing;
+
+        return emitCentred(value, step, slope, minValue, maxValue);
+    }
+
+    double lastValue = 0.0;
+    double lastEvalMs = -1.0;
+    double sentValue = 0.0;    // unrounded value of the last send
+    double carry = 0.0;        // rounding error of the last centred send
+    int ticksLeft = 0;
+    int holdLength = 1;        // ticks between the last send and the next planned one
+    int direction = 0;
+
+private:
+    int emitCentred(double value, double step, double slope, int minValue, int maxValue) noexcept
+    {
+        const int hold = holdTicks(step, slope);
+        const double target = value + slope * (hold - 1) * 0.5 + carry;
+        const double rounded = std::round(target);
+
+        carry = target - rounded;
+        return emit(target, rounded, step, slope, minValue, maxValue);
+    }
+
+    int emit(double target, double value, double span, double slope, int minValue, int maxValue) noexcept
+    {
+        sentValue = target;
+        ticksLeft = holdLength = holdTicks(span, slope);
+        return juce::jlimit(minValue, maxValue, (int) std::round(value));
+    }
+
+    // ticks the curve needs to travel that far at this slope
+    static int holdTicks(double distance, double slope) noexcept
+    {
+        const double ticks = std::ceil(distance / std::max(std::abs(slope), 1.0e-6));
+        return (int) juce::jlimit(1.0, (double) maxHoldTicks, ticks);
+    }
+};
@@ -0,0 +1,431 @@
+#pragma once
+#include <JuceHeader.h>
+#include "ModulationEngine.h"
+#include "EngineTelemetry.h"
+#include "MidiOutputPort.h"
+#include "MergedMidiInput.h"
+
+// Opt-in: needs the JACK headers, and linking with libjack (add "jack" to
+// the Linux exporter's pkg-config libraries and MODZTAKT_JACK=1 to its
+// preprocessor definitions).
+#ifndef MODZTAKT_JACK
+ #define MODZTAKT_JACK 0
+#endif
+
+#if MODZTAKT_JACK
+ #include <jack/jack.h>
+ #include <jack/midiport.h>
+#endif
+
+// ==========================================
+// JACK MIDI backend
+// ==========================================
+// A JACK client with one MIDI output and one MIDI input port. While it is
+// active the engine is ticked from the JACK process callback instead of
+// EngineThread: every tickRateHz-th of a second of audio frames, at the
+// exact frame it falls on, and the messages of that tick are written at
+// that frame offset. LFO output is then sample-accurate relative to the
+// rest of the graph. Input events are pushed into the merged input (as
+// its first source) between ticks in frame order, stamped with their frame
+// time.
+//
+// Times passed on stay on the Time::getMillisecondCounterHiRes() timebase
+// (cycle start + frame offset), so probes, the EG and the clock handler
+// work the same as with EngineThread. The cycle start is the one JACK
+// keeps for the cycle's first frame (jack_get_cycle_times), not the moment
+// the callback woke, so tick and input times carry no wake-up jitter.
+// jack_get_time() is CLOCK_MONOTONIC under JACK2, like the counter; the
+// offset between the two is measured when the client opens, for servers
+// on another clock source.
+//
+// Scheduled messages (the clock master's, see sendScheduled()) are held
+// until the frame their due time falls on, which may be a later cycle, and
+// written in order with the ticks' events. A full hold drops the message
+// and counts it in the telemetry, as QueuedOutputPort does.
+//
+// Quick test without audio hardware:
+//   jackd -d dummy -r 48000 -p 256 &
+//   jack_midi_dump &   then pick "midi-monitor:input" as MIDI output
+class JackMidiClient : private juce::AsyncUpdater
+{
+public:
+    static constexpr bool isAvailable() noexcept   { return MODZTAKT_JACK != 0; }
+
+   #if MODZTAKT_JACK
+    // Message thread. Returns nullptr if no JACK server is running.
+    static std::unique_ptr<JackMidiClient> open(ModulationEngine& engine, EngineTelemetry& telemetry)
+    {
+        jack_status_t status {};
+        auto* app = juce::JUCEApplicationBase::getInstance();
+        const juce::String clientName = app != nullptr ? app->getApplicationName() : "ModzTakt";
+
+        auto* client = jack_client_open(clientName.toRawUTF8(), JackNoStartServer, &status);
+
+        if (client == nullptr)
+            return nullptr;
+
+        auto* outPort = jack_port_register(client, "midi_out", JACK_DEFAULT_MIDI_TYPE, JackPortIsOutput, 0);
+        auto* inPort  = jack_port_register(client, "midi_in",  JACK_DEFAULT_MIDI_TYPE, JackPortIsInput, 0);
+
+        if (outPort == nullptr || inPort == nullptr)
+        {
+            jack_client_close(client);
+            return nullptr;
+        }
+
+        return std::unique_ptr<JackMidiClient>(new JackMidiClient(engine, telemetry, client, outPort, inPort));
+    }
+
+    ~JackMidiClient() override
+    {
+        cancelPendingUpdate();
+
+        // returns once the process callback has finished for good
+        jack_deactivate(client);
+        jack_client_close(client);
+    }
+
+    // Receiver for all input events, as source 0; set before activate()
+    void setInput(MergedMidiInput* mergedInput) noexcept   { input = mergedInput; }
+
+    // From here on the process callback ticks the engine
+    bool activate()
+    {
+        return jack_activate(client) == 0;
+    }
+
+    MidiOutputPort* getOutputPort() noexcept   { return &output; }
+
+    // ---- Other clients' ports (message thread) ----
+    juce::Array<juce::MidiDeviceInfo> getDestinations() const   { return listPorts(JackPortIsInput); }
+    juce::Array<juce::MidiDeviceInfo> getSources() const        { return listPorts(JackPortIsOutput); }
+
+    // Connects our output to that port only; an empty name disconnects
+    void connectOutputTo(const juce::String& portName)
+    {
+        disconnectAll(outPort);
+
+        if (portName.isNotEmpty())
+            jack_connect(client, jack_port_name(outPort), portName.toRawUTF8());
+    }
+
+    void connectInputFrom(const juce::String& portName)
+    {
+        disconnectAll(inPort);
+
+        if (portName.isNotEmpty())
+            jack_connect(client, portName.toRawUTF8(), jack_port_name(inPort));
+    }
+
+    bool isOutputConnectedTo(const juce::String& portName) const
+    {
+        return jack_port_connected_to(outPort, portName.toRawUTF8()) != 0;
+    }
+
+    bool isInputConnectedFrom(const juce::String& portName) const
+    {
+        return jack_port_connected_to(inPort, portName.toRawUTF8()) != 0;
+    }
+
+    // Message thread notifications
+    std::function<void()> onPortsChanged;   // ports registered/unregistered or (dis)connected
+    std::function<void()> onShutdown;       // the server went away; delete this client
+
+private:
+    // ==========================================
+    // Output port: events of the current tick at its frame
+    // ==========================================
+    class Output : public MidiOutputPort
+    {
+    public:
+        static constexpr int scheduledCapacity = 64;
+
+        Output(jack_port_t* p, EngineTelemetry& t)
+            : name("JACK " + juce::String(jack_port_name(p))), identifier(jack_port_name(p)), telemetry(t)
+        {
+        }
+
+        juce::String getName() const override         { return name; }
+        juce::String getIdentifier() const override   { return identifier; }
+
+        int send(juce::ump::View packet) noexcept override
+        {
+            juce::uint8 bytes[3];
+            const int size = toBytestream(packet, bytes);
+
+            if (size == 0)
+                return 0;
+
+            writeScheduledUpTo(frame);
+
+            if (buffer == nullptr
+                || jack_midi_event_write(buffer, frame, bytes, (size_t) size) != 0)
+            {
+                droppedSinceFlush += size;
+                return 0;
+            }
+
+            return size;
+        }
+
+        int sendScheduled(juce::ump::View packet, double dueMs) noexcept override
+        {
+            juce::uint8 bytes[3];
+            const int size = toBytestream(packet, bytes);
+
+            if (size == 0)
+                return 0;
+
+            if (numScheduled == scheduledCapacity)
+            {
+                telemetry.clockDropped();
+                return 0;
+            }
+
+            scheduled[(size_t) ((firstScheduled + numScheduled++) % scheduledCapacity)] = { packet[0], dueMs };
+            return size;
+        }
+
+        int flush() noexcept override
+        {
+            return std::exchange(droppedSinceFlush, 0);
+        }
+
+        // Process callback: scheduled messages due up to that frame of the
+        // cycle; earlier events keep the frame order JACK wants
+        void writeScheduledUpTo(jack_nframes_t lastFrame) noexcept
+        {
+            while (numScheduled > 0 && buffer != nullptr)
+            {
+                const auto& entry = scheduled[(size_t) firstScheduled];
+                const double dueFrame = (entry.dueMs - cycleStartMs) / msPerFrame;
+
+                if (dueFrame > (double) lastFrame)
+                    return;
+
+                juce::uint8 bytes[3];
+                const int size = toBytestream(juce::ump::View(&entry.word), bytes);
+                const auto at = (jack_nframes_t) juce::jmax(0.0, std::ceil(dueFrame));
+
+                juce::ignoreUnused(jack_midi_event_write(buffer, juce::jmin(at, lastFrame), bytes, (size_t) size));
+
+                firstScheduled = (firstScheduled + 1) % scheduledCapacity;
+                --numScheduled;
+            }
+        }
+
+        void* buffer = nullptr;    // this cycle's port buffer, process callback only
+        jack_nframes_t frame = 0;  // offset of the tick being run
+        double cycleStartMs = 0.0;
+        double msPerFrame = 1.0;
+
+    private:
+        struct Scheduled
+        {
+            juce::uint32 word = 0;
+            double dueMs = 0.0;
+        };
+
+        juce::String name, identifier;
+        EngineTelemetry& telemetry;
+        int droppedSinceFlush = 0;
+
+        std::array<Scheduled, scheduledCapacity> scheduled {};
+        int firstScheduled = 0, numScheduled = 0;
+    };
+
+    JackMidiClient(ModulationEngine& e, EngineTelemetry& telemetry, jack_client_t* c, jack_port_t* out, jack_port_t* in)
+        : engine(e), client(c), outPort(out), inPort(in), output(out, telemetry)
+    {
+        sampleRate.store((double) jack_get_sample_rate(client), std::memory_order_relaxed);
+        jackTimeOffsetMs = juce::Time::getMillisecondCounterHiRes() - (double) jack_get_time() * 0.001;
+
+        jack_set_process_callback(client, processCallback, this);
+        jack_set_sample_rate_callback(client, sampleRateCallback, this);
+        jack_set_port_registration_callback(client, portRegistrationCallback, this);
+        jack_set_port_connect_callback(client, portConnectCallback, this);
+        jack_on_shutdown(client, shutdownCallback, this);
+    }
+
+    // ---- JACK process thread ----
+    static int processCallback(jack_nframes_t numFrames, void* arg)
+    {
+        static_cast<JackMidiClient*>(arg)->process(numFrames);
+        return 0;
+    }
+
+    void process(jack_nframes_t numFrames) noexcept
+    {
+        const double cycleStartMs = getCycleStartMs();
+        const double rate = sampleRate.load(std::memory_order_relaxed);
+        const double msPerFrame = 1000.0 / rate;
+        const double framesPerTick = rate / ModulationEngine::tickRateHz;
+
+        output.buffer = jack_port_get_buffer(outPort, numFrames);
+        output.cycleStartMs = cycleStartMs;
+        output.msPerFrame = msPerFrame;
+        jack_midi_clear_buffer(output.buffer);
+
+        void* inBuffer = jack_port_get_buffer(inPort, numFrames);
+        const auto numEvents = jack_midi_get_event_count(inBuffer);
+        jack_nframes_t nextEvent = 0;
+
+        auto dispatchInputUpTo = [&](double frame)
+        {
+            jack_midi_event_t event;
+
+            while (nextEvent < numEvents
+                   && jack_midi_event_get(&event, inBuffer, nextEvent) == 0
+                   && (double) event.time <= frame)
+            {
+                ++nextEvent;
+                dispatchInput(event, cycleStartMs + event.time * msPerFrame);
+            }
+        };
+
+        while (framesToNextTick < (double) numFrames)
+        {
+            dispatchInputUpTo(framesToNextTick);
+
+            output.frame = (jack_nframes_t) framesToNextTick;
+            engine.tick(cycleStartMs + framesToNextTick * msPerFrame);
+
+            framesToNextTick += framesPerTick;
+        }
+
+        dispatchInputUpTo((double) numFrames);
+        output.writeScheduledUpTo(numFrames - 1);
+
+        framesToNextTick -= (double) numFrames;
+        output.buffer = nullptr;
+    }
+
+    // The time JACK has for the cycle's first frame, on the millisecond
+    // counter's timebase
+    double getCycleStartMs() const noexcept
+    {
+        jack_nframes_t frames = 0;
+        jack_time_t usecs = 0, nextUsecs = 0;
+        float periodUsecs = 0.0f;
+
+        if (jack_get_cycle_times(client, &frames, &usecs, &nextUsecs, &periodUsecs) != 0)
+            usecs = jack_frames_to_time(client, jack_last_frame_time(client));
+
+        return (double) usecs * 0.001 + jackTimeOffsetMs;
+    }
+
+    // channel and realtime messages only: sysex would allocate in MidiMessage
+    void dispatchInput(const jack_midi_event_t& event, double timeMs) noexcept
+    {
+        if (event.size == 0 || event.size > 3 || event.buffer[0] == 0xf0)
+            return;
+
+        const juce::MidiMessage message(event.buffer, (int) event.size, timeMs * 0.001);
+
+        if (input != nullptr)
+            input->push(0, message, timeMs);
+    }
+
+    // ---- JACK notification thread ----
+    static int sampleRateCallback(jack_nframes_t newRate, void* arg)
+    {
+        static_cast<JackMidiClient*>(arg)->sampleRate.store((double) newRate, std::memory_order_relaxed);
+        return 0;
+    }
+
+    static void portRegistrationCallback(jack_port_id_t, int, void* arg)
+    {
+        static_cast<JackMidiClient*>(arg)->triggerAsyncUpdate();
+    }
+
+    static void portConnectCallback(jack_port_id_t, jack_port_id_t, int, void* arg)
+    {
+        static_cast<JackMidiClient*>(arg)->triggerAsyncUpdate();
+    }
+
+    static void shutdownCallback(void* arg)
+    {
+        auto* self = static_cast<JackMidiClient*>(arg);
+        self->serverGone.store(true);
+        self->triggerAsyncUpdate();
+    }
+
+    // ---- Message thread ----
+    void handleAsyncUpdate() override
+    {
+        if (serverGone.load())
+        {
+            if (onShutdown)
+                onShutdown();
+        }
+        else if (onPortsChanged)
+        {
+            onPortsChanged();
+        }
+    }
+
+    juce::Array<juce::MidiDeviceInfo> listPorts(unsigned long flags) const
+    {
+        juce::Array<juce::MidiDeviceInfo> result;
+
+        if (const char** names = jack_get_ports(client, nullptr, JACK_DEFAULT_MIDI_TYPE, flags))
+        {
+            for (auto** name = names; *name != nullptr; ++name)
+                if (!jack_port_is_mine(client, jack_port_by_name(client, *name)))
+                    result.add({ juce::String(*name), juce::String(*name) });
+
+            jack_free(names);
+        }
+
+        return result;
+    }
+
+    void disconnectAll(jack_port_t* port)
+    {
+        if (const char** connections = jack_port_get_connections(port))
+        {
+            for (auto** other = connections; *other != nullptr; ++other)
+            {
+                if (port == outPort)
+                    jack_disconnect(client, jack_port_name(outPort), *other);
+                else
+                    jack_disconnect(client, *other, jack_port_name(inPort));
+            }
+
+            jack_free(connections);
+        }
+    }
+
+    ModulationEngine& engine;
+    jack_client_t* client;
+    jack_port_t* outPort;
+    jack_port_t* inPort;
+    Output output;
+
+    MergedMidiInput* input = nullptr;
+
+    std::atomic<double> sampleRate { 48000.0 };
+    double jackTimeOffsetMs = 0.0;   // millisecond counter - jack_get_time(), set before activate()
+    double framesToNextTick = 0.0;   // process thread only
+    std::atomic<bool> serverGone { false };
+
+   #else
+    // Built without JACK support
+    static std::unique_ptr<JackMidiClient> open(ModulationEngine&, EngineTelemetry&)   { return nullptr; }
+
+    void setInput(MergedMidiInput*) noexcept {}
+    bool activate()                                                        { return false; }
+    MidiOutputPort* getOutputPort() noexcept                               { return nullptr; }
+    juce::Array<juce::MidiDeviceInfo> getDestinations() const              { return {}; }
+    juce::Array<juce::MidiDeviceInfo> getSources() const                   { return {}; }
+    void connectOutputTo(const juce::String&) {}
+    void connectInputFrom(const juce::String&) {}
+    bool isOutputConnectedTo(const juce::String&) const                    { return false; }
+    bool isInputConnectedFrom(const juce::String&) const                   { return false; }
+
+    std::function<void()> onPortsChanged, onShutdown;
+
+private:
+    void handleAsyncUpdate() override {}
+   #endif
+};
@@ -8,6 +8,7 @@
 
 #include <JuceHeader.h>
 #include "MainComponent.h"
+#include "EngineDaemon.h"
 #include "SyntaktParameterTable.h"
 #include "MidiInput.h"
 
@@ -25,13 +26,49 @@ public:
     //==============================================================================
     void initialise (const juce::String&) override
     {
+        const auto arguments = getCommandLineParameterArray();
+
+        // The engine process: no window, driven by the windows through the
+        // shared control surface (started by the first window that finds none)
+        if (arguments.contains ("--daemon"))
+        {
+            auto surface = SharedControlSurface::create();
+
+            // another engine already runs
+            if (surface == nullptr)
+            {
+                setApplicationReturnValue (1);
+                quit();
+                return;
+            }
+
+            daemon = std::make_unique<EngineDaemon> (std::move (surface));
+            daemon->onQuit = [] { quit(); };
+            return;
+        }
+
+        if (arguments.contains ("--stop-engine"))
+        {
+            if (auto surface = SharedControlSurface::attach())
+            {
+                SharedControlSurface::Command command;
+                command.kind = SharedControlSurface::Command::quit;
+                surface->send (command);
+            }
+
+            quit();
+            return;
+        }
+
+        const double initialiseMs = juce::Time::getMillisecondCounterHiRes();
+
         mainWindow.reset (new MainWindow (getApplicationName()));
 
         // JUCE 8 need MIDI devices to be started earlier
-        juce::MessageManager::callAsync ([this]
+        juce::MessageManager::callAsync ([this, initialiseMs]
         {
             if (auto* mc = dynamic_cast<MainComponent*> (mainWindow->getContentComponent()))
-                mc->postJuceInit();
+                mc->postJuceInit (initialiseMs);
         });
     }
 
@@ -40,6 +77,7 @@ public:
         // Add your application's shutdown code here..
 
         mainWindow = nullptr; // (deletes our window)
+        daemon = nullptr;
     }
 
     //==============================================================================
@@ -113,6 +151,7 @@ public:
 
 private:
     std::unique_ptr<MainWindow> mainWindow;
+    std::unique_ptr<EngineDaemon> daemon;
 };
 
 //==============================================================================
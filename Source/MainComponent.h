@@ -5,19 +5,18 @@
 #include "MidiMonitorWindow.h"
 #include "EnvelopeComponent.h"
 #include "ScopeModalComponent.h"
+#include "TelemetryWindow.h"
+#include "EngineClient.h"
+#include "EngineTrace.h"
+#include "RealtimeGuard.h"
 #include "Cosmetic.h"
 
 class MainComponent : public juce::Component,
-                      private juce::Timer,
-                      public MidiClockListener
+                      private juce::Timer
 {
 public:
     MainComponent()
     {
-
-        // Initialize MIDI clock listener
-        midiClock.setListener(this);
-
         // frame
         lfoGroup.setText("LFO");
         lfoGroup.setColour(juce::GroupComponent::outlineColourId, juce::Colours::white);
@@ -29,6 +28,13 @@ public:
         envelopeComponent = std::make_unique<EnvelopeComponent>();
         addAndMakeVisible(*envelopeComponent);
 
+        engineSettings.eg = envelopeComponent->getSettings();
+        envelopeComponent->onSettingsChanged = [this](const EnvelopeGenerator::Settings& eg)
+        {
+            engineSettings.eg = eg;
+            publishEngineSettings();
+        };
+
         // MIDI Output
         midiOutputLabel.setText("MIDI Output:", juce::dontSendNotification);
         addAndMakeVisible(midiOutputLabel);
@@ -39,35 +45,53 @@ public:
         addAndMakeVisible(midiInputLabel);
         addAndMakeVisible(midiInputBox);
 
-        refreshMidiInputs();
-        refreshMidiOutputs();
-
         // Sync Mode
         syncModeLabel.setText("Sync Source:", juce::dontSendNotification);
         addAndMakeVisible(syncModeLabel);
         addAndMakeVisible(syncModeBox);
         syncModeBox.addItem("Free", 1);
         syncModeBox.addItem("MIDI Clock", 2);
+        syncModeBox.addItem("Clock Master", 3);
 
         // SET UP CALLBACKS BEFORE POPULATING OR SETTING VALUES
         midiOutputBox.onChange = [this] { openSelectedMidiOutput(); };
         midiInputBox.onChange = [this]() { updateMidiInput(); };
-        syncModeBox.onChange = [this]() { updateMidiClockState(); };
-
-        // NOW populate the combo boxes (might trigger callbacks if devices exist)
-        refreshMidiOutputs();
-        refreshMidiInputs();
+        syncModeBox.onChange = [this]()
+        {
+            engineSettings.syncEnabled = (syncModeBox.getSelectedId() == 2);
+            engineSettings.clockMaster = (syncModeBox.getSelectedId() == 3);
+            updateBpmRow();
+            publishEngineSettings();
+        };
 
         // Set default selections AFTER everything is wired up
         syncModeBox.setSelectedId(1); // Free mode by default      
 
-        // Select first available MIDI output if any
-        if (midiOutputBox.getNumItems() > 0)
-            midiOutputBox.setSelectedId(1);
-    
-        // Select first available MIDI input if any  
-        if (midiInputBox.getNumItems() > 0)
-            midiInputBox.setSelectedId(1);
+        // MIDI device boxes are filled once the window is on screen, see listMidiDevices()
+        engine.onDevicesChanged = [this] { refillMidiDeviceBoxes(); };
+
+        // the engine was already running, or another window changed them
+        engine.onSettingsChanged = [this](const ModulationEngine::Settings& s) { showSettings(s); };
+
+        engine.onConnectionChanged = [this] { telemetryWindow.reset(); };
+        engine.onBackendFailed = []
+        {
+            juce::AlertWindow::showMessageBoxAsync(juce::MessageBoxIconType::WarningIcon,
+                                                   "JACK MIDI", "No JACK server is running.");
+        };
+
+        engine.onPresetsFailed = []
+        {
+            juce::AlertWindow::showMessageBoxAsync(juce::MessageBoxIconType::WarningIcon,
+                                                   "Presets", "The preset file couldn't be written or read, or the preset is empty.");
+        };
+
+        engine.onAutomationFailed = []
+        {
+            juce::AlertWindow::showMessageBoxAsync(juce::MessageBoxIconType::WarningIcon,
+                                                   "Automation", "The MIDI file couldn't be written, held no parameter changes, "
+                                                   "or had more than fit (some tracks or lanes were left out).");
+        };
 
         // BPM Display
         bpmLabelTitle.setText("Detected BPM:", juce::dontSendNotification);
@@ -76,6 +100,21 @@ public:
         bpmLabel.setColour(juce::Label::textColourId, juce::Colours::aqua);
         addAndMakeVisible(bpmLabel);
 
+        // typed in as clock master
+        bpmLabel.onTextChange = [this]
+        {
+            const double bpm = bpmLabel.getText().getDoubleValue();
+
+            if (bpm >= MidiClockGenerator::minBpm && bpm <= MidiClockGenerator::maxBpm)
+            {
+                engineSettings.masterBpm = bpm;
+                publishEngineSettings();
+                updateLfoRateFromBpm(rateSlider.getValue());
+            }
+
+            bpmLabel.setText(juce::String(engineSettings.masterBpm, 1), juce::dontSendNotification);
+        };
+
         // Sync Division
         divisionLabel.setText("Tempo Divider:", juce::dontSendNotification);
         addAndMakeVisible(divisionLabel);
@@ -88,7 +127,12 @@ public:
         divisionBox.addItem("1/32", 6);
         divisionBox.addItem("1/8 dotted", 7);
         divisionBox.addItem("1/16 dotted", 8);
-        divisionBox.onChange = [this]() { updateLfoRateFromBpm(rateSlider.getValue()); };
+        divisionBox.onChange = [this]()
+        {
+            engineSettings.divisionId = divisionBox.getSelectedId();
+            publishEngineSettings();
+            updateLfoRateFromBpm(rateSlider.getValue());
+        };
         addAndMakeVisible(divisionBox);
 
         divisionBox.setSelectedId(3); // default quarter note
@@ -106,6 +150,9 @@ public:
 
         shapeBox.onChange = [this]()
         {
+            engineSettings.shapeId = shapeBox.getSelectedId();
+            publishEngineSettings();
+
             for (int i = 0; i < maxRoutes; ++i)
             {
                 if (shapeBox.getSelectedId() == 5) // disable bipolar and invert-Phase if shape = Random
@@ -137,6 +184,11 @@ public:
         rateSlider.setValue(2.0);
         rateSlider.setTextValueSuffix(" Hz");
         rateSlider.setLookAndFeel(&lookGreen);
+        rateSlider.onValueChange = [this]()
+        {
+            engineSettings.rateHz = rateSlider.getValue();
+            publishEngineSettings();
+        };
 
 
         // Depth
@@ -146,6 +198,11 @@ public:
         depthSlider.setRange(0.0, 1.0, 0.01);
         depthSlider.setValue(1.0);
         depthSlider.setLookAndFeel(&lookPurple);
+        depthSlider.onValueChange = [this]()
+        {
+            engineSettings.depth = depthSlider.getValue();
+            publishEngineSettings();
+        };
 
 
           // Start Button
@@ -175,12 +232,14 @@ public:
 
         noteSourceChannelBox.onChange = [this]()
         {
-            noteRestartChannel.store(noteSourceChannelBox.getSelectedId(), std::memory_order_release);
+            engineSettings.noteRestartChannel = noteSourceChannelBox.getSelectedId();
+            publishEngineSettings();
         };
 
         noteRestartToggle->onClick = [this]()
         {
             const bool enabled = noteRestartToggle->getToggleState();
+            engineSettings.noteRestartEnabled = enabled;
 
             for (int i = 0; i < maxRoutes; ++i)
             {
@@ -193,11 +252,12 @@ public:
                     // Hard-disable one-shot state
                     routeOneShotToggles[i]->setToggleState(false, juce::dontSendNotification);
 
-                    lfoRoutes[i].oneShot = false;
-                    lfoRoutes[i].hasFinishedOneShot = false;
+                    engineSettings.routes[i].oneShot = false;
                 }
             }
 
+            publishEngineSettings();
+
             // Stop-on-Note-Off UI logic
             noteOffStopToggle->setVisible(enabled);
             noteOffStopToggle->setEnabled(enabled);
@@ -214,6 +274,8 @@ public:
 
             }
 
+            updateNoteOffStopArmed();
+
             // layout refresh
             juce::MessageManager::callAsync([this]() { resized(); });
         };
@@ -228,6 +290,7 @@ public:
         noteOffStopToggle->setVisible(noteRestartToggle->getToggleState());
         noteOffStopToggle->setButtonText ("");
         noteOffStopToggle->setEnabled(false);
+        noteOffStopToggle->onClick = [this]() { updateNoteOffStopArmed(); };
 
         noteOffStopToggleLabel.setText ("Stop on Note-Off", juce::dontSendNotification);
         noteOffStopToggleLabel.setJustificationType (juce::Justification::centredLeft);
@@ -265,13 +328,7 @@ public:
             addAndMakeVisible(routeLabels[i]);
 
             // Channel box
-            if (i != 0) {
-                routeChannelBoxes[i].addItem("Disabled", 1);
-            }
-            
-            for (int ch = 1; ch <= 16; ++ch)
-                routeChannelBoxes[i].addItem("Ch " + juce::String(ch), ch + 1);
-
+            fillRouteChannelBox(i);
             addAndMakeVisible(routeChannelBoxes[i]);
 
             // Parameter box
@@ -310,53 +367,50 @@ public:
             // Set up callbacks BEFORE setting any values
             routeChannelBoxes[i].onChange = [this, i]()
             {
-                //debug
-                bool stopLFO = false;
-                if (lfoActive)
-                {
-                    toggleLfo();
-                    stopLFO = true;
-                }
                 const int comboId = routeChannelBoxes[i].getSelectedId();
-                lfoRoutes[i].midiChannel = (comboId == 1) ? 0 : (comboId - 1);
+                setRouteDestination(engineSettings.routes[i], comboId);
                 const bool enabled = (comboId != 1);
                 routeParameterBoxes[i].setVisible(enabled);
                 routeBipolarToggles[i]->setVisible(enabled);
                 routeInvertToggles[i]->setVisible(enabled);
                 if (!enabled)
+                {
                     routeOneShotToggles[i]->setToggleState(false, juce::dontSendNotification);
+                    engineSettings.routes[i].oneShot = false;
+                }
                 routeOneShotToggles[i]->setVisible(enabled && noteRestartToggle->getToggleState());
 
                 updateNoteSourceChannel();
 
-                if (stopLFO)
-                {
-                    toggleLfo();
-                    stopLFO = false;
-                }
-                
+                // a route switched on joins the running ones in phase (see
+                // ModulationEngine::joinNewRoutes), the others carry on
+                publishEngineSettings();
+
                 // Defer resized() to avoid blocking during ComboBox interaction
                 juce::MessageManager::callAsync([this]() { resized(); });
             };
 
             routeParameterBoxes[i].onChange = [this, i]()
             {
-                lfoRoutes[i].parameterIndex =
+                auto& route = engineSettings.routes[i];
+                route.parameterIndex =
                     routeParameterBoxes[i].getSelectedId() - 1;
 
                 const bool paramIsBipolar =
-                    syntaktParameters[lfoRoutes[i].parameterIndex].isBipolar;
+                    syntaktParameters[route.parameterIndex].isBipolar;
 
                 // Initialize UI + route state ONCE
                 routeBipolarToggles[i]->setToggleState(paramIsBipolar,
                                                      juce::dontSendNotification);
-                lfoRoutes[i].bipolar = paramIsBipolar;
+                route.bipolar = paramIsBipolar;
+                publishEngineSettings();
             };
 
 
             routeBipolarToggles[i]->onClick = [this, i]()
             {
-                lfoRoutes[i].bipolar = routeBipolarToggles[i]->getToggleState();
+                engineSettings.routes[i].bipolar = routeBipolarToggles[i]->getToggleState();
+                publishEngineSettings();
                 #if JUCE_DEBUG
                 updateLfoRouteDebugLabel();
                 #endif
@@ -364,15 +418,14 @@ public:
 
             routeInvertToggles[i]->onClick = [this, i]()
             {
-                lfoRoutes[i].invertPhase = routeInvertToggles[i]->getToggleState();
+                engineSettings.routes[i].invertPhase = routeInvertToggles[i]->getToggleState();
+                publishEngineSettings();
             };
 
             routeOneShotToggles[i]->onClick = [this, i]()
             {
-                lfoRoutes[i].oneShot = routeOneShotToggles[i]->getToggleState();
-
-                if (!lfoRoutes[i].oneShot)
-                    lfoRoutes[i].hasFinishedOneShot = false;
+                engineSettings.routes[i].oneShot = routeOneShotToggles[i]->getToggleState();
+                publishEngineSettings();
             };
 
             routeInvertToggles[i]->setToggleState(false, juce::dontSendNotification);
@@ -388,17 +441,15 @@ public:
             routeBipolarToggles[i]->setToggleState(false, juce::dontSendNotification);
 
             // Initialize route state
-            lfoRoutes[i].midiChannel = (routeChannelBoxes[i].getSelectedId() == 1)
-                                        ? 0
-                                        : routeChannelBoxes[i].getSelectedId() - 1;
+            auto& route = engineSettings.routes[i];
+            setRouteDestination(route, routeChannelBoxes[i].getSelectedId());
 
-            lfoRoutes[i].parameterIndex = routeParameterBoxes[i].getSelectedId() - 1;
+            route.parameterIndex = routeParameterBoxes[i].getSelectedId() - 1;
 
-            lfoRoutes[i].bipolar = routeBipolarToggles[i]->getToggleState();
+            route.bipolar = routeBipolarToggles[i]->getToggleState();
 
-            lfoRoutes[i].invertPhase = false;
-            lfoRoutes[i].oneShot     = false;
-            lfoRoutes[i].hasFinishedOneShot = false;
+            route.invertPhase = false;
+            route.oneShot     = false;
 
             // Set initial visibility
             const bool enabled = (routeChannelBoxes[i].getSelectedId() != 1);
@@ -411,9 +462,6 @@ public:
         // Initialize note source channel list
         updateNoteSourceChannel();
 
-        // Initialize the atomic variable with current selection
-        noteRestartChannel.store(noteSourceChannelBox.getSelectedId(), std::memory_order_release);
-
         // scope image button
         scopeIcon = juce::ImageCache::getFromMemory(
             BinaryData::scope_png,
@@ -460,6 +508,7 @@ public:
             juce::PopupMenu menu;
 
             juce::PopupMenu throttleSub;
+                            const int changeThreshold = engineSettings.changeThreshold;
                             throttleSub.addItem(1, "Off (send every change)", true, changeThreshold == 0);
                             throttleSub.addItem(2, "1 step (fine)",           true, changeThreshold == 1);
                             throttleSub.addItem(3, "2 steps",                 true, changeThreshold == 2);
@@ -467,6 +516,7 @@ public:
                             throttleSub.addItem(5, "8 steps (coarse)",        true, changeThreshold == 8);
 
             juce::PopupMenu limiterSub;
+                            const double msFloofThreshold = engineSettings.msFloofThreshold;
                             limiterSub.addItem(6, "Off (send every change)", true, msFloofThreshold == 0.0);
                             limiterSub.addItem(7, "0.5ms",                   true, msFloofThreshold == 0.5);
                             limiterSub.addItem(8, "1.0ms",                   true, msFloofThreshold == 1.0);
@@ -475,34 +525,244 @@ public:
                             limiterSub.addItem(11, "3.0ms",                  true, msFloofThreshold == 3.0);
                             limiterSub.addItem(12, "5.0ms",                  true, msFloofThreshold == 5.0);
 
+            // max lag behind the source, in parameter steps (see UpdateSchedule)
+            juce::PopupMenu scheduleSub;
+                            const double errorBound = engineSettings.errorBoundSteps;
+                            scheduleSub.addItem(14, "Off (every tick)", true, errorBound == 0.0);
+                            scheduleSub.addItem(15, "1 step",           true, errorBound == 1.0);
+                            scheduleSub.addItem(16, "2 steps",          true, errorBound == 2.0);
+                            scheduleSub.addItem(17, "4 steps",          true, errorBound == 4.0);
+                            scheduleSub.addItem(18, "8 steps",          true, errorBound == 8.0);
+
 
             menu.addSectionHeader("Performance");
             menu.addSubMenu("MIDI Data throttle", throttleSub);
             menu.addSubMenu("MIDI Rate limiter", limiterSub);
+            menu.addSubMenu("Adaptive update rate", scheduleSub);
+            menu.addItem(13, "Track edits echoed by the device", true, engineSettings.seedShadowFromInput);
+            menu.addItem(20, "Engine telemetry...");
+            menu.addItem(21, engine.isTraceEnabled() ? "Stop trace and export..." : "Start engine trace");
+
+            // Realtime deployment (dedicated rigs): SCHED_FIFO + mlockall, optional CPU pinning
+            const auto& realtimeSettings = engine.getRealtimeSettings();
+            juce::PopupMenu realtimeSub;
+                            realtimeSub.addItem(30, "Realtime engine thread", true, realtimeSettings.enabled);
+                            realtimeSub.addSeparator();
+                            realtimeSub.addItem(31, "Any CPU", realtimeSettings.enabled, realtimeSettings.cpuCore < 0);
+
+                            for (int core = 0; core < juce::jmin(RealtimeSupport::getNumCores(), 64); ++core)
+                                realtimeSub.addItem(32 + core, "Pin to CPU " + juce::String(core),
+                                                    realtimeSettings.enabled, realtimeSettings.cpuCore == core);
+
+            menu.addSubMenu("Realtime mode", realtimeSub);
+
+            // Raw MIDI: running status + one write per tick, for DIN interfaces
+            // JACK: engine ticked by the JACK graph, input and output through JACK ports
+            const auto backend = engine.getBackend();
+            juce::PopupMenu backendSub;
+                            backendSub.addItem(100, "ALSA sequencer", true, backend == MidiDeviceManager::Backend::sequencer);
+                            backendSub.addItem(101, "Raw MIDI (hardware ports)", true, backend == MidiDeviceManager::Backend::rawMidi);
+                            backendSub.addItem(102, "JACK MIDI", JackMidiClient::isAvailable(), backend == MidiDeviceManager::Backend::jack);
+
+            menu.addSubMenu("MIDI backend", backendSub);
+
+            // Extra outputs for routes to send to (not under JACK)
+            const bool extraOutputs = engine.getNumOutputSlots() > 1;
+            const auto& devices = engine.getOutputs();
+
+            for (int slot = 1; slot < MidiDeviceManager::maxOutputs; ++slot)
+            {
+                const auto& selected = engine.getSelectedOutput(slot);
+                juce::PopupMenu outputSub;
+                outputSub.addItem(outputMenuId(slot, -1), "None", true, selected.identifier.isEmpty());
+
+                for (int d = 0; d < devices.size(); ++d)
+                    outputSub.addItem(outputMenuId(slot, d), devices[d].name, true,
+                                      devices[d].identifier == selected.identifier);
+
+                menu.addSubMenu("Output " + juce::String(slot + 1), outputSub, extraOutputs);
+            }
+
+            // Merged input: roles of every input, and the extra devices
+            menu.addSectionHeader("Inputs");
+            const auto& inputs = engine.getInputs();
+
+            for (int slot = 0; slot < MidiDeviceManager::maxInputs; ++slot)
+            {
+                const auto& selected = engine.getSelectedInput(slot);
+                const int roles = engine.getInputRoles(slot);
+                juce::PopupMenu inputSub;
+
+                if (slot > 0)
+                {
+                    inputSub.addItem(inputMenuId(slot, -1), "None", true, selected.identifier.isEmpty());
+
+                    for (int d = 0; d < juce::jmin(inputs.size(), inputRoleItem); ++d)
+                        inputSub.addItem(inputMenuId(slot, d), inputs[d].name, true,
+                                         inputs[d].identifier == selected.identifier);
+
+                    inputSub.addSeparator();
+                }
+
+                inputSub.addItem(inputMenuId(slot, inputRoleItem + 0), "Clock master", true,
+                                 (roles & MergedMidiInput::clock) != 0);
+                inputSub.addItem(inputMenuId(slot, inputRoleItem + 1), "Triggers (notes)", true,
+                                 (roles & MergedMidiInput::notes) != 0);
+                inputSub.addItem(inputMenuId(slot, inputRoleItem + 2), "Controls (CC)", true,
+                                 (roles & MergedMidiInput::controls) != 0);
+                inputSub.addItem(inputMenuId(slot, inputRoleItem + 3), "Thru", true,
+                                 (roles & MergedMidiInput::thru) != 0);
+
+                menu.addSubMenu("Input " + juce::String(slot + 1), inputSub,
+                                slot < engine.getNumInputSlots());
+            }
+
+            // Thru: inputs with the Thru role, merged into one output's stream
+            const int thruOutput = engine.getThruOutput();
+            const int thruKinds = engine.getThruKinds();
+            const bool thruAvailable = !engine.isEngineDrivenByJack();
+            juce::PopupMenu thruSub;
+                            thruSub.addItem(3000, "Off", true, thruOutput < 0);
+
+                            for (int slot = 0; slot < MidiDeviceManager::maxOutputs; ++slot)
+                                thruSub.addItem(3001 + slot, "To Output " + juce::String(slot + 1),
+                                                thruAvailable, thruOutput == slot);
+
+                            thruSub.addSeparator();
+                            thruSub.addItem(3010, "Notes", true, (thruKinds & MergedMidiInput::notes) != 0);
+                            thruSub.addItem(3011, "Controls (CC, bend, pressure)", true, (thruKinds & MergedMidiInput::controls) != 0);
+                            thruSub.addItem(3012, "Clock and transport", true, (thruKinds & MergedMidiInput::clock) != 0);
+
+            menu.addSubMenu("MIDI thru", thruSub);
+
+            // Automation: recorded along the transport, looped on playback
+            const int automationLanes = engine.getAutomationLanes();
+            const juce::String automationLength = automationLanes > 0
+                ? " (" + juce::String(automationLanes) + " lanes, " + juce::String(engine.getAutomationBars()) + " bars)"
+                : juce::String();
+            juce::PopupMenu automationSub;
+                            automationSub.addItem(200, "Record", true, engine.isAutomationRecording());
+                            automationSub.addItem(201, "Play" + automationLength, automationLanes > 0, engine.isAutomationPlaying());
+                            automationSub.addSeparator();
+                            automationSub.addItem(202, "Export MIDI file...", automationLanes > 0);
+                            automationSub.addItem(203, "Import MIDI file...");
+
+            menu.addSubMenu("Automation", automationSub);
+
+            // Presets: recalled at the switch point, phases going on unless asked
+            const int activePreset = engine.getActivePreset();
+            juce::PopupMenu presetSub, storePresetSub, clearPresetSub;
+
+                            for (int slot = 0; slot < PresetBank::numSlots; ++slot)
+                            {
+                                const auto name = engine.getPresetName(slot);
+                                const auto label = juce::String(slot + 1) + ": " + (name.isEmpty() ? juce::String("(empty)") : name);
+
+                                if (name.isNotEmpty())
+                                {
+                                    presetSub.addItem(300 + slot, label, true, slot == activePreset);
+                                    clearPresetSub.addItem(340 + slot, label);
+                                }
+
+                                storePresetSub.addItem(320 + slot, label);
+                            }
+
+                            presetSub.addSeparator();
+                            presetSub.addSubMenu("Store current", storePresetSub);
+                            presetSub.addSubMenu("Clear", clearPresetSub, clearPresetSub.getNumItems() > 0);
+                            presetSub.addSeparator();
+                            presetSub.addItem(360, "Switch now", true, presetSwitchPoint == ModulationEngine::SwitchPoint::now);
+                            presetSub.addItem(361, "Switch on next beat", true, presetSwitchPoint == ModulationEngine::SwitchPoint::beat);
+                            presetSub.addItem(362, "Switch on next bar", true, presetSwitchPoint == ModulationEngine::SwitchPoint::bar);
+                            presetSub.addItem(363, "Restart LFO on switch", true, presetResetsPhases);
+                            presetSub.addSeparator();
+                            presetSub.addItem(364, "Export (JSON)...");
+                            presetSub.addItem(365, "Import (JSON)...");
+
+            menu.addSubMenu("Presets", presetSub);
 
             menu.addSeparator();
+            menu.addItem(22, "Stop engine and quit");
             menu.addItem(99, "zaoum");
 
 
+            EngineTrace::instant("settings menu open");
+
             menu.showMenuAsync(juce::PopupMenu::Options(),
                 [this](int result)
                 {
+                    EngineTrace::instant("settings menu result", result);
+
+                    auto& throttleSteps = engineSettings.changeThreshold;
+                    auto& limiterMs     = engineSettings.msFloofThreshold;
+
                     switch (result)
                     {
-                        case 1: changeThreshold = 0; break;
-                        case 2: changeThreshold = 1; break;
-                        case 3: changeThreshold = 2; break;
-                        case 4: changeThreshold = 4; break;
-                        case 5: changeThreshold = 8; break;
-                        case 6: msFloofThreshold = 0.0; break;
-                        case 7: msFloofThreshold = 0.5; break;
-                        case 8: msFloofThreshold = 1.0; break;
-                        case 9: msFloofThreshold = 1.5; break;
-                        case 10: msFloofThreshold = 2.0; break;
-                        case 11: msFloofThreshold = 3.0; break;
-                        case 12: msFloofThreshold = 5.0; break;
-                        default: break;
+                        case 1: throttleSteps = 0; break;
+                        case 2: throttleSteps = 1; break;
+                        case 3: throttleSteps = 2; break;
+                        case 4: throttleSteps = 4; break;
+                        case 5: throttleSteps = 8; break;
+                        case 6: limiterMs = 0.0; break;
+                        case 7: limiterMs = 0.5; break;
+                        case 8: limiterMs = 1.0; break;
+                        case 9: limiterMs = 1.5; break;
+                        case 10: limiterMs = 2.0; break;
+                        case 11: limiterMs = 3.0; break;
+                        case 12: limiterMs = 5.0; break;
+                        case 13: engineSettings.seedShadowFromInput = !engineSettings.seedShadowFromInput; break;
+                        case 14: engineSettings.errorBoundSteps = 0.0; break;
+                        case 15: engineSettings.errorBoundSteps = 1.0; break;
+                        case 16: engineSettings.errorBoundSteps = 2.0; break;
+                        case 17: engineSettings.errorBoundSteps = 4.0; break;
+                        case 18: engineSettings.errorBoundSteps = 8.0; break;
+                        case 20: showTelemetry(); break;
+                        case 21: toggleTrace(); break;
+                        case 22: quitEngine(); return;
+                        case 30: setRealtimeEnabled(!engine.getRealtimeSettings().enabled); break;
+                        case 31: setRealtimeCore(-1); break;
+                        case 100: engine.setBackend(MidiDeviceManager::Backend::sequencer); break;
+                        case 101: engine.setBackend(MidiDeviceManager::Backend::rawMidi); break;
+                        case 3000: engine.setThruOutput(-1); break;
+                        case 3010: engine.setThruKinds(engine.getThruKinds() ^ MergedMidiInput::notes); break;
+                        case 3011: engine.setThruKinds(engine.getThruKinds() ^ MergedMidiInput::controls); break;
+                        case 3012: engine.setThruKinds(engine.getThruKinds() ^ MergedMidiInput::clock); break;
+                        case 102: engine.setBackend(MidiDeviceManager::Backend::jack); break;
+                        case 200: engine.setAutomationRecording(!engine.isAutomationRecording()); break;
+                        case 201: engine.setAutomationPlaying(!engine.isAutomationPlaying()); break;
+                        case 202: chooseAutomationFile(true); break;
+                        case 203: chooseAutomationFile(false); break;
+                        case 360: presetSwitchPoint = ModulationEngine::SwitchPoint::now; break;
+                        case 361: presetSwitchPoint = ModulationEngine::SwitchPoint::beat; break;
+                        case 362: presetSwitchPoint = ModulationEngine::SwitchPoint::bar; break;
+                        case 363: presetResetsPhases = !presetResetsPhases; break;
+                        case 364: choosePresetFile(true); break;
+                        case 365: choosePresetFile(false); break;
+                        default:
+                            if (result >= 32 && result < 32 + 64)
+                                setRealtimeCore(result - 32);
+                            else if (result >= 300 && result < 300 + PresetBank::numSlots)
+                                engine.recallPreset(result - 300, presetSwitchPoint, presetResetsPhases);
+                            else if (result >= 320 && result < 320 + PresetBank::numSlots)
+                                askPresetName(result - 320);
+                            else if (result >= 340 && result < 340 + PresetBank::numSlots)
+                                engine.clearPreset(result - 340);
+                            else if (result > 3000 && result <= 3000 + MidiDeviceManager::maxOutputs)
+                                engine.setThruOutput(result - 3001);
+                            else if (result >= inputMenuId(0, -1))
+                                handleInputMenu((result - inputMenuId(0, -1)) / 100,
+                                                (result - inputMenuId(0, -1)) % 100 - 1);
+                            else if (result >= outputMenuId(1, -1))
+                                selectExtraOutput((result - outputMenuId(0, -1)) / 100,
+                                                  (result - outputMenuId(0, -1)) % 100 - 1);
+                            break;
                     }
+
+                    // only items 1-18 change the settings; sending them for
+                    // the others would replace what those commands do (a
+                    // recalled preset, above all)
+                    if (result >= 1 && result <= 18)
+                        publishEngineSettings();
                 });
         };
 
@@ -518,7 +778,10 @@ public:
             if (midiMonitorButton.getToggleState())
             {
                 if (midiMonitorWindow == nullptr)
+                {
                     midiMonitorWindow = std::make_unique<MidiMonitorWindow>();
+                    engine.setMonitor(midiMonitorWindow.get());
+                }
 
                 midiMonitorWindow->setVisible(true);
                 midiMonitorWindow->toFront(true);
@@ -545,19 +808,26 @@ public:
         showEGinScopeToggle.onClick = [this]()
             {
                 showEGinScope = showEGinScopeToggle.getToggleState();
+
+                if (scopeOverlay)
+                    scopeOverlay->setChannelProbe(0, showEGinScope ? EngineProbes::Id::eg
+                                                                   : EngineProbes::routeProbe(0));
             };
 
         #endif
 
-        // Timer
-        startTimerHz(100); // 100Hz refresh  
+        // Engine runs in its own process; the timer only mirrors its state into the UI
+        publishEngineSettings();
+
+        startTimerHz(uiRefreshHz);
+
+        startup.windowBuiltMs = juce::Time::getMillisecondCounterHiRes();
     }
 
     ~MainComponent() override
     {
         stopTimer();
-        midiClock.stop();
-        midiOut.reset();
+        telemetryWindow.reset();
         rateSlider.setLookAndFeel (nullptr);
         depthSlider.setLookAndFeel (nullptr);
     }
@@ -565,10 +835,24 @@ public:
     void paint (juce::Graphics& g) override
     {
         g.fillAll (SetupUI::background);
+
+        // device enumeration waits until the first frame is out
+        if (startup.firstPaintMs == 0.0)
+        {
+            startup.firstPaintMs = juce::Time::getMillisecondCounterHiRes();
+
+            juce::MessageManager::callAsync ([safeThis = juce::Component::SafePointer<MainComponent> (this)]
+            {
+                if (safeThis != nullptr)
+                    safeThis->listMidiDevices();
+            });
+        }
     }
 
     void resized() override
     {
+        const EngineTrace::Scope trace("MainComponent::resized");
+
         // prepare column layout
         constexpr int lfoWidth = 450;
         constexpr int egWidth  = 450;
@@ -873,10 +1157,18 @@ public:
             envelopeComponent->setBounds(egColumn);
     }
 
-    void postJuceInit()
+    void postJuceInit(double initialiseMs)
     {
-        refreshMidiInputs();
-        refreshMidiOutputs();
+        startup.initialiseMs = initialiseMs;
+
+        // in case the window isn't painted soon (e.g. started minimised)
+        juce::Component::SafePointer<MainComponent> safeThis (this);
+
+        juce::Timer::callAfterDelay(500, [safeThis]
+        {
+            if (safeThis != nullptr)
+                safeThis->listMidiDevices();
+        });
     }
 
     // Oscilloscope pop-up view (not modal)
@@ -891,9 +1183,14 @@ public:
         lfoRoutesToScope[0] = true; // first route active by default
 
         scopeOverlay.reset(new ScopeModalComponent<maxRoutes>(
-            lastLfoRoutesValues,
+            engine.probes,
             lfoRoutesToScope));
 
+        #if JUCE_DEBUG
+        if (showEGinScope)
+            scopeOverlay->setChannelProbe(0, EngineProbes::Id::eg);
+        #endif
+
         scopeOverlay->onAllRoutesDisabled = [this]()
         {
             toggleScope();   // closes and cleans up
@@ -955,22 +1252,18 @@ private:
     juce::TextButton startButton;
 
     // MIDI
-    std::unique_ptr<juce::MidiOutput> midiOut;
-    MidiClockHandler midiClock;
+    bool midiDevicesListed = false;
 
-    std::unique_ptr<juce::MidiInput> globalMidiInput;
-    std::unique_ptr<juce::MidiInputCallback> midiCallback;
+    static constexpr int uiRefreshHz = 30;
+    static constexpr int idleUiRefreshHz = 4;
 
-    std::atomic<bool> pendingNoteOn { false };
-    std::atomic<bool> pendingNoteOff { false };
-    std::atomic<int>  pendingNoteChannel { 0 };
-    std::atomic<int>  pendingNoteNumber { 0 };
-    std::atomic<float>  pendingNoteVelocity { 0 };
+    // Engine: settings are edited here and published as one snapshot
+    static constexpr int maxRoutes = ModulationEngine::maxRoutes;
 
-    std::atomic<int> noteRestartChannel { 0 }; // 1–16, 0 = disabled
+    // the engine process (see EngineDaemon.h), its ports and clock
+    EngineClient engine;
 
-    std::atomic<bool> requestLfoRestart { false };
-    std::atomic<bool> requestLfoStop { false };
+    ModulationEngine::Settings engineSettings;
 
     //DEBUG
     #if JUCE_DEBUG
@@ -980,26 +1273,12 @@ private:
     #endif
 
     // Multi-CC Routing
-    static constexpr int maxRoutes = 3;
-    struct LfoRoute { 
-        int midiChannel = 0;
-        int parameterIndex = 0;
-        bool bipolar = false;
-        bool invertPhase = false;
-        bool oneShot = false;
-        bool passedPeak = false; // used when unipolar + oneshot
-        bool hasFinishedOneShot = false; // runtime state
-    };
-
-    std::array<LfoRoute, maxRoutes> lfoRoutes;
     std::array<juce::Label, maxRoutes> routeLabels;
     std::array<juce::ComboBox, maxRoutes> routeChannelBoxes;
     std::array<juce::ComboBox, maxRoutes> routeParameterBoxes;
 
     std::unique_ptr<LedToggleButton> routeBipolarToggles[maxRoutes], routeInvertToggles[maxRoutes], routeOneShotToggles[maxRoutes];
 
-    std::array<double, maxRoutes> lfoPhase { 0.0, 0.0, 0.0 };
-
     #if JUCE_DEBUG
     std::unique_ptr<MidiMonitorWindow> midiMonitorWindow;
     juce::TextButton midiMonitorButton { "MIDI Monitor" };
@@ -1014,28 +1293,9 @@ private:
     bool showEGinScope = false;
     #endif
 
-    enum class LfoShape
-    {
-        Sine = 1,
-        Triangle,
-        Square,
-        Saw,
-        Random
-    };
-
     // Setting Pop-Up
     juce::TextButton settingsButton;
 
-    // LFO State
-    double phase = 0.0;
-    double sampleRate = 100.0;
-    juce::Random random;
-    bool lfoActive = false;
-
-    bool oneShotActive = false;
-
-    double oneShotPhaseAccum = 0.0;
-
     // BPM smoothing / throttling
     double displayedBpm = 0.0;
     juce::int64 lastBpmUpdateMs = 0;
@@ -1045,19 +1305,153 @@ private:
     juce::ImageButton scopeButton;
     std::unique_ptr<ScopeModalComponent<maxRoutes>> scopeOverlay;
 
-    std::array<std::atomic<float>, maxRoutes> lastLfoRoutesValues { 0.0f, 0.0f, 0.0f };
     std::array<bool, maxRoutes> lfoRoutesToScope { false, false, false };
 
     // EG
     std::unique_ptr<EnvelopeComponent> envelopeComponent;
 
-    // settings - Dithering and MIDI throttle
-    std::unordered_map<int, int> lastSentValuePerParam;  // key: param ID or CC number
-    int changeThreshold = 1; // difference needed before sending
+    // Telemetry: the engine's, and this window's own startup
+    StartupTimes startup;
+    std::unique_ptr<TelemetryWindow> telemetryWindow;
 
-    // settings - Anti flooding
-    std::unordered_map<int, double> lastSendTimePerParam;
-    double msFloofThreshold = 0.0; // delay between Midi datas chunk
+    // Trace export
+    std::unique_ptr<juce::FileChooser> traceChooser;
+
+    // Automation export and import
+    std::unique_ptr<juce::FileChooser> automationChooser;
+
+    // Presets: where a recall takes over, and the readable export
+    ModulationEngine::SwitchPoint presetSwitchPoint = ModulationEngine::SwitchPoint::bar;
+    bool presetResetsPhases = false;
+    std::unique_ptr<juce::FileChooser> presetChooser;
+
+    // Both this window and the engine process record; the engine merges
+    // the two into the chosen file
+    void toggleTrace()
+    {
+        if (!engine.isTraceEnabled())
+        {
+            engine.startTrace();
+            return;
+        }
+
+        traceChooser = std::make_unique<juce::FileChooser>("Export trace",
+                                                           juce::File::getSpecialLocation(juce::File::userHomeDirectory)
+                                                               .getChildFile("modztakt_trace.json"),
+                                                           "*.json");
+
+        traceChooser->launchAsync(juce::FileBrowserComponent::saveMode
+                                    | juce::FileBrowserComponent::canSelectFiles
+                                    | juce::FileBrowserComponent::warnAboutOverwriting,
+                                  [this](const juce::FileChooser& fc)
+                                  {
+                                      engine.stopTrace(fc.getResult());
+                                  });
+    }
+
+    // The current settings go to the engine's bank under the name typed in
+    void askPresetName(int slot)
+    {
+        auto* window = new juce::AlertWindow("Store preset " + juce::String(slot + 1), {}, juce::MessageBoxIconType::NoIcon);
+        window->addTextEditor("name", engine.getPresetName(slot), "Name:");
+        window->addButton("Store", 1, juce::KeyPress(juce::KeyPress::returnKey));
+        window->addButton("Cancel", 0, juce::KeyPress(juce::KeyPress::escapeKey));
+
+        // called before the window is deleted
+        window->enterModalState(true, juce::ModalCallbackFunction::create([this, slot, window](int result)
+        {
+            if (result == 1)
+                engine.storePreset(slot, window->getTextEditorContents("name"));
+        }), true);
+    }
+
+    // The engine process reads and writes the file
+    void choosePresetFile(bool exporting)
+    {
+        presetChooser = std::make_unique<juce::FileChooser>(exporting ? "Export presets" : "Import presets",
+                                                            juce::File::getSpecialLocation(juce::File::userHomeDirectory)
+                                                                .getChildFile("modztakt_presets.json"),
+                                                            "*.json");
+
+        const int chooserFlags = exporting ? juce::FileBrowserComponent::saveMode | juce::FileBrowserComponent::warnAboutOverwriting
+                                           : juce::FileBrowserComponent::openMode;
+
+        presetChooser->launchAsync(chooserFlags | juce::FileBrowserComponent::canSelectFiles,
+                                   [this, exporting](const juce::FileChooser& fc)
+                                   {
+                                       const auto file = fc.getResult();
+
+                                       if (file == juce::File())
+                                           return;
+
+                                       if (exporting)
+                                           engine.exportPresets(file);
+                                       else
+                                           engine.importPresets(file);
+                                   });
+    }
+
+    // The engine process reads and writes the file
+    void chooseAutomationFile(bool exporting)
+    {
+        automationChooser = std::make_unique<juce::FileChooser>(exporting ? "Export automation" : "Import automation",
+                                                                juce::File::getSpecialLocation(juce::File::userHomeDirectory)
+                                                                    .getChildFile("modztakt_automation.mid"),
+                                                                "*.mid;*.midi");
+
+        const int chooserFlags = exporting ? juce::FileBrowserComponent::saveMode | juce::FileBrowserComponent::warnAboutOverwriting
+                                           : juce::FileBrowserComponent::openMode;
+
+        automationChooser->launchAsync(chooserFlags | juce::FileBrowserComponent::canSelectFiles,
+                                       [this, exporting](const juce::FileChooser& fc)
+                                       {
+                                           const auto file = fc.getResult();
+
+                                           if (file == juce::File())
+                                               return;
+
+                                           if (exporting)
+                                               engine.exportAutomation(file);
+                                           else
+                                               engine.importAutomation(file);
+                                       });
+    }
+
+    void publishEngineSettings()
+    {
+        engine.publishSettings(engineSettings);
+    }
+
+    // Applied to the engine thread by the engine process (see EngineHost)
+    void setRealtimeEnabled(bool shouldBeEnabled)
+    {
+        auto realtimeSettings = engine.getRealtimeSettings();
+        realtimeSettings.enabled = shouldBeEnabled;
+        engine.setRealtimeSettings(realtimeSettings);
+    }
+
+    void setRealtimeCore(int core)
+    {
+        auto realtimeSettings = engine.getRealtimeSettings();
+        realtimeSettings.cpuCore = core;
+        engine.setRealtimeSettings(realtimeSettings);
+    }
+
+    // The modulation otherwise goes on after the window is closed
+    void quitEngine()
+    {
+        engine.quitEngine();
+        juce::JUCEApplicationBase::quit();
+    }
+
+    void showTelemetry()
+    {
+        if (telemetryWindow == nullptr)
+            telemetryWindow = std::make_unique<TelemetryWindow>(engine.getTelemetry(), startup);
+
+        telemetryWindow->setVisible(true);
+        telemetryWindow->toFront(true);
+    }
 
     //MIDI MONITOR
     #if JUCE_DEBUG
@@ -1066,6 +1460,7 @@ private:
         if (midiMonitorWindow == nullptr)
         {
             midiMonitorWindow = std::make_unique<MidiMonitorWindow>();
+            engine.setMonitor(midiMonitorWindow.get());
         }
 
         midiMonitorWindow->setVisible(true);
@@ -1073,18 +1468,30 @@ private:
     }
     #endif
 
+    void updateNoteOffStopArmed()
+    {
+        engine.setNoteOffStop(noteRestartToggle->getToggleState()
+                                  && noteOffStopToggle->getToggleState());
+    }
+
     void updateNoteSourceChannel()
     {
-        // Store current selection before clearing
-        const int currentSelection = noteSourceChannelBox.getSelectedId();
-        
+        engineSettings.noteRestartChannel = fillNoteSourceChannelBox(noteSourceChannelBox.getSelectedId());
+
+        // IMPORTANT: Update the engine since onChange won't fire with dontSendNotification
+        publishEngineSettings();
+    }
+
+    // Lists the channels routes send on; returns the one selected
+    int fillNoteSourceChannelBox(int currentSelection)
+    {
         // Clear without triggering onChange
         noteSourceChannelBox.clear(juce::dontSendNotification);
 
         juce::Array<int> activeChannels;
 
         // Collect unique active MIDI channels from routes
-        for (const auto& route : lfoRoutes)
+        for (const auto& route : engineSettings.routes)
         {
             if (route.midiChannel > 0 && !activeChannels.contains(route.midiChannel))
                 activeChannels.add(route.midiChannel);
@@ -1106,728 +1513,349 @@ private:
             newSelection = activeChannels[0];
             noteSourceChannelBox.setSelectedId(activeChannels[0], juce::dontSendNotification);
         }
-        
-        // IMPORTANT: Update the atomic variable since onChange won't fire with dontSendNotification
-        noteRestartChannel.store(newSelection, std::memory_order_release);
-    }
 
-    void refreshMidiOutputs()
-    {
-        midiOutputBox.clear();
-        auto devices = juce::MidiOutput::getAvailableDevices();
-        for (int i = 0; i < devices.size(); ++i)
-            midiOutputBox.addItem(devices[i].name, i + 1);
-        #if JUCE_DEBUG
-            midiOutputBox.setSelectedId(1);
-        #endif
-    }
-
-    void refreshMidiInputs()
-    {
-        midiInputBox.clear();
-        auto devices = juce::MidiInput::getAvailableDevices();
-        for (int i = 0; i < devices.size(); ++i)
-            midiInputBox.addItem(devices[i].name, i + 1);
-        #if JUCE_DEBUG
-            midiInputBox.setSelectedId(3);
-        #endif
+        return newSelection;
     }
 
-    // MIDI Sync
-    void handleIncomingMessage(const juce::MidiMessage& msg)
+    // Settings the engine already had (another window set them), shown
+    // without sending them back
+    void showSettings(const ModulationEngine::Settings& newSettings)
     {
-        const bool syncEnabled = (syncModeBox.getSelectedId() == 2);
-        if (!syncEnabled)
-        {
-            midiClock.stop();
-            return;
-        }
+        engineSettings = newSettings;
 
-        // existing clock parsing here  midiInputBox
-        int inIndex = midiInputBox.getSelectedId() - 1;
-        midiClock.start(inIndex);
-        return;
-    }
+        syncModeBox.setSelectedId(engineSettings.clockMaster ? 3 : engineSettings.syncEnabled ? 2 : 1,
+                                  juce::dontSendNotification);
+        updateBpmRow();
+        divisionBox.setSelectedId(engineSettings.divisionId, juce::dontSendNotification);
+        shapeBox.setSelectedId(engineSettings.shapeId, juce::dontSendNotification);
+        rateSlider.setValue(engineSettings.rateHz, juce::dontSendNotification);
+        depthSlider.setValue(engineSettings.depth, juce::dontSendNotification);
+        envelopeComponent->setSettings(engineSettings.eg);
 
-    // Call to start/stop the MidiClockHandler based on UI state
-    void updateMidiClockState()
-    {
-        const bool syncEnabled = (syncModeBox.getSelectedId() == 2);
-        
-        if (syncEnabled)
-        {
-            int inIndex = midiInputBox.getSelectedId() - 1;
-            if (inIndex >= 0)
-            {
-                midiClock.start(inIndex);
-            }
-            else
-            {
-                // No valid input selected, stop the clock
-                midiClock.stop();
-            }
-        }
-        else
-        {
-            // Free mode - ensure the clock is stopped
-            midiClock.stop();
-        }
-    }
-    
-    struct GlobalMidiCallback : public juce::MidiInputCallback
-    {
-        MainComponent& owner;
-        GlobalMidiCallback(MainComponent& o) : owner(o) {}
+        const bool restart = engineSettings.noteRestartEnabled;
+        const bool random = engineSettings.shapeId == 5;
+        noteRestartToggle->setToggleState(restart, juce::dontSendNotification);
 
-        void handleIncomingMidiMessage(juce::MidiInput*, const juce::MidiMessage& msg) override
+        for (int i = 0; i < maxRoutes; ++i)
         {
-            // MIDI CLOCK
-            if (owner.syncModeBox.getSelectedId() == 2)
-            {
-                owner.handleIncomingMessage(msg); 
-            }
+            const auto& route = engineSettings.routes[i];
+            const bool enabled = route.midiChannel > 0;
 
-            if (msg.isNoteOn())
-            {
-                owner.pendingNoteChannel.store(msg.getChannel(), std::memory_order_relaxed);
-                owner.pendingNoteNumber.store(msg.getNoteNumber(), std::memory_order_relaxed);
-                owner.pendingNoteVelocity.store(msg.getFloatVelocity(), std::memory_order_relaxed);
-                owner.pendingNoteOn.store(true, std::memory_order_release);
-            }
-            else if (msg.isNoteOff())
-            {
-                owner.pendingNoteChannel.store(msg.getChannel(), std::memory_order_relaxed);
-                owner.pendingNoteOff.store(true, std::memory_order_release);
+            fillRouteChannelBox(i);
+            routeParameterBoxes[i].setSelectedId(route.parameterIndex + 1, juce::dontSendNotification);
+            routeBipolarToggles[i]->setToggleState(route.bipolar, juce::dontSendNotification);
+            routeInvertToggles[i]->setToggleState(route.invertPhase, juce::dontSendNotification);
+            routeOneShotToggles[i]->setToggleState(route.oneShot, juce::dontSendNotification);
 
-                // Request LFO stop only if UI allows it
-                if (owner.noteRestartToggle->getToggleState()
-                    && owner.noteOffStopToggle->getToggleState())
-                {
-                    owner.requestLfoStop.store(true, std::memory_order_release);
-                }
-            }
-        }
-    };
+            routeParameterBoxes[i].setVisible(enabled);
+            routeBipolarToggles[i]->setVisible(enabled);
+            routeInvertToggles[i]->setVisible(enabled);
+            routeOneShotToggles[i]->setVisible(enabled && restart);
 
-    void updateMidiInput()
-    {
-        if (globalMidiInput)
-        {
-            globalMidiInput->stop();
-            globalMidiInput.reset();
+            routeBipolarToggles[i]->setEnabled(!random);
+            routeBipolarToggles[i]->setAlpha(random ? 0.8f : 1.0f);
+            routeInvertToggles[i]->setEnabled(!random);
+            routeInvertToggles[i]->setAlpha(random ? 0.8f : 1.0f);
         }
 
-        auto inputs = juce::MidiInput::getAvailableDevices();
-        int index = midiInputBox.getSelectedId() - 1;
-        if (index < 0 || index >= inputs.size())
-        {
-            // Stop the clock if no valid input selected
-            midiClock.stop();
-            return;
-        }
+        fillNoteSourceChannelBox(engineSettings.noteRestartChannel);
 
-        midiCallback = std::make_unique<GlobalMidiCallback>(*this);
-        globalMidiInput = juce::MidiInput::openDevice(inputs[index].identifier,
-                                                       midiCallback.get());
-        if (globalMidiInput)
-            globalMidiInput->start();
-    }
+        noteOffStopToggle->setToggleState(restart && engine.getNoteOffStop(), juce::dontSendNotification);
+        noteOffStopToggle->setVisible(restart);
+        noteOffStopToggle->setEnabled(restart);
+        noteOffStopToggleLabel.setVisible(restart);
 
-    void toggleLfo()
-    {
-        if (lfoActive)
+        if (restart)
         {
-            // reset LFO value
-            for (int i = 0; i < maxRoutes; ++i)
-            {
-                auto& route = lfoRoutes[i];
-                lfoPhase[i] = getWaveformStartPhase(
-                    shapeBox.getSelectedId(),
-                    lfoRoutes[i].bipolar,
-                    lfoRoutes[i].invertPhase
-                );
-
-                lfoRoutes[i].hasFinishedOneShot = false;
-                lfoRoutes[i].passedPeak = false;
-            }
-            
-            lfoActive = false;
-            startButton.setButtonText("Start LFO");
+            addAndMakeVisible(*noteOffStopToggle);
+            addAndMakeVisible(noteOffStopToggleLabel);
         }
-        else
-        {
-            // Clock may still be needed for sync
-            updateMidiClockState();
-            // reset LFO value
-            for (int i = 0; i < maxRoutes; ++i)
-            {
-                auto& route = lfoRoutes[i];
-                lfoPhase[i] = getWaveformStartPhase(
-                    shapeBox.getSelectedId(),
-                    lfoRoutes[i].bipolar,
-                    lfoRoutes[i].invertPhase
-                );
 
-                lfoRoutes[i].hasFinishedOneShot = false;
-                lfoRoutes[i].passedPeak = false;
-            }
-            
-            lfoActive = true;
-            startButton.setButtonText("Stop LFO");
-        }
+        #if JUCE_DEBUG
+        updateLfoRouteDebugLabel();
+        #endif
+
+        resized();
     }
 
-    // Timer Callback
-    void timerCallback() override
+    // Fills both boxes from the engine's device lists. Deferred until the
+    // window has painted, so the startup timings stay comparable; from then
+    // on onDevicesChanged follows hot-plug and other windows' choices.
+    void listMidiDevices()
     {
-        if (!midiOut)
+        if (midiDevicesListed)
             return;
 
-        // Note messages
-        if (pendingNoteOn.exchange(false))
-        {
-            const int ch   = pendingNoteChannel.load();
-            const int note = pendingNoteNumber.load();
-            const float velocity = pendingNoteVelocity.load();
-
-            // --- EG ---
-            if (envelopeComponent && envelopeComponent->isEgEnabled())
-                envelopeComponent->noteOn(ch, note, velocity);
+        const EngineTrace::Scope trace("MainComponent::listMidiDevices");
+        midiDevicesListed = true;
 
-            // --- LFO Note Restart ---
-            const int restartCh = noteRestartChannel.load(std::memory_order_acquire);
+        refillMidiDeviceBoxes();
 
-            if (noteRestartToggle->getToggleState()
-                && restartCh > 0
-                && ch == restartCh)
-            {
-                requestLfoRestart.store(true, std::memory_order_release);
-                
-                #if JUCE_DEBUG
-                noteDebugLabel.setText("NoteOn: Ch " + juce::String(ch) +
-                                       " | Note " + juce::String(note),
-                                       juce::dontSendNotification);
-               #endif
-            }
-        }
-
-        // EG trig
-        if (pendingNoteOff.exchange(false))
-        {
-            const int ch = pendingNoteChannel.load();
-            const int note = pendingNoteOff.load();
+        startup.devicesListedMs = juce::Time::getMillisecondCounterHiRes();
+    }
 
-            if (envelopeComponent && envelopeComponent->isEgEnabled())
-                envelopeComponent->noteOff(ch, note);
-        }
+    // Box item ids are device list index + 1; a selected device that is
+    // unplugged stays shown until it comes back or another one is picked
+    static void fillMidiDeviceBox(juce::ComboBox& box,
+                                  const juce::Array<juce::MidiDeviceInfo>& devices,
+                                  const juce::MidiDeviceInfo& selected)
+    {
+        box.clear(juce::dontSendNotification);
+        int selectedId = 0;
 
-        // Stop LFO on Note-Off
-        if (requestLfoStop.exchange(false))
+        for (int i = 0; i < devices.size(); ++i)
         {
-            lfoActive = false;
-            startButton.setButtonText("Start LFO");
+            box.addItem(devices[i].name, i + 1);
 
-            // reset phases for next start
-            for (int i = 0; i < maxRoutes; ++i)
-            {
-                lfoRoutes[i].hasFinishedOneShot = false;
-                lfoRoutes[i].passedPeak = false;
-            }
+            if (devices[i].identifier == selected.identifier)
+                selectedId = i + 1;
         }
 
-        // LFO
-        const bool syncEnabled = (syncModeBox.getSelectedId() == 2);
-        const double bpm = midiClock.getCurrentBPM();
-        int egValue;
+        if (selectedId > 0)
+            box.setSelectedId(selectedId, juce::dontSendNotification);
+        else if (selected.identifier.isNotEmpty())
+            box.setText(selected.name + " (disconnected)", juce::dontSendNotification);
+    }
 
-        // Handle pending retrigger from Note-On
-        if (requestLfoRestart.exchange(false))
-        {
-            // reset LFO value
-            for (int i = 0; i < maxRoutes; ++i)
-            {
-                auto& route = lfoRoutes[i];
-                lfoPhase[i] = getWaveformStartPhase(
-                    shapeBox.getSelectedId(),
-                    lfoRoutes[i].bipolar,
-                    lfoRoutes[i].invertPhase
-                );
+    void refillMidiDeviceBoxes()
+    {
+        fillMidiDeviceBox(midiOutputBox, engine.getOutputs(), engine.getSelectedOutput());
+        fillMidiDeviceBox(midiInputBox, engine.getInputs(), engine.getSelectedInput());
 
-                lfoRoutes[i].hasFinishedOneShot = false;
-                lfoRoutes[i].passedPeak = false;
-            }
+        for (int i = 0; i < maxRoutes; ++i)
+            fillRouteChannelBox(i);
+    }
 
-            if (!lfoActive)
-            {
-                lfoActive = true;
-                startButton.setButtonText("Stop LFO");
-            }
+    // Route channel box ids: 1 = Disabled, then 16 channels per engine
+    // output (2 = output 1, Ch 1). The first output keeps the plain "Ch n"
+    // items; the others are listed once they have a device, or while a
+    // route still sends to them.
+    static int routeChannelId(int output, int midiChannel)   { return 2 + output * 16 + (midiChannel - 1); }
 
+    static void setRouteDestination(ModulationEngine::Route& route, int comboId)
+    {
+        if (comboId < 2)
+        {
+            route.midiChannel = 0;
+            return;
         }
 
-        // Always update BPM display if sync mode is active
-        if (syncEnabled)
-        {
-            const double bpm = midiClock.getCurrentBPM();
-            const auto nowMs = juce::Time::getMillisecondCounterHiRes();
+        route.output = (comboId - 2) / 16;
+        route.midiChannel = (comboId - 2) % 16 + 1;
+    }
 
-            if (bpm > 0.0)
-            {
-                // Smooth & rate-limit UI updates
-                displayedBpm = 0.9 * displayedBpm + 0.1 * bpm;
-                if (nowMs - lastBpmUpdateMs > 250.0)
-                {
-                    bpmLabel.setText(juce::String(displayedBpm, 1), juce::dontSendNotification);
-                    lastBpmUpdateMs = nowMs;
-                }
-            }
-            else
-            {
-                // No clock yet: show placeholder
-                if (nowMs - lastBpmUpdateMs > 500.0)
-                {
-                    bpmLabel.setText("--", juce::dontSendNotification);
-                    lastBpmUpdateMs = nowMs;
-                }
-            }
-        }
-        else
-        {
-            // When not in sync mode, just freeze BPM display
-        }
+    void fillRouteChannelBox(int i)
+    {
+        auto& box = routeChannelBoxes[i];
+        const auto& route = engineSettings.routes[i];
 
-        if (lfoActive)
-        {
-            // Compute current rate
-            double rateHz = rateSlider.getValue();
+        box.clear(juce::dontSendNotification);
 
-            if (syncEnabled && bpm > 0.0)
-            {
-                rateHz = updateLfoRateFromBpm(rateHz);
-            }                
+        if (i != 0)
+            box.addItem("Disabled", 1);
 
-            // Generate and send LFO values
-            const double phaseInc = rateHz / sampleRate;
-            const auto shapeId = static_cast<LfoShape>(shapeBox.getSelectedId());
+        for (int output = 0; output < ModulationEngine::maxOutputs; ++output)
+        {
+            juce::String prefix;
 
-            for (int i = 0; i < maxRoutes; ++i)
+            if (output > 0)
             {
-                auto& route = lfoRoutes[i];
-
-                if (route.midiChannel <= 0 || route.parameterIndex < 0)
-                    continue;
+                const auto& device = engine.getSelectedOutput(output);
+                const bool inUse = route.midiChannel > 0 && route.output == output;
 
-                if (route.oneShot && route.hasFinishedOneShot)
+                if (device.identifier.isEmpty() && !inUse)
                     continue;
 
-                const bool wrapped = advancePhase(lfoPhase[i], phaseInc);
-
-                double shape = computeWaveform(shapeId,
-                                                lfoPhase[i],
-                                                route.bipolar,
-                                                route.invertPhase,
-                                                random
-                                            );
-
-                // One-shot logic
-                if (route.oneShot)
-                {
-                    if (route.bipolar)
-                    {
-                        if (wrapped)
-                            route.hasFinishedOneShot = true;
-                    }
-                    else
-                    {
-                        if (!route.passedPeak && shape >= 0.999)
-                            route.passedPeak = true;
-
-                        if (route.passedPeak && shape <= -0.999)
-                            route.hasFinishedOneShot = true;
-                    }
-                }
-
-                // Mapping
-                const auto& param = syntaktParameters[route.parameterIndex];
-                const double depth = depthSlider.getValue();
-
-                int midiVal = 0;
-
-                if (route.bipolar)
-                {
-                    const int center = (param.minValue + param.maxValue) / 2;
-                    const int range  = (param.maxValue - param.minValue) / 2;
-
-                    midiVal = center + int(std::round(shape * depth * range));
-                }
-                else
-                {
-                    const double uni = juce::jlimit(0.0, 1.0, (shape + 1.0) * 0.5);
-                    midiVal = param.minValue
-                            + int(std::round(uni * depth * (param.maxValue - param.minValue)));
-                }
-
-                midiVal = juce::jlimit(param.minValue, param.maxValue, midiVal);
-
-                sendThrottledParamValue(i, route.midiChannel, param, midiVal);
-
-                // Oscilloscope
-                if (lfoRoutesToScope[i])
-                {
-                    lastLfoRoutesValues[i].store(shape * depth, std::memory_order_relaxed);
-                }
+                prefix = "Out " + juce::String(output + 1) + " ";
+                box.addSectionHeading("Output " + juce::String(output + 1)
+                                      + (device.name.isNotEmpty() ? ": " + device.name : juce::String()));
             }
-        }
-        
-        if (envelopeComponent && envelopeComponent->isEgEnabled())
-        {
-            double egMIDIvalue = 0.0;
-            
-            if (envelopeComponent->tick(egMIDIvalue))
-            {
-                #if JUCE_DEBUG
-                    float egScopeValue = static_cast<float>(egMIDIvalue * 2.0 - 1.0);
-                    // 0.0 → -1.0
-                    // 1.0 → +1.0
-                    if ( showEGinScope )
-                    {
-                        // ---- SCOPE DEBUG TAP (temporary) ----
-                        lastLfoRoutesValues[0].store(
-                            static_cast<float>(egMIDIvalue * 2.0 - 1.0),
-                            std::memory_order_relaxed
-                        );
-                        // -------------------------------------
-                    }
-                #endif
 
-                const int paramId = envelopeComponent->selectedEgOutParamsId();
-                const int egValue = mapEgToMidi(egMIDIvalue, paramId);
-                const int egCh    = envelopeComponent->selectedEgOutChannel();
-
-                if (egCh > 0 && paramId >= 0)
-                {
-                    const auto& param = syntaktParameters[paramId];
-
-                    sendThrottledParamValue(
-                        0x7FFF,
-                        egCh,
-                        param,
-                        egValue
-                    );
-                }
-            }
+            for (int ch = 1; ch <= 16; ++ch)
+                box.addItem(prefix + "Ch " + juce::String(ch), routeChannelId(output, ch));
         }
 
-        #if JUCE_DEBUG
-            if (showRouteDebugLabel)
-                updateLfoRouteDebugLabel();
-        #endif
+        if (route.midiChannel > 0)
+            box.setSelectedId(routeChannelId(route.output, route.midiChannel), juce::dontSendNotification);
+        else if (i != 0)
+            box.setSelectedId(1, juce::dontSendNotification);
     }
 
-    inline bool advancePhase(double& phase, double phaseInc)
+    // Settings menu ids of the extra outputs: 1000 + slot * 100 for "None",
+    // then one per entry of the output device list
+    static int outputMenuId(int slot, int deviceIndex)   { return 1000 + slot * 100 + deviceIndex + 1; }
+
+    // Settings menu ids of the inputs: 2000 + slot * 100 for "None", then one
+    // per entry of the input device list, then the role toggles
+    static constexpr int inputRoleItem = 90;
+    static int inputMenuId(int slot, int item)   { return 2000 + slot * 100 + item + 1; }
+
+    void handleInputMenu(int slot, int item)
     {
-        phase += phaseInc;
-        if (phase >= 1.0)
+        if (item >= inputRoleItem)
         {
-            phase -= 1.0;
-            return true;
+            engine.setInputRoles(slot, engine.getInputRoles(slot) ^ (1 << (item - inputRoleItem)));
+            return;
         }
-        return false;
-    }
 
-    // waveforms
-    inline double lfoSine(double phase)
-    {
-        return std::sin(juce::MathConstants<double>::twoPi * phase);
-    }
+        const auto& inputs = engine.getInputs();
 
-    inline double lfoTriangle(double phase)
-    {
-        // canonical triangle: 0 → +1 → 0 → -1 → 0
-        double t = phase - std::floor(phase);
-        return 4.0 * std::abs(t - 0.5) - 1.0;
+        engine.selectInput(juce::isPositiveAndBelow(item, inputs.size()) ? inputs[item]
+                                                                              : juce::MidiDeviceInfo(),
+                                slot);
     }
 
-    inline double lfoSquare(double phase)
+    void selectExtraOutput(int slot, int deviceIndex)
     {
-        return (phase < 0.5) ? 1.0 : -1.0;
-    }
+        const auto& outputs = engine.getOutputs();
 
-    inline double lfoSaw(double phase)
-    {
-        return 2.0 * phase - 1.0;
+        engine.selectOutput(juce::isPositiveAndBelow(deviceIndex, outputs.size()) ? outputs[deviceIndex]
+                                                                                      : juce::MidiDeviceInfo(),
+                                 slot);
+
+        for (int i = 0; i < maxRoutes; ++i)
+            fillRouteChannelBox(i);
     }
 
-    inline double lfoRandom(double phase, juce::Random& rng)
+    // clock input follows the selected device through onInputChanged
+    void updateMidiInput()
     {
-        static double lastPhase = 0.0;
-        static double lastValue = 0.0;
-
-        // detect phase wrap
-        if (phase < lastPhase) 
-        {
-            lastValue = rng.nextDouble() * 2.0 - 1.0;
-        }
+        const auto& inputs = engine.getInputs();
+        const int index = midiInputBox.getSelectedId() - 1;
 
-        lastPhase = phase;
-        return lastValue;
+        engine.selectInput(juce::isPositiveAndBelow(index, inputs.size()) ? inputs[index]
+                                                                               : juce::MidiDeviceInfo());
     }
 
-    double computeWaveform(LfoShape shape,
-                           double phase,
-                           bool bipolar,
-                           bool invertPhase,
-                           juce::Random& rng)
+    void toggleLfo()
     {
-        // true phase inversion (180°)
-        if (invertPhase && shape != LfoShape::Saw)
+        if (engine.isLfoActive())
         {
-            phase += 0.5;
-            if (phase >= 1.0)
-                phase -= 1.0;
-        }
-
-        if (invertPhase && (shape == LfoShape::Saw))
-        {
-            phase = -phase;
-            if (phase <= 1.0)
-                phase += 1.0;
-        }
-
-        // phase alignment per shape
-        if (shape == LfoShape::Triangle && !bipolar)
-        {
-            phase += 0.25;
-            if (phase >= 1.0)
-                phase -= 1.0;
-        }
-
-        if (shape == LfoShape::Triangle && bipolar)
-        {
-            phase -= 0.25;
-            if (phase >= 1.0)
-                phase -= 1.0;
-        }
-
-        if (shape == LfoShape::Saw && bipolar)
-        {
-            phase += 0.5;
-            if (phase >= 1.0)
-                phase -= 1.0;
+            // phases are reset by the engine
+            engine.stopLfo();
+            startButton.setButtonText("Start LFO");
         }
-
-        switch (shape)
+        else
         {
-            case LfoShape::Sine:     return lfoSine(phase);
-            case LfoShape::Triangle: return lfoTriangle(phase);
-            case LfoShape::Square:   return lfoSquare(phase);
-            case LfoShape::Saw:      return lfoSaw(phase);
-            case LfoShape::Random:   return lfoRandom(phase, rng);
-            default:                 return 0.0;
+            engine.startLfo();
+            startButton.setButtonText("Stop LFO");
         }
     }
 
-    // ensure that LFO Waveforms start from correct offset (bipolar/unipolar)
-    double getWaveformStartPhase(int shapeId, bool bipolar, bool invert) const
+    // Timer Callback
+    void timerCallback() override
     {
-        double phase = 0.0;
+        engine.update();
+        updateEngineUi();
 
-        if (!bipolar)
-        {
-            switch (static_cast<LfoShape>(shapeId))
-            {
-                case LfoShape::Sine:     phase = 0.75; break; // -1
-                case LfoShape::Triangle: phase = 0.25; break; // -1 ✅ FIX
-                case LfoShape::Square:   phase = 0.5;  break; // -1
-                case LfoShape::Saw:      phase = 0.0;  break; // -1
-                default: break;
-            }
-        }
+        // full rate only while something on screen follows the engine or the
+        // clock; an LFO started over MIDI still shows within a quarter second
+        const bool following = engine.isLfoActive() || syncModeBox.getSelectedId() == 2 || scopeOverlay != nullptr;
+        const int wantedHz = following ? uiRefreshHz : idleUiRefreshHz;
 
-        return phase;
+        if (getTimerInterval() != 1000 / wantedHz)
+            startTimerHz(wantedHz);
     }
 
-    // shared throttling and MIDI send function
-    void sendThrottledParamValue(
-                                int routeIndex,              // for unique throttle key
-                                int midiChannel,
-                                const SyntaktParameter& param,
-                                int midiValue)
+    // Mirrors engine state into the UI
+    void updateEngineUi()
     {
-        // Build per-route + per-parameter key
-        const int paramKey =
-            (routeIndex << 16) |
-            (param.isCC ? 0x1000 : 0x2000) |
-            (param.isCC ? param.ccNumber
-                        : ((param.nrpnMsb << 7) | param.nrpnLsb));
-
-        // Value change threshold
-        const int lastVal = lastSentValuePerParam[paramKey];
-        if (std::abs(midiValue - lastVal) < changeThreshold)
-            return;
-
-        lastSentValuePerParam[paramKey] = midiValue;
-
-        // Time-based anti-flood
-        const double now = juce::Time::getMillisecondCounterHiRes();
-        if (now - lastSendTimePerParam[paramKey] < msFloofThreshold)
-            return;
+        const bool syncEnabled = isSynced();
+        const bool lfoActive = engine.isLfoActive();
 
-        lastSendTimePerParam[paramKey] = now;
+        const juce::String buttonText = lfoActive ? "Stop LFO" : "Start LFO";
+        if (startButton.getButtonText() != buttonText)
+            startButton.setButtonText(buttonText);
 
-        // Split value if NRPN
-        const int valueMSB = (midiValue >> 7) & 0x7F;
-        const int valueLSB = midiValue & 0x7F;
+        // Keep the rate slider on the clock-derived rate
+        if (lfoActive && syncEnabled && engine.getCurrentBpm() > 0.0)
+            updateLfoRateFromBpm(rateSlider.getValue());
 
-        const bool monitorInput = false;
-
-        if (param.isCC)
+        // Always update BPM display if sync mode is active (the master tempo
+        // is typed in instead)
+        if (syncModeBox.getSelectedId() == 2)
         {
-            auto msg = juce::MidiMessage::controllerEvent(
-                midiChannel, param.ccNumber, midiValue);
-
-            midiOut->sendMessageNow(msg);
+            const double bpm = engine.getCurrentBpm();
+            const auto nowMs = juce::Time::getMillisecondCounterHiRes();
 
-            #if JUCE_DEBUG
-            if (midiMonitorWindow)
-                midiMonitorWindow->pushEvent(msg, monitorInput);
-            #endif
+            if (bpm > 0.0)
+            {
+                // Smooth & rate-limit UI updates
+                displayedBpm = 0.9 * displayedBpm + 0.1 * bpm;
+                if (nowMs - lastBpmUpdateMs > 250.0)
+                {
+                    bpmLabel.setText(juce::String(displayedBpm, 1), juce::dontSendNotification);
+                    lastBpmUpdateMs = nowMs;
+                }
+            }
+            else
+            {
+                // No clock yet: show placeholder
+                if (nowMs - lastBpmUpdateMs > 500.0)
+                {
+                    bpmLabel.setText("--", juce::dontSendNotification);
+                    lastBpmUpdateMs = nowMs;
+                }
+            }
         }
-
         else
         {
-            auto send = [&](int cc, int val)
-            {
-                auto msg = juce::MidiMessage::controllerEvent(midiChannel, cc, val);
-                midiOut->sendMessageNow(msg);
-
-                #if JUCE_DEBUG
-                if (midiMonitorWindow)
-                    midiMonitorWindow->pushEvent(msg, monitorInput);
-                #endif
-            };
-
-            send(99, param.nrpnMsb);
-            send(98, param.nrpnLsb);
-            send(6,  valueMSB);
-            send(38, valueLSB);
+            // When not in sync mode, just freeze BPM display
         }
-    }
 
-    // MIDI Transport Callbacks
-    void handleMidiStart() override
-    {
-        // Reset LFO phase when sequencer starts
-        for (int i = 0; i < maxRoutes; ++i)
-        {
-            auto& route = lfoRoutes[i];
-            lfoPhase[i] = getWaveformStartPhase(
-                    shapeBox.getSelectedId(),
-                    lfoRoutes[i].bipolar,
-                    lfoRoutes[i].invertPhase
-            );
+        #if JUCE_DEBUG
+        const int restartNote = engine.takeRestartNote();
 
-            lfoRoutes[i].hasFinishedOneShot = false;
-            lfoRoutes[i].passedPeak = false;
+        if (restartNote >= 0)
+        {
+            noteDebugLabel.setText("NoteOn: Ch " + juce::String(restartNote >> 8) +
+                                   " | Note " + juce::String(restartNote & 0xff),
+                                   juce::dontSendNotification);
         }
 
-        lfoActive = false;
-        // passing via the UI start/stop function to avoid decoherence between HW and UI
-        toggleLfo();
+        if (showRouteDebugLabel)
+            updateLfoRouteDebugLabel();
+        #endif
     }
 
-    void handleMidiStop() override
+    // following the MIDI clock or sending it
+    bool isSynced() const   { return syncModeBox.getSelectedId() >= 2; }
+
+    // As clock master the BPM row sets the tempo instead of showing the detected one
+    void updateBpmRow()
     {
-        // Reset LFO to get a clean start even is the LFO is restarted from the UI
-        for (int i = 0; i < maxRoutes; ++i)
-            {
-                auto& route = lfoRoutes[i];
-                lfoPhase[i] = getWaveformStartPhase(
-                    shapeBox.getSelectedId(),
-                    lfoRoutes[i].bipolar,
-                    lfoRoutes[i].invertPhase
-                );
+        const bool master = syncModeBox.getSelectedId() == 3;
 
-                lfoRoutes[i].hasFinishedOneShot = false;
-                lfoRoutes[i].passedPeak = false;
-            }
+        bpmLabelTitle.setText(master ? "Master BPM:" : "Detected BPM:", juce::dontSendNotification);
+        bpmLabel.setEditable(master);
 
-        lfoActive = true;
-        toggleLfo();
+        if (master)
+            bpmLabel.setText(juce::String(engineSettings.masterBpm, 1), juce::dontSendNotification);
+        else if (syncModeBox.getSelectedId() != 2)
+            bpmLabel.setText("--", juce::dontSendNotification);
     }
 
     double updateLfoRateFromBpm(double rateHz)
     {
-        const double bpm = midiClock.getCurrentBPM();
-        const bool syncEnabled = (syncModeBox.getSelectedId() == 2);
-        if (syncEnabled && bpm > 0.0)
+        const double bpm = engine.getCurrentBpm();
+        if (isSynced() && bpm > 0.0)
         {
-            rateHz = bpmToHz(bpm);
+            rateHz = ModulationEngine::bpmToHz(bpm, divisionBox.getSelectedId());
 
             rateSlider.setValue(rateHz, juce::dontSendNotification);
+            engineSettings.rateHz = rateHz; // kept when sync is switched off
         }
             
         return rateHz;
     }
 
-    // BPM → Frequency Conversion
-    double bpmToHz(double bpm)
-    {
-        if (bpm <= 0.0)
-            return 0.0;
-
-        // Division multiplier relative to 1 beat = quarter note
-        double multiplier = 1.0;
-
-        switch (divisionBox.getSelectedId())
-        {
-            case 1: multiplier = 0.25; break;  // whole note (4 beats per cycle)
-            case 2: multiplier = 0.5;  break;  // half note
-            case 3: multiplier = 1.0;  break;  // quarter note
-            case 4: multiplier = 2.0;  break;  // eighth
-            case 5: multiplier = 4.0;  break;  // sixteenth
-            case 6: multiplier = 8.0;  break;  // thirty-second
-            case 7: multiplier = 2.0 / 1.5; break;  // dotted ⅛ (triplet-based)
-            case 8: multiplier = 4.0 / 1.5; break;  // dotted 1/16
-            default: break;
-        }
-
-        // base beat frequency = beats per second
-        const double beatsPerSecond = bpm / 60.0;
-
-        // final LFO frequency in Hz
-        return beatsPerSecond * multiplier;
-    }
-
-    // Map EG value to MIDI
-    int mapEgToMidi(double egValue, int paramId)
-    {
-        const auto& param = syntaktParameters[paramId];
-
-        if (param.isBipolar)
-        {
-            // centered mapping
-            const double center = (param.minValue + param.maxValue) * 0.5;
-            const double range  = (param.maxValue - param.minValue) * 0.5;
-            return (int)(center + (egValue * 2.0 - 1.0) * range);
-        }
-        else
-        {
-            return (int)(param.minValue + egValue * (param.maxValue - param.minValue));
-        }
-    }
-
     void openSelectedMidiOutput()
     {
-        midiOut.reset();
-
-        auto outputs = juce::MidiOutput::getAvailableDevices();
+        const auto& outputs = engine.getOutputs();
         const int outIndex = midiOutputBox.getSelectedId() - 1;
 
-        if (outIndex >= 0 && outIndex < outputs.size())
-        {
-            midiOut = juce::MidiOutput::openDevice(outputs[outIndex].identifier);
-        }
+        engine.selectOutput(juce::isPositiveAndBelow(outIndex, outputs.size()) ? outputs[outIndex]
+                                                                                   : juce::MidiDeviceInfo());
     }
 
     #if JUCE_DEBUG
@@ -1841,9 +1869,10 @@ private:
 
         for (int i = 0; i < maxRoutes; ++i)
         {
-            const auto& r = lfoRoutes[i];
+            const auto& r = engineSettings.routes[i];
 
             text << "Route " << i
+                 << " | out=" << r.output
                  << " | ch=" << r.midiChannel
                  << " | param=" << r.parameterIndex
                  << " | bipolar=" << (r.bipolar ? "TRUE" : "FALSE")
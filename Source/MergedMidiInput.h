@@ -0,0 +1,276 @@
+#pragma once
+#include <JuceHeader.h>
+#include "EngineTelemetry.h"
+#include "EngineTrace.h"
+#include "MidiInput.h"
+#include "MidiOutputPort.h"
+#include "RealtimeGuard.h"
+
+// ==========================================
+// Merged MIDI input
+// ==========================================
+// Several input devices feeding one event stream. Each source has roles that
+// decide what the app takes from it: clock and transport (one clock master
+// at a time), notes (LFO restart, EG and velocity), and controls (CCs for
+// the matrix and device echo). A Syntakt can be the clock master while a
+// keyboard on another interface plays the triggers.
+//
+// Events carry the time the ALSA sequencer stamped them with on arrival
+// (JUCE converts the queue's real time to the Time::getMillisecondCounter()
+// base), so clock intervals don't pick up the input thread's wake-up jitter.
+// Nothing is held back to sort the merge: every event is passed on from the
+// input callback it came in on. One arriving with a time before the last
+// one passed on (another source's thread got there first) is stamped with
+// that time instead, so the stream stays in order, and counted in telemetry.
+//
+// Thru: sources with the thru role have the kinds of message picked with
+// setThruKinds() forwarded to one output port, straight from the input
+// callback, each source on its own lane of the port (see
+// QueuedOutputPort::sendThru for how they are merged with the engine's
+// output). The port is swapped atomically; one being closed is kept until
+// the pushes that may still hold it are done (getRetireToken()).
+//
+// Sources are opened and closed on the message thread (MidiDeviceManager);
+// the listener and the clock handler are called from the MIDI input threads,
+// one event at a time.
+class MergedMidiInput
+{
+public:
+    static constexpr int maxSources = MidiOutputPort::maxThruSources;
+
+    enum Role
+    {
+        clock    = 1 << 0,   // clock, start/stop/continue, song position
+        notes    = 1 << 1,   // note on/off
+        controls = 1 << 2,   // everything else on a channel (CCs)
+        allRoles = clock | notes | controls,
+
+        thru     = 1 << 3    // forwarded to the thru port
+    };
+
+    class Listener
+    {
+    public:
+        virtual ~Listener() = default;
+
+        // MIDI input thread: no allocation or locking (see RealtimeGuard).
+        // Clock and transport messages go to the clock handler instead.
+        virtual void handleMergedEvent(int source, const juce::MidiMessage& message, double timeMs) = 0;
+    };
+
+    explicit MergedMidiInput(EngineTelemetry& t)
+        : telemetry(t)
+    {
+        roles[0].store(allRoles);
+
+        for (int s = 1; s < maxSources; ++s)
+            roles[(size_t) s].store(notes | controls);
+    }
+
+    ~MergedMidiInput()
+    {
+        for (int s = 0; s < maxSources; ++s)
+            close(s);
+    }
+
+    // Set before any source is opened
+    void setListener(Listener* l) noexcept   { listener = l; }
+
+    // Receiver for the clock master's messages (nullptr: none). Message
+    // thread: once this returns, no input thread uses the previous handler,
+    // which can then be reset.
+    void setClockHandler(MidiClockHandler* handler) noexcept
+    {
+        clockHandler.store(handler);
+        waitForPushes(getRetireToken());
+    }
+
+    // Pushes started so far, per source: whatever was swapped out before
+    // taking it is unused once isRetired() says so
+    using RetireToken = std::array<juce::uint64, maxSources>;
+
+    RetireToken getRetireToken() const noexcept
+    {
+        RetireToken token;
+
+        for (int s = 0; s < maxSources; ++s)
+            token[(size_t) s] = activities[(size_t) s].started.load();
+
+        return token;
+    }
+
+    bool isRetired(const RetireToken& token) const noexcept
+    {
+        for (int s = 0; s < maxSources; ++s)
+            if (activities[(size_t) s].finished.load(std::memory_order_acquire) < token[(size_t) s])
+                return false;
+
+        return true;
+    }
+
+    // A push takes microseconds
+    void waitForPushes(const RetireToken& token) const noexcept
+    {
+        while (!isRetired(token))
+            juce::Thread::yield();
+    }
+
+    // Giving a source the clock role takes it from the others
+    void setRoles(int source, int newRoles) noexcept
+    {
+        if (newRoles & clock)
+            for (auto& r : roles)
+                r.fetch_and(~clock);
+
+        roles[(size_t) source].store(newRoles);
+    }
+
+    int getRoles(int source) const noexcept   { return roles[(size_t) source].load(); }
+
+    // Message kinds (clock, notes, controls) the thru role forwards
+    void setThruKinds(int kinds) noexcept   { thruKinds.store(kinds & allRoles); }
+    int getThruKinds() const noexcept       { return thruKinds.load(); }
+
+    // Message thread. The previous port may still be in use until a token
+    // taken after this call retires.
+    void setThruPort(MidiOutputPort* port) noexcept   { thruPort.store(port); }
+
+    // ---- Message thread ----
+    bool open(int source, const juce::String& identifier)
+    {
+        close(source);
+
+        auto& port = ports[(size_t) source];
+        port.owner = this;
+        port.source = source;
+        port.device = juce::MidiInput::openDevice(identifier, &port);
+
+        if (port.device == nullptr)
+            return false;
+
+        port.device->start();
+        return true;
+    }
+
+    void close(int source)
+    {
+        auto& port = ports[(size_t) source];
+
+        if (port.device != nullptr)
+        {
+            port.device->stop();
+            port.device.reset();
+        }
+    }
+
+    bool isOpen(int source, const juce::String& identifier) const
+    {
+        const auto& device = ports[(size_t) source].device;
+        return device != nullptr && device->getIdentifier() == identifier;
+    }
+
+    // ---- MIDI input threads ----
+    // Also called by backends that read the input themselves (JACK), with
+    // the event's own time.
+    void push(int source, const juce::MidiMessage& message, double timeMs) noexcept
+    {
+        const RealtimeGuard::Scope realtime;
+
+        auto& activity = activities[(size_t) source];
+        activity.started.fetch_add(1);
+        const juce::ScopeGuard pushed { [&activity] { activity.finished.fetch_add(1, std::memory_order_release); } };
+
+        telemetry.inputReceived();
+        EngineTrace::instant("midi in", message.getRawData()[0]);
+
+        const int sourceRoles = roles[(size_t) source].load(std::memory_order_relaxed);
+        const int role = roleOf(message);
+
+        timeMs = keepInOrder(timeMs);
+
+        if ((sourceRoles & thru) != 0 && (thruKinds.load(std::memory_order_relaxed) & role) != 0)
+            forwardThru(source, message);
+
+        if ((sourceRoles & role) == 0)
+            return;
+
+        if (role == clock)
+        {
+            if (auto* handler = clockHandler.load())
+                handler->handleMessageAt(message, timeMs);
+        }
+        else if (listener != nullptr)
+        {
+            listener->handleMergedEvent(source, message, timeMs);
+        }
+    }
+
+private:
+    struct Port : public juce::MidiInputCallback
+    {
+        void handleIncomingMidiMessage(juce::MidiInput*, const juce::MidiMessage& message) override
+        {
+            // seconds on the Time::getMillisecondCounter() base
+            const double stampMs = message.getTimeStamp() * 1000.0;
+            owner->push(source, message, stampMs > 0.0 ? stampMs : juce::Time::getMillisecondCounterHiRes());
+        }
+
+        MergedMidiInput* owner = nullptr;
+        int source = 0;
+        std::unique_ptr<juce::MidiInput> device;
+    };
+
+    // Later than every time passed on so far, or stamped with the latest
+    // one; a time another source got in with first is retried, not locked out
+    double keepInOrder(double timeMs) noexcept
+    {
+        double last = lastTimeMs.load(std::memory_order_relaxed);
+
+        while (timeMs >= last)
+            if (lastTimeMs.compare_exchange_weak(last, timeMs, std::memory_order_relaxed))
+                return timeMs;
+
+        telemetry.inputReordered();
+        return last;
+    }
+
+    void forwardThru(int source, const juce::MidiMessage& message) noexcept
+    {
+        auto* port = thruPort.load();
+
+        if (port == nullptr)
+            return;
+
+        // sysex isn't forwarded
+        const auto word = MidiOutputPort::fromBytestream(message.getRawData(), message.getRawDataSize());
+
+        if (word != 0 && !port->sendThru(source, juce::ump::View(&word)))
+            telemetry.thruDropped();
+    }
+
+    static int roleOf(const juce::MidiMessage& message) noexcept
+    {
+        if (message.isMidiClock() || message.isMidiStart() || message.isMidiStop()
+            || message.isMidiContinue() || message.isSongPositionPointer())
+            return clock;
+
+        return message.isNoteOnOrOff() ? notes : controls;
+    }
+
+    struct Activity
+    {
+        std::atomic<juce::uint64> started { 0 }, finished { 0 };
+    };
+
+    EngineTelemetry& telemetry;
+    Listener* listener = nullptr;
+    std::atomic<MidiClockHandler*> clockHandler { nullptr };
+    std::array<std::atomic<int>, maxSources> roles {};
+    std::atomic<int> thruKinds { notes | controls };
+
+    std::array<Port, maxSources> ports;
+    std::array<Activity, maxSources> activities;
+
+    std::atomic<double> lastTimeMs { 0.0 };
+    std::atomic<MidiOutputPort*> thruPort { nullptr };
+};
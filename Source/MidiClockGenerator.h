@@ -0,0 +1,166 @@
+#pragma once
+#include <JuceHeader.h>
+
+// ==========================================
+// MIDI clock generator
+// ==========================================
+// Timebase of the clock master mode (Settings::clockMaster), owned by the
+// engine thread. Clock pulses (24 per quarter note) are planned ahead: each
+// engine tick hands every pulse due before a horizon past the next tick to
+// the outputs with its exact time (see MidiOutputPort::sendScheduled), so
+// how late the tick itself ran doesn't show on the wire.
+//
+// The clock keeps running while the mode is on; the transport only decides
+// whether the song position advances. Start, Stop, Continue and Song
+// Position Pointer go out just before the next unplanned pulse, the one a
+// slave counts from, and so do tempo changes. After Start that pulse is
+// song position 0.
+//
+// The song position is also what synced LFOs follow (getPositionAt()), so
+// they stay on the grid the slaves play to.
+class MidiClockGenerator
+{
+public:
+    static constexpr int pulsesPerQuarter = 24;
+    static constexpr int pulsesPerSixteenth = pulsesPerQuarter / 4;
+    static constexpr double minBpm = 20.0;
+    static constexpr double maxBpm = 300.0;
+
+    enum class Transport
+    {
+        none,
+        start,
+        stop,
+        continuePlayback
+    };
+
+    // Switched on: first pulse at nowMs, transport stopped at position 0
+    void reset(double nowMs, double bpm) noexcept
+    {
+        tempoBpm = pendingBpm = juce::jlimit(minBpm, maxBpm, bpm);
+        pulseMs = 60000.0 / (tempoBpm * pulsesPerQuarter);
+        nextPulseMs = nowMs;
+
+        running = false;
+        songPulse = 0;
+        lastPulse = resumedAt = 0;
+        lastPulseMs = nowMs;
+
+        pendingTransport = Transport::none;
+        pendingLocate = -1;
+    }
+
+    // Take effect at the next unplanned pulse
+    void setTempo(double bpm) noexcept              { pendingBpm = juce::jlimit(minBpm, maxBpm, bpm); }
+    void requestTransport(Transport t) noexcept     { pendingTransport = t; }
+
+    // Song position while stopped, in sixteenths (sent as Song Position Pointer)
+    void locate(int sixteenths) noexcept            { pendingLocate = juce::jlimit(0, 0x3fff, sixteenths); }
+
+    // Every message due before untilMs, in time order, as
+    // emit(packet word, due time). Returns the transport change planned on
+    // the way, if any.
+    template <typename Emit>
+    Transport plan(double untilMs, Emit&& emit)
+    {
+        auto applied = Transport::none;
+
+        while (nextPulseMs < untilMs)
+        {
+            const double dueMs = nextPulseMs;
+            const auto transport = std::exchange(pendingTransport, Transport::none);
+
+            if (transport == Transport::start)
+            {
+                emit(juce::ump::Factory::makeStart(0)[0], dueMs);
+                running = true;
+                songPulse = resumedAt = 0;
+                applied = transport;
+            }
+            else if (transport == Transport::stop && running)
+            {
+                emit(juce::ump::Factory::makeStop(0)[0], dueMs);
+                running = false;
+                applied = transport;
+            }
+            else if (transport == Transport::continuePlayback && !running)
+            {
+                // the pointer only has sixteenth resolution
+                songPulse -= songPulse % pulsesPerSixteenth;
+                emitSongPosition(dueMs, emit);
+                emit(juce::ump::Factory::makeContinue(0)[0], dueMs);
+                running = true;
+                resumedAt = songPulse;
+                applied = transport;
+            }
+
+            if (pendingLocate >= 0 && !running)
+            {
+                songPulse = std::exchange(pendingLocate, -1) * pulsesPerSixteenth;
+                emitSongPosition(dueMs, emit);
+            }
+
+            if (pendingBpm != tempoBpm)
+            {
+                tempoBpm = pendingBpm;
+                pulseMs = 60000.0 / (tempoBpm * pulsesPerQuarter);
+            }
+
+            emit(juce::ump::Factory::makeTimingClock(0)[0], dueMs);
+
+            lastPulseMs = dueMs;
+            lastPulse = songPulse;
+
+            if (running)
+                ++songPulse;
+
+            nextPulseMs = dueMs + pulseMs;
+        }
+
+        return applied;
+    }
+
+    // Switched off: a running transport gets its Stop after the last
+    // planned pulse
+    template <typename Emit>
+    void finish(Emit&& emit)
+    {
+        if (std::exchange(running, false))
+            emit(juce::ump::Factory::makeStop(0)[0], lastPulseMs);
+    }
+
+    // Song position at a time around the planned pulses, in quarter notes;
+    // held at the start (or continue) position until that pulse is due
+    double getPositionAt(double timeMs) const noexcept
+    {
+        if (!running)
+            return (double) songPulse / pulsesPerQuarter;
+
+        const double pulse = (double) lastPulse + (timeMs - lastPulseMs) / pulseMs;
+        return juce::jmax((double) resumedAt, pulse) / pulsesPerQuarter;
+    }
+
+    double getBpm() const noexcept          { return tempoBpm; }
+    bool isRunning() const noexcept         { return running; }
+
+private:
+    template <typename Emit>
+    void emitSongPosition(double dueMs, Emit&& emit)
+    {
+        const auto sixteenths = (juce::uint16) juce::jmin(0x3fff, songPulse / pulsesPerSixteenth);
+        emit(juce::ump::Factory::makeSongPositionPointer(0, sixteenths)[0], dueMs);
+    }
+
+    double tempoBpm = 120.0, pendingBpm = 120.0;
+    double pulseMs = 60000.0 / (120.0 * pulsesPerQuarter);
+    double nextPulseMs = 0.0;      // first pulse not planned yet
+
+    bool running = false;
+    int songPulse = 0;             // position the next pulse gets while running
+    int lastPulse = 0;             // position of the last planned pulse
+    int resumedAt = 0;             // position of the last Start/Continue
+    double lastPulseMs = 0.0;
+
+    Transport pendingTransport = Transport::none;
+    int pendingLocate = -1;
+};
@@ -0,0 +1,523 @@
+#pragma once
+#include <JuceHeader.h>
+#include "ModulationEngine.h"
+#include "EngineTelemetry.h"
+#include "EngineTrace.h"
+#include "MidiOutputPort.h"
+#include "QueuedOutputPort.h"
+#include "RawMidiOutput.h"
+#include "JackMidiClient.h"
+#include "MergedMidiInput.h"
+
+// ==========================================
+// MIDI device manager
+// ==========================================
+// Owns the output ports the engine sends to and the input ports the app
+// listens on, and keeps them following the system device list. There is one
+// output slot per engine output (routes pick theirs); each device port is
+// written by its own sender thread (see QueuedOutputPort.h), so a slow
+// device doesn't hold up the engine or the other outputs. Input slots are
+// the sources of one merged stream, each with its roles (see
+// MergedMidiInput.h).
+//
+// Device changes arrive through MidiDeviceListConnection, which JUCE drives
+// from its ump::Endpoints listener after the device tables are refreshed.
+// A selected device that disappears is closed; when a device with the same
+// identifier (or, failing that, the same name: a replugged USB device may
+// get a new ALSA client number) shows up again it is reopened.
+//
+// JUCE 8 only allows opening ports on the message thread, so that's where
+// this lives. What never blocks is the hand-over: the engine picks up a new
+// output with one atomic load, and the previous port is kept in a retire
+// list until the engine has finished every tick that could still see it.
+//
+// Outputs go through the ALSA sequencer (JUCE MidiOutput) by default, or
+// straight to the hardware's rawmidi device (see RawMidiOutput.h).
+//
+// With the JACK backend (see JackMidiClient.h) both directions go through
+// our JACK client's two ports instead: "devices" are the other clients'
+// MIDI ports, selecting one connects to it, and the engine is ticked by the
+// JACK process callback. Only the first output and input slots exist there.
+// onEngineDriverChanged tells the owner to stop its EngineThread first, and
+// to start it again once the client is gone.
+class MidiDeviceManager : private juce::Timer
+{
+public:
+    enum class Backend
+    {
+        sequencer,
+        rawMidi,
+        jack
+    };
+
+    MidiDeviceManager(ModulationEngine& e, EngineTelemetry& t)
+        : engine(e), telemetry(t), mergedInput(t)
+    {
+    }
+
+    ~MidiDeviceManager() override
+    {
+        stopTimer();
+
+        if (jack != nullptr)
+        {
+            // no restart of the engine thread on the way out
+            engine.setOutput(nullptr);
+            jack.reset();
+        }
+
+        for (int slot = 0; slot < maxInputs; ++slot)
+            closeInput(slot);
+
+        for (int slot = 0; slot < maxOutputs; ++slot)
+            retireOutput(slot);
+
+        // only reached with the engine thread stopped or about to finish a tick
+        while (!retiredOutputs.empty())
+        {
+            freeRetiredOutputs();
+
+            if (!retiredOutputs.empty())
+                juce::Thread::yield();
+        }
+    }
+
+    // Receiver of the merged input (must outlive the manager's ports)
+    void setInputListener(MergedMidiInput::Listener* listener) noexcept   { mergedInput.setListener(listener); }
+
+    // Receiver of the clock master input's clock (nullptr: clock input ignored)
+    void setClockHandler(MidiClockHandler* handler) noexcept   { mergedInput.setClockHandler(handler); }
+
+    // Takes the first device snapshot and starts following device changes
+    void start()
+    {
+        if (deviceListConnection.has_value())
+            return;
+
+        outputs = listOutputs();
+        inputs = listInputs();
+
+        deviceListConnection = juce::MidiDeviceListConnection::make([this] { devicesChanged(); });
+    }
+
+    const juce::Array<juce::MidiDeviceInfo>& getOutputs() const noexcept   { return outputs; }
+    const juce::Array<juce::MidiDeviceInfo>& getInputs() const noexcept    { return inputs; }
+
+    // ---- Backend ----
+    // Switching backend closes the outputs: each lists different ports. Going
+    // to or from JACK closes the input too. Returns false if JACK was asked
+    // for but no server could be connected to.
+    bool setBackend(Backend newBackend)
+    {
+        if (newBackend == backend)
+            return true;
+
+        std::unique_ptr<JackMidiClient> newJack;
+
+        if (newBackend == Backend::jack)
+        {
+            newJack = JackMidiClient::open(engine, telemetry);
+
+            if (newJack == nullptr)
+                return false;
+        }
+
+        const bool inputsChange = (newBackend == Backend::jack) != (backend == Backend::jack);
+
+        if (jack != nullptr)
+            closeJack();
+
+        for (int slot = 0; slot < maxOutputs; ++slot)
+        {
+            wantedOutputs[(size_t) slot] = {};
+            retireOutput(slot);
+        }
+
+        if (inputsChange)
+        {
+            for (int slot = 0; slot < maxInputs; ++slot)
+            {
+                wantedInputs[(size_t) slot] = {};
+                closeInput(slot);
+            }
+        }
+
+        backend = newBackend;
+
+        if (newJack != nullptr && !startJack(std::move(newJack)))
+            backend = Backend::sequencer;
+
+        outputs = listOutputs();
+        inputs = listInputs();
+
+        if (onDevicesChanged)
+            onDevicesChanged();
+
+        if (inputsChange && onInputChanged)
+            onInputChanged();
+
+        return backend == newBackend;
+    }
+
+    Backend getBackend() const noexcept          { return backend; }
+    bool isEngineDrivenByJack() const noexcept   { return jack != nullptr; }
+
+    // ---- Output ----
+    static constexpr int maxOutputs = ModulationEngine::maxOutputs;
+
+    // Slots that can be used with the current backend
+    int getNumOutputSlots() const noexcept   { return jack != nullptr ? 1 : maxOutputs; }
+
+    // Opens the device for the engine output, or closes it for an empty
+    // identifier. The choice is remembered for reconnecting.
+    void selectOutput(const juce::MidiDeviceInfo& device, int slot = 0)
+    {
+        if (!juce::isPositiveAndBelow(slot, getNumOutputSlots()))
+            return;
+
+        wantedOutputs[(size_t) slot] = device;
+        connectOutput(slot);
+    }
+
+    const juce::MidiDeviceInfo& getSelectedOutput(int slot = 0) const noexcept   { return wantedOutputs[(size_t) slot]; }
+    bool isOutputConnected(int slot = 0) const   { return isOutputOn(slot, wantedOutputs[(size_t) slot].identifier); }
+
+    // For the output sender threads, open ones and the ones opened later
+    void setRealtimeSettings(const RealtimeSettings& newSettings)
+    {
+        realtimeSettings = newSettings;
+
+        for (auto& port : ports)
+            if (port != nullptr)
+                port->setRealtimeSettings(realtimeSettings);
+    }
+
+    // ---- Input ----
+    static constexpr int maxInputs = MergedMidiInput::maxSources;
+
+    int getNumInputSlots() const noexcept   { return jack != nullptr ? 1 : maxInputs; }
+
+    void selectInput(const juce::MidiDeviceInfo& device, int slot = 0)
+    {
+        if (!juce::isPositiveAndBelow(slot, getNumInputSlots()))
+            return;
+
+        wantedInputs[(size_t) slot] = device;
+        connectInput(slot);
+    }
+
+    const juce::MidiDeviceInfo& getSelectedInput(int slot = 0) const noexcept   { return wantedInputs[(size_t) slot]; }
+    bool isInputConnected(int slot = 0) const   { return isInputOn(slot, wantedInputs[(size_t) slot].identifier); }
+
+    // MergedMidiInput::Role flags; the clock role moves to the slot given it
+    void setInputRoles(int slot, int roles) noexcept   { mergedInput.setRoles(slot, roles); }
+    int getInputRoles(int slot) const noexcept         { return mergedInput.getRoles(slot); }
+
+    // ---- Thru ----
+    // Output slot that inputs with the thru role are forwarded to (-1: none).
+    // Needs a queued device port, so there's no thru under JACK.
+    void setThruOutput(int slot)
+    {
+        thruSlot = slot;
+        updateThruPort();
+    }
+
+    int getThruOutput() const noexcept   { return thruSlot; }
+
+    void setThruKinds(int kinds) noexcept   { mergedInput.setThruKinds(kinds); }
+    int getThruKinds() const noexcept       { return mergedInput.getThruKinds(); }
+
+    // Message thread notifications
+    std::function<void()> onDevicesChanged;          // device lists changed (refill selectors)
+    std::function<void()> onInputChanged;            // input port opened or closed
+    std::function<void(bool)> onEngineDriverChanged; // true: JACK is about to tick the engine
+
+private:
+    void devicesChanged()
+    {
+        const EngineTrace::Scope trace("MidiDeviceManager::devicesChanged");
+
+        outputs = listOutputs();
+        inputs = listInputs();
+
+        for (int slot = 0; slot < getNumOutputSlots(); ++slot)
+        {
+            const auto& wanted = wantedOutputs[(size_t) slot];
+
+            if (wanted.identifier.isEmpty())
+                continue;
+
+            const auto* available = findDevice(outputs, wanted);
+
+            if (available == nullptr)
+                retireOutput(slot);
+            else if (!isOutputOn(slot, available->identifier))
+                connectOutput(slot);
+        }
+
+        for (int slot = 0; slot < getNumInputSlots(); ++slot)
+        {
+            const auto& wanted = wantedInputs[(size_t) slot];
+
+            if (wanted.identifier.isEmpty())
+                continue;
+
+            const auto* available = findDevice(inputs, wanted);
+
+            if (available == nullptr)
+            {
+                if (isInputOn(slot, wanted.identifier))
+                {
+                    closeInput(slot);
+
+                    if (onInputChanged)
+                        onInputChanged();
+                }
+            }
+            else if (!isInputOn(slot, available->identifier))
+            {
+                connectInput(slot);
+            }
+        }
+
+        if (onDevicesChanged)
+            onDevicesChanged();
+    }
+
+    void connectOutput(int slot)
+    {
+        retireOutput(slot);
+
+        auto& wanted = wantedOutputs[(size_t) slot];
+        const auto* device = findDevice(outputs, wanted);
+
+        if (device != nullptr)
+            wanted = *device;
+
+        if (jack != nullptr)
+        {
+            // same port, maybe another device
+            engine.invalidateDeviceShadow();
+            jack->connectOutputTo(device != nullptr ? device->identifier : juce::String());
+            telemetry.setPortName(0, device != nullptr ? "JACK " + device->name : juce::String());
+            return;
+        }
+
+        auto& port = ports[(size_t) slot];
+
+        if (device != nullptr)
+        {
+            auto devicePort = backend == Backend::rawMidi ? RawMidiOutput::open(*device)
+                                                          : SequencerOutputPort::open(device->identifier);
+
+            if (devicePort != nullptr)
+                port = std::make_unique<QueuedOutputPort>(std::move(devicePort), telemetry, slot, realtimeSettings);
+        }
+
+        telemetry.setPortName(slot, port != nullptr ? port->getName() : juce::String());
+        engine.setOutput(port.get(), slot);
+        updateThruPort();
+    }
+
+    // Detaches the slot's output from the engine and the thru; it is deleted once no
+    // tick or input thread can use it.
+    // Under JACK the engine keeps its port, which is only disconnected.
+    void retireOutput(int slot)
+    {
+        telemetry.setPortName(slot, {});
+
+        if (jack != nullptr)
+        {
+            if (slot == 0)
+                jack->connectOutputTo({});
+
+            return;
+        }
+
+        const auto token = engine.setOutput(nullptr, slot);
+        auto& port = ports[(size_t) slot];
+
+        if (port != nullptr)
+        {
+            // off the thru lanes first: the input threads' token comes after
+            auto retired = std::move(port);
+            updateThruPort();
+
+            retiredOutputs.push_back({ token, mergedInput.getRetireToken(), std::move(retired) });
+            freeRetiredOutputs();
+
+            if (!retiredOutputs.empty())
+                startTimerHz(50);
+        }
+    }
+
+    void updateThruPort()
+    {
+        mergedInput.setThruPort(juce::isPositiveAndBelow(thruSlot, maxOutputs) ? ports[(size_t) thruSlot].get()
+                                                                               : nullptr);
+    }
+
+    bool isOutputOn(int slot, const juce::String& identifier) const
+    {
+        if (jack != nullptr)
+            return slot == 0 && identifier.isNotEmpty() && jack->isOutputConnectedTo(identifier);
+
+        const auto& port = ports[(size_t) slot];
+        return port != nullptr && port->getIdentifier() == identifier;
+    }
+
+    void freeRetiredOutputs()
+    {
+        retiredOutputs.erase(std::remove_if(retiredOutputs.begin(), retiredOutputs.end(),
+                                            [this](const RetiredOutput& r)
+                                            {
+                                                return engine.isRetired(r.token) && mergedInput.isRetired(r.inputToken);
+                                            }),
+                             retiredOutputs.end());
+    }
+
+    void timerCallback() override
+    {
+        freeRetiredOutputs();
+
+        if (retiredOutputs.empty())
+            stopTimer();
+    }
+
+    juce::Array<juce::MidiDeviceInfo> listOutputs() const
+    {
+        if (jack != nullptr)
+            return jack->getDestinations();
+
+        return backend == Backend::rawMidi ? RawMidiOutput::getAvailableDevices()
+                                           : juce::MidiOutput::getAvailableDevices();
+    }
+
+    juce::Array<juce::MidiDeviceInfo> listInputs() const
+    {
+        return jack != nullptr ? jack->getSources() : juce::MidiInput::getAvailableDevices();
+    }
+
+    void connectInput(int slot)
+    {
+        closeInput(slot);
+
+        auto& wanted = wantedInputs[(size_t) slot];
+
+        if (const auto* device = findDevice(inputs, wanted))
+        {
+            wanted = *device;
+
+            if (jack != nullptr)
+                jack->connectInputFrom(device->identifier);
+            else
+                mergedInput.open(slot, device->identifier);
+        }
+
+        if (onInputChanged)
+            onInputChanged();
+    }
+
+    void closeInput(int slot)
+    {
+        if (jack != nullptr && slot == 0)
+            jack->connectInputFrom({});
+
+        mergedInput.close(slot);
+    }
+
+    bool isInputOn(int slot, const juce::String& identifier) const
+    {
+        if (jack != nullptr)
+            return slot == 0 && identifier.isNotEmpty() && jack->isInputConnectedFrom(identifier);
+
+        return mergedInput.isOpen(slot, identifier);
+    }
+
+    // ---- JACK ----
+    // The engine thread is stopped before the client activates: from then on
+    // only the process callback ticks the engine.
+    bool startJack(std::unique_ptr<JackMidiClient> client)
+    {
+        jack = std::move(client);
+        jack->setInput(&mergedInput);
+        jack->onPortsChanged = [this] { devicesChanged(); };
+
+        // the client is deleted from here, so not from inside its own callback
+        jack->onShutdown = [weakThis = juce::WeakReference<MidiDeviceManager>(this)]
+        {
+            juce::MessageManager::callAsync([weakThis]
+            {
+                if (weakThis != nullptr)
+                    weakThis->setBackend(Backend::sequencer);
+            });
+        };
+
+        if (onEngineDriverChanged)
+            onEngineDriverChanged(true);
+
+        engine.setOutput(jack->getOutputPort());
+
+        if (jack->activate())
+            return true;
+
+        closeJack();
+        return false;
+    }
+
+    // Deleting the client deactivates it, which waits for the process
+    // callback to return; the engine thread can take over after that.
+    void closeJack()
+    {
+        engine.setOutput(nullptr);
+        jack.reset();
+
+        if (onEngineDriverChanged)
+            onEngineDriverChanged(false);
+    }
+
+    // Same identifier first, then same name (the identifier can change on replug)
+    static const juce::MidiDeviceInfo* findDevice(const juce::Array<juce::MidiDeviceInfo>& devices,
+                                                  const juce::MidiDeviceInfo& wanted)
+    {
+        if (wanted.identifier.isEmpty())
+            return nullptr;
+
+        for (const auto& d : devices)
+            if (d.identifier == wanted.identifier)
+                return &d;
+
+        for (const auto& d : devices)
+            if (d.name == wanted.name)
+                return &d;
+
+        return nullptr;
+    }
+
+    struct RetiredOutput
+    {
+        juce::uint64 token;                          // engine ticks
+        MergedMidiInput::RetireToken inputToken;     // thru from the input threads
+        std::unique_ptr<MidiOutputPort> port;
+    };
+
+    ModulationEngine& engine;
+    EngineTelemetry& telemetry;
+
+    juce::Array<juce::MidiDeviceInfo> outputs, inputs;
+    std::optional<juce::MidiDeviceListConnection> deviceListConnection;
+
+    Backend backend = Backend::sequencer;
+    std::array<juce::MidiDeviceInfo, maxOutputs> wantedOutputs;
+    std::array<std::unique_ptr<QueuedOutputPort>, maxOutputs> ports;
+    RealtimeSettings realtimeSettings;
+    std::array<juce::MidiDeviceInfo, maxInputs> wantedInputs;
+    MergedMidiInput mergedInput;
+    int thruSlot = -1;
+
+    std::unique_ptr<JackMidiClient> jack;
+
+    std::vector<RetiredOutput> retiredOutputs;
+
+    JUCE_DECLARE_WEAK_REFERENCEABLE(MidiDeviceManager)
+};
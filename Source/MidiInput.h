@@ -1,5 +1,7 @@
 #pragma once
 #include <JuceHeader.h>
+#include "EngineTrace.h"
+#include "RealtimeGuard.h"
 
 // Listener interface for transport events (unchanged)
 class MidiClockListener
@@ -9,6 +11,9 @@ public:
     virtual void handleMidiStart() {}
     virtual void handleMidiStop() {}
     virtual void handleMidiContinue() {}
+
+    // Every clock pulse, with the time it arrived
+    virtual void handleMidiClock(double /*timeMs*/) {}
 };
 
 class MidiClockHandler : public juce::MidiInputCallback
@@ -24,22 +29,20 @@ public:
     // MainComponent can set this to receive Note-On events from the open input.
     std::function<void(const juce::MidiMessage&)> noteOnCallback;
 
-    // Start listening to the given MIDI input device index.
+    // Start listening to the given MIDI input device.
     // Returns true if the device was opened.
-    bool start(int deviceIndex)
+    bool start(const juce::String& deviceIdentifier)
     {
         stop();
 
-        auto devices = juce::MidiInput::getAvailableDevices();
-        if (deviceIndex < 0 || deviceIndex >= devices.size())
+        if (deviceIdentifier.isEmpty())
             return false;
 
-        midiInput = juce::MidiInput::openDevice(devices[deviceIndex].identifier, this);
+        midiInput = juce::MidiInput::openDevice(deviceIdentifier, this);
         if (midiInput)
         {
             midiInput->start();
-            lastClockTimes.clear();
-            currentBpm = 0.0;
+            resetClockHistory();
             return true;
         }
         return false;
@@ -52,28 +55,37 @@ public:
             midiInput->stop();
             midiInput.reset();
         }
-        lastClockTimes.clear();
-        currentBpm = 0.0;
+        resetClockHistory();
     }
 
     // The incoming message handler: keeps your BPM computation
+    // (MIDI input thread: no allocation or locking, see RealtimeGuard)
     void handleIncomingMidiMessage(juce::MidiInput* /*source*/, const juce::MidiMessage& message) override
     {
         // High resolution timestamp in milliseconds
-        const double nowMs = juce::Time::getMillisecondCounterHiRes();
+        handleMessageAt(message, juce::Time::getMillisecondCounterHiRes());
+    }
+
+    // Same, for backends that know when the message arrived (JACK frame time)
+    void handleMessageAt(const juce::MidiMessage& message, double nowMs)
+    {
+        const RealtimeGuard::Scope realtime;
+
+        EngineTrace::instant("clock input", message.getRawData()[0]);
 
         if (message.isMidiClock())
         {
             // Store up to last N clocks for averaging (default 48)
-            lastClockTimes.add(nowMs);
-            if (lastClockTimes.size() > 48)
-                lastClockTimes.remove(0);
+            clockHead = (clockHead + 1) % maxClockTimes;
+            lastClockTimes[(size_t) clockHead] = nowMs;
+            numClockTimes = juce::jmin(numClockTimes + 1, maxClockTimes);
 
-            const int n = lastClockTimes.size();
+            const int n = numClockTimes;
             if (n >= 2)
             {
+                const int oldest = (clockHead - (n - 1) + maxClockTimes) % maxClockTimes;
                 const double clockIntervals = (double)(n - 1);
-                const double elapsedMs = lastClockTimes.getLast() - lastClockTimes.getFirst();
+                const double elapsedMs = lastClockTimes[(size_t) clockHead] - lastClockTimes[(size_t) oldest];
                 if (elapsedMs > 0.0)
                 {
                     // BPM = (60000 * clockIntervals) / (elapsedMs * 24)
@@ -83,19 +95,22 @@ public:
                     if (computedBpm > 10.0 && computedBpm < 400.0)
                     {
                         // simple smoothing to reduce jitter (keeps previous behaviour)
-                        if (currentBpm <= 0.0)
-                            currentBpm = computedBpm;
+                        const double previousBpm = currentBpm.load(std::memory_order_relaxed);
+
+                        if (previousBpm <= 0.0)
+                            currentBpm.store(computedBpm, std::memory_order_relaxed);
                         else
-                            currentBpm = 0.9 * currentBpm + 0.1 * computedBpm;
+                            currentBpm.store(0.9 * previousBpm + 0.1 * computedBpm, std::memory_order_relaxed);
                     }
                 }
             }
+
+            if (listener) listener->handleMidiClock(nowMs);
         }
         else if (message.isMidiStart())
         {
             // reset stored clocks so BPM restarts cleanly
-            lastClockTimes.clear();
-            currentBpm = 0.0;
+            resetClockHistory();
             if (listener) listener->handleMidiStart();
         }
         else if (message.isMidiStop())
@@ -113,13 +128,23 @@ public:
 
     }
 
-    double getCurrentBPM() const noexcept { return currentBpm; }
+    double getCurrentBPM() const noexcept { return currentBpm.load(std::memory_order_relaxed); }
 
 private:
+    void resetClockHistory() noexcept
+    {
+        numClockTimes = 0;
+        clockHead = -1;
+        currentBpm.store(0.0, std::memory_order_relaxed);
+    }
+
     std::unique_ptr<juce::MidiInput> midiInput;
     MidiClockListener* listener = nullptr;
 
-    // BPM calculation state (unchanged)
-    juce::Array<double> lastClockTimes; // timestamps in ms
-    double currentBpm { 0.0 };
+    // BPM calculation state: fixed ring so the input thread never reallocates
+    static constexpr int maxClockTimes = 48;
+    std::array<double, maxClockTimes> lastClockTimes {}; // timestamps in ms
+    int numClockTimes = 0;
+    int clockHead = -1;
+    std::atomic<double> currentBpm { 0.0 };
 };
@@ -2,8 +2,20 @@
 
 #include "MidiMonitorContent.h"
 
+// Where the engine reports the messages it sends (debug builds): the
+// window itself, or the engine process' forwarder to its front-ends
+class MidiMonitorSink
+{
+public:
+    virtual ~MidiMonitorSink() = default;
+
+    // realtime-safe: called from the engine thread
+    virtual void pushEvent(const juce::MidiMessage& msg, bool isIncoming) = 0;
+};
+
 // MidiMonitorWindow.h
 class MidiMonitorWindow : public juce::DialogWindow,
+                          public MidiMonitorSink,
                           private juce::Timer
 {
 public:
@@ -20,14 +32,23 @@ public:
         setContentOwned(content.get(), false);
 
         centreWithSize(500, 300);
+    }
 
-        startTimerHz(2); // UI refresh rate (low priority)
+    // refreshed only while on screen; events keep queueing meanwhile
+    void visibilityChanged() override
+    {
+        DialogWindow::visibilityChanged();
+
+        if (isVisible())
+            startTimerHz(2); // UI refresh rate (low priority)
+        else
+            stopTimer();
     }
 
     // ============================================================
     // REALTIME-SAFE ENTRY POINT (called from MIDI / LFO code)
     // ============================================================
-    void pushEvent(const juce::MidiMessage& msg, bool isIncoming)
+    void pushEvent(const juce::MidiMessage& msg, bool isIncoming) override
     {
         // Optional decimation to reduce load further
         // if (++decimationCounter % monitorDecimation != 0)
@@ -38,7 +59,11 @@ public:
 
         if (size1 > 0)
         {
-            eventBuffer[(size_t)start1] = { msg, isIncoming };
+            // copy raw bytes only: no MidiMessage is built on the caller's thread
+            auto& e = eventBuffer[(size_t)start1];
+            e.size = juce::jmin(msg.getRawDataSize(), (int) e.bytes.size());
+            std::copy_n(msg.getRawData(), e.size, e.bytes.begin());
+            e.incoming = isIncoming;
             fifo.finishedWrite(1);
         }
     }
@@ -48,7 +73,8 @@ public:
     // ============================================================
     struct MidiLogEvent
     {
-        juce::MidiMessage msg;
+        std::array<juce::uint8, 3> bytes {};
+        int size = 0;
         bool incoming = false;
     };
 
@@ -87,7 +113,11 @@ private:
         //     : getChannelColour(e.msg.getChannel());
 
         // editor.setColour(juce::TextEditor::textColourId, colour);
-        editor.insertTextAtCaret(e.msg.getDescription() + "\n");
+        if (e.size <= 0)
+            return;
+
+        const juce::MidiMessage msg(e.bytes.data(), e.size);
+        editor.insertTextAtCaret(msg.getDescription() + "\n");
     }
 
     void trimHistory(juce::TextEditor& editor)
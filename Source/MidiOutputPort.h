@@ -0,0 +1,181 @@
+#pragma once
+#include <JuceHeader.h>
+
+// ==========================================
+// MIDI output port
+// ==========================================
+// What the engine sends to. The engine thread calls send() for every message
+// of a tick and flush() once when the tick is done, so a backend can batch a
+// whole tick into one write. Ports are created, swapped and deleted on the
+// message thread (see MidiDeviceManager).
+//
+// Messages are Universal MIDI Packets, built on the stack with
+// juce::ump::Factory (MIDI 1.0 channel voice or system messages, group 0).
+// Byte stream backends turn them into MIDI 1.0 bytes with toBytestream().
+class MidiOutputPort
+{
+public:
+    virtual ~MidiOutputPort() = default;
+
+    virtual juce::String getName() const = 0;
+    virtual juce::String getIdentifier() const = 0;
+
+    // Engine thread. Returns the number of bytes this message puts on the wire.
+    virtual int send(juce::ump::View packet) noexcept = 0;
+
+    // Engine thread, end of tick. Returns the number of bytes the port had
+    // to drop since the last flush.
+    virtual int flush() noexcept   { return 0; }
+
+    // Engine thread. A message due at dueMs (Time::getMillisecondCounterHiRes()
+    // timebase) rather than with the tick: MIDI clock. Calls come in order of
+    // due time, up to a couple of ticks ahead. Returns what send() returns;
+    // ports without a timed writer send it with the tick.
+    virtual int sendScheduled(juce::ump::View packet, double /*dueMs*/) noexcept   { return send(packet); }
+
+    // MIDI input threads (thru), each source on its own lane, so every lane
+    // has one producer. Hands a message to the port's own writer, to go out
+    // between two engine ticks; false if the port has none (only queued
+    // ports do) or the lane is full.
+    static constexpr int maxThruSources = 4;
+
+    virtual bool sendThru(int /*source*/, juce::ump::View /*packet*/) noexcept   { return false; }
+
+    // The MIDI 1.0 bytes of a 32-bit channel voice or system packet (dest has
+    // room for 3); 0 for packets a byte stream can't carry as they are
+    static int toBytestream(juce::ump::View packet, juce::uint8* dest) noexcept
+    {
+        const auto word = packet[0];
+        const auto type = juce::ump::Utils::getMessageType(word);
+
+        if (type != juce::ump::Utils::MessageKind::commonRealtime
+            && type != juce::ump::Utils::MessageKind::channelVoice1)
+            return 0;
+
+        const auto status = (juce::uint8) (word >> 16);
+
+        // sysex start/end travel as sysex packets
+        if (status == 0xf0 || status == 0xf7)
+            return 0;
+
+        dest[0] = status;
+        dest[1] = (juce::uint8) ((word >> 8) & 0x7f);
+        dest[2] = (juce::uint8) (word & 0x7f);
+
+        return juce::MidiMessage::getMessageLengthFromFirstByte(status);
+    }
+
+    // The 32-bit packet (group 0) of a MIDI 1.0 channel or system message
+    // of up to 3 bytes; 0 for anything longer (sysex)
+    static juce::uint32 fromBytestream(const juce::uint8* data, int size) noexcept
+    {
+        if (size <= 0 || size > 3 || data[0] < 0x80 || data[0] == 0xf0)
+            return 0;
+
+        const juce::uint32 messageType = data[0] >= 0xf0 ? 0x1u : 0x2u;
+
+        return (messageType << 28)
+             | ((juce::uint32) data[0] << 16)
+             | (size > 1 ? (juce::uint32) data[1] << 8 : 0u)
+             | (size > 2 ? (juce::uint32) data[2] : 0u);
+    }
+};
+
+// ==========================================
+// ALSA sequencer output
+// ==========================================
+// A UMP connection to the sequencer endpoint behind a JUCE MidiOutput
+// identifier. A tick's packets are collected in a fixed buffer and handed
+// over in one call on flush: JUCE writes them with
+// snd_seq_ump_event_output_direct when the kernel and alsa-lib have UMP
+// support, and converts them to byte stream sequencer events otherwise.
+class SequencerOutputPort : public MidiOutputPort
+{
+public:
+    static constexpr int capacityWords = 1024;
+
+    // Message thread
+    static std::unique_ptr<MidiOutputPort> open(const juce::String& identifier)
+    {
+        // resolves the identifier to its endpoint and group
+        auto device = juce::MidiOutput::openDevice(identifier);
+
+        if (device == nullptr)
+            return nullptr;
+
+        auto* app = juce::JUCEApplicationBase::getInstance();
+        auto session = juce::ump::Endpoints::getInstance()->makeSession(app != nullptr ? app->getApplicationName()
+                                                                                       : "ModzTakt");
+        auto connection = session.connectOutput(device->getEndpointId());
+
+        if (!connection.isAlive())
+            return nullptr;
+
+        return std::unique_ptr<MidiOutputPort>(new SequencerOutputPort(device->getDeviceInfo(),
+                                                                       std::move(session),
+                                                                       std::move(connection),
+                                                                       device->getGroup()));
+    }
+
+    juce::String getName() const override         { return info.name; }
+    juce::String getIdentifier() const override   { return info.identifier; }
+
+    int send(juce::ump::View packet) noexcept override
+    {
+        const auto numWords = (int) packet.size();
+
+        // wire size: MIDI 1.0 bytes where there is an equivalent
+        juce::uint8 bytes[3];
+        const int asBytes = toBytestream(packet, bytes);
+        const int size = asBytes > 0 ? asBytes : numWords * 4;
+
+        if (numPending + numWords > capacityWords)
+            droppedSinceFlush += write();
+
+        std::copy(packet.begin(), packet.end(), pending.begin() + numPending);
+
+        // onto the group the identifier names
+        pending[(size_t) numPending] = (pending[(size_t) numPending] & ~0x0f000000u) | ((juce::uint32) group << 24);
+        numPending += numWords;
+        pendingBytes += size;
+
+        return size;
+    }
+
+    int flush() noexcept override
+    {
+        return std::exchange(droppedSinceFlush, 0) + write();
+    }
+
+private:
+    SequencerOutputPort(const juce::MidiDeviceInfo& i, juce::ump::Session s, juce::ump::Output c, juce::uint8 g)
+        : info(i), session(std::move(s)), connection(std::move(c)), group(g)
+    {
+    }
+
+    // returns the bytes that didn't make it (endpoint gone)
+    int write() noexcept
+    {
+        if (numPending == 0)
+            return 0;
+
+        const juce::ump::Iterator begin(pending.data(), (size_t) numPending);
+        const juce::ump::Iterator end(pending.data() + numPending, 0);
+        const bool written = connection.isAlive() && connection.send(begin, end);
+
+        const int dropped = written ? 0 : pendingBytes;
+        numPending = 0;
+        pendingBytes = 0;
+        return dropped;
+    }
+
+    juce::MidiDeviceInfo info;
+    juce::ump::Session session;
+    juce::ump::Output connection;
+    juce::uint8 group = 0;
+
+    std::array<juce::uint32, capacityWords> pending {};
+    int numPending = 0;      // words
+    int pendingBytes = 0;    // their size on the wire
+    int droppedSinceFlush = 0;
+};
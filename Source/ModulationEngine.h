@@ -0,0 +1,1532 @@
+#pragma once
+#include <JuceHeader.h>
+#include "SyntaktParameterTable.h"
+#include "EnvelopeGenerator.h"
+#include "ModulationMatrix.h"
+#include "DeviceShadow.h"
+#include "UpdateSchedule.h"
+#include "ErrorDiffusionQuantizer.h"
+#include "EngineProbes.h"
+#include "MidiOutputPort.h"
+#include "EngineTelemetry.h"
+#include "EngineTrace.h"
+#include "RealtimeGuard.h"
+#include "MidiClockGenerator.h"
+#include "AutomationClip.h"
+
+#if JUCE_DEBUG
+ #include "MidiMonitorWindow.h"
+#endif
+
+// ==========================================
+// Latest-value exchange
+// ==========================================
+// Triple buffer: one writer publishes whole snapshots, one reader picks up
+// the most recent one. Neither side blocks or allocates; intermediate
+// snapshots the reader never saw are simply skipped.
+template <typename T>
+class LatestValue
+{
+public:
+    // writer thread
+    void write(const T& value) noexcept
+    {
+        buffers[(size_t) back] = value;
+        back = state.exchange(back | dirtyBit, std::memory_order_acq_rel) & indexMask;
+    }
+
+    // reader thread: returns false if nothing new was published
+    bool read(T& out) noexcept
+    {
+        if ((state.load(std::memory_order_relaxed) & dirtyBit) == 0)
+            return false;
+
+        front = state.exchange(front, std::memory_order_acq_rel) & indexMask;
+        out = buffers[(size_t) front];
+        return true;
+    }
+
+private:
+    static constexpr int dirtyBit  = 4;
+    static constexpr int indexMask = 3;
+
+    std::array<T, 3> buffers {};
+    int back = 0;                // writer owned
+    int front = 1;               // reader owned
+    std::atomic<int> state { 2 }; // shared slot index | dirtyBit
+};
+
+// ==========================================
+// Modulation engine
+// ==========================================
+// LFO routes and EG, ticked at a fixed rate by EngineThread. Everything the
+// tick reads comes from a Settings snapshot published by the UI or from
+// atomics posted by the MIDI input threads, so tick() never touches a
+// component and runs inside a RealtimeGuard scope.
+//
+// Sources feed a ModulationMatrix, which sends each destination once per
+// tick however many sources drive it, and only if the value differs from
+// what the output's DeviceShadow says the device already holds. There are
+// up to maxOutputs output ports; each LFO route picks one, the EG and the
+// matrix connections go to the first. How often a
+// destination is due depends on its range and slope (see UpdateSchedule),
+// or, with a coarse change threshold, on ErrorDiffusionQuantizer.
+//
+// With nothing to emit (LFO stopped, EG idle or sustaining) isIdle() says
+// so, and EngineThread stops ticking until a request arrives: every call
+// from the UI or the MIDI input goes through requestTick(), which wakes it.
+//
+// As clock master (Settings::clockMaster) the engine also sends MIDI clock
+// and transport to every output, planned by a MidiClockGenerator a little
+// ahead of time. Start/stop requests then go to its transport, and synced
+// LFOs take their phase from its song position, as they do from a host's.
+//
+// Automation: while the AutomationRecorder is armed, every value sent, and
+// every CC/NRPN parameter received, is handed to it with the transport
+// position (the clock master's, the host's, or pulses counted from the
+// incoming clock since Start). An AutomationClip set for playback loops
+// along that position; its lanes are sent as recorded, after the matrix.
+//
+// A whole configuration (a preset, see PresetBank) can be swapped in at the
+// next beat or bar of that position with switchSettings(). The snapshot
+// waits in the engine until the tick that crosses the boundary; the LFO
+// phases carry on through the swap unless a reset is asked for.
+class ModulationEngine
+{
+public:
+    static constexpr int maxRoutes = 3;
+    static constexpr int maxOutputs = EngineTelemetry::maxPorts;
+    static_assert (AutomationClip::maxOutputs == maxOutputs);
+    static constexpr int maxInputSources = 4;   // MergedMidiInput::maxSources
+    static constexpr double tickRateHz = 100.0;
+
+    // Whoever ticks the engine and sleeps while it is idle (EngineThread)
+    struct WakeUp
+    {
+        virtual ~WakeUp() = default;
+
+        // any thread, no locking
+        virtual void wake() noexcept = 0;
+    };
+
+    enum class LfoShape
+    {
+        Sine = 1,
+        Triangle,
+        Square,
+        Saw,
+        Random
+    };
+
+    struct Route
+    {
+        int output = 0;          // index into the engine's outputs
+        int midiChannel = 0;     // 0 = disabled
+        int parameterIndex = 0;
+        bool bipolar = false;
+        bool invertPhase = false;
+        bool oneShot = false;
+        double amount = 1.0;     // -1..1, on top of the global depth
+    };
+
+    struct Settings
+    {
+        std::array<Route, maxRoutes> routes {};
+        int shapeId = 1;
+        double rateHz = 2.0;
+        double depth = 1.0;
+
+        bool syncEnabled = false;
+        int divisionId = 3;
+
+        bool clockMaster = false;   // send clock instead of following it; LFOs synced to it
+        double masterBpm = 120.0;
+
+        bool noteRestartEnabled = false;
+        int noteRestartChannel = 0; // 1–16, 0 = disabled
+
+        int changeThreshold = 1;        // difference needed before sending; 2+ quantizes the curve
+        double errorBoundSteps = 1.0;   // adaptive update rate, 0 = every tick (see UpdateSchedule)
+        double msFloofThreshold = 0.0;  // delay between Midi datas chunk
+        bool seedShadowFromInput = false; // track edits the device echoes (see DeviceShadow)
+
+        EnvelopeGenerator::Settings eg;
+        double egAmount = 1.0;
+
+        // velocity and incoming CC sources
+        std::array<ModulationMatrix::Connection, ModulationMatrix::maxConnections> connections {};
+    };
+
+    // Start/stop carried by a control batch (see ControlSource)
+    enum class LfoRequest
+    {
+        none,
+        start,    // from the start phase, also when already running
+        stop,
+        resume    // clock master: Continue from the song position; otherwise start where it stopped
+    };
+
+    // Where switchSettings() takes over
+    enum class SwitchPoint
+    {
+        now,
+        beat,
+        bar
+    };
+
+    using ClockTransport = MidiClockGenerator::Transport;
+
+    // Control batches (ControlSocket) are taken up by the tick itself, so
+    // they don't wait for the message thread: the source edits the settings
+    // the engine runs, and says what the LFO and the clock master's song
+    // position should do.
+    struct ControlSource
+    {
+        virtual ~ControlSource() = default;
+
+        // Engine thread, at the start of each tick; false once none is
+        // waiting. issuedMs: when the batch arrived.
+        virtual bool takeControl(Settings& settings, LfoRequest& lfoRequest,
+                                 int& songPosition, double& issuedMs) noexcept = 0;
+    };
+
+    ModulationEngine(EngineTelemetry& t, std::function<double()> tempoSource)
+        : telemetry(t), getTempoBpm(std::move(tempoSource))
+    {
+        for (auto& value : inputCcValues)
+            value.store(-1, std::memory_order_relaxed);
+
+        lastConnectionInput.fill(-1);
+    }
+
+    // ==========================================
+    // Message thread
+    // ==========================================
+    void publishSettings(const Settings& newSettings) noexcept
+    {
+        published.settings = newSettings;
+        pendingSettings.write(published);
+        requestTick();
+    }
+
+    // Takes over at the first tick at or past the next beat or bar of the
+    // transport, or right away while none runs. A snapshot published before
+    // then replaces it.
+    void switchSettings(const Settings& newSettings, SwitchPoint at, bool resetPhases) noexcept
+    {
+        published.settings = newSettings;
+        published.switchPoint = at;
+        published.resetPhases = resetPhases;
+        pendingSettings.write(published);
+        requestTick();
+
+        published.switchPoint = SwitchPoint::now;
+        published.resetPhases = false;
+    }
+
+    // Start/stop from the UI: both reset the phases on the next tick
+    void startLfo() noexcept
+    {
+        phaseResetRequested.store(true, std::memory_order_relaxed);
+        lfoActive.store(true, std::memory_order_release);
+        requestTick();
+    }
+
+    void stopLfo() noexcept
+    {
+        phaseResetRequested.store(true, std::memory_order_relaxed);
+        lfoActive.store(false, std::memory_order_release);
+        requestTick();
+    }
+
+    bool isLfoActive() const noexcept   { return lfoActive.load(std::memory_order_relaxed); }
+
+    // Clock master transport, sent just before the next clock pulse; the
+    // LFOs start and stop with it
+    void postClockTransport(ClockTransport transport) noexcept
+    {
+        clockTransportRequest.store((int) transport, std::memory_order_release);
+        requestTick();
+    }
+
+    // Song position for the next Continue, in sixteenths (while stopped)
+    void postSongPosition(int sixteenths) noexcept
+    {
+        songPositionRequest.store(juce::jmax(0, sixteenths), std::memory_order_release);
+        requestTick();
+    }
+
+    // Swaps an output port without waiting for the engine. The previous
+    // port may still be in use by a tick in flight: keep it alive until
+    // isRetired() returns true for the token returned here.
+    juce::uint64 setOutput(MidiOutputPort* newOutput, int index = 0) noexcept
+    {
+        jassert (juce::isPositiveAndBelow(index, maxOutputs));
+        outputs[(size_t) index].store(newOutput);
+        requestTick();
+
+        return getRetirementToken();
+    }
+
+    // Clip looped along the transport, nullptr for none; the previous one
+    // is retired like an output port
+    juce::uint64 setAutomationClip(const AutomationClip* clip) noexcept
+    {
+        automationClip.store(clip);
+        requestTick();
+
+        return getRetirementToken();
+    }
+
+    // nullptr for none; the previous one is retired like an output port
+    juce::uint64 setControlSource(ControlSource* source) noexcept
+    {
+        controlSource.store(source);
+        return getRetirementToken();
+    }
+
+    bool isRetired(juce::uint64 token) const noexcept
+    {
+        return ticksCompleted.load(std::memory_order_acquire) >= token;
+    }
+
+    AutomationRecorder& getAutomationRecorder() noexcept   { return recorder; }
+    const AutomationRecorder& getAutomationRecorder() const noexcept   { return recorder; }
+
+    // Transport position of the last tick, in AutomationClip ticks; -1 while
+    // no transport runs
+    juce::int64 getTransportTick() const noexcept   { return publishedTransportTick.load(std::memory_order_relaxed); }
+
+    // The output reaches a different device without the port changing
+    // (JACK reconnect): values it holds are unknown again
+    void invalidateDeviceShadow(int index = 0) noexcept
+    {
+        shadows[(size_t) index].invalidate();
+        requestTick();
+    }
+
+    // Set before the first tick (nullptr: ticked regardless, e.g. by JACK or a host)
+    void setWakeUp(WakeUp* w) noexcept   { wakeUp.store(w); }
+
+    // Something for the next tick to pick up; wakes a sleeping engine thread
+    void requestTick() noexcept
+    {
+        tickRequested.store(true);
+
+        if (auto* w = wakeUp.load())
+            w->wake();
+    }
+
+    // Division multiplier relative to 1 beat = quarter note (LFO cycles per beat)
+    static double cyclesPerBeat(int divisionId) noexcept
+    {
+        switch (divisionId)
+        {
+            case 1: return 0.25;       // whole note (4 beats per cycle)
+            case 2: return 0.5;        // half note
+            case 3: return 1.0;        // quarter note
+            case 4: return 2.0;        // eighth
+            case 5: return 4.0;        // sixteenth
+            case 6: return 8.0;        // thirty-second
+            case 7: return 2.0 / 1.5;  // dotted ⅛ (triplet-based)
+            case 8: return 4.0 / 1.5;  // dotted 1/16
+            default: return 1.0;
+        }
+    }
+
+    // BPM → Frequency Conversion
+    static double bpmToHz(double bpm, int divisionId) noexcept
+    {
+        if (bpm <= 0.0)
+            return 0.0;
+
+        // base beat frequency = beats per second
+        const double beatsPerSecond = bpm / 60.0;
+
+        // final LFO frequency in Hz
+        return beatsPerSecond * cyclesPerBeat(divisionId);
+    }
+
+    #if JUCE_DEBUG
+    // nullptr for none; the previous one is retired like an output port
+    juce::uint64 setMonitor(MidiMonitorSink* w) noexcept
+    {
+        monitor.store(w, std::memory_order_release);
+        return getRetirementToken();
+    }
+
+    // Last Note-On that restarted the LFO, packed as (channel << 8) | note, or -1
+    int takeRestartNote() noexcept                    { return restartNoteDebug.exchange(-1, std::memory_order_relaxed); }
+    #endif
+
+    // ==========================================
+    // MIDI input threads
+    // ==========================================
+    void postNoteOn(int channel, int note, float velocity) noexcept
+    {
+        pendingNoteChannel.store(channel, std::memory_order_relaxed);
+        pendingNoteNumber.store(note, std::memory_order_relaxed);
+        pendingNoteVelocity.store(velocity, std::memory_order_relaxed);
+
+        // a Note-On not yet consumed by the tick gets overwritten
+        if (pendingNoteOn.exchange(true, std::memory_order_release))
+            telemetry.inputDropped();
+
+        requestTick();
+    }
+
+    // Last value per controller number, for ModulationMatrix::Source::inputCc.
+    // source: the merged input source it came from, whose thread is the only
+    // one posting for it. Only the first source (the device input) seeds
+    // the first output's device shadow, when enabled: a keyboard's CCs say
+    // nothing about what the Syntakt holds, and the shadow follows a single
+    // input's NRPN sequence.
+    void postControlChange(int channel, int controller, int value, int source = 0) noexcept
+    {
+        if (juce::isPositiveAndBelow(controller, 128))
+            inputCcValues[(size_t) controller].store(value, std::memory_order_relaxed);
+
+        // decoded and recorded by the tick, one queue per source
+        if (recorder.isArmed() && juce::isPositiveAndBelow(source, maxInputSources))
+        {
+            auto& lane = inputControlLanes[(size_t) source];
+            const auto scope = lane.fifo.write(1);
+
+            if (scope.blockSize1 + scope.blockSize2 > 0)
+                lane.controls[(size_t) (scope.blockSize1 > 0 ? scope.startIndex1 : scope.startIndex2)] = { channel, controller, value };
+        }
+
+        if (source == 0)
+            shadows[0].seedFromInput(channel, controller, value);
+
+        requestTick();
+    }
+
+    void postNoteOff(int channel) noexcept
+    {
+        pendingNoteChannel.store(channel, std::memory_order_relaxed);
+        pendingNoteOff.store(true, std::memory_order_release);
+        requestTick();
+    }
+
+    void postLfoStop() noexcept
+    {
+        requestLfoStop.store(true, std::memory_order_release);
+        requestTick();
+    }
+
+    void postTransportStart() noexcept
+    {
+        inputClockPulses.store(0, std::memory_order_relaxed);
+        inputTransportRunning.store(true, std::memory_order_release);
+        requestTransportStart.store(true, std::memory_order_release);
+        requestTick();
+    }
+
+    void postTransportStop() noexcept
+    {
+        inputTransportRunning.store(false, std::memory_order_release);
+        requestTransportStop.store(true, std::memory_order_release);
+        requestTick();
+    }
+
+    // The incoming clock's position goes on from where it stopped
+    void postTransportContinue() noexcept
+    {
+        inputTransportRunning.store(true, std::memory_order_release);
+        requestTick();
+    }
+
+    // Every incoming clock pulse (timeMs: when it arrived); counted while
+    // the transport runs, since Start
+    void postClockPulse(double timeMs) noexcept
+    {
+        if (!inputTransportRunning.load(std::memory_order_acquire))
+            return;
+
+        inputClockLastMs.store(timeMs, std::memory_order_relaxed);
+        inputClockPulses.fetch_add(1, std::memory_order_release);
+    }
+
+    // ==========================================
+    // Engine thread
+    // ==========================================
+    // Host transport position of the next tick, in quarter notes (plugin
+    // build, host playing). Synced LFOs then take their phase from it
+    // instead of accumulating it, so they stay locked to the host's grid.
+    // Applies to one tick only.
+    void setNextTickPosition(double ppq) noexcept
+    {
+        nextTickPpq = ppq;
+        hasNextTickPpq = true;
+    }
+
+    // nowMs: when this tick's output takes effect, on the
+    // Time::getMillisecondCounterHiRes() timebase. EngineThread passes the
+    // current time; the JACK backend passes the time of the tick's frame.
+    void tick(double nowMs)
+    {
+        // requests from here on are for the next tick
+        tickRequested.store(false);
+
+        const double startMs = telemetry.tickBegin();
+        const juce::ScopeGuard tickEnd { [&] { telemetry.tickEnd(startMs); } };
+        tickTimeMs = nowMs;
+        const EngineTrace::Scope trace("engine tick");
+        const RealtimeGuard::Scope realtime;
+
+        insideTick.store(true);
+        const juce::ScopeGuard leaveTick { [this]
+        {
+            ticksCompleted.fetch_add(1, std::memory_order_release);
+            insideTick.store(false, std::memory_order_release);
+        } };
+
+        // a switch waits for its boundary (see applyPendingSwitch())
+        if (pendingSettings.read(received))
+        {
+            switchPending = received.switchPoint != SwitchPoint::now;
+            switchTick = -1;
+
+            if (!switchPending)
+                applyUpdate(received);
+        }
+
+        takeControl();
+
+        // measured on the tick that applies the batch only
+        const juce::ScopeGuard controlDone { [this] { controlIssuedMs = 0.0; } };
+
+        bool anyOutput = false;
+
+        for (size_t i = 0; i < (size_t) maxOutputs; ++i)
+        {
+            currentOutputs[i] = outputs[i].load();
+
+            // a new port may lead anywhere
+            if (currentOutputs[i] != shadowOutputs[i])
+            {
+                shadows[i].clear();
+                shadowOutputs[i] = currentOutputs[i];
+            }
+
+            shadows[i].applyInvalidation();
+            anyOutput = anyOutput || currentOutputs[i] != nullptr;
+        }
+
+        anyOutputOpen = anyOutput;
+
+        // the clock master keeps counting while no output is open
+        if (!anyOutput && !settings.clockMaster)
+            return;
+
+        // whole tick goes out together on batching ports; after a drop the
+        // device's state is unknown
+        const juce::ScopeGuard flushOutputs { [this]
+        {
+            for (size_t i = 0; i < (size_t) maxOutputs; ++i)
+            {
+                if (currentOutputs[i] == nullptr)
+                    continue;
+
+                const int dropped = currentOutputs[i]->flush();
+                telemetry.outputDropped(dropped);
+
+                if (dropped > 0)
+                    shadows[i].clear();
+            }
+        } };
+
+        matrix.beginTick();
+        bool velocityChanged = false;
+
+        // Note messages
+        if (pendingNoteOn.exchange(false))
+        {
+            const int ch   = pendingNoteChannel.load();
+            const int note = pendingNoteNumber.load();
+            const float velocity = pendingNoteVelocity.load();
+
+            velocityChanged = velocity != lastVelocity;
+            lastVelocity = velocity;
+
+            // --- EG ---
+            if (eg.isEnabled())
+                eg.noteOn(ch, note, velocity, nowMs);
+
+            // --- LFO Note Restart ---
+            if (settings.noteRestartEnabled
+                && settings.noteRestartChannel > 0
+                && ch == settings.noteRestartChannel)
+            {
+                resetLfoPhases();
+                lfoActive.store(true, std::memory_order_relaxed);
+
+                #if JUCE_DEBUG
+                restartNoteDebug.store((ch << 8) | note, std::memory_order_relaxed);
+                #endif
+            }
+        }
+
+        // EG trig
+        if (pendingNoteOff.exchange(false))
+        {
+            if (eg.isEnabled())
+                eg.noteOff(pendingNoteChannel.load(), nowMs);
+        }
+
+        // Stop LFO on Note-Off
+        if (requestLfoStop.exchange(false))
+        {
+            lfoActive.store(false, std::memory_order_relaxed);
+
+            // reset phases for next start
+            for (auto& state : routeStates)
+            {
+                state.hasFinishedOneShot = false;
+                state.passedPeak = false;
+            }
+        }
+
+        // MIDI transport: Start restarts the LFO from its start phase, Stop halts it
+        if (requestTransportStart.exchange(false))
+        {
+            resetLfoPhases();
+            lfoActive.store(true, std::memory_order_relaxed);
+        }
+
+        if (requestTransportStop.exchange(false))
+        {
+            resetLfoPhases();
+            lfoActive.store(false, std::memory_order_relaxed);
+        }
+
+        if (settings.clockMaster)
+            tickClock(nowMs);
+        else if (std::exchange(clockEnabled, false))
+            clock.finish([this](juce::uint32 word, double dueMs) { sendClockMessage(word, dueMs); });
+
+        // Start/stop from the UI
+        const bool active = lfoActive.load(std::memory_order_acquire);
+
+        if (phaseResetRequested.exchange(false, std::memory_order_acq_rel))
+            resetLfoPhases();
+
+        // a running clock master is followed like a host's transport
+        if (clockEnabled && clock.isRunning())
+            setNextTickPosition(clock.getPositionAt(nowMs));
+
+        updateTransportTick(nowMs);
+        applyPendingSwitch();
+        recordInputControls();
+
+        const bool hostLocked = std::exchange(hasNextTickPpq, false) && isSynced();
+
+        if (active)
+            tickLfo(nowMs, hostLocked);
+
+        if (eg.isEnabled())
+            tickEg(nowMs);
+
+        addConnectionSources(velocityChanged);
+        sendDestinations();
+        playAutomation();
+
+        if (probes.isAttached(EngineProbes::Id::bpm))
+            probes.push(EngineProbes::Id::bpm, nowMs, (float) getCurrentBpm());
+    }
+
+    // Engine thread, after a tick: true if the next one would emit nothing
+    // and no request is waiting. Stays true until requestTick().
+    bool isIdle() const noexcept
+    {
+        if (tickRequested.load())
+            return false;
+
+        // the clock runs for as long as the mode is on
+        if (settings.clockMaster)
+            return false;
+
+        // a tick without outputs does nothing (setOutput() requests a tick)
+        if (!anyOutputOpen)
+            return true;
+
+        // automation and switches follow the transport, wherever it comes from
+        if (automationClip.load() != nullptr || recorder.isArmed() || switchPending)
+            return false;
+
+        if (eg.isMoving())
+            return false;
+
+        if (!lfoActive.load(std::memory_order_acquire))
+            return true;
+
+        // a running LFO whose routes are all off or done with their one shot
+        for (int i = 0; i < maxRoutes; ++i)
+        {
+            const auto& route = settings.routes[(size_t) i];
+
+            if (route.midiChannel > 0 && !(route.oneShot && routeStates[(size_t) i].hasFinishedOneShot))
+                return false;
+        }
+
+        return true;
+    }
+
+    // Touches the engine's state once so the first ticks after a
+    // (re)start don't fault pages in; called from EngineThread::run().
+    void prefault() noexcept
+    {
+        const auto* bytes = reinterpret_cast<const volatile char*>(this);
+
+        for (size_t i = 0; i < sizeof(*this); i += 64)
+            juce::ignoreUnused(bytes[i]);
+    }
+
+    // per-tick taps for the scope and other visualizers
+    EngineProbes::Set probes;
+
+private:
+    // A settings snapshot as published
+    struct Update
+    {
+        Settings settings;
+        SwitchPoint switchPoint = SwitchPoint::now;
+        bool resetPhases = false;
+    };
+
+    struct RouteState
+    {
+        double phase = 0.0;
+        bool passedPeak = false;          // used when unipolar + oneshot
+        bool hasFinishedOneShot = false;
+    };
+
+    void applyUpdate(const Update& update) noexcept
+    {
+        const auto previousRoutes = settings.routes;
+
+        settings = update.settings;
+        settingsChanged(previousRoutes);
+
+        if (update.resetPhases)
+            resetLfoPhases();
+    }
+
+    // Batches that arrived since the last tick, on top of what runs
+    void takeControl() noexcept
+    {
+        auto* source = controlSource.load();
+
+        if (source == nullptr)
+            return;
+
+        auto edited = settings;
+        auto lfoRequest = LfoRequest::none;
+        int songPosition = -1;
+        double issuedMs = 0.0;
+        bool anyBatch = false;
+
+        // the first batch's arrival: the round trip of the earliest one
+        for (double batchMs = 0.0; source->takeControl(edited, lfoRequest, songPosition, batchMs);)
+        {
+            if (!anyBatch)
+                issuedMs = batchMs;
+
+            anyBatch = true;
+        }
+
+        if (!anyBatch)
+            return;
+
+        // ahead of the Continue the same tick sends
+        if (songPosition >= 0)
+            songPositionRequest.store(songPosition, std::memory_order_release);
+
+        const auto previousRoutes = settings.routes;
+
+        settings = edited;
+        settingsChanged(previousRoutes);
+        controlIssuedMs = issuedMs;
+
+        if (lfoRequest != LfoRequest::none)
+            applyLfoRequest(lfoRequest);
+    }
+
+    // The boundary is fixed by the first tick that sees the switch; a
+    // transport that stops (or never ran) lets it through
+    void applyPendingSwitch() noexcept
+    {
+        if (!switchPending)
+            return;
+
+        if (transportTick >= 0 && switchTick < 0)
+        {
+            const juce::int64 step = received.switchPoint == SwitchPoint::bar ? AutomationClip::ticksPerBar
+                                                                              : AutomationClip::ticksPerQuarter;
+            switchTick = (transportTick + step - 1) / step * step;
+        }
+
+        if (transportTick >= 0 && transportTick < switchTick)
+            return;
+
+        switchPending = false;
+        applyUpdate(received);
+        EngineTrace::instant("settings switch", (int) received.switchPoint);
+    }
+
+    void settingsChanged(const std::array<Route, maxRoutes>& previousRoutes) noexcept
+    {
+        eg.setSettings(settings.eg);
+        shadows[0].setSeedingEnabled(settings.seedShadowFromInput);
+
+        for (int i = 0; i < maxRoutes; ++i)
+            if (!settings.routes[(size_t) i].oneShot)
+                routeStates[(size_t) i].hasFinishedOneShot = false;
+
+        joinNewRoutes(previousRoutes);
+    }
+
+    static bool isRouteOn(const Route& route) noexcept
+    {
+        return route.midiChannel > 0 && route.parameterIndex >= 0
+            && juce::isPositiveAndBelow(route.output, maxOutputs);
+    }
+
+    // A route switched on takes up the cycle where the running ones are,
+    // instead of all of them restarting; with none running it starts from
+    // its start phase
+    void joinNewRoutes(const std::array<Route, maxRoutes>& previousRoutes) noexcept
+    {
+        int reference = -1;
+
+        for (int i = 0; i < maxRoutes && reference < 0; ++i)
+            if (isRouteOn(previousRoutes[(size_t) i]) && isRouteOn(settings.routes[(size_t) i]))
+                reference = i;
+
+        double cycle = 0.0;
+
+        if (reference >= 0)
+        {
+            const auto& route = settings.routes[(size_t) reference];
+            cycle = routeStates[(size_t) reference].phase
+                  - getWaveformStartPhase(settings.shapeId, route.bipolar, route.invertPhase);
+        }
+
+        for (int i = 0; i < maxRoutes; ++i)
+        {
+            const auto& route = settings.routes[(size_t) i];
+
+            if (isRouteOn(previousRoutes[(size_t) i]) || !isRouteOn(route))
+                continue;
+
+            auto& state = routeStates[(size_t) i];
+            const double phase = getWaveformStartPhase(settings.shapeId, route.bipolar, route.invertPhase) + cycle;
+
+            state.phase = phase - std::floor(phase);
+            state.passedPeak = false;
+            state.hasFinishedOneShot = false;
+        }
+    }
+
+    bool isSynced() const noexcept   { return settings.syncEnabled || settings.clockMaster; }
+
+    // the clock master's tempo, or the one followed
+    double getCurrentBpm() const   { return clockEnabled ? clock.getBpm() : getTempoBpm(); }
+
+    void applyLfoRequest(LfoRequest request) noexcept
+    {
+        if (settings.clockMaster)
+        {
+            const auto transport = request == LfoRequest::start ? ClockTransport::start
+                                 : request == LfoRequest::stop  ? ClockTransport::stop
+                                                                : ClockTransport::continuePlayback;
+
+            clockTransportRequest.store((int) transport, std::memory_order_relaxed);
+            return;
+        }
+
+        if (request != LfoRequest::resume)
+            resetLfoPhases();
+
+        lfoActive.store(request != LfoRequest::stop, std::memory_order_relaxed);
+    }
+
+    // Plans the clock up to past the next tick; the LFOs follow the
+    // transport changes planned on the way
+    void tickClock(double nowMs)
+    {
+        constexpr double horizonMs = 1000.0 / tickRateHz + clockLeadMs;
+
+        if (!std::exchange(clockEnabled, true))
+            clock.reset(nowMs + clockLeadMs, settings.masterBpm);
+
+        clock.setTempo(settings.masterBpm);
+
+        if (const int transport = clockTransportRequest.exchange(0, std::memory_order_acquire))
+            clock.requestTransport((ClockTransport) transport);
+
+        const int songPosition = songPositionRequest.exchange(-1, std::memory_order_acquire);
+
+        if (songPosition >= 0)
+            clock.locate(songPosition);
+
+        const auto applied = clock.plan(nowMs + horizonMs, [this](juce::uint32 word, double dueMs)
+        {
+            sendClockMessage(word, dueMs);
+        });
+
+        switch (applied)
+        {
+            case ClockTransport::start:
+                resetLfoPhases();
+                lfoActive.store(true, std::memory_order_relaxed);
+                break;
+
+            case ClockTransport::continuePlayback:
+                lfoActive.store(true, std::memory_order_relaxed);
+                break;
+
+            case ClockTransport::stop:
+                resetLfoPhases();
+                lfoActive.store(false, std::memory_order_relaxed);
+                break;
+
+            case ClockTransport::none:
+                break;
+        }
+    }
+
+    void sendClockMessage(juce::uint32 word, double dueMs) noexcept
+    {
+        for (auto* port : currentOutputs)
+            if (port != nullptr)
+                port->sendScheduled(juce::ump::View(&word), dueMs);
+    }
+
+    juce::uint64 getRetirementToken() const noexcept
+    {
+        // a tick that started before the store ends by bumping ticksCompleted
+        if (!insideTick.load())
+            return 0;
+
+        return ticksCompleted.load() + 1;
+    }
+
+    // The host's or clock master's position, or the pulses of the incoming
+    // clock since Start; -1 while none is running
+    void updateTransportTick(double nowMs) noexcept
+    {
+        double quarters = -1.0;
+
+        if (hasNextTickPpq)
+        {
+            quarters = nextTickPpq;
+        }
+        else if (settings.syncEnabled && inputTransportRunning.load(std::memory_order_acquire))
+        {
+            const int pulses = inputClockPulses.load(std::memory_order_acquire);
+            const double bpm = getTempoBpm();
+
+            // between two pulses: as far as the tempo says, up to the next one
+            const double fraction = pulses > 0 && bpm > 0.0
+                ? juce::jlimit(0.0, 1.0, (nowMs - inputClockLastMs.load(std::memory_order_relaxed)) * bpm
+                                           * MidiClockGenerator::pulsesPerQuarter / 60000.0)
+                : 0.0;
+
+            quarters = (juce::jmax(0, pulses - 1) + fraction) / MidiClockGenerator::pulsesPerQuarter;
+        }
+
+        transportTick = quarters >= 0.0 ? (juce::int64) (quarters * AutomationClip::ticksPerQuarter) : -1;
+        publishedTransportTick.store(transportTick, std::memory_order_relaxed);
+    }
+
+    // Incoming controllers, as the parameter values they carry (the input is
+    // taken to be the device on the first output); each source keeps its
+    // own NRPN state
+    void recordInputControls() noexcept
+    {
+        for (auto& lane : inputControlLanes)
+        {
+            const int numReady = lane.fifo.getNumReady();
+
+            if (numReady == 0)
+                continue;
+
+            lane.fifo.read(numReady).forEach([this, &lane](int index)
+            {
+                const auto& control = lane.controls[(size_t) index];
+
+                lane.decoder.decode(control.channel, control.controller, control.value, [&](int parameterIndex, int value)
+                {
+                    if (transportTick >= 0 && recorder.isArmed())
+                        recorder.record({ 0, control.channel, parameterIndex }, transportTick, value);
+                });
+            });
+        }
+    }
+
+    // One comparison per lane; a lane only sends when its value changes
+    void playAutomation()
+    {
+        const auto* clip = automationClip.load();
+
+        if (clip != playingClip)
+        {
+            playingClip = clip;
+            automationCursors.fill({});
+            automationSeekNeeded = true;
+        }
+
+        if (clip == nullptr || transportTick < 0)
+            return;
+
+        const EngineTrace::Scope trace("automation");
+        const auto loopTick = clip->toLoopTick(transportTick);
+        const int numLanes = juce::jmin(clip->getNumLanes(), AutomationClip::maxLanes);
+
+        // started over, or wrapped around
+        if (std::exchange(automationSeekNeeded, false) || loopTick < lastLoopTick)
+            for (int i = 0; i < numLanes; ++i)
+                clip->rewind(i, automationCursors[(size_t) i]);
+
+        lastLoopTick = loopTick;
+
+        for (int i = 0; i < numLanes; ++i)
+        {
+            auto& cursor = automationCursors[(size_t) i];
+
+            if (!clip->advance(i, cursor, loopTick))
+                continue;
+
+            const auto& destination = clip->getLane(i).destination;
+
+            if (!juce::isPositiveAndBelow(destination.output, maxOutputs))
+                continue;
+
+            const auto& param = syntaktParameters[destination.parameterIndex];
+            sendThrottledParamValue(destination.output, destination.midiChannel, param,
+                                    juce::jlimit(param.minValue, param.maxValue, cursor.value));
+        }
+    }
+
+    void tickLfo(double nowMs, bool hostLocked)
+    {
+        // Compute current rate
+        double rateHz = settings.rateHz;
+        const double bpm = getCurrentBpm();
+
+        if (isSynced() && bpm > 0.0)
+            rateHz = bpmToHz(bpm, settings.divisionId);
+
+        // Generate and send LFO values
+        const double phaseInc = rateHz / tickRateHz;
+        const auto shapeId = static_cast<LfoShape>(settings.shapeId);
+        const double depth = settings.depth;
+
+        for (int i = 0; i < maxRoutes; ++i)
+        {
+            const auto& route = settings.routes[(size_t) i];
+            auto& state = routeStates[(size_t) i];
+
+            if (!isRouteOn(route))
+                continue;
+
+            if (route.oneShot && state.hasFinishedOneShot)
+                continue;
+
+            const EngineTrace::Scope routeTrace("route value", i);
+
+            const bool wrapped = hostLocked
+                ? lockPhase(state.phase, getWaveformStartPhase(settings.shapeId, route.bipolar, route.invertPhase)
+                                         + nextTickPpq * cyclesPerBeat(settings.divisionId))
+                : advancePhase(state.phase, phaseInc);
+
+            double shape = computeWaveform(shapeId,
+                                           state.phase,
+                                           route.bipolar,
+                                           route.invertPhase);
+
+            // One-shot logic
+            if (route.oneShot)
+            {
+                if (route.bipolar)
+                {
+                    if (wrapped)
+                        state.hasFinishedOneShot = true;
+                }
+                else
+                {
+                    if (!state.passedPeak && shape >= 0.999)
+                        state.passedPeak = true;
+
+                    if (state.passedPeak && shape <= -0.999)
+                        state.hasFinishedOneShot = true;
+                }
+            }
+
+            // Mapping: around the centre, or up from the minimum
+            const double signal = route.bipolar ? shape
+                                                : juce::jlimit(0.0, 1.0, (shape + 1.0) * 0.5);
+
+            matrix.add(route.output, route.midiChannel, route.parameterIndex, signal * depth * route.amount, route.bipolar, true);
+
+            // Oscilloscope
+            probes.push(EngineProbes::routeProbe(i), nowMs, (float) (shape * depth));
+        }
+    }
+
+    void tickEg(double nowMs)
+    {
+        double egMIDIvalue = 0.0;
+
+        const EngineTrace::Scope egTrace("eg value");
+
+        if (!eg.tick(nowMs, egMIDIvalue))
+            return;
+
+        probes.push(EngineProbes::Id::eg, nowMs, (float) egMIDIvalue);
+
+        const int paramId = settings.eg.outParamIndex;
+        const int egCh    = settings.eg.outChannel;
+
+        if (egCh > 0 && paramId >= 0)
+        {
+            // bipolar parameters: centred mapping
+            const bool bipolar = syntaktParameters[paramId].isBipolar;
+            const double signal = bipolar ? egMIDIvalue * 2.0 - 1.0 : egMIDIvalue;
+
+            matrix.add(0, egCh, paramId, signal * settings.egAmount, bipolar, true);
+        }
+    }
+
+    // Velocity and incoming CC connections: resent only when they move,
+    // unless something else drives the same destination
+    void addConnectionSources(bool velocityChanged) noexcept
+    {
+        for (size_t i = 0; i < settings.connections.size(); ++i)
+        {
+            const auto& c = settings.connections[i];
+
+            if (c.source == ModulationMatrix::Source::velocity)
+            {
+                matrix.add(0, c.midiChannel, c.parameterIndex, lastVelocity * c.amount, false, velocityChanged);
+            }
+            else if (c.source == ModulationMatrix::Source::inputCc && juce::isPositiveAndBelow(c.ccNumber, 128))
+            {
+                const int value = inputCcValues[(size_t) c.ccNumber].load(std::memory_order_relaxed);
+
+                if (value < 0)
+                    continue;   // nothing received yet
+
+                matrix.add(0, c.midiChannel, c.parameterIndex, value / 127.0 * c.amount, false,
+                           std::exchange(lastConnectionInput[i], value) != value);
+            }
+        }
+    }
+
+    void sendDestinations()
+    {
+        constexpr double tickMs = 1000.0 / tickRateHz;
+        constexpr double maxIntervalMs = 500.0;
+        const double errorBound = settings.errorBoundSteps;
+        double plannedHz = 0.0;
+
+        matrix.resolve([&](const ModulationMatrix::Destination& d, int midiValue, double exactValue)
+        {
+            if (d.numSources > 1)
+                telemetry.contributionsMerged(d.numSources - 1);
+
+            const auto& param = syntaktParameters[d.parameterIndex];
+            auto& state = destinationStates[(size_t) d.output][(size_t) (d.midiChannel - 1)][(size_t) d.parameterIndex];
+            const int deviceValue = shadows[(size_t) d.output].get(d.midiChannel, (size_t) d.parameterIndex);
+
+            // Coarse threshold: the quantizer picks what goes out and when
+            if (settings.changeThreshold >= 2)
+            {
+                const int quantized = state.quantizer.process(exactValue, tickTimeMs, settings.changeThreshold,
+                                                              param.minValue, param.maxValue);
+
+                if (quantized != ErrorDiffusionQuantizer::nothing)
+                    sendThrottledParamValue(d.output, d.midiChannel, param, quantized);
+                else if (deviceValue == DeviceShadow::unknown)
+                    sendThrottledParamValue(d.output, d.midiChannel, param, midiValue);
+                else
+                    telemetry.suppressedByThreshold();
+
+                plannedHz += tickRateHz / state.quantizer.holdLength;
+                return;
+            }
+
+            plannedHz += 1000.0 / state.schedule.evaluate(exactValue, tickTimeMs, errorBound, tickMs, maxIntervalMs);
+
+            if (!state.schedule.isDue(exactValue, deviceValue, tickTimeMs, errorBound))
+            {
+                telemetry.deferredBySchedule();
+                return;
+            }
+
+            if (sendThrottledParamValue(d.output, d.midiChannel, param, midiValue))
+                state.schedule.sent(tickTimeMs);
+        });
+
+        telemetry.updateBudget(plannedHz, matrix.getNumDestinations() * tickRateHz);
+    }
+
+    void resetLfoPhases() noexcept
+    {
+        for (int i = 0; i < maxRoutes; ++i)
+        {
+            const auto& route = settings.routes[(size_t) i];
+            auto& state = routeStates[(size_t) i];
+
+            state.phase = getWaveformStartPhase(settings.shapeId, route.bipolar, route.invertPhase);
+            state.hasFinishedOneShot = false;
+            state.passedPeak = false;
+        }
+    }
+
+    static bool advancePhase(double& phase, double phaseInc) noexcept
+    {
+        phase += phaseInc;
+        if (phase >= 1.0)
+        {
+            phase -= 1.0;
+            return true;
+        }
+        return false;
+    }
+
+    // Jumps to the phase the host position implies
+    static bool lockPhase(double& phase, double target) noexcept
+    {
+        const double newPhase = target - std::floor(target);
+        const bool wrapped = newPhase < phase;
+        phase = newPhase;
+        return wrapped;
+    }
+
+    // waveforms
+    static double lfoSine(double phase)
+    {
+        return std::sin(juce::MathConstants<double>::twoPi * phase);
+    }
+
+    static double lfoTriangle(double phase)
+    {
+        // canonical triangle: 0 → +1 → 0 → -1 → 0
+        double t = phase - std::floor(phase);
+        return 4.0 * std::abs(t - 0.5) - 1.0;
+    }
+
+    static double lfoSquare(double phase)
+    {
+        return (phase < 0.5) ? 1.0 : -1.0;
+    }
+
+    static double lfoSaw(double phase)
+    {
+        return 2.0 * phase - 1.0;
+    }
+
+    double lfoRandom(double phase)
+    {
+        // detect phase wrap
+        if (phase < randomLastPhase)
+        {
+            randomLastValue = random.nextDouble() * 2.0 - 1.0;
+        }
+
+        randomLastPhase = phase;
+        return randomLastValue;
+    }
+
+    double computeWaveform(LfoShape shape,
+                           double phase,
+                           bool bipolar,
+                           bool invertPhase)
+    {
+        // true phase inversion (180°)
+        if (invertPhase && shape != LfoShape::Saw)
+        {
+            phase += 0.5;
+            if (phase >= 1.0)
+                phase -= 1.0;
+        }
+
+        if (invertPhase && (shape == LfoShape::Saw))
+        {
+            phase = -phase;
+            if (phase <= 1.0)
+                phase += 1.0;
+        }
+
+        // phase alignment per shape
+        if (shape == LfoShape::Triangle && !bipolar)
+        {
+            phase += 0.25;
+            if (phase >= 1.0)
+                phase -= 1.0;
+        }
+
+        if (shape == LfoShape::Triangle && bipolar)
+        {
+            phase -= 0.25;
+            if (phase >= 1.0)
+                phase -= 1.0;
+        }
+
+        if (shape == LfoShape::Saw && bipolar)
+        {
+            phase += 0.5;
+            if (phase >= 1.0)
+                phase -= 1.0;
+        }
+
+        switch (shape)
+        {
+            case LfoShape::Sine:     return lfoSine(phase);
+            case LfoShape::Triangle: return lfoTriangle(phase);
+            case LfoShape::Square:   return lfoSquare(phase);
+            case LfoShape::Saw:      return lfoSaw(phase);
+            case LfoShape::Random:   return lfoRandom(phase);
+            default:                 return 0.0;
+        }
+    }
+
+    // ensure that LFO Waveforms start from correct offset (bipolar/unipolar)
+    static double getWaveformStartPhase(int shapeId, bool bipolar, bool invert) noexcept
+    {
+        juce::ignoreUnused(invert);
+        double phase = 0.0;
+
+        if (!bipolar)
+        {
+            switch (static_cast<LfoShape>(shapeId))
+            {
+                case LfoShape::Sine:     phase = 0.75; break; // -1
+                case LfoShape::Triangle: phase = 0.25; break; // -1 ✅ FIX
+                case LfoShape::Square:   phase = 0.5;  break; // -1
+                case LfoShape::Saw:      phase = 0.0;  break; // -1
+                default: break;
+            }
+        }
+
+        return phase;
+    }
+
+    // throttling and MIDI send, once per destination and tick; true if sent
+    bool sendThrottledParamValue(int outputIndex,
+                                 int midiChannel,
+                                 const SyntaktParameter& param,
+                                 int midiValue)
+    {
+        const auto paramIndex = (size_t) (&param - syntaktParameters);
+        jassert (juce::isPositiveAndBelow(midiChannel - 1, 16) && paramIndex < numSyntaktParameters);
+
+        auto* port = currentOutputs[(size_t) outputIndex];
+        auto& shadow = shadows[(size_t) outputIndex];
+
+        // route to an output that isn't open
+        if (port == nullptr)
+            return false;
+
+        auto& lastTime = destinationStates[(size_t) outputIndex][(size_t) (midiChannel - 1)][paramIndex].lastSendTime;
+        const int deviceValue = shadow.get(midiChannel, paramIndex);
+
+        // Already on the device
+        if (deviceValue == midiValue)
+        {
+            telemetry.suppressedByShadow();
+            return false;
+        }
+
+        // Time-based anti-flood
+        const double now = tickTimeMs;
+        if (now - lastTime < settings.msFloofThreshold)
+        {
+            telemetry.suppressedByRateLimit();
+            return false;
+        }
+
+        lastTime = now;
+
+        // Split value if NRPN
+        const int valueMSB = (midiValue >> 7) & 0x7F;
+        const int valueLSB = midiValue & 0x7F;
+
+        // false if the port refused the message
+        auto send = [&](int cc, int val)
+        {
+            const auto packet = juce::ump::Factory::makeControlChangeV1(0, (juce::uint8) (midiChannel - 1),
+                                                                        (juce::uint8) cc, (juce::uint8) val);
+            int wireBytes = 0;
+            {
+                const EngineTrace::Scope sendTrace("alsa send", cc);
+                wireBytes = port->send(juce::ump::View(packet.data()));
+            }
+            telemetry.messageSent(outputIndex, midiChannel, wireBytes);
+
+            if (controlIssuedMs > 0.0)
+            {
+                telemetry.controlRoundTrip((juce::Time::getMillisecondCounterHiRes() - controlIssuedMs) * 1000.0);
+                controlIssuedMs = 0.0;
+            }
+
+            #if JUCE_DEBUG
+            if (auto* m = monitor.load(std::memory_order_acquire))
+                m->pushEvent(juce::MidiMessage::controllerEvent(midiChannel, cc, val), false);
+            #endif
+
+            return wireBytes > 0;
+        };
+
+        bool sent = false;
+
+        if (param.isCC)
+        {
+            sent = send(param.ccNumber, midiValue);
+        }
+        else
+        {
+            const EngineTrace::Scope flushTrace("nrpn flush", midiValue);
+
+            // all four, even after a refusal: a partial NRPN is worse than a repeated one
+            sent = send(99, param.nrpnMsb);
+            sent = send(98, param.nrpnLsb) && sent;
+            sent = send(6,  valueMSB) && sent;
+            sent = send(38, valueLSB) && sent;
+        }
+
+        shadow.set(midiChannel, paramIndex, sent ? midiValue : DeviceShadow::unknown);
+
+        if (sent && transportTick >= 0 && recorder.isArmed())
+            recorder.record({ outputIndex, midiChannel, (int) paramIndex }, transportTick, midiValue);
+
+        return sent;
+    }
+
+    EngineTelemetry& telemetry;
+    std::function<double()> getTempoBpm;
+
+    // ---- Settings (reader side owned by the engine thread) ----
+    Update published;                    // message thread
+    LatestValue<Update> pendingSettings;
+    Update received;                     // waits here while a switch is pending
+    Settings settings;
+    bool switchPending = false;
+    juce::int64 switchTick = -1;         // boundary, once the transport is known
+    double controlIssuedMs = 0.0;
+
+    // ---- Outputs ----
+    std::array<std::atomic<MidiOutputPort*>, maxOutputs> outputs {};
+    std::atomic<bool> insideTick { false };
+    std::atomic<juce::uint64> ticksCompleted { 0 };
+    std::array<MidiOutputPort*, maxOutputs> currentOutputs {};
+    bool anyOutputOpen = false;
+    double tickTimeMs = 0.0;
+
+    // ---- Host transport (plugin) ----
+    double nextTickPpq = 0.0;
+    bool hasNextTickPpq = false;
+
+    // ---- Clock master (engine thread only) ----
+    // pulses go out this far ahead of the tick after next, so a tick that
+    // runs late doesn't make them late
+    static constexpr double clockLeadMs = 5.0;
+
+    MidiClockGenerator clock;
+    bool clockEnabled = false;
+
+    // ---- Transport from the incoming clock (MIDI input threads) ----
+    std::atomic<int> inputClockPulses { 0 };          // since Start
+    std::atomic<double> inputClockLastMs { 0.0 };
+    std::atomic<bool> inputTransportRunning { false };
+
+    // ---- Automation ----
+    struct InputControl
+    {
+        int channel = 0, controller = 0, value = 0;
+    };
+
+    static constexpr int inputControlCapacity = 256;
+
+    // MIDI input source -> engine
+    struct InputControlLane
+    {
+        juce::AbstractFifo fifo { inputControlCapacity };
+        std::array<InputControl, inputControlCapacity> controls {};
+        ControllerDecoder decoder;          // engine thread
+    };
+
+    AutomationRecorder recorder;
+    std::atomic<const AutomationClip*> automationClip { nullptr };
+    std::atomic<juce::int64> publishedTransportTick { -1 };
+
+    std::array<InputControlLane, maxInputSources> inputControlLanes;
+
+    // engine thread only
+    juce::int64 transportTick = -1;
+    const AutomationClip* playingClip = nullptr;
+    std::array<AutomationClip::Cursor, AutomationClip::maxLanes> automationCursors {};
+    juce::int64 lastLoopTick = 0;
+    bool automationSeekNeeded = true;
+
+    // ---- Requests from the UI and MIDI input threads ----
+    std::atomic<bool> lfoActive { false };
+    std::atomic<bool> phaseResetRequested { false };
+
+    std::atomic<bool> pendingNoteOn { false };
+    std::atomic<bool> pendingNoteOff { false };
+    std::atomic<int>  pendingNoteChannel { 0 };
+    std::atomic<int>  pendingNoteNumber { 0 };
+    std::atomic<float> pendingNoteVelocity { 0 };
+
+    std::atomic<bool> requestLfoStop { false };
+    std::atomic<bool> requestTransportStart { false };
+    std::atomic<bool> requestTransportStop { false };
+    std::atomic<int> clockTransportRequest { 0 };   // ClockTransport
+    std::atomic<int> songPositionRequest { -1 };
+
+    std::atomic<bool> tickRequested { false };
+    std::atomic<WakeUp*> wakeUp { nullptr };
+    std::atomic<ControlSource*> controlSource { nullptr };
+
+    std::array<std::atomic<int>, 128> inputCcValues;   // -1 until received
+
+    #if JUCE_DEBUG
+    std::atomic<MidiMonitorSink*> monitor { nullptr };
+    std::atomic<int> restartNoteDebug { -1 };
+    #endif
+
+    // ---- LFO / EG state (engine thread only) ----
+    std::array<RouteState, maxRoutes> routeStates {};
+    EnvelopeGenerator eg;
+
+    juce::Random random;
+    double randomLastPhase = 0.0;
+    double randomLastValue = 0.0;
+
+    // ---- Matrix (engine thread only) ----
+    static_assert (ModulationMatrix::maxDestinations >= maxRoutes + 1 + ModulationMatrix::maxConnections,
+                   "every source may need its own destination");
+
+    ModulationMatrix matrix;
+    float lastVelocity = 0.0f;
+    std::array<int, ModulationMatrix::maxConnections> lastConnectionInput {};
+
+    // ---- Device state, per output ----
+    std::array<DeviceShadow, maxOutputs> shadows;
+    std::array<MidiOutputPort*, maxOutputs> shadowOutputs {};   // the port each shadow describes
+
+    struct DestinationState
+    {
+        double lastSendTime = 0.0;   // rate limit
+        UpdateSchedule schedule;
+        ErrorDiffusionQuantizer quantizer;
+    };
+
+    // indexed [output][channel - 1][parameter]
+    using ChannelStates = std::array<std::array<DestinationState, numSyntaktParameters>, 16>;
+    std::array<ChannelStates, maxOutputs> destinationStates {};
+};
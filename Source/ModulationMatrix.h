@@ -0,0 +1,133 @@
+#pragma once
+#include <JuceHeader.h>
+#include "SyntaktParameterTable.h"
+
+// ==========================================
+// Modulation matrix
+// ==========================================
+// Sources (LFO routes, the EG, note velocity, incoming CCs) don't send
+// anything themselves. During a tick each one adds its contribution to a
+// destination (output, MIDI channel and parameter); at the end of the tick
+// every destination is resolved to one value and sent once. Two sources on
+// the same parameter are summed instead of taking turns on the wire.
+//
+// Contributions are scaled to the parameter's range: bipolar ones swing
+// around its centre, unipolar ones rise from its minimum. A destination
+// with any bipolar contribution is centred, otherwise it starts at the
+// minimum, and the sum is clamped to the range. A single source at amount
+// 1 gives the same value it used to send on its own.
+class ModulationMatrix
+{
+public:
+    static constexpr int maxDestinations = 8;
+    static constexpr int maxConnections = 4;
+
+    // Sources wired through Settings::connections; LFO routes and the EG
+    // carry their own destination.
+    enum class Source
+    {
+        off,
+        velocity,   // last Note-On velocity, 0..1
+        inputCc     // last value of a CC received on the MIDI input, 0..1
+    };
+
+    struct Connection
+    {
+        Source source = Source::off;
+        int ccNumber = 1;          // inputCc only
+        int midiChannel = 0;       // destination; 0 = disabled
+        int parameterIndex = 0;
+        double amount = 1.0;       // -1..1
+    };
+
+    struct Destination
+    {
+        int output = 0;            // index of the engine output
+        int midiChannel = 0;
+        int parameterIndex = 0;
+        double offset = 0.0;       // summed contributions, in parameter steps
+        bool centred = false;
+        bool changed = false;      // at least one contribution moved this tick
+        int numSources = 0;
+    };
+
+    void beginTick() noexcept   { numDestinations = 0; }
+
+    // signal is -1..1 for bipolar contributions, 0..1 otherwise (before amount).
+    // changed: false for a source that holds still (velocity, CC) and hasn't
+    // moved since the previous tick.
+    void add(int output, int midiChannel, int parameterIndex, double signal, bool bipolar, bool changed) noexcept
+    {
+        if (midiChannel <= 0 || !juce::isPositiveAndBelow(parameterIndex, (int) numSyntaktParameters))
+            return;
+
+        auto* d = find(output, midiChannel, parameterIndex);
+
+        if (d == nullptr)
+        {
+            // sized for every source having its own destination
+            jassert (numDestinations < maxDestinations);
+
+            if (numDestinations == maxDestinations)
+                return;
+
+            d = &destinations[(size_t) numDestinations++];
+            *d = { output, midiChannel, parameterIndex };
+        }
+
+        const auto& param = syntaktParameters[parameterIndex];
+
+        if (bipolar)
+        {
+            d->offset += signal * ((param.maxValue - param.minValue) / 2);
+            d->centred = true;
+        }
+        else
+        {
+            d->offset += signal * (param.maxValue - param.minValue);
+        }
+
+        d->changed = d->changed || changed;
+        ++d->numSources;
+    }
+
+    int getNumDestinations() const noexcept   { return numDestinations; }
+
+    // Calls send(destination, midiValue, exactValue) once for every destination
+    // that changed; exactValue is the clamped value before rounding
+    template <typename SendFn>
+    void resolve(SendFn&& send) const
+    {
+        for (int i = 0; i < numDestinations; ++i)
+        {
+            const auto& d = destinations[(size_t) i];
+
+            if (!d.changed)
+                continue;
+
+            const auto& param = syntaktParameters[d.parameterIndex];
+            const int base = d.centred ? (param.minValue + param.maxValue) / 2 : param.minValue;
+
+            send(d,
+                 juce::jlimit(param.minValue, param.maxValue, base + (int) std::round(d.offset)),
+                 juce::jlimit((double) param.minValue, (double) param.maxValue, base + d.offset));
+        }
+    }
+
+private:
+    Destination* find(int output, int midiChannel, int parameterIndex) noexcept
+    {
+        for (int i = 0; i < numDestinations; ++i)
+        {
+            auto& d = destinations[(size_t) i];
+
+            if (d.output == output && d.midiChannel == midiChannel && d.parameterIndex == parameterIndex)
+                return &d;
+        }
+
+        return nullptr;
+    }
+
+    std::array<Destination, maxDestinations> destinations {};
+    int numDestinations = 0;
+};
@@ -0,0 +1,16 @@
+/*
+  ==============================================================================
+
+    Entry point of the plugin build (Plugin/ModzTakt_LV2.jucer).
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "PluginProcessor.h"
+
+//==============================================================================
+juce::AudioProcessor* JUCE_CALLTYPE createPluginFilter()
+{
+    return new ModzTaktProcessor();
+}
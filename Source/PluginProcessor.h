@@ -0,0 +1,394 @@
+#pragma once
+#include <JuceHeader.h>
+#include "ModulationEngine.h"
+#include "MidiOutputPort.h"
+#include "EngineTelemetry.h"
+#include "SyntaktParameterTable.h"
+
+// ==========================================
+// Plugin build (LV2)
+// ==========================================
+// The same ModulationEngine as the standalone app, as a headless MIDI
+// effect: settings are host parameters (the host draws its generic UI), MIDI
+// comes from and goes to the host's MIDI ports. Incoming events pass
+// through, with the generated CC/NRPN messages added among them, so the
+// notes still reach the instrument after it.
+//
+// Nothing here reads a clock. processBlock() ticks the engine at
+// tickRateHz in sample time, at the exact sample each tick falls on, and
+// the tick's messages are written at that sample offset. Engine time is
+// the sample position in ms. Synced LFOs take their tempo from the host
+// and, while the transport runs, their phase from its PPQ position, so
+// there is no clock estimation. Host play/stop act like MIDI Start/Stop in
+// the app.
+//
+// Built from Plugin/ModzTakt_LV2.jucer; only PluginMain.cpp is compiled.
+class ModzTaktProcessor : public juce::AudioProcessor,
+                          private juce::AudioProcessorParameter::Listener
+{
+public:
+    ModzTaktProcessor()
+        : juce::AudioProcessor(BusesProperties())
+    {
+        juce::StringArray parameterNames;
+
+        for (size_t i = 0; i < numSyntaktParameters; ++i)
+            parameterNames.add(syntaktParameters[i].name);
+
+        auto msRange = [](float max) { return juce::NormalisableRange<float>(0.0f, max, 0.0f, 0.3f); };
+
+        addParameter(active = new juce::AudioParameterBool({ "active", 1 }, "LFO On", true));
+        addParameter(shape = new juce::AudioParameterChoice({ "shape", 1 }, "Shape",
+                                                            { "Sine", "Triangle", "Square", "Saw", "Random" }, 0));
+        addParameter(rate = new juce::AudioParameterFloat({ "rate", 1 }, "Rate (Hz)",
+                                                          juce::NormalisableRange<float>(0.01f, 20.0f, 0.0f, 0.3f), 2.0f));
+        addParameter(depth = new juce::AudioParameterFloat({ "depth", 1 }, "Depth", 0.0f, 1.0f, 1.0f));
+        addParameter(sync = new juce::AudioParameterBool({ "sync", 1 }, "Host Sync", true));
+        addParameter(division = new juce::AudioParameterChoice({ "division", 1 }, "Division",
+                                                               { "1/1", "1/2", "1/4", "1/8", "1/16", "1/32",
+                                                                 "1/8 dotted", "1/16 dotted" }, 2));
+
+        for (size_t r = 0; r < (size_t) ModulationEngine::maxRoutes; ++r)
+        {
+            const auto id = "route" + juce::String(r + 1) + "_";
+            const auto name = "Route " + juce::String(r + 1) + " ";
+            auto& p = routes[r];
+
+            addParameter(p.channel = new juce::AudioParameterInt({ id + "channel", 1 }, name + "Channel", 0, 16, r == 0 ? 1 : 0));
+            addParameter(p.parameter = new juce::AudioParameterChoice({ id + "parameter", 1 }, name + "Parameter", parameterNames, 0));
+            addParameter(p.bipolar = new juce::AudioParameterBool({ id + "bipolar", 1 }, name + "Bipolar", false));
+            addParameter(p.invert = new juce::AudioParameterBool({ id + "invert", 1 }, name + "Invert", false));
+            addParameter(p.oneShot = new juce::AudioParameterBool({ id + "oneshot", 1 }, name + "One Shot", false));
+            addParameter(p.amount = new juce::AudioParameterFloat({ id + "amount", 1 }, name + "Amount", -1.0f, 1.0f, 1.0f));
+        }
+
+        addParameter(noteRestartChannel = new juce::AudioParameterInt({ "noterestart", 1 }, "Note Restart Channel", 0, 16, 0));
+        addParameter(noteOffStop = new juce::AudioParameterBool({ "noteoffstop", 1 }, "Note Off Stops LFO", false));
+        addParameter(changeThreshold = new juce::AudioParameterInt({ "threshold", 1 }, "Change Threshold", 0, 8, 1));
+        addParameter(errorBound = new juce::AudioParameterFloat({ "errorbound", 1 }, "Update Error Bound (steps)", 0.0f, 8.0f, 1.0f));
+        addParameter(trackDeviceEdits = new juce::AudioParameterBool({ "trackedits", 1 }, "Track Device Edits", false));
+
+        juce::StringArray egParameterNames { "Off" };
+        egParameterNames.addArray(parameterNames);
+
+        addParameter(egSource = new juce::AudioParameterInt({ "eg_source", 1 }, "EG Note Channel", 0, 16, 0));
+        addParameter(egChannel = new juce::AudioParameterInt({ "eg_channel", 1 }, "EG Channel", 1, 16, 1));
+        addParameter(egParameter = new juce::AudioParameterChoice({ "eg_parameter", 1 }, "EG Parameter", egParameterNames, 0));
+        addParameter(egAttack = new juce::AudioParameterFloat({ "eg_attack", 1 }, "EG Attack (ms)", msRange(5000.0f), 0.5f));
+        addParameter(egHold = new juce::AudioParameterFloat({ "eg_hold", 1 }, "EG Hold (ms)", msRange(5000.0f), 0.0f));
+        addParameter(egDecay = new juce::AudioParameterFloat({ "eg_decay", 1 }, "EG Decay (ms)", msRange(10000.0f), 1.0f));
+        addParameter(egSustain = new juce::AudioParameterFloat({ "eg_sustain", 1 }, "EG Sustain", 0.0f, 1.0f, 0.0f));
+        addParameter(egRelease = new juce::AudioParameterFloat({ "eg_release", 1 }, "EG Release (ms)", msRange(10000.0f), 5.0f));
+        addParameter(egVelocity = new juce::AudioParameterFloat({ "eg_velocity", 1 }, "EG Velocity Amount", 0.0f, 1.0f, 0.0f));
+        addParameter(egAmount = new juce::AudioParameterFloat({ "eg_amount", 1 }, "EG Amount", -1.0f, 1.0f, 1.0f));
+
+        // velocity / incoming CC sources of the modulation matrix
+        for (size_t c = 0; c < (size_t) ModulationMatrix::maxConnections; ++c)
+        {
+            const auto id = "mod" + juce::String(c + 1) + "_";
+            const auto name = "Mod " + juce::String(c + 1) + " ";
+            auto& p = connections[c];
+
+            addParameter(p.source = new juce::AudioParameterChoice({ id + "source", 1 }, name + "Source", { "Off", "Velocity", "Input CC" }, 0));
+            addParameter(p.ccNumber = new juce::AudioParameterInt({ id + "cc", 1 }, name + "CC", 0, 127, 1));
+            addParameter(p.channel = new juce::AudioParameterInt({ id + "channel", 1 }, name + "Channel", 0, 16, 0));
+            addParameter(p.parameter = new juce::AudioParameterChoice({ id + "parameter", 1 }, name + "Parameter", parameterNames, 0));
+            addParameter(p.amount = new juce::AudioParameterFloat({ id + "amount", 1 }, name + "Amount", -1.0f, 1.0f, 1.0f));
+        }
+
+        for (auto* p : getParameters())
+            p->addListener(this);
+    }
+
+    ~ModzTaktProcessor() override
+    {
+        for (auto* p : getParameters())
+            p->removeListener(this);
+    }
+
+    // ==========================================
+    // AudioProcessor
+    // ==========================================
+    const juce::String getName() const override   { return JucePlugin_Name; }
+
+    bool acceptsMidi() const override    { return true; }
+    bool producesMidi() const override   { return true; }
+    bool isMidiEffect() const override   { return true; }
+
+    double getTailLengthSeconds() const override   { return 0.0; }
+
+    bool hasEditor() const override                      { return false; }
+    juce::AudioProcessorEditor* createEditor() override  { return nullptr; }
+
+    int getNumPrograms() override                                  { return 1; }
+    int getCurrentProgram() override                               { return 0; }
+    void setCurrentProgram(int) override                           {}
+    const juce::String getProgramName(int) override                { return {}; }
+    void changeProgramName(int, const juce::String&) override      {}
+
+    void prepareToPlay(double newSampleRate, int) override
+    {
+        sampleRate = newSampleRate;
+        samplesToNextTick = 0.0;
+
+        // room for a few blocks of NRPN output: addEvent() never allocates while ticking
+        outBuffer.ensureSize(outputReserveBytes);
+        engine.setOutput(&output);
+    }
+
+    void releaseResources() override
+    {
+        engine.setOutput(nullptr);
+    }
+
+    void processBlock(juce::AudioBuffer<float>& audio, juce::MidiBuffer& midi) override
+    {
+        audio.clear();
+
+        if (settingsChanged.exchange(false))
+            engine.publishSettings(readSettings());
+
+        // like the app's Start/Stop button: acts on changes only, so a
+        // Note-Off or host stop can still halt the LFO
+        if (active->get() != lfoSwitch)
+        {
+            lfoSwitch = active->get();
+            lfoSwitch ? engine.startLfo() : engine.stopLfo();
+        }
+
+        const auto position = getPlayHead() != nullptr ? getPlayHead()->getPosition()
+                                                       : juce::Optional<juce::AudioPlayHead::PositionInfo>();
+        const bool playing = position.hasValue() && position->getIsPlaying();
+        const auto ppq = position.hasValue() ? position->getPpqPosition() : juce::Optional<double>();
+
+        hostBpm = position.hasValue() && position->getBpm().hasValue() ? *position->getBpm() : 0.0;
+
+        if (playing != wasPlaying && sync->get())
+            playing ? engine.postTransportStart() : engine.postTransportStop();
+
+        wasPlaying = playing;
+
+        const int numSamples = audio.getNumSamples();
+        const double msPerSample = 1000.0 / sampleRate;
+        const double samplesPerTick = sampleRate / ModulationEngine::tickRateHz;
+        const double ppqPerSample = hostBpm / (60.0 * sampleRate);
+        const double blockStartMs = (double) samplePosition * msPerSample;
+
+        auto input = midi.cbegin();
+
+        auto dispatchInputUpTo = [&](int sample)
+        {
+            for (; input != midi.cend() && (*input).samplePosition <= sample; ++input)
+                handleInput((*input).getMessage());
+        };
+
+        while (samplesToNextTick < (double) numSamples)
+        {
+            const int sample = (int) samplesToNextTick;
+            dispatchInputUpTo(sample);
+
+            if (playing && ppq.hasValue())
+                engine.setNextTickPosition(*ppq + samplesToNextTick * ppqPerSample);
+
+            output.sample = sample;
+            engine.tick(blockStartMs + samplesToNextTick * msPerSample);
+
+            samplesToNextTick += samplesPerTick;
+        }
+
+        dispatchInputUpTo(numSamples);
+
+        samplesToNextTick -= (double) numSamples;
+        samplePosition += numSamples;
+
+        // the host's events stay; ours go in at their sample positions
+        midi.addEvents(outBuffer, 0, numSamples, 0);
+        outBuffer.clear();
+    }
+
+    // Parameter values by ID
+    void getStateInformation(juce::MemoryBlock& destData) override
+    {
+        juce::XmlElement state("ModzTakt");
+
+        for (auto* p : getParameters())
+            if (auto* withId = dynamic_cast<juce::AudioProcessorParameterWithID*>(p))
+                state.setAttribute(withId->paramID, withId->getValue());
+
+        copyXmlToBinary(state, destData);
+    }
+
+    void setStateInformation(const void* data, int sizeInBytes) override
+    {
+        if (auto state = getXmlFromBinary(data, sizeInBytes))
+            for (auto* p : getParameters())
+                if (auto* withId = dynamic_cast<juce::AudioProcessorParameterWithID*>(p))
+                    if (state->hasAttribute(withId->paramID))
+                        withId->setValueNotifyingHost((float) state->getDoubleAttribute(withId->paramID));
+    }
+
+private:
+    // ==========================================
+    // Output: messages of the current tick at its sample offset
+    // ==========================================
+    struct BufferOutput : public MidiOutputPort
+    {
+        explicit BufferOutput(juce::MidiBuffer& b) : buffer(b) {}
+
+        juce::String getName() const override         { return "Host MIDI out"; }
+        juce::String getIdentifier() const override   { return "host"; }
+
+        int send(juce::ump::View packet) noexcept override
+        {
+            juce::uint8 bytes[3];
+            const int size = toBytestream(packet, bytes);
+
+            return size > 0 && buffer.addEvent(bytes, size, sample) ? size : 0;
+        }
+
+        juce::MidiBuffer& buffer;
+        int sample = 0;
+    };
+
+    struct RouteParameters
+    {
+        juce::AudioParameterInt* channel = nullptr;
+        juce::AudioParameterChoice* parameter = nullptr;
+        juce::AudioParameterBool* bipolar = nullptr;
+        juce::AudioParameterBool* invert = nullptr;
+        juce::AudioParameterBool* oneShot = nullptr;
+        juce::AudioParameterFloat* amount = nullptr;
+    };
+
+    struct ConnectionParameters
+    {
+        juce::AudioParameterChoice* source = nullptr;
+        juce::AudioParameterInt* ccNumber = nullptr;
+        juce::AudioParameterInt* channel = nullptr;
+        juce::AudioParameterChoice* parameter = nullptr;
+        juce::AudioParameterFloat* amount = nullptr;
+    };
+
+    static constexpr int outputReserveBytes = 16384;
+
+    // same handling as the app's GlobalMidiCallback
+    void handleInput(const juce::MidiMessage& message) noexcept
+    {
+        telemetry.inputReceived();
+
+        if (message.isNoteOn())
+        {
+            engine.postNoteOn(message.getChannel(), message.getNoteNumber(), message.getFloatVelocity());
+        }
+        else if (message.isNoteOff())
+        {
+            engine.postNoteOff(message.getChannel());
+
+            if (noteOffStop->get() && noteRestartChannel->get() > 0)
+                engine.postLfoStop();
+        }
+        else if (message.isController())
+        {
+            engine.postControlChange(message.getChannel(), message.getControllerNumber(), message.getControllerValue());
+        }
+    }
+
+    ModulationEngine::Settings readSettings() const noexcept
+    {
+        ModulationEngine::Settings s;
+
+        s.shapeId = shape->getIndex() + 1;
+        s.rateHz = rate->get();
+        s.depth = depth->get();
+        s.syncEnabled = sync->get();
+        s.divisionId = division->getIndex() + 1;
+
+        for (size_t r = 0; r < routes.size(); ++r)
+        {
+            s.routes[r].midiChannel = routes[r].channel->get();
+            s.routes[r].parameterIndex = routes[r].parameter->getIndex();
+            s.routes[r].bipolar = routes[r].bipolar->get();
+            s.routes[r].invertPhase = routes[r].invert->get();
+            s.routes[r].oneShot = routes[r].oneShot->get();
+            s.routes[r].amount = routes[r].amount->get();
+        }
+
+        for (size_t c = 0; c < connections.size(); ++c)
+        {
+            auto& connection = s.connections[c];
+            connection.source = static_cast<ModulationMatrix::Source>(connections[c].source->getIndex());
+            connection.ccNumber = connections[c].ccNumber->get();
+            connection.midiChannel = connections[c].channel->get();
+            connection.parameterIndex = connections[c].parameter->getIndex();
+            connection.amount = connections[c].amount->get();
+        }
+
+        s.noteRestartEnabled = noteRestartChannel->get() > 0;
+        s.noteRestartChannel = noteRestartChannel->get();
+        s.changeThreshold = changeThreshold->get();
+        s.seedShadowFromInput = trackDeviceEdits->get();
+        s.errorBoundSteps = errorBound->get();
+
+        s.eg.noteSourceChannel = egSource->get() > 0 ? egSource->get() : 17;
+        s.eg.outChannel = egChannel->get();
+        s.eg.outParamIndex = egParameter->getIndex() - 1;
+        s.eg.attackMs = egAttack->get();
+        s.eg.holdMs = egHold->get();
+        s.eg.decayMs = egDecay->get();
+        s.eg.sustainLevel = egSustain->get();
+        s.eg.releaseMs = egRelease->get();
+        s.eg.velocityAmount = egVelocity->get();
+        s.egAmount = egAmount->get();
+
+        return s;
+    }
+
+    // any thread: picked up by the next processBlock
+    void parameterValueChanged(int, float) override   { settingsChanged.store(true); }
+    void parameterGestureChanged(int, bool) override  {}
+
+    EngineTelemetry telemetry;
+    ModulationEngine engine { telemetry, [this] { return hostBpm; } };
+
+    juce::MidiBuffer outBuffer;
+    BufferOutput output { outBuffer };
+
+    // ---- Audio thread ----
+    double sampleRate = 48000.0;
+    double samplesToNextTick = 0.0;
+    juce::int64 samplePosition = 0;
+    double hostBpm = 0.0;
+    bool wasPlaying = false;
+    bool lfoSwitch = false;
+
+    std::atomic<bool> settingsChanged { true };
+
+    // ---- Parameters (owned by the AudioProcessor) ----
+    juce::AudioParameterBool* active = nullptr;
+    juce::AudioParameterChoice* shape = nullptr;
+    juce::AudioParameterFloat* rate = nullptr;
+    juce::AudioParameterFloat* depth = nullptr;
+    juce::AudioParameterBool* sync = nullptr;
+    juce::AudioParameterChoice* division = nullptr;
+    std::array<RouteParameters, ModulationEngine::maxRoutes> routes {};
+    juce::AudioParameterInt* noteRestartChannel = nullptr;
+    juce::AudioParameterBool* noteOffStop = nullptr;
+    juce::AudioParameterInt* changeThreshold = nullptr;
+    juce::AudioParameterFloat* errorBound = nullptr;
+    juce::AudioParameterBool* trackDeviceEdits = nullptr;
+
+    juce::AudioParameterInt* egSource = nullptr;
+    juce::AudioParameterInt* egChannel = nullptr;
+    juce::AudioParameterChoice* egParameter = nullptr;
+    juce::AudioParameterFloat* egAttack = nullptr;
+    juce::AudioParameterFloat* egHold = nullptr;
+    juce::AudioParameterFloat* egDecay = nullptr;
+    juce::AudioParameterFloat* egSustain = nullptr;
+    juce::AudioParameterFloat* egRelease = nullptr;
+    juce::AudioParameterFloat* egVelocity = nullptr;
+    juce::AudioParameterFloat* egAmount = nullptr;
+
+    std::array<ConnectionParameters, ModulationMatrix::maxConnections> connections {};
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(ModzTaktProcessor)
+};
@@ -0,0 +1,513 @@
+#pragma once
+#include <JuceHeader.h>
+#include "ModulationEngine.h"
+#include "SyntaktParameterTable.h"
+
+// ==========================================
+// Preset bank
+// ==========================================
+// Numbered setups of the modulation: routes, LFO, EG and matrix, what
+// changes between songs. The sync source, the clock master tempo and the
+// performance settings (throttle, update rate) are left as they are when a
+// preset is recalled.
+//
+// The whole bank is kept in memory, so a recall is a copy and the engine
+// gets it as one snapshot (ModulationEngine::switchSettings()). It is
+// written after every change as a compact binary file, and can be exported
+// to and imported from JSON that a person can read and edit; parameters
+// are named there rather than numbered.
+//
+// Binary layout: "MZPB", u8 version, u8 number of presets, then for each
+// one u8 slot, the name (UTF-8, zero terminated) and the settings, whole
+// numbers as JUCE compressed ints and the rest as floats, closed by an 'E'
+// so a cut-off file is noticed.
+class PresetBank
+{
+public:
+    static constexpr int numSlots = 16;
+    static constexpr int maxNameBytes = 32;    // with the terminator, as in the shared status
+    static constexpr int version = 1;
+    static constexpr char presetEnd = 'E';
+
+    using Settings = ModulationEngine::Settings;
+
+    struct Preset
+    {
+        juce::String name;       // empty: slot unused
+        Settings settings;
+    };
+
+    bool isUsed(int slot) const noexcept
+    {
+        return juce::isPositiveAndBelow(slot, numSlots) && presets[(size_t) slot].name.isNotEmpty();
+    }
+
+    const Preset& get(int slot) const noexcept   { return presets[(size_t) slot]; }
+
+    void store(int slot, const juce::String& name, const Settings& settings)
+    {
+        jassert (juce::isPositiveAndBelow(slot, numSlots));
+
+        auto& preset = presets[(size_t) slot];
+        preset.name = trimName(name, slot);
+        preset.settings = settings;
+    }
+
+    void clear(int slot)   { presets[(size_t) slot] = {}; }
+
+    // The preset's part of the settings, over the rest of current
+    static Settings recall(const Settings& preset, const Settings& current) noexcept
+    {
+        auto settings = current;
+
+        settings.routes = preset.routes;
+        settings.shapeId = preset.shapeId;
+        settings.rateHz = preset.rateHz;
+        settings.depth = preset.depth;
+        settings.divisionId = preset.divisionId;
+        settings.noteRestartEnabled = preset.noteRestartEnabled;
+        settings.noteRestartChannel = preset.noteRestartChannel;
+        settings.eg = preset.eg;
+        settings.egAmount = preset.egAmount;
+        settings.connections = preset.connections;
+
+        return settings;
+    }
+
+    // ---- Files ----
+    static juce::File getDefaultFile()
+    {
+        return juce::File::getSpecialLocation(juce::File::userApplicationDataDirectory)
+                   .getChildFile("ModzTakt").getChildFile("presets.mzpb");
+    }
+
+    bool save(const juce::File& file) const
+    {
+        juce::MemoryOutputStream out;
+        writeBinary(out);
+
+        return file.getParentDirectory().createDirectory()
+            && file.replaceWithData(out.getData(), out.getDataSize());
+    }
+
+    // Leaves the bank as it was if the file can't be read
+    bool load(const juce::File& file)
+    {
+        juce::MemoryBlock data;
+
+        if (!file.loadFileAsData(data))
+            return false;
+
+        juce::MemoryInputStream in(data, false);
+        return readBinary(in);
+    }
+
+    bool exportJson(const juce::File& file) const
+    {
+        return file.replaceWithText(juce::JSON::toString(toVar()));
+    }
+
+    bool importJson(const juce::File& file)
+    {
+        return fromVar(juce::JSON::parse(file));
+    }
+
+    // ---- Binary ----
+    void writeBinary(juce::OutputStream& out) const
+    {
+        out.write("MZPB", 4);
+        out.writeByte((char) version);
+
+        int numUsed = 0;
+
+        for (int slot = 0; slot < numSlots; ++slot)
+            numUsed += isUsed(slot) ? 1 : 0;
+
+        out.writeByte((char) numUsed);
+
+        for (int slot = 0; slot < numSlots; ++slot)
+        {
+            if (!isUsed(slot))
+                continue;
+
+            out.writeByte((char) slot);
+            out.writeString(presets[(size_t) slot].name);
+            writeSettings(out, presets[(size_t) slot].settings);
+        }
+    }
+
+    // All or nothing: a preset out of range rejects the file
+    bool readBinary(juce::InputStream& in)
+    {
+        char magic[4] = {};
+
+        if (in.read(magic, 4) != 4 || std::memcmp(magic, "MZPB", 4) != 0 || in.readByte() != version)
+            return false;
+
+        std::array<Preset, numSlots> loaded;
+        const int numUsed = (juce::uint8) in.readByte();
+
+        for (int i = 0; i < numUsed; ++i)
+        {
+            const int slot = (juce::uint8) in.readByte();
+
+            if (!juce::isPositiveAndBelow(slot, numSlots) || in.isExhausted())
+                return false;
+
+            auto& preset = loaded[(size_t) slot];
+            preset.name = trimName(in.readString(), slot);
+
+            if (!readSettings(in, preset.settings) || !isValid(preset.settings))
+                return false;
+        }
+
+        presets = loaded;
+        return true;
+    }
+
+    // ---- JSON ----
+    juce::var toVar() const
+    {
+        juce::Array<juce::var> list;
+
+        for (int slot = 0; slot < numSlots; ++slot)
+        {
+            if (!isUsed(slot))
+                continue;
+
+            const auto& s = presets[(size_t) slot].settings;
+            auto* object = new juce::DynamicObject();
+
+            object->setProperty("slot", slot + 1);
+            object->setProperty("name", presets[(size_t) slot].name);
+            object->setProperty("shape", s.shapeId);
+            object->setProperty("rateHz", s.rateHz);
+            object->setProperty("depth", s.depth);
+            object->setProperty("division", s.divisionId);
+            object->setProperty("noteRestart", s.noteRestartEnabled);
+            object->setProperty("noteRestartChannel", s.noteRestartChannel);
+
+            juce::Array<juce::var> routes;
+
+            for (const auto& route : s.routes)
+            {
+                auto* r = new juce::DynamicObject();
+                r->setProperty("output", route.output + 1);
+                r->setProperty("channel", route.midiChannel);
+                r->setProperty("parameter", parameterName(route.parameterIndex));
+                r->setProperty("bipolar", route.bipolar);
+                r->setProperty("invert", route.invertPhase);
+                r->setProperty("oneShot", route.oneShot);
+                r->setProperty("amount", route.amount);
+                routes.add(juce::var(r));
+            }
+
+            object->setProperty("routes", routes);
+
+            auto* eg = new juce::DynamicObject();
+            eg->setProperty("noteChannel", s.eg.isEnabled() ? s.eg.noteSourceChannel : 0);
+            eg->setProperty("channel", s.eg.outChannel);
+            eg->setProperty("parameter", parameterName(s.eg.outParamIndex));
+            eg->setProperty("attackMs", s.eg.attackMs);
+            eg->setProperty("holdMs", s.eg.holdMs);
+            eg->setProperty("decayMs", s.eg.decayMs);
+            eg->setProperty("sustain", s.eg.sustainLevel);
+            eg->setProperty("releaseMs", s.eg.releaseMs);
+            eg->setProperty("velocity", s.eg.velocityAmount);
+            eg->setProperty("attackMode", (int) s.eg.attackMode);
+            eg->setProperty("decayCurve", (int) s.eg.decayCurve);
+            eg->setProperty("releaseCurve", (int) s.eg.releaseCurve);
+            eg->setProperty("amount", s.egAmount);
+            object->setProperty("eg", juce::var(eg));
+
+            juce::Array<juce::var> connections;
+
+            for (const auto& connection : s.connections)
+            {
+                auto* c = new juce::DynamicObject();
+                c->setProperty("source", connection.source == ModulationMatrix::Source::velocity ? "velocity"
+                                        : connection.source == ModulationMatrix::Source::inputCc ? "cc" : "off");
+                c->setProperty("cc", connection.ccNumber);
+                c->setProperty("channel", connection.midiChannel);
+                c->setProperty("parameter", parameterName(connection.parameterIndex));
+                c->setProperty("amount", connection.amount);
+                connections.add(juce::var(c));
+            }
+
+            object->setProperty("connections", connections);
+            list.add(juce::var(object));
+        }
+
+        auto* root = new juce::DynamicObject();
+        root->setProperty("modztaktPresets", version);
+        root->setProperty("presets", list);
+        return juce::var(root);
+    }
+
+    // All or nothing, like readBinary(); missing fields keep their defaults
+    bool fromVar(const juce::var& root)
+    {
+        const auto* list = root["presets"].getArray();
+
+        if ((int) root["modztaktPresets"] != version || list == nullptr)
+            return false;
+
+        std::array<Preset, numSlots> loaded;
+
+        for (const auto& object : *list)
+        {
+            const int slot = (int) object["slot"] - 1;
+
+            if (!juce::isPositiveAndBelow(slot, numSlots))
+                return false;
+
+            auto& preset = loaded[(size_t) slot];
+            auto& s = preset.settings;
+            preset.name = trimName(object["name"].toString(), slot);
+
+            s.shapeId = object.getProperty("shape", s.shapeId);
+            s.rateHz = object.getProperty("rateHz", s.rateHz);
+            s.depth = object.getProperty("depth", s.depth);
+            s.divisionId = object.getProperty("division", s.divisionId);
+            s.noteRestartEnabled = object.getProperty("noteRestart", s.noteRestartEnabled);
+            s.noteRestartChannel = object.getProperty("noteRestartChannel", s.noteRestartChannel);
+
+            if (const auto* routes = object["routes"].getArray())
+            {
+                for (int i = 0; i < juce::jmin(routes->size(), ModulationEngine::maxRoutes); ++i)
+                {
+                    const auto& r = routes->getReference(i);
+                    auto& route = s.routes[(size_t) i];
+
+                    route.output = (int) r.getProperty("output", 1) - 1;
+                    route.midiChannel = r.getProperty("channel", 0);
+                    route.parameterIndex = parameterIndex(r.getProperty("parameter", route.parameterIndex));
+                    route.bipolar = r.getProperty("bipolar", false);
+                    route.invertPhase = r.getProperty("invert", false);
+                    route.oneShot = r.getProperty("oneShot", false);
+                    route.amount = r.getProperty("amount", 1.0);
+                }
+            }
+
+            if (const auto& eg = object["eg"]; eg.isObject())
+            {
+                const int noteChannel = eg.getProperty("noteChannel", 0);
+                s.eg.noteSourceChannel = noteChannel == 0 ? 17 : noteChannel;
+                s.eg.outChannel = eg.getProperty("channel", s.eg.outChannel);
+                s.eg.outParamIndex = parameterIndex(eg.getProperty("parameter", s.eg.outParamIndex));
+                s.eg.attackMs = eg.getProperty("attackMs", s.eg.attackMs);
+                s.eg.holdMs = eg.getProperty("holdMs", s.eg.holdMs);
+                s.eg.decayMs = eg.getProperty("decayMs", s.eg.decayMs);
+                s.eg.sustainLevel = eg.getProperty("sustain", s.eg.sustainLevel);
+                s.eg.releaseMs = eg.getProperty("releaseMs", s.eg.releaseMs);
+                s.eg.velocityAmount = eg.getProperty("velocity", s.eg.velocityAmount);
+                s.eg.attackMode = (EnvelopeGenerator::AttackMode) (int) eg.getProperty("attackMode", (int) s.eg.attackMode);
+                s.eg.decayCurve = (EnvelopeGenerator::CurveShape) (int) eg.getProperty("decayCurve", (int) s.eg.decayCurve);
+                s.eg.releaseCurve = (EnvelopeGenerator::CurveShape) (int) eg.getProperty("releaseCurve", (int) s.eg.releaseCurve);
+                s.egAmount = eg.getProperty("amount", s.egAmount);
+            }
+
+            if (const auto* connections = object["connections"].getArray())
+            {
+                for (int i = 0; i < juce::jmin(connections->size(), ModulationMatrix::maxConnections); ++i)
+                {
+                    const auto& c = connections->getReference(i);
+                    auto& connection = s.connections[(size_t) i];
+                    const auto source = c["source"].toString();
+
+                    connection.source = source == "velocity" ? ModulationMatrix::Source::velocity
+                                      : source == "cc"       ? ModulationMatrix::Source::inputCc
+                                                             : ModulationMatrix::Source::off;
+                    connection.ccNumber = c.getProperty("cc", 1);
+                    connection.midiChannel = c.getProperty("channel", 0);
+                    connection.parameterIndex = parameterIndex(c.getProperty("parameter", connection.parameterIndex));
+                    connection.amount = c.getProperty("amount", 1.0);
+                }
+            }
+
+            if (!isValid(s))
+                return false;
+        }
+
+        presets = loaded;
+        return true;
+    }
+
+private:
+    static juce::String trimName(const juce::String& name, int slot)
+    {
+        auto trimmed = name.trim();
+
+        if (trimmed.isEmpty())
+            trimmed = "Preset " + juce::String(slot + 1);
+
+        // whole characters only
+        while ((int) trimmed.getNumBytesAsUTF8() >= maxNameBytes)
+            trimmed = trimmed.dropLastCharacters(1);
+
+        return trimmed;
+    }
+
+    static juce::String parameterName(int index)
+    {
+        return juce::isPositiveAndBelow(index, (int) numSyntaktParameters) ? juce::String(syntaktParameters[index].name)
+                                                                            : juce::String();
+    }
+
+    // by name, or by number; -1 for none (no name), and a name the table
+    // doesn't have gives an index isValid() rejects for every use
+    static int parameterIndex(const juce::var& value)
+    {
+        if (value.isInt() || value.isDouble())
+            return (int) value;
+
+        if (value.toString().isEmpty())
+            return -1;
+
+        for (int i = 0; i < (int) numSyntaktParameters; ++i)
+            if (value.toString() == syntaktParameters[i].name)
+                return i;
+
+        return unknownParameter;
+    }
+
+    static constexpr int unknownParameter = -2;
+
+    static void writeSettings(juce::OutputStream& out, const Settings& s)
+    {
+        out.writeCompressedInt(s.shapeId);
+        out.writeFloat((float) s.rateHz);
+        out.writeFloat((float) s.depth);
+        out.writeCompressedInt(s.divisionId);
+        out.writeBool(s.noteRestartEnabled);
+        out.writeCompressedInt(s.noteRestartChannel);
+
+        for (const auto& route : s.routes)
+        {
+            out.writeCompressedInt(route.output);
+            out.writeCompressedInt(route.midiChannel);
+            out.writeCompressedInt(route.parameterIndex);
+            out.writeByte((char) ((route.bipolar ? 1 : 0) | (route.invertPhase ? 2 : 0) | (route.oneShot ? 4 : 0)));
+            out.writeFloat((float) route.amount);
+        }
+
+        out.writeCompressedInt(s.eg.noteSourceChannel);
+        out.writeCompressedInt(s.eg.outChannel);
+        out.writeCompressedInt(s.eg.outParamIndex);
+        out.writeFloat((float) s.eg.attackMs);
+        out.writeFloat((float) s.eg.holdMs);
+        out.writeFloat((float) s.eg.decayMs);
+        out.writeFloat((float) s.eg.sustainLevel);
+        out.writeFloat((float) s.eg.releaseMs);
+        out.writeFloat((float) s.eg.velocityAmount);
+        out.writeByte((char) s.eg.attackMode);
+        out.writeByte((char) s.eg.decayCurve);
+        out.writeByte((char) s.eg.releaseCurve);
+        out.writeFloat((float) s.egAmount);
+
+        for (const auto& connection : s.connections)
+        {
+            out.writeByte((char) connection.source);
+            out.writeCompressedInt(connection.ccNumber);
+            out.writeCompressedInt(connection.midiChannel);
+            out.writeCompressedInt(connection.parameterIndex);
+            out.writeFloat((float) connection.amount);
+        }
+
+        out.writeByte(presetEnd);
+    }
+
+    static bool readSettings(juce::InputStream& in, Settings& s)
+    {
+        s.shapeId = in.readCompressedInt();
+        s.rateHz = in.readFloat();
+        s.depth = in.readFloat();
+        s.divisionId = in.readCompressedInt();
+        s.noteRestartEnabled = in.readBool();
+        s.noteRestartChannel = in.readCompressedInt();
+
+        for (auto& route : s.routes)
+        {
+            route.output = in.readCompressedInt();
+            route.midiChannel = in.readCompressedInt();
+            route.parameterIndex = in.readCompressedInt();
+            const int flags = in.readByte();
+            route.bipolar = (flags & 1) != 0;
+            route.invertPhase = (flags & 2) != 0;
+            route.oneShot = (flags & 4) != 0;
+            route.amount = in.readFloat();
+        }
+
+        s.eg.noteSourceChannel = in.readCompressedInt();
+        s.eg.outChannel = in.readCompressedInt();
+        s.eg.outParamIndex = in.readCompressedInt();
+        s.eg.attackMs = in.readFloat();
+        s.eg.holdMs = in.readFloat();
+        s.eg.decayMs = in.readFloat();
+        s.eg.sustainLevel = in.readFloat();
+        s.eg.releaseMs = in.readFloat();
+        s.eg.velocityAmount = in.readFloat();
+        s.eg.attackMode = (EnvelopeGenerator::AttackMode) in.readByte();
+        s.eg.decayCurve = (EnvelopeGenerator::CurveShape) in.readByte();
+        s.eg.releaseCurve = (EnvelopeGenerator::CurveShape) in.readByte();
+        s.egAmount = in.readFloat();
+
+        for (auto& connection : s.connections)
+        {
+            connection.source = (ModulationMatrix::Source) in.readByte();
+            connection.ccNumber = in.readCompressedInt();
+            connection.midiChannel = in.readCompressedInt();
+            connection.parameterIndex = in.readCompressedInt();
+            connection.amount = in.readFloat();
+        }
+
+        // a short read leaves zeros behind
+        return in.readByte() == presetEnd;
+    }
+
+    // Ranges the engine relies on (see ControlSocket::isValid for the same
+    // limits on single operations)
+    static bool isValid(const Settings& s) noexcept
+    {
+        const int numParameters = (int) numSyntaktParameters;
+        auto finiteIn = [](double v, double low, double high)   { return std::isfinite(v) && v >= low && v <= high; };
+
+        if (!juce::isPositiveAndNotGreaterThan(s.shapeId - 1, 4) || !juce::isPositiveAndNotGreaterThan(s.divisionId - 1, 7)
+            || !finiteIn(s.rateHz, 0.01, 100.0) || !finiteIn(s.depth, 0.0, 1.0)
+            || !juce::isPositiveAndNotGreaterThan(s.noteRestartChannel, 16))
+            return false;
+
+        for (const auto& route : s.routes)
+            if (!juce::isPositiveAndBelow(route.output, ModulationEngine::maxOutputs)
+                || !juce::isPositiveAndNotGreaterThan(route.midiChannel, 16)
+                || !juce::isPositiveAndBelow(route.parameterIndex, numParameters)
+                || !finiteIn(route.amount, -1.0, 1.0))
+                return false;
+
+        const auto& eg = s.eg;
+
+        if (!juce::isPositiveAndNotGreaterThan(eg.noteSourceChannel - 1, 16)
+            || !juce::isPositiveAndNotGreaterThan(eg.outChannel - 1, 15)
+            || eg.outParamIndex < -1 || eg.outParamIndex >= numParameters
+            || !finiteIn(eg.attackMs, 0.0, 60000.0) || !finiteIn(eg.holdMs, 0.0, 60000.0)
+            || !finiteIn(eg.decayMs, 0.0, 60000.0) || !finiteIn(eg.releaseMs, 0.0, 60000.0)
+            || !finiteIn(eg.sustainLevel, 0.0, 1.0) || !finiteIn(eg.velocityAmount, 0.0, 1.0)
+            || !juce::isPositiveAndNotGreaterThan((int) eg.attackMode, 2)
+            || !juce::isPositiveAndNotGreaterThan((int) eg.decayCurve, 2)
+            || !juce::isPositiveAndNotGreaterThan((int) eg.releaseCurve, 2)
+            || !finiteIn(s.egAmount, -1.0, 1.0))
+            return false;
+
+        for (const auto& connection : s.connections)
+            if (!juce::isPositiveAndNotGreaterThan((int) connection.source, 2)
+                || !juce::isPositiveAndBelow(connection.ccNumber, 128)
+                || !juce::isPositiveAndNotGreaterThan(connection.midiChannel, 16)
+                || !juce::isPositiveAndBelow(connection.parameterIndex, numParameters)
+                || !finiteIn(connection.amount, -1.0, 1.0))
+                return false;
+
+        return true;
+    }
+
+    std::array<Preset, numSlots> presets;
+};
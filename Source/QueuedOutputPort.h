@@ -0,0 +1,502 @@
+#pragma once
+#include <JuceHeader.h>
+#include "MidiOutputPort.h"
+#include "EngineTelemetry.h"
+#include "RealtimeSupport.h"
+
+#if JUCE_LINUX
+ #include <semaphore.h>
+#endif
+
+// ==========================================
+// Queued output (per-port sender thread)
+// ==========================================
+// Runs a device port on its own thread. The engine's send() only copies the
+// packet into a single-producer/single-consumer FIFO, and flush() queues an
+// end-of-tick mark and wakes the sender, which does the port's writes and
+// its flush. A device that blocks or drains slowly (a busy USB port) only
+// backs up its own queue; the engine and the other outputs keep their timing.
+//
+// A full queue drops the packet, and whatever the device port reports as
+// dropped on its own flush or send comes back through the next flush(), so
+// the engine forgets that device's state as it does for a direct port. The
+// wake-up is a semaphore post on Linux, which doesn't take a lock.
+//
+// Per port, the telemetry gets the time from the end of a tick to the
+// sender having flushed it, and the number of packets still queued.
+//
+// Thru: the MIDI input side can forward messages through second queues
+// (sendThru), one per input source so that each has a single producer, and
+// the sender is the one place where input and engine output are put in
+// order. Engine packets are only ever written a whole tick at a
+// time, and thru messages go out between ticks, so nothing gets inside an
+// NRPN group. A thru data entry (CC 6/38/96/97) whose parameter number was
+// overwritten by an engine NRPN in the meantime gets its own 99/98 (or
+// 101/100) sent again first. Every byte goes through the one device port,
+// whose running status stays right; the raw port starts each write with a
+// full status byte.
+//
+// Scheduled packets (MIDI clock, see sendScheduled()) take a third queue,
+// ordered by due time. The sender sleeps until shortly before the first of
+// them is due, yields until it is, and writes and flushes it on its own;
+// realtime messages may go out between any two bytes, so that can happen
+// in the middle of a tick. How far past its due time each one left goes to
+// the telemetry's clock jitter.
+//
+// The sender takes the same realtime settings as the engine thread (SCHED_FIFO,
+// pinning, prefaulting), applied from inside it when it starts and reported
+// per port in the telemetry; changing them restarts it.
+class QueuedOutputPort : public MidiOutputPort,
+                         private juce::Thread
+{
+public:
+    static constexpr int capacity = 2048;   // packets, ~20 ticks of every destination as NRPN
+    static constexpr int thruCapacity = 256;
+    static constexpr int scheduledCapacity = 64;
+    static constexpr double spinLeadMs = 0.3;   // woken this much early, then yields
+
+    QueuedOutputPort(std::unique_ptr<MidiOutputPort> devicePort, EngineTelemetry& t, int telemetryPort,
+                     const RealtimeSettings& realtime)
+        : juce::Thread("MIDI out: " + devicePort->getName()),
+          port(std::move(devicePort)), telemetry(t), telemetryIndex(telemetryPort), realtimeSettings(realtime)
+    {
+       #if JUCE_LINUX
+        sem_init(&wakeUp, 0, 0);
+       #endif
+
+        startThread(juce::Thread::Priority::high);
+    }
+
+    // Message thread. Waits for a write in progress; a device that stays
+    // blocked is given up on after two seconds.
+    ~QueuedOutputPort() override
+    {
+        signalThreadShouldExit();
+        wake();
+        stopThread(2000);
+
+       #if JUCE_LINUX
+        sem_destroy(&wakeUp);
+       #endif
+    }
+
+    // Message thread. The engine keeps queueing meanwhile; the restarted
+    // sender picks that up.
+    void setRealtimeSettings(const RealtimeSettings& newSettings)
+    {
+        signalThreadShouldExit();
+        wake();
+        stopThread(2000);
+
+        realtimeSettings = newSettings;
+        startThread(juce::Thread::Priority::high);
+    }
+
+    juce::String getName() const override         { return port->getName(); }
+    juce::String getIdentifier() const override   { return port->getIdentifier(); }
+
+    // ---- Engine thread ----
+    int send(juce::ump::View packet) noexcept override
+    {
+        juce::uint8 bytes[3];
+        const int asBytes = toBytestream(packet, bytes);
+        const int size = asBytes > 0 ? asBytes : (int) packet.size() * 4;
+
+        if (!push(packet, size, false))
+        {
+            droppedSinceFlush += size;
+            return 0;
+        }
+
+        return size;
+    }
+
+    // picked up when the tick's flush() wakes the sender
+    int sendScheduled(juce::ump::View packet, double dueMs) noexcept override
+    {
+        const auto scope = scheduledFifo.write(1);
+
+        if (scope.blockSize1 + scope.blockSize2 == 0)
+        {
+            telemetry.clockDropped();
+            return 0;
+        }
+
+        auto& entry = scheduledEntries[(size_t) (scope.blockSize1 > 0 ? scope.startIndex1 : scope.startIndex2)];
+        entry.word = packet[0];
+        entry.dueMs = dueMs;
+
+        juce::uint8 bytes[3];
+        return toBytestream(packet, bytes);
+    }
+
+    int flush() noexcept override
+    {
+        // a lost mark only delays the port's flush to the next tick
+        push({}, 0, true);
+        wake();
+
+        telemetry.outputBacklog(telemetryIndex, fifo.getNumReady());
+        return std::exchange(droppedSinceFlush, 0) + droppedByPort.exchange(0, std::memory_order_relaxed);
+    }
+
+    // ---- MIDI input threads (one per source lane) ----
+    bool sendThru(int source, juce::ump::View packet) noexcept override
+    {
+        jassert (juce::isPositiveAndBelow(source, maxThruSources));
+        auto& lane = thruLanes[(size_t) source];
+
+        {
+            const auto scope = lane.fifo.write(1);
+
+            if (scope.blockSize1 + scope.blockSize2 == 0)
+                return false;
+
+            auto& entry = lane.entries[(size_t) (scope.blockSize1 > 0 ? scope.startIndex1 : scope.startIndex2)];
+            entry.word = packet[0];
+            entry.receivedMs = juce::Time::getMillisecondCounterHiRes();
+        }
+
+        wake();
+        return true;
+    }
+
+private:
+    struct Entry
+    {
+        std::array<juce::uint32, 4> words {};
+        int size = 0;              // bytes on the wire
+        double tickEndMs = 0.0;    // end-of-tick marks only
+        bool endOfTick = false;
+    };
+
+    struct ScheduledEntry
+    {
+        juce::uint32 word = 0;      // 32-bit system packet
+        double dueMs = 0.0;
+    };
+
+    struct ThruEntry
+    {
+        juce::uint32 word = 0;      // 32-bit packet
+        double receivedMs = 0.0;    // handed over by the input thread
+    };
+
+    struct ThruLane
+    {
+        juce::AbstractFifo fifo { thruCapacity };
+        std::array<ThruEntry, thruCapacity> entries {};
+    };
+
+    // NRPN or RPN number the data entry CCs of a channel currently go to
+    struct ParameterNumber
+    {
+        enum Kind { none, nrpn, rpn };
+
+        int kind = none;
+        int msb = -1, lsb = -1;
+
+        bool operator!= (const ParameterNumber& other) const noexcept
+        {
+            return kind != other.kind || msb != other.msb || lsb != other.lsb;
+        }
+
+        // true for CC 99/98/101/100
+        bool select(int cc, int value) noexcept
+        {
+            const int newKind = (cc == 99 || cc == 98) ? nrpn : (cc == 101 || cc == 100) ? rpn : none;
+
+            if (newKind == none)
+                return false;
+
+            if (newKind != kind)
+                *this = { newKind, -1, -1 };
+
+            (cc == 99 || cc == 101 ? msb : lsb) = value;
+            return true;
+        }
+    };
+
+    bool push(juce::ump::View packet, int size, bool endOfTick) noexcept
+    {
+        const auto scope = fifo.write(1);
+
+        if (scope.blockSize1 + scope.blockSize2 == 0)
+            return false;
+
+        auto& entry = entries[(size_t) (scope.blockSize1 > 0 ? scope.startIndex1 : scope.startIndex2)];
+        entry.size = size;
+        entry.endOfTick = endOfTick;
+
+        if (endOfTick)
+            entry.tickEndMs = juce::Time::getMillisecondCounterHiRes();
+        else
+            std::copy(packet.begin(), packet.end(), entry.words.begin());
+
+        return true;
+    }
+
+    void wake() noexcept
+    {
+       #if JUCE_LINUX
+        sem_post(&wakeUp);
+       #else
+        notify();
+       #endif
+    }
+
+    // ---- Sender thread ----
+    void run() override
+    {
+        applyRealtimeSettings();
+
+        while (!threadShouldExit())
+        {
+            waitForWork();
+
+            // scheduled packets that are due, thru, then one tick, until
+            // none has anything
+            while (!threadShouldExit())
+            {
+                writeScheduled();
+
+                const bool wroteThru = writeThru();
+                const int numTickEntries = getNumEntriesOfNextTick();
+
+                if (numTickEntries > 0)
+                    writeTick(numTickEntries);
+                else if (!wroteThru)
+                    break;
+            }
+        }
+    }
+
+    void applyRealtimeSettings() noexcept
+    {
+        auto& status = telemetry.portRealtime[(size_t) telemetryIndex];
+
+        RealtimeSupport::applyToCurrentThread(realtimeSettings, status);
+
+        if (realtimeSettings.enabled)
+            RealtimeSupport::prefaultStack();
+
+        status.prefault.store(realtimeSettings.enabled ? RealtimeStatus::applied : RealtimeStatus::notRequested,
+                              std::memory_order_relaxed);
+    }
+
+    // Until woken, or until the first scheduled packet is nearly due
+    void waitForWork() noexcept
+    {
+        double dueMs = 0.0;
+        const bool anyScheduled = getNextDue(dueMs);
+        const double sleepMs = dueMs - spinLeadMs - juce::Time::getMillisecondCounterHiRes();
+
+       #if JUCE_LINUX
+        if (!anyScheduled)
+        {
+            while (sem_wait(&wakeUp) != 0 && errno == EINTR) {}
+            return;
+        }
+
+        if (sleepMs <= 0.0)
+            return;
+
+        // the millisecond counter is CLOCK_MONOTONIC
+        timespec deadline {};
+        clock_gettime(CLOCK_MONOTONIC, &deadline);
+
+        const auto nanos = (long long) deadline.tv_nsec + (long long) (sleepMs * 1.0e6);
+        deadline.tv_sec += (time_t) (nanos / 1000000000);
+        deadline.tv_nsec = (long) (nanos % 1000000000);
+
+        while (sem_clockwait(&wakeUp, CLOCK_MONOTONIC, &deadline) != 0 && errno == EINTR) {}
+       #else
+        wait(anyScheduled ? juce::jmax(0, (int) sleepMs) : 100);
+       #endif
+    }
+
+    bool getNextDue(double& dueMs) const noexcept
+    {
+        int start1 = 0, size1 = 0, start2 = 0, size2 = 0;
+        scheduledFifo.prepareToRead(1, start1, size1, start2, size2);
+
+        if (size1 + size2 == 0)
+            return false;
+
+        dueMs = scheduledEntries[(size_t) (size1 > 0 ? start1 : start2)].dueMs;
+        return true;
+    }
+
+    // Scheduled packets due within spinLeadMs, each flushed at its time.
+    // They carry no device state, so a drop isn't reported to the engine.
+    void writeScheduled() noexcept
+    {
+        double dueMs = 0.0;
+
+        while (getNextDue(dueMs))
+        {
+            auto nowMs = juce::Time::getMillisecondCounterHiRes();
+
+            if (dueMs - nowMs > spinLeadMs)
+                return;
+
+            while (nowMs < dueMs)
+            {
+                std::this_thread::yield();
+                nowMs = juce::Time::getMillisecondCounterHiRes();
+            }
+
+            const auto scope = scheduledFifo.read(1);
+            const auto word = scheduledEntries[(size_t) (scope.blockSize1 > 0 ? scope.startIndex1 : scope.startIndex2)].word;
+
+            if (write(word, juce::ump::View(&word)) > 0 && port->flush() == 0)
+                telemetry.clockWritten((juce::Time::getMillisecondCounterHiRes() - dueMs) * 1000.0);
+            else
+                telemetry.clockDropped();
+        }
+    }
+
+    // Entries up to the next end-of-tick mark; 0 while the engine is still
+    // in the middle of that tick
+    int getNumEntriesOfNextTick() const noexcept
+    {
+        int start1 = 0, size1 = 0, start2 = 0, size2 = 0;
+        fifo.prepareToRead(fifo.getNumReady(), start1, size1, start2, size2);
+
+        for (int i = 0; i < size1; ++i)
+            if (entries[(size_t) (start1 + i)].endOfTick)
+                return i + 1;
+
+        for (int i = 0; i < size2; ++i)
+            if (entries[(size_t) (start2 + i)].endOfTick)
+                return size1 + i + 1;
+
+        // a tick too big for the queue lost its mark
+        return fifo.getFreeSpace() == 0 ? size1 + size2 : 0;
+    }
+
+    void writeTick(int numEntries) noexcept
+    {
+        fifo.read(numEntries).forEach([this](int index)
+        {
+            const auto& entry = entries[(size_t) index];
+
+            if (entry.endOfTick)
+            {
+                droppedByPort.fetch_add(port->flush(), std::memory_order_relaxed);
+                telemetry.outputWritten(telemetryIndex,
+                                        (juce::Time::getMillisecondCounterHiRes() - entry.tickEndMs) * 1000.0);
+            }
+            else if (write(entry.words[0], juce::ump::View(entry.words.data())) == 0)
+            {
+                droppedByPort.fetch_add(entry.size, std::memory_order_relaxed);
+            }
+        });
+    }
+
+    // Lane after lane; each source's messages stay in order
+    bool writeThru() noexcept
+    {
+        bool wroteAny = false;
+
+        for (auto& lane : thruLanes)
+            wroteAny = writeThru(lane) || wroteAny;
+
+        return wroteAny;
+    }
+
+    bool writeThru(ThruLane& lane) noexcept
+    {
+        const int numReady = lane.fifo.getNumReady();
+
+        if (numReady == 0)
+            return false;
+
+        const auto scope = lane.fifo.read(numReady);
+
+        scope.forEach([this, &lane](int index)
+        {
+            const auto word = lane.entries[(size_t) index].word;
+            const auto status = (int) ((word >> 16) & 0xff);
+
+            // controller: keep its data entry on the number the input chose
+            if ((status & 0xf0) == 0xb0)
+            {
+                auto& selected = thruNumbers[(size_t) (status & 0x0f)];
+                const int cc = (int) ((word >> 8) & 0x7f);
+
+                if (!selected.select(cc, (int) (word & 0x7f))
+                    && (cc == 6 || cc == 38 || cc == 96 || cc == 97)
+                    && selected.kind != ParameterNumber::none
+                    && selected != deviceNumbers[(size_t) (status & 0x0f)])
+                {
+                    const bool rpn = selected.kind == ParameterNumber::rpn;
+
+                    if (selected.msb >= 0)
+                        writeThruController(status, rpn ? 101 : 99, selected.msb);
+
+                    if (selected.lsb >= 0)
+                        writeThruController(status, rpn ? 100 : 98, selected.lsb);
+                }
+            }
+
+            if (write(word, juce::ump::View(&word)) == 0)
+                telemetry.thruDropped();
+        });
+
+        droppedByPort.fetch_add(port->flush(), std::memory_order_relaxed);
+
+        const double nowMs = juce::Time::getMillisecondCounterHiRes();
+        scope.forEach([this, &lane, nowMs](int index)
+        {
+            telemetry.thruForwarded((nowMs - lane.entries[(size_t) index].receivedMs) * 1000.0);
+        });
+
+        return true;
+    }
+
+    void writeThruController(int status, int cc, int value) noexcept
+    {
+        const juce::uint8 bytes[] { (juce::uint8) status, (juce::uint8) cc, (juce::uint8) value };
+        const auto word = fromBytestream(bytes, 3);
+
+        if (write(word, juce::ump::View(&word)) == 0)
+            telemetry.thruDropped();
+    }
+
+    // Every packet to the device goes through here, to follow the parameter
+    // number each channel's data entry goes to
+    int write(juce::uint32 firstWord, juce::ump::View packet) noexcept
+    {
+        const auto status = (int) ((firstWord >> 16) & 0xff);
+
+        if (juce::ump::Utils::getMessageType(firstWord) == juce::ump::Utils::MessageKind::channelVoice1
+            && (status & 0xf0) == 0xb0)
+            deviceNumbers[(size_t) (status & 0x0f)].select((int) ((firstWord >> 8) & 0x7f), (int) (firstWord & 0x7f));
+
+        return port->send(packet);
+    }
+
+    std::unique_ptr<MidiOutputPort> port;
+    EngineTelemetry& telemetry;
+    const int telemetryIndex;
+    RealtimeSettings realtimeSettings;   // read by the sender when it starts
+
+    juce::AbstractFifo fifo { capacity };
+    std::array<Entry, capacity> entries {};
+
+    juce::AbstractFifo scheduledFifo { scheduledCapacity };
+    std::array<ScheduledEntry, scheduledCapacity> scheduledEntries {};
+
+    std::array<ThruLane, maxThruSources> thruLanes;
+
+    int droppedSinceFlush = 0;               // engine thread
+    std::atomic<int> droppedByPort { 0 };    // sender -> engine
+
+    // sender thread
+    std::array<ParameterNumber, 16> deviceNumbers {}, thruNumbers {};
+
+   #if JUCE_LINUX
+    sem_t wakeUp;
+   #endif
+};
@@ -0,0 +1,232 @@
+#pragma once
+#include <JuceHeader.h>
+#include "MidiOutputPort.h"
+
+#if JUCE_LINUX && JUCE_ALSA
+ #include <alsa/asoundlib.h>
+ #include <cerrno>
+#endif
+
+// ==========================================
+// Running status
+// ==========================================
+// Drops the status byte of a channel message when it repeats the previous
+// one. Realtime bytes (0xF8..0xFF) leave the running status alone; any other
+// system message cancels it.
+struct RunningStatusEncoder
+{
+    // Appends the message to dest (room for size bytes), returns bytes written
+    int encode(const juce::uint8* data, int size, juce::uint8* dest) noexcept
+    {
+        if (size <= 0)
+            return 0;
+
+        const auto status = data[0];
+
+        if (status >= 0xf8)
+        {
+            dest[0] = status;
+            return 1;
+        }
+
+        if (status >= 0xf0)
+            lastStatus = 0;
+        else if (status == lastStatus)
+            return copy(data + 1, size - 1, dest);
+        else
+            lastStatus = status;
+
+        return copy(data, size, dest);
+    }
+
+    void reset() noexcept   { lastStatus = 0; }
+
+    juce::uint8 lastStatus = 0;
+
+private:
+    static int copy(const juce::uint8* data, int size, juce::uint8* dest) noexcept
+    {
+        std::memcpy(dest, data, (size_t) size);
+        return size;
+    }
+};
+
+// ==========================================
+// Raw MIDI output (ALSA rawmidi)
+// ==========================================
+// Writes straight to a hardware port's snd_rawmidi device instead of going
+// through the sequencer: messages are running-status compressed and each
+// tick goes out in a single write(). On NRPN streams (four CCs per value)
+// that's 9 bytes instead of 12.
+//
+// The status byte is sent again at the start of every tick, so a receiver
+// that lost sync recovers within one tick. The device is opened non-blocking;
+// whatever the kernel buffer can't take is kept and written first on the
+// next flush, and a backlog that doesn't drain (e.g. interface unplugged) is
+// dropped and reported rather than stalling the engine.
+//
+// A hardware port can only be opened once: if the sequencer is already
+// connected to it (e.g. another application), opening here fails.
+class RawMidiOutput : public MidiOutputPort
+{
+public:
+    static constexpr int batchCapacity = 4096;
+
+    ~RawMidiOutput() override
+    {
+       #if JUCE_LINUX && JUCE_ALSA
+        snd_rawmidi_close(handle);
+       #endif
+    }
+
+    // Hardware output ports, identifier "hw:card,device,subdevice"
+    static juce::Array<juce::MidiDeviceInfo> getAvailableDevices()
+    {
+        juce::Array<juce::MidiDeviceInfo> result;
+
+       #if JUCE_LINUX && JUCE_ALSA
+        int card = -1;
+
+        while (snd_card_next(&card) == 0 && card >= 0)
+        {
+            snd_ctl_t* ctl = nullptr;
+
+            if (snd_ctl_open(&ctl, ("hw:" + juce::String(card)).toRawUTF8(), 0) < 0)
+                continue;
+
+            snd_rawmidi_info_t* info = nullptr;
+            snd_rawmidi_info_alloca(&info);
+
+            int device = -1;
+
+            while (snd_ctl_rawmidi_next_device(ctl, &device) == 0 && device >= 0)
+            {
+                snd_rawmidi_info_set_device(info, (unsigned int) device);
+                snd_rawmidi_info_set_stream(info, SND_RAWMIDI_STREAM_OUTPUT);
+                snd_rawmidi_info_set_subdevice(info, 0);
+
+                if (snd_ctl_rawmidi_info(ctl, info) < 0)
+                    continue;
+
+                const auto numSubdevices = (int) snd_rawmidi_info_get_subdevices_count(info);
+
+                for (int sub = 0; sub < numSubdevices; ++sub)
+                {
+                    snd_rawmidi_info_set_subdevice(info, (unsigned int) sub);
+
+                    if (snd_ctl_rawmidi_info(ctl, info) < 0)
+                        continue;
+
+                    juce::String name (numSubdevices > 1 ? snd_rawmidi_info_get_subdevice_name(info)
+                                                         : snd_rawmidi_info_get_name(info));
+
+                    result.add({ name.trim() + " (raw)",
+                                 "hw:" + juce::String(card) + "," + juce::String(device) + "," + juce::String(sub) });
+                }
+            }
+
+            snd_ctl_close(ctl);
+        }
+       #endif
+
+        return result;
+    }
+
+    static std::unique_ptr<MidiOutputPort> open(const juce::MidiDeviceInfo& info)
+    {
+       #if JUCE_LINUX && JUCE_ALSA
+        snd_rawmidi_t* handle = nullptr;
+
+        if (snd_rawmidi_open(nullptr, &handle, info.identifier.toRawUTF8(), SND_RAWMIDI_NONBLOCK) < 0)
+            return nullptr;
+
+        return std::unique_ptr<MidiOutputPort>(new RawMidiOutput(handle, info));
+       #else
+        juce::ignoreUnused(info);
+        return nullptr;
+       #endif
+    }
+
+    juce::String getName() const override         { return info.name; }
+    juce::String getIdentifier() const override   { return info.identifier; }
+
+    int send(juce::ump::View packet) noexcept override
+    {
+        juce::uint8 bytes[3];
+        const int size = toBytestream(packet, bytes);
+
+        if (size == 0)
+            return 0;
+
+        if (batchSize + size > batchCapacity)
+            droppedSinceFlush += flush();
+
+        // backlog still in the way: the port isn't draining
+        if (batchSize + size > batchCapacity)
+        {
+            droppedSinceFlush += size;
+            return 0;
+        }
+
+        const int written = encoder.encode(bytes, size, batch.data() + batchSize);
+        batchSize += written;
+        return written;
+    }
+
+    int flush() noexcept override
+    {
+        int dropped = std::exchange(droppedSinceFlush, 0);
+
+       #if JUCE_LINUX && JUCE_ALSA
+        if (batchSize > 0)
+        {
+            const auto result = snd_rawmidi_write(handle, batch.data(), (size_t) batchSize);
+            const int written = result > 0 ? (int) result : 0;
+
+            stalledFlushes = written > 0 ? 0 : stalledFlushes + 1;
+
+            if (written == batchSize)
+            {
+                batchSize = 0;
+            }
+            else if ((result < 0 && result != -EAGAIN) || stalledFlushes > maxStalledFlushes)
+            {
+                // device error, or nothing moved for too long
+                dropped += batchSize - written;
+                batchSize = 0;
+            }
+            else
+            {
+                // keep the tail for the next tick
+                std::memmove(batch.data(), batch.data() + written, (size_t) (batchSize - written));
+                batchSize -= written;
+            }
+        }
+       #else
+        dropped += batchSize;
+        batchSize = 0;
+       #endif
+
+        // the next tick starts with a full status byte
+        encoder.reset();
+        return dropped;
+    }
+
+private:
+   #if JUCE_LINUX && JUCE_ALSA
+    RawMidiOutput(snd_rawmidi_t* h, const juce::MidiDeviceInfo& i) : handle(h), info(i) {}
+
+    snd_rawmidi_t* handle = nullptr;
+   #endif
+
+    // ~1 s at 100 Hz: a DIN link that moves nothing for that long is gone
+    static constexpr int maxStalledFlushes = 100;
+
+    juce::MidiDeviceInfo info;
+    RunningStatusEncoder encoder;
+
+    std::array<juce::uint8, batchCapacity> batch {};
+    int batchSize = 0;
+    int stalledFlushes = 0;
+    int droppedSinceFlush = 0;
+};
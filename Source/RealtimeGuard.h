@@ -0,0 +1,142 @@
+#pragma once
+#include <JuceHeader.h>
+
+// ==========================================
+// Realtime guard
+// ==========================================
+// Marks the code that must never allocate or block: the engine tick and the
+// MIDI input callbacks. Scopes nest and are tracked per thread.
+//
+// Build with -DMODZTAKT_RT_CHECKS=1 (e.g. make CPPFLAGS=-DMODZTAKT_RT_CHECKS=1)
+// to hook global operator new and the pthread mutex entry points: any call
+// made while a Scope is open on the calling thread prints the offending entry
+// point and aborts. With the flag off a Scope is just a thread_local counter.
+
+#ifndef MODZTAKT_RT_CHECKS
+ #define MODZTAKT_RT_CHECKS 0
+#endif
+
+namespace RealtimeGuard
+{
+    inline thread_local int scopeDepth = 0;
+
+    inline bool isActive() noexcept   { return scopeDepth > 0; }
+
+    struct Scope
+    {
+        Scope() noexcept    { ++scopeDepth; }
+        ~Scope() noexcept   { --scopeDepth; }
+
+        JUCE_DECLARE_NON_COPYABLE (Scope)
+    };
+
+    // Deliberately lifts the guard, e.g. around a debug-only UI hook.
+    struct Suspend
+    {
+        Suspend() noexcept : saved (scopeDepth)   { scopeDepth = 0; }
+        ~Suspend() noexcept                       { scopeDepth = saved; }
+
+        const int saved;
+
+        JUCE_DECLARE_NON_COPYABLE (Suspend)
+    };
+
+    // Called from the hooks below; must not allocate or lock itself.
+    inline void violation (const char* entryPoint) noexcept
+    {
+        if (! isActive())
+            return;
+
+        scopeDepth = 0; // don't recurse while reporting
+
+        static constexpr char prefix[] = "\n*** ModzTakt realtime violation: ";
+        static constexpr char suffix[] = " called from a realtime scope\n";
+
+        [[maybe_unused]] auto r1 = ::write (2, prefix, sizeof (prefix) - 1);
+        [[maybe_unused]] auto r2 = ::write (2, entryPoint, std::strlen (entryPoint));
+        [[maybe_unused]] auto r3 = ::write (2, suffix, sizeof (suffix) - 1);
+
+        std::abort();
+    }
+}
+
+#if MODZTAKT_RT_CHECKS && JUCE_LINUX
+// These replace the global definitions, so this header must only be
+// compiled into one translation unit (Main.cpp, via MainComponent.h).
+#include <dlfcn.h>
+#include <pthread.h>
+
+void* operator new (std::size_t size)
+{
+    RealtimeGuard::violation ("operator new");
+
+    if (auto* p = std::malloc (size == 0 ? 1 : size))
+        return p;
+
+    throw std::bad_alloc();
+}
+
+void* operator new[] (std::size_t size)                                  { return operator new (size); }
+void* operator new (std::size_t size, const std::nothrow_t&) noexcept    { RealtimeGuard::violation ("operator new"); return std::malloc (size == 0 ? 1 : size); }
+void* operator new[] (std::size_t size, const std::nothrow_t&) noexcept  { RealtimeGuard::violation ("operator new[]"); return std::malloc (size == 0 ? 1 : size); }
+void operator delete (void* p) noexcept                                  { std::free (p); }
+void operator delete[] (void* p) noexcept                                { std::free (p); }
+void operator delete (void* p, std::size_t) noexcept                     { std::free (p); }
+void operator delete[] (void* p, std::size_t) noexcept                   { std::free (p); }
+
+void* operator new (std::size_t size, std::align_val_t align)
+{
+    RealtimeGuard::violation ("operator new (aligned)");
+
+    const auto alignment = juce::jmax ((std::size_t) align, sizeof (void*));
+
+    if (auto* p = std::aligned_alloc (alignment, (size + alignment - 1) / alignment * alignment))
+        return p;
+
+    throw std::bad_alloc();
+}
+
+void* operator new[] (std::size_t size, std::align_val_t align)              { return operator new (size, align); }
+void operator delete (void* p, std::align_val_t) noexcept                    { std::free (p); }
+void operator delete[] (void* p, std::align_val_t) noexcept                  { std::free (p); }
+void operator delete (void* p, std::size_t, std::align_val_t) noexcept       { std::free (p); }
+void operator delete[] (void* p, std::size_t, std::align_val_t) noexcept     { std::free (p); }
+
+namespace RealtimeGuard
+{
+    // Resolved lazily without locking: a racing first call writes the same value.
+    template <typename Fn>
+    Fn resolve (Fn& cached, const char* name) noexcept
+    {
+        if (cached == nullptr)
+            cached = reinterpret_cast<Fn> (dlsym (RTLD_NEXT, name));
+
+        return cached;
+    }
+
+    using MutexFn      = int (*) (pthread_mutex_t*);
+    using TimedMutexFn = int (*) (pthread_mutex_t*, const struct timespec*);
+
+    inline MutexFn realMutexLock = nullptr;
+    inline MutexFn realMutexTryLock = nullptr;
+    inline TimedMutexFn realMutexTimedLock = nullptr;
+}
+
+extern "C" int pthread_mutex_lock (pthread_mutex_t* m)
+{
+    RealtimeGuard::violation ("pthread_mutex_lock");
+    return RealtimeGuard::resolve (RealtimeGuard::realMutexLock, "pthread_mutex_lock") (m);
+}
+
+extern "C" int pthread_mutex_trylock (pthread_mutex_t* m)
+{
+    RealtimeGuard::violation ("pthread_mutex_trylock");
+    return RealtimeGuard::resolve (RealtimeGuard::realMutexTryLock, "pthread_mutex_trylock") (m);
+}
+
+extern "C" int pthread_mutex_timedlock (pthread_mutex_t* m, const struct timespec* t)
+{
+    RealtimeGuard::violation ("pthread_mutex_timedlock");
+    return RealtimeGuard::resolve (RealtimeGuard::realMutexTimedLock, "pthread_mutex_timedlock") (m, t);
+}
+#endif
@@ -0,0 +1,130 @@
+#pragma once
+#include <JuceHeader.h>
+#include "EngineTelemetry.h"
+
+#if JUCE_LINUX
+ #include <pthread.h>
+ #include <sched.h>
+ #include <sys/mman.h>
+ #include <sys/resource.h>
+ #include <unistd.h>
+#endif
+
+// ==========================================
+// Realtime deployment
+// ==========================================
+// Opt-in settings for threads that generate or send MIDI on a dedicated rig:
+// SCHED_FIFO priority (bounded by RLIMIT_RTPRIO unless running as root),
+// pinning to one core, mlockall() and prefaulting. Each step reports its
+// outcome into a RealtimeStatus so the telemetry window shows what held.
+//
+// JUCE's startRealtimeThread() maps to SCHED_RR on Linux, so the policy is
+// set here directly from inside the thread instead.
+struct RealtimeSettings
+{
+    bool enabled = false;
+    int priority = 70;   // SCHED_FIFO 1..99, clamped to what the rlimit allows
+    int cpuCore = -1;    // -1 = let the scheduler choose
+};
+
+namespace RealtimeSupport
+{
+    static constexpr size_t stackPrefaultBytes = 256 * 1024;
+
+    // Highest SCHED_FIFO priority this process may request, 0 if none.
+    inline int maxAllowedPriority() noexcept
+    {
+       #if JUCE_LINUX
+        const int maxFifo = sched_get_priority_max (SCHED_FIFO);
+
+        if (geteuid() == 0)
+            return maxFifo;
+
+        rlimit limit {};
+        if (getrlimit (RLIMIT_RTPRIO, &limit) != 0)
+            return 0;
+
+        if (limit.rlim_cur == RLIM_INFINITY)
+            return maxFifo;
+
+        return (int) juce::jmin ((rlim_t) maxFifo, limit.rlim_cur);
+       #else
+        return 0;
+       #endif
+    }
+
+    inline int getNumCores() noexcept
+    {
+        return juce::SystemStats::getNumCpus();
+    }
+
+    // Process-wide: called from the message thread before the engine starts.
+    inline void applyMemoryLock (bool shouldLock, RealtimeStatus& status) noexcept
+    {
+       #if JUCE_LINUX
+        if (! shouldLock)
+        {
+            munlockall();
+            status.memoryLock.store (RealtimeStatus::notRequested, std::memory_order_relaxed);
+            return;
+        }
+
+        const bool ok = mlockall (MCL_CURRENT | MCL_FUTURE) == 0;
+        status.memoryLock.store (ok ? RealtimeStatus::applied : RealtimeStatus::failed, std::memory_order_relaxed);
+       #else
+        status.memoryLock.store (shouldLock ? RealtimeStatus::failed : RealtimeStatus::notRequested, std::memory_order_relaxed);
+       #endif
+    }
+
+    // Touch the pages the thread's stack will grow into so the first deep
+    // call chain (e.g. into the ALSA client) doesn't take a page fault.
+    [[gnu::noinline]] inline void prefaultStack() noexcept
+    {
+        volatile char stackPages[stackPrefaultBytes];
+
+        for (size_t i = 0; i < sizeof (stackPages); i += 4096)
+            stackPages[i] = 0;
+    }
+
+    // Applies scheduling and affinity to the calling thread.
+    inline void applyToCurrentThread (const RealtimeSettings& settings, RealtimeStatus& status) noexcept
+    {
+        status.scheduling.store (RealtimeStatus::notRequested, std::memory_order_relaxed);
+        status.affinity.store (RealtimeStatus::notRequested, std::memory_order_relaxed);
+        status.priority.store (0, std::memory_order_relaxed);
+        status.cpuCore.store (-1, std::memory_order_relaxed);
+
+        if (! settings.enabled)
+            return;
+
+       #if JUCE_LINUX
+        // ---- Scheduling ----
+        const int priority = juce::jmin (settings.priority, maxAllowedPriority());
+        bool scheduled = false;
+
+        if (priority > 0)
+        {
+            sched_param param {};
+            param.sched_priority = priority;
+            scheduled = pthread_setschedparam (pthread_self(), SCHED_FIFO, &param) == 0;
+        }
+
+        status.scheduling.store (scheduled ? RealtimeStatus::applied : RealtimeStatus::failed, std::memory_order_relaxed);
+        status.priority.store (scheduled ? priority : 0, std::memory_order_relaxed);
+
+        // ---- Affinity ----
+        if (juce::isPositiveAndBelow (settings.cpuCore, getNumCores()))
+        {
+            cpu_set_t cpus;
+            CPU_ZERO (&cpus);
+            CPU_SET (settings.cpuCore, &cpus);
+
+            const bool pinned = pthread_setaffinity_np (pthread_self(), sizeof (cpus), &cpus) == 0;
+            status.affinity.store (pinned ? RealtimeStatus::applied : RealtimeStatus::failed, std::memory_order_relaxed);
+            status.cpuCore.store (pinned ? settings.cpuCore : -1, std::memory_order_relaxed);
+        }
+       #else
+        status.scheduling.store (RealtimeStatus::failed, std::memory_order_relaxed);
+       #endif
+    }
+}
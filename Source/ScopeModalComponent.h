@@ -1,6 +1,11 @@
 #pragma once
 #include <JuceHeader.h>
+#include "EngineProbes.h"
 
+// Round oscilloscope overlay. The bezel is rendered once into an image;
+// traces live in a second image that is scrolled left as time passes and
+// only gets the newly arrived segments drawn at its right edge, so the cost
+// of a frame depends on the number of new samples, not on the history length.
 template <size_t N>
 
 class ScopeModalComponent : public juce::Component,
@@ -8,14 +13,18 @@ class ScopeModalComponent : public juce::Component,
 {
 public:
 
-    using LFOValuesArray = std::array<std::atomic<float>, N>;
     using RoutesEnabledArray = std::array<bool, N>;
 
-    ScopeModalComponent(LFOValuesArray& lfoValuesRefs, RoutesEnabledArray& lfoRoutesEnabled)
-        : lfoValues(lfoValuesRefs), lfoRoutesEnabled(lfoRoutesEnabled)
+    static constexpr int maxHistory = 8192;  // samples kept per channel for full redraws
+
+    // Channel i shows probe routeProbe(i) unless changed with setChannelProbe()
+    ScopeModalComponent(EngineProbes::Set& probeSet, RoutesEnabledArray& lfoRoutesEnabled)
+        : probes(probeSet), lfoRoutesEnabled(lfoRoutesEnabled)
     {
         for (size_t i = 0; i < N; ++i)
         {
+            channelProbes[i] = EngineProbes::routeProbe((int) i);
+
             addAndMakeVisible(routeButtons[i]);
 
             routeButtons[i].setToggleState(lfoRoutesEnabled[i],
@@ -24,6 +33,8 @@ public:
             routeButtons[i].onClick = [this, i]()
             {
                 this->lfoRoutesEnabled[i] = routeButtons[i].getToggleState();
+                updateProbeAttachments();
+                redrawTraces();
 
                 if (!anyRouteEnabled())
                 {
@@ -39,6 +50,34 @@ public:
             };
         }
         setOpaque(false);
+        updateProbeAttachments();
+    }
+
+    ~ScopeModalComponent() override
+    {
+        for (auto id : channelProbes)
+            probes[id].detach();
+    }
+
+    void setChannelProbe(size_t channel, EngineProbes::Id id)
+    {
+        jassert (channel < N);
+
+        if (channelProbes[channel] == id)
+            return;
+
+        probes[channelProbes[channel]].detach();
+        channelProbes[channel] = id;
+        histories[channel].clear();
+        updateProbeAttachments();
+        redrawTraces();
+    }
+
+    // Visible time span; with the 100 Hz engine, 20 s is 2000 points per trace
+    void setHistoryLength(double milliseconds)
+    {
+        historyMs = juce::jlimit(100.0, 60000.0, milliseconds);
+        redrawTraces();
     }
 
     // capture click only inside the circular shape of window
@@ -77,6 +116,9 @@ public:
             b.setBounds(x, toggleArea.getY() + 15, buttonWidth, toggleArea.getHeight());
             x += buttonWidth + spacing;
         }
+
+        renderBezel();
+        redrawTraces();
     }
 
 
@@ -90,88 +132,252 @@ public:
 
     void paint(juce::Graphics& g) override
     {
+        if (!anyRouteEnabled() || bezelImage.isNull())
+            return;
+
+        g.drawImageAt(bezelImage, 0, 0);
+
+        g.saveState();
+        g.reduceClipRegion(clipPath);
+        g.drawImageAt(traceImage, plotBounds.getX(), plotBounds.getY());
+        g.restoreState(); // ⬅ restore unclipped state
+    }
+
+    std::function<void()> onAllRoutesDisabled;
+
+private:
+    struct Point
+    {
+        double timeMs;
+        float value; // -1..+1
+    };
+
+    // Fixed ring of the most recent samples of one channel
+    struct History
+    {
+        void push(const Point& p) noexcept
+        {
+            points[(size_t) ((start + size) % maxHistory)] = p;
+
+            if (size < maxHistory)
+                ++size;
+            else
+                start = (start + 1) % maxHistory;
+        }
+
+        const Point& operator[](int i) const noexcept   { return points[(size_t) ((start + i) % maxHistory)]; }
+
+        void clear() noexcept   { start = size = 0; drawn = 0; }
+
+        std::array<Point, maxHistory> points {};
+        int start = 0, size = 0;
+        int drawn = 0; // leading points already in the trace image
+    };
+
+    // a gap longer than this (route disabled, one-shot finished) breaks the line
+    static constexpr double maxSegmentGapMs = 100.0;
+
+    // the right edge trails real time so samples land before their column scrolls in
+    static constexpr double displayLatencyMs = 30.0;
+
+    void timerCallback() override
+    {
+        if (!anyRouteEnabled() || traceImage.isNull())
+            return;   // sleep completely
 
-        for (size_t i = 0; i < lfoValues.size(); ++i)
+        // every sample the engine produced since the last frame
+        for (size_t i = 0; i < N; ++i)
         {
             if (!lfoRoutesEnabled[i])
                 continue;
 
-            auto r = getLocalBounds().toFloat();
-            auto centre = r.getCentre();
-            const float radius = juce::jmin(r.getWidth(), r.getHeight()) * 0.5f - 2.0f;
-
-            g.setColour(juce::Colours::darkgrey);
-            g.fillEllipse(r);
+            const auto info = EngineProbes::getInfo(channelProbes[i]);
+            const float scale = 2.0f / (info.maxValue - info.minValue);
+            auto& history = histories[i];
 
-            g.saveState();
+            probes[channelProbes[i]].drain([&](const EngineProbes::Sample& sample)
             {
-                juce::Path clipPath;
-                clipPath.addEllipse(r);
-                g.reduceClipRegion(clipPath);
+                const bool full = history.size == maxHistory;
 
-                g.setColour(juce::Colour(0xff003300));
-                g.drawEllipse(r, 2.0f);
+                history.push({ sample.timeMs,
+                               juce::jlimit(-1.0f, 1.0f, (sample.value - info.minValue) * scale - 1.0f) });
 
-                // Draw each active LFO waveform
-                for (size_t i = 0; i < lfoValues.size(); ++i)
-                {
-                    if (!lfoRoutesEnabled[i])
-                        continue;
-
-                    juce::Path p;
-                    for (int j = 0; j < bufferSize; ++j)
-                    {
-                        const int idx = (writeIndices[i] + j) % bufferSize;
-                        const float xNorm = float(j) / (bufferSize - 1);
-                        const float yNorm = buffers[i][idx];
-
-                        const float x = centre.x + (xNorm - 0.5f) * (radius - 8.0f) * 2.0f;
-                        const float y = centre.y - yNorm * (radius - 8.0f);
-
-                        if (j == 0)
-                            p.startNewSubPath(x, y);
-                        else
-                            p.lineTo(x, y);
-                    }
-
-                    // glow pass
-                    g.setColour(juce::Colour::fromHSV(i / float(N), 0.8f, 0.9f, 0.2f));
-                    g.strokePath(p, juce::PathStrokeType(3.5f));
-
-                    // core beam
-                    g.setColour(juce::Colour::fromHSV(i / float(N), 0.8f, 0.9f, 1.0f));
-                    g.strokePath(p, juce::PathStrokeType(1.5f));
-                }
-            }
-            g.restoreState(); // ⬅ restore unclipped state
+                // the oldest point was overwritten: indices moved down by one
+                if (full)
+                    history.drawn = juce::jmax(0, history.drawn - 1);
+            });
         }
+
+        // scroll by whole pixels
+        const double msPerPixel = getMsPerPixel();
+        const double targetEdgeMs = juce::Time::getMillisecondCounterHiRes() - displayLatencyMs;
+        const int pixels = (int) ((targetEdgeMs - rightEdgeMs) / msPerPixel);
+
+        if (pixels <= 0)
+            return;
+
+        if (pixels >= traceImage.getWidth())
+        {
+            rightEdgeMs = targetEdgeMs;
+            redrawTraces();
+            return;
+        }
+
+        rightEdgeMs += pixels * msPerPixel;
+
+        traceImage.moveImageSection(0, 0, pixels, 0, traceImage.getWidth() - pixels, traceImage.getHeight());
+        traceImage.clear({ traceImage.getWidth() - pixels, 0, pixels, traceImage.getHeight() });
+
+        {
+            juce::Graphics g(traceImage);
+
+            for (size_t i = 0; i < N; ++i)
+                if (lfoRoutesEnabled[i])
+                    drawNewSegments(g, i);
+        }
+
+        repaint(plotBounds);
     }
 
-    std::function<void()> onAllRoutesDisabled;
+    // Appends the segments between the last drawn point and the right edge
+    void drawNewSegments(juce::Graphics& g, size_t channel)
+    {
+        auto& history = histories[channel];
 
-private:
-    
-    void timerCallback() override
+        // keep the last drawn point as the start of the new segments
+        int first = juce::jmax(0, history.drawn - 1);
+        int last = first;
+
+        while (last < history.size && history[last].timeMs <= rightEdgeMs)
+            ++last;
+
+        if (last - first >= 2)
+            strokeTrace(g, channel, first, last);
+
+        history.drawn = juce::jmax(history.drawn, last);
+    }
+
+    // Full rebuild from the histories (resize, channel or span change)
+    void redrawTraces()
     {
-        if (!anyRouteEnabled())
-            return;   // sleep completely
+        if (plotBounds.isEmpty())
+            return;
+
+        if (traceImage.isNull() || traceImage.getBounds() != plotBounds.withZeroOrigin())
+            traceImage = juce::Image(juce::Image::ARGB, plotBounds.getWidth(), plotBounds.getHeight(), true);
+        else
+            traceImage.clear(traceImage.getBounds());
+
+        rightEdgeMs = juce::Time::getMillisecondCounterHiRes() - displayLatencyMs;
+
+        juce::Graphics g(traceImage);
+
+        for (size_t i = 0; i < N; ++i)
+        {
+            auto& history = histories[i];
+            history.drawn = 0;
+
+            if (!lfoRoutesEnabled[i] || history.size == 0)
+                continue;
+
+            const double leftEdgeMs = rightEdgeMs - historyMs;
+
+            int first = 0;
+            while (first < history.size && history[first].timeMs < leftEdgeMs)
+                ++first;
+
+            int last = first;
+            while (last < history.size && history[last].timeMs <= rightEdgeMs)
+                ++last;
+
+            if (last - first >= 2)
+                strokeTrace(g, i, first, last);
+
+            history.drawn = last;
+        }
+
+        repaint(plotBounds);
+    }
+
+    void strokeTrace(juce::Graphics& g, size_t channel, int first, int last)
+    {
+        const auto& history = histories[channel];
+        const double msPerPixel = getMsPerPixel();
+        const float width = (float) traceImage.getWidth();
+        const float halfHeight = (float) traceImage.getHeight() * 0.5f;
+
+        juce::Path p;
+        double previousTime = 0.0;
 
-        for (size_t i = 0; i < lfoValues.size(); ++i)
+        for (int j = first; j < last; ++j)
         {
-            if (lfoRoutesEnabled[i])
-                pushSample(lfoValues[i].load(std::memory_order_relaxed), i);
+            const auto& point = history[j];
+
+            const float x = width - (float) ((rightEdgeMs - point.timeMs) / msPerPixel);
+            const float y = halfHeight - point.value * halfHeight;
+
+            if (j == first || point.timeMs - previousTime > maxSegmentGapMs)
+                p.startNewSubPath(x, y);
+            else
+                p.lineTo(x, y);
+
+            previousTime = point.timeMs;
         }
 
-        repaint();
+        // glow pass
+        g.setColour(juce::Colour::fromHSV(channel / float(N), 0.8f, 0.9f, 0.2f));
+        g.strokePath(p, juce::PathStrokeType(3.5f));
+
+        // core beam
+        g.setColour(juce::Colour::fromHSV(channel / float(N), 0.8f, 0.9f, 1.0f));
+        g.strokePath(p, juce::PathStrokeType(1.5f));
+    }
+
+    void renderBezel()
+    {
+        auto r = getLocalBounds().toFloat();
+
+        if (r.isEmpty())
+            return;
+
+        auto centre = r.getCentre();
+        const float radius = juce::jmin(r.getWidth(), r.getHeight()) * 0.5f - 2.0f;
+        const float plotRadius = radius - 8.0f;
+
+        plotBounds = juce::Rectangle<float>(centre.x - plotRadius, centre.y - plotRadius,
+                                            plotRadius * 2.0f, plotRadius * 2.0f).getSmallestIntegerContainer();
+
+        clipPath.clear();
+        clipPath.addEllipse(r);
+
+        bezelImage = juce::Image(juce::Image::ARGB, getWidth(), getHeight(), true);
+        juce::Graphics g(bezelImage);
+
+        g.setColour(juce::Colours::darkgrey);
+        g.fillEllipse(r);
+
+        g.reduceClipRegion(clipPath);
+        g.setColour(juce::Colour(0xff003300));
+        g.drawEllipse(r, 2.0f);
     }
 
+    double getMsPerPixel() const noexcept
+    {
+        return historyMs / juce::jmax(1, plotBounds.getWidth());
+    }
 
-    // Push a new LFO sample (-1..+1 expected)
-    void pushSample(float v, size_t lfoIndex)
+    // a probe is attached while its channel is shown
+    void updateProbeAttachments()
     {
-        v = juce::jlimit(-1.0f, 1.0f, v);
-        buffers[lfoIndex][writeIndices[lfoIndex]] = v;
-        writeIndices[lfoIndex] = (writeIndices[lfoIndex] + 1) % bufferSize;
+        for (size_t i = 0; i < N; ++i)
+        {
+            auto& ring = probes[channelProbes[i]];
+
+            if (lfoRoutesEnabled[i] && !ring.isAttached())
+                ring.attach();
+            else if (!lfoRoutesEnabled[i])
+                ring.detach();
+        }
     }
 
     // used to disable scope when unused
@@ -184,14 +390,18 @@ private:
         return false;
     }
 
-    LFOValuesArray& lfoValues;
+    EngineProbes::Set& probes;
     RoutesEnabledArray& lfoRoutesEnabled;
+    std::array<EngineProbes::Id, N> channelProbes;
 
-    static constexpr int bufferSize = 128;
+    std::array<History, N> histories;
+    double historyMs = 2560.0;  // 256 engine ticks
+    double rightEdgeMs = 0.0;   // time at the trace image's right edge
 
-    std::array<std::array<float, bufferSize>, N> buffers;
-    std::array<int, N> writeIndices = {};
+    juce::Image bezelImage, traceImage;
+    juce::Path clipPath;
+    juce::Rectangle<int> plotBounds;
 
     // toggles to display routes
     std::array<juce::ToggleButton, N> routeButtons;
-};
\ No newline at end of file
+};
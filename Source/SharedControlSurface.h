@@ -0,0 +1,550 @@
+#pragma once
+#include <JuceHeader.h>
+#include "ModulationEngine.h"
+#include "MidiDeviceManager.h"
+#include "PresetBank.h"
+#include "EngineProbes.h"
+#include "EngineTelemetry.h"
+#include "RealtimeSupport.h"
+
+#include <fcntl.h>
+#include <signal.h>
+#include <semaphore.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+// ==========================================
+// Shared control surface
+// ==========================================
+// The POSIX shared memory segment between the engine process (see
+// EngineDaemon.h) and its front-ends. It holds:
+//
+//  - a command ring: front-ends push settings snapshots, start/stop and
+//    device changes, then post the segment's semaphore;
+//  - the status: the engine's current settings and device state, written
+//    by the engine only and read under a sequence counter;
+//  - the engine's EngineTelemetry itself, so a front-end's telemetry window
+//    reads the counters the engine thread writes;
+//  - probe and MIDI monitor rings, filled by the engine process while a
+//    front-end asks for them, read by every front-end with its own cursor.
+//
+// Everything in the segment is plain data or lock-free atomics, and nothing
+// in it points anywhere: both sides map it at different addresses. One
+// engine owns it, which a juce::InterProcessLock enforces; that lock goes
+// with the process, so an engine that crashed is replaced by the next one,
+// which starts over on a new segment. Front-ends notice by the engine's pid
+// no longer running and attach again.
+class SharedControlSurface
+{
+public:
+    static constexpr juce::uint32 layoutMagic = 0x4d5a544b;   // "MZTK"
+    static constexpr juce::uint32 layoutVersion = 6;
+
+    static constexpr int maxClients = 8;
+    static constexpr int maxDevices = 32;
+    static constexpr int commandCapacity = 64;     // power of two
+    static constexpr int monitorCapacity = 256;
+
+    // A device as the engine's MidiDeviceManager knows it
+    struct Device
+    {
+        std::array<char, 64> name {};
+        std::array<char, 128> identifier {};
+
+        static Device from(const juce::MidiDeviceInfo& info) noexcept
+        {
+            Device d;
+            info.name.copyToUTF8(d.name.data(), d.name.size());
+            info.identifier.copyToUTF8(d.identifier.data(), d.identifier.size());
+            return d;
+        }
+
+        juce::MidiDeviceInfo toInfo() const
+        {
+            return { juce::String::fromUTF8(name.data()), juce::String::fromUTF8(identifier.data()) };
+        }
+    };
+
+    // What the engine publishes after every command and, while front-ends
+    // are attached, at EngineDaemon::publishHz
+    struct Status
+    {
+        // bumped by every settings command; 0: nobody has set any yet
+        juce::uint64 settingsRevision = 0;
+        int settingsSender = 0;              // pid of the front-end that sent them
+        ModulationEngine::Settings settings {};
+
+        juce::uint64 devicesRevision = 0;    // lists or selections changed
+        std::array<Device, maxDevices> outputs {}, inputs {};
+        int numOutputs = 0, numInputs = 0;
+        std::array<Device, MidiDeviceManager::maxOutputs> selectedOutputs {};
+        std::array<Device, MidiDeviceManager::maxInputs> selectedInputs {};
+        std::array<int, MidiDeviceManager::maxInputs> inputRoles {};
+        int numOutputSlots = 0, numInputSlots = 0;
+        int thruOutput = -1;
+        int thruKinds = 0;
+        int backend = 0;                     // MidiDeviceManager::Backend
+        bool engineDrivenByJack = false;
+        juce::uint64 backendFailures = 0;    // JACK asked for without a server
+
+        RealtimeSettings realtime {};
+        bool lfoActive = false;
+        bool noteOffStop = false;
+        double bpm = 0.0;
+        bool traceEnabled = false;
+
+        bool automationRecording = false;
+        bool automationPlaying = false;
+        int automationLanes = 0;             // of the clip there is, 0: none
+        int automationBars = 0;
+        juce::uint64 automationFailures = 0; // export or import that didn't work, or left lanes out
+
+        juce::uint64 presetsRevision = 0;    // bank changed
+        std::array<std::array<char, PresetBank::maxNameBytes>, PresetBank::numSlots> presetNames {};   // empty: unused
+        int activePreset = -1;               // last recalled or stored
+        juce::uint64 presetFailures = 0;     // export, import or recall that didn't work
+
+        int restartNote = -1;                // last LFO restart, (channel << 8) | note
+    };
+
+    struct Command
+    {
+        enum Kind
+        {
+            hello,          // a front-end attached: publish the status
+            setSettings,    // settings
+            startLfo,       // (re)starts from the start phase
+            stopLfo,
+            noteOffStop,    // value: stop the LFO on Note-Off
+            selectOutput,   // slot, device (no identifier: none)
+            selectInput,    // slot, device
+            inputRoles,     // slot, value: MergedMidiInput roles
+            thruOutput,     // value: output slot, -1 = off
+            thruKinds,      // value: MergedMidiInput roles
+            backend,        // value: MidiDeviceManager::Backend
+            setRealtime,    // realtime
+            startTrace,
+            stopTrace,      // path: where to write it, empty to drop it
+            recordAutomation,   // value: record (stopping keeps the clip)
+            playAutomation,     // value: loop the clip along the transport
+            exportAutomation,   // path: MIDI file to write
+            importAutomation,   // path: MIDI file to read
+            storePreset,        // slot, path: name
+            clearPreset,        // slot
+            recallPreset,       // slot, value: SwitchPoint, | resetPhasesFlag
+            exportPresets,      // path: JSON file to write
+            importPresets,      // path: JSON file to read
+            quit            // stops the engine process
+        };
+
+        static constexpr int resetPhasesFlag = 0x100;   // recallPreset: restart the LFO phases
+
+        Kind kind = hello;
+        int sender = 0;     // pid
+        int slot = 0;
+        int value = 0;
+        Device device {};
+        std::array<char, 512> path {};
+        RealtimeSettings realtime {};
+        ModulationEngine::Settings settings {};
+    };
+
+    struct MonitorEvent
+    {
+        std::array<juce::uint8, 3> bytes {};
+        int size = 0;
+        bool incoming = false;
+    };
+
+    // ==========================================
+    // Single writer snapshot
+    // ==========================================
+    // A sequence counter around a trivially copyable value: odd while the
+    // writer is copying, so a reader that saw it change copies again.
+    template <typename T>
+    class Snapshot
+    {
+    public:
+        static_assert (std::is_trivially_copyable_v<T>, "copied across processes as bytes");
+
+        void write(const T& newValue) noexcept
+        {
+            const auto s = sequence.load(std::memory_order_relaxed);
+            sequence.store(s + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+
+            std::memcpy(&value, &newValue, sizeof(T));
+            sequence.store(s + 2, std::memory_order_release);
+        }
+
+        // false if the writer kept it busy for every attempt
+        bool read(T& out) const noexcept
+        {
+            for (int attempt = 0; attempt < 64; ++attempt)
+            {
+                const auto before = sequence.load(std::memory_order_acquire);
+
+                if ((before & 1) != 0)
+                {
+                    juce::Thread::yield();
+                    continue;
+                }
+
+                std::memcpy(&out, &value, sizeof(T));
+                std::atomic_thread_fence(std::memory_order_acquire);
+
+                if (sequence.load(std::memory_order_relaxed) == before)
+                    return true;
+            }
+
+            return false;
+        }
+
+    private:
+        std::atomic<juce::uint64> sequence { 0 };
+        T value {};
+    };
+
+    // ==========================================
+    // Broadcast ring
+    // ==========================================
+    // One producer that never waits; any number of readers, each with its
+    // own cursor. A reader that falls a whole ring behind skips what was
+    // overwritten instead of holding the producer up.
+    template <typename T, int capacity>
+    class BroadcastRing
+    {
+    public:
+        void push(const T& item) noexcept
+        {
+            const auto n = written.load(std::memory_order_relaxed);
+            items[(size_t) (n % capacity)] = item;
+            written.store(n + 1, std::memory_order_release);
+        }
+
+        juce::uint64 getNumWritten() const noexcept   { return written.load(std::memory_order_acquire); }
+
+        // Calls fn(const T&) for every item pushed since cursor, and moves it on
+        template <typename Fn>
+        void read(juce::uint64& cursor, Fn&& fn) const
+        {
+            const auto end = getNumWritten();
+
+            if (end - cursor > (juce::uint64) capacity)
+                cursor = end - (juce::uint64) capacity;
+
+            for (; cursor < end; ++cursor)
+            {
+                const T item = items[(size_t) (cursor % capacity)];
+                std::atomic_thread_fence(std::memory_order_acquire);
+
+                // the producer started on this slot again while it was copied
+                if (written.load(std::memory_order_relaxed) >= cursor + (juce::uint64) capacity)
+                    continue;
+
+                fn(item);
+            }
+        }
+
+    private:
+        std::atomic<juce::uint64> written { 0 };
+        std::array<T, capacity> items {};
+    };
+
+    // A ring front-ends read from while they keep asking for it
+    template <typename T, int capacity>
+    struct Feed
+    {
+        static constexpr double keepAliveMs = 1000.0;
+
+        BroadcastRing<T, capacity> ring;
+        std::atomic<double> wantedUntilMs { 0.0 };
+
+        // front-end, at every read
+        void want() noexcept   { wantedUntilMs.store(juce::Time::getMillisecondCounterHiRes() + keepAliveMs); }
+
+        bool isWanted() const noexcept   { return juce::Time::getMillisecondCounterHiRes() < wantedUntilMs.load(); }
+    };
+
+    using ProbeFeed = Feed<EngineProbes::Sample, EngineProbes::Ring::capacity>;
+    using MonitorFeed = Feed<MonitorEvent, monitorCapacity>;
+
+    // ==========================================
+    // Factories
+    // ==========================================
+    // Engine process: a new segment, or nullptr if another engine runs
+    static std::unique_ptr<SharedControlSurface> create()
+    {
+        auto lock = std::make_unique<juce::InterProcessLock>("ModzTaktEngine");
+
+        if (!lock->enter(0))
+            return nullptr;
+
+        // left behind by an engine that didn't exit cleanly; front-ends still
+        // mapping it keep their copy until they notice
+        const auto name = getSegmentName();
+        shm_unlink(name.toRawUTF8());
+
+        const int fd = shm_open(name.toRawUTF8(), O_CREAT | O_EXCL | O_RDWR, 0600);
+
+        if (fd < 0)
+            return nullptr;
+
+        void* memory = ftruncate(fd, (off_t) sizeof(Segment)) == 0
+                           ? mmap(nullptr, sizeof(Segment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)
+                           : MAP_FAILED;
+        close(fd);
+
+        if (memory == MAP_FAILED)
+        {
+            shm_unlink(name.toRawUTF8());
+            return nullptr;
+        }
+
+        auto* segment = new (memory) Segment();
+        sem_init(&segment->commandPosted, 1, 0);
+        segment->magic = layoutMagic;
+        segment->version = layoutVersion;
+        segment->enginePid.store((int) getpid(), std::memory_order_release);
+
+        return std::unique_ptr<SharedControlSurface>(new SharedControlSurface(segment, std::move(lock)));
+    }
+
+    // Front-end: the running engine's segment, or nullptr if there is none
+    // (or it's from another build, or every client slot is taken)
+    static std::unique_ptr<SharedControlSurface> attach()
+    {
+        const int fd = shm_open(getSegmentName().toRawUTF8(), O_RDWR, 0);
+
+        if (fd < 0)
+            return nullptr;
+
+        struct stat info {};
+        void* memory = fstat(fd, &info) == 0 && info.st_size == (off_t) sizeof(Segment)
+                           ? mmap(nullptr, sizeof(Segment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)
+                           : MAP_FAILED;
+        close(fd);
+
+        if (memory == MAP_FAILED)
+            return nullptr;
+
+        auto* segment = static_cast<Segment*>(memory);
+        const int pid = segment->enginePid.load(std::memory_order_acquire);
+
+        if (pid == 0 || segment->magic != layoutMagic || segment->version != layoutVersion || !isRunning(pid))
+        {
+            munmap(memory, sizeof(Segment));
+            return nullptr;
+        }
+
+        std::unique_ptr<SharedControlSurface> surface(new SharedControlSurface(segment, nullptr));
+
+        for (auto& slot : segment->clientPids)
+        {
+            int expected = 0;
+
+            if (slot.compare_exchange_strong(expected, (int) getpid()))
+            {
+                surface->clientSlot = &slot;
+                return surface;
+            }
+        }
+
+        return nullptr;
+    }
+
+    // The segment itself stays mapped by whoever else uses it. Its
+    // semaphore and atomics are never destroyed: a front-end may be
+    // posting while the engine leaves.
+    ~SharedControlSurface()
+    {
+        if (engineLock != nullptr)
+        {
+            segment->enginePid.store(0);
+            shm_unlink(getSegmentName().toRawUTF8());
+        }
+
+        if (clientSlot != nullptr)
+            clientSlot->store(0);
+
+        munmap(segment, sizeof(Segment));
+    }
+
+    EngineTelemetry& getTelemetry() noexcept   { return segment->telemetry; }
+
+    ProbeFeed& getProbeFeed(EngineProbes::Id id) noexcept   { return segment->probes[(size_t) id]; }
+    MonitorFeed& getMonitorFeed() noexcept                  { return segment->monitor; }
+
+    // ---- Front-end ----
+    // Any thread of the front-end. False if the ring is full.
+    bool send(Command command) noexcept
+    {
+        command.sender = (int) getpid();
+
+        if (!segment->commands.push(command))
+            return false;
+
+        sem_post(&segment->commandPosted);
+        return true;
+    }
+
+    bool readStatus(Status& out) const noexcept   { return segment->status.read(out); }
+
+    // False once the engine that created this segment is gone
+    bool isEngineRunning() const noexcept
+    {
+        const int pid = segment->enginePid.load(std::memory_order_relaxed);
+        return pid != 0 && isRunning(pid);
+    }
+
+    // ---- Engine process ----
+    // Command thread: true when a front-end posted (or wakeWaiter() was called)
+    bool waitForCommand() noexcept
+    {
+        while (sem_wait(&segment->commandPosted) != 0)
+            if (errno != EINTR)
+                return false;
+
+        return true;
+    }
+
+    void wakeWaiter() noexcept   { sem_post(&segment->commandPosted); }
+
+    // Message thread (the ring's one consumer)
+    bool nextCommand(Command& command) noexcept   { return segment->commands.pop(command); }
+
+    void publishStatus(const Status& status) noexcept   { segment->status.write(status); }
+
+    // Front-ends attached; slots of those that died without detaching are freed
+    int getNumClients() noexcept
+    {
+        int count = 0;
+
+        for (auto& slot : segment->clientPids)
+        {
+            int pid = slot.load();
+
+            if (pid != 0 && !isRunning(pid))
+                slot.compare_exchange_strong(pid, 0);
+            else if (pid != 0)
+                ++count;
+        }
+
+        return count;
+    }
+
+private:
+    // ==========================================
+    // Command ring
+    // ==========================================
+    // Bounded multi-producer queue (one sequence number per cell): front-ends
+    // claim a cell with a compare-and-swap, so two of them never write the
+    // same one, and the engine takes cells in order. A front-end that dies
+    // between claiming and filling a cell stalls the ring at that cell until
+    // the engine restarts.
+    class CommandRing
+    {
+    public:
+        static_assert ((commandCapacity & (commandCapacity - 1)) == 0, "capacity must be a power of two");
+
+        CommandRing() noexcept
+        {
+            for (size_t i = 0; i < cells.size(); ++i)
+                cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+
+        bool push(const Command& command) noexcept
+        {
+            auto position = enqueuePosition.load(std::memory_order_relaxed);
+
+            for (;;)
+            {
+                auto& cell = cells[(size_t) (position & mask)];
+                const auto difference = (juce::int64) cell.sequence.load(std::memory_order_acquire) - (juce::int64) position;
+
+                if (difference == 0)
+                {
+                    if (enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                    {
+                        cell.command = command;
+                        cell.sequence.store(position + 1, std::memory_order_release);
+                        return true;
+                    }
+                }
+                else if (difference < 0)
+                {
+                    return false;
+                }
+                else
+                {
+                    position = enqueuePosition.load(std::memory_order_relaxed);
+                }
+            }
+        }
+
+        bool pop(Command& command) noexcept
+        {
+            auto& cell = cells[(size_t) (dequeuePosition & mask)];
+
+            if ((juce::int64) cell.sequence.load(std::memory_order_acquire) - (juce::int64) (dequeuePosition + 1) < 0)
+                return false;
+
+            command = cell.command;
+            cell.sequence.store(dequeuePosition + commandCapacity, std::memory_order_release);
+            ++dequeuePosition;
+            return true;
+        }
+
+    private:
+        static constexpr juce::uint64 mask = commandCapacity - 1;
+
+        struct Cell
+        {
+            std::atomic<juce::uint64> sequence { 0 };
+            Command command {};
+        };
+
+        std::array<Cell, commandCapacity> cells;
+        std::atomic<juce::uint64> enqueuePosition { 0 };
+        juce::uint64 dequeuePosition = 0;   // engine only
+    };
+
+    struct Segment
+    {
+        juce::uint32 magic = 0, version = 0;   // set before enginePid
+        std::atomic<int> enginePid { 0 };
+        std::array<std::atomic<int>, maxClients> clientPids {};
+        sem_t commandPosted;
+
+        CommandRing commands;
+        Snapshot<Status> status;
+
+        std::array<ProbeFeed, EngineProbes::numProbes> probes;
+        MonitorFeed monitor;
+
+        EngineTelemetry telemetry;
+    };
+
+    static_assert (std::atomic<double>::is_always_lock_free
+                   && std::atomic<juce::uint64>::is_always_lock_free
+                   && std::atomic<int>::is_always_lock_free,
+                   "atomics in the segment are shared between processes");
+
+    SharedControlSurface(Segment* s, std::unique_ptr<juce::InterProcessLock> lock)
+        : segment(s), engineLock(std::move(lock))
+    {
+    }
+
+    // one engine per user
+    static juce::String getSegmentName()   { return "/modztakt-engine." + juce::String((int) getuid()); }
+
+    static bool isRunning(int pid) noexcept   { return kill((pid_t) pid, 0) == 0 || errno == EPERM; }
+
+    Segment* segment;
+    std::unique_ptr<juce::InterProcessLock> engineLock;   // engine side only
+    std::atomic<int>* clientSlot = nullptr;                // front-end side only
+
+    JUCE_DECLARE_NON_COPYABLE(SharedControlSurface)
+};
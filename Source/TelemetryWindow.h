@@ -0,0 +1,372 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "EngineTelemetry.h"
+
+// TelemetryWindow.h
+// Live view of EngineTelemetry, opened from the settings menu, with the
+// startup times of the window that opened it.
+class TelemetryWindow : public juce::DialogWindow,
+                        private juce::Timer
+{
+public:
+    TelemetryWindow (EngineTelemetry& t, const StartupTimes& s)
+        : DialogWindow ("Engine Telemetry",
+                        juce::Colours::darkgrey,
+                        true),
+          telemetry (t),
+          startup (s)
+    {
+        setUsingNativeTitleBar (true);
+        setResizable (true, true);
+
+        content = std::make_unique<Content> (*this);
+        setContentOwned (content.get(), false);
+
+        centreWithSize (560, 420);
+
+        previous = telemetry.snapshot();
+    }
+
+    // refreshed only while on screen
+    void visibilityChanged() override
+    {
+        DialogWindow::visibilityChanged();
+
+        if (isVisible())
+        {
+            previous = telemetry.snapshot();
+            startTimerHz (4); // UI refresh rate (low priority)
+        }
+        else
+        {
+            stopTimer();
+        }
+    }
+
+    void closeButtonPressed() override
+    {
+        setVisible (false);
+    }
+
+    // ============================================================
+    // CSV EXPORT
+    // ============================================================
+    juce::String toCsv() const
+    {
+        const auto s = telemetry.snapshot();
+        juce::String csv;
+
+        csv << "section,name,port,channel,value\n";
+
+        auto row = [&csv] (const char* section, const juce::String& name,
+                           const juce::String& port, const juce::String& channel, auto value)
+        {
+            csv << section << "," << name << "," << port << "," << channel << "," << value << "\n";
+        };
+
+        row ("engine", "ticks", {}, {}, (juce::int64) s.ticks);
+        row ("engine", "suppressed_threshold", {}, {}, (juce::int64) s.suppressedThreshold);
+        row ("engine", "suppressed_rate_limit", {}, {}, (juce::int64) s.suppressedRateLimit);
+        row ("engine", "suppressed_on_device", {}, {}, (juce::int64) s.suppressedShadow);
+        row ("engine", "merged_contributions", {}, {}, (juce::int64) s.mergedContributions);
+        row ("engine", "deferred_by_schedule", {}, {}, (juce::int64) s.scheduleDeferred);
+        row ("engine", "budget_planned_hz", {}, {}, s.budgetPlannedHz);
+        row ("engine", "budget_nominal_hz", {}, {}, s.budgetNominalHz);
+        row ("engine", "wakeups", {}, {}, (juce::int64) s.engineWakeups);
+        row ("engine", "idle", {}, {}, s.engineIdle ? 1 : 0);
+        row ("input", "events_received", {}, {}, (juce::int64) s.inputEvents);
+        row ("input", "events_dropped", {}, {}, (juce::int64) s.inputDrops);
+        row ("input", "events_reordered", {}, {}, (juce::int64) s.inputReorders);
+        row ("thru", "messages", {}, {}, (juce::int64) s.thruMessages);
+        row ("thru", "dropped", {}, {}, (juce::int64) s.thruDrops);
+        row ("clock", "messages", {}, {}, (juce::int64) s.clockMessages);
+        row ("clock", "dropped", {}, {}, (juce::int64) s.clockDrops);
+        row ("control", "batches", {}, {}, (juce::int64) s.controlBatches);
+        row ("control", "rejected", {}, {}, (juce::int64) s.controlRejects);
+        row ("output", "bytes_dropped", {}, {}, (juce::int64) s.outputBytesDropped);
+
+        auto histogramRows = [&row] (const char* name, const TelemetryHistogram& h, const juce::String& port)
+        {
+            row ("histogram_us", juce::String (name) + "_count", port, {}, (juce::int64) h.getCount());
+            row ("histogram_us", juce::String (name) + "_mean", port, {}, h.getMean());
+            row ("histogram_us", juce::String (name) + "_p50", port, {}, h.getPercentile (50.0));
+            row ("histogram_us", juce::String (name) + "_p99", port, {}, h.getPercentile (99.0));
+            row ("histogram_us", juce::String (name) + "_p999", port, {}, h.getPercentile (99.9));
+            row ("histogram_us", juce::String (name) + "_max", port, {}, (juce::int64) h.getMax());
+        };
+
+        const auto& rt = telemetry.engineRealtime;
+        row ("realtime", "scheduling", {}, {}, RealtimeStatus::toString (rt.scheduling.load()));
+        row ("realtime", "priority", {}, {}, rt.priority.load());
+        row ("realtime", "affinity", {}, {}, RealtimeStatus::toString (rt.affinity.load()));
+        row ("realtime", "cpu_core", {}, {}, rt.cpuCore.load());
+        row ("realtime", "memory_lock", {}, {}, RealtimeStatus::toString (rt.memoryLock.load()));
+        row ("realtime", "prefault", {}, {}, RealtimeStatus::toString (rt.prefault.load()));
+
+        const auto& st = startup;
+        row ("startup", "window_built_ms", {}, {}, st.elapsed (st.windowBuiltMs));
+        row ("startup", "first_paint_ms", {}, {}, st.elapsed (st.firstPaintMs));
+        row ("startup", "devices_listed_ms", {}, {}, st.elapsed (st.devicesListedMs));
+
+        histogramRows ("tick_interval", telemetry.tickInterval, {});
+        histogramRows ("tick_jitter", telemetry.tickJitter, {});
+        histogramRows ("tick_compute", telemetry.tickCompute, {});
+        histogramRows ("thru_latency", telemetry.thruLatency, {});
+        histogramRows ("clock_jitter", telemetry.clockJitter, {});
+        histogramRows ("control_round_trip", telemetry.controlLatency, {});
+
+        for (int p = 0; p < EngineTelemetry::maxPorts; ++p)
+        {
+            const auto& latency = telemetry.portLatency[(size_t) p];
+
+            if (latency.getCount() > 0)
+            {
+                const auto portName = telemetry.getPortName (p).replaceCharacter (',', ' ');
+                histogramRows ("sender_latency", latency, portName);
+                row ("output", "backlog", portName, {}, s.backlog[(size_t) p]);
+                row ("output", "backlog_max", portName, {}, s.backlogMax[(size_t) p]);
+
+                const auto& sender = telemetry.portRealtime[(size_t) p];
+                row ("realtime", "scheduling", portName, {}, RealtimeStatus::toString (sender.scheduling.load()));
+                row ("realtime", "priority", portName, {}, sender.priority.load());
+                row ("realtime", "affinity", portName, {}, RealtimeStatus::toString (sender.affinity.load()));
+                row ("realtime", "cpu_core", portName, {}, sender.cpuCore.load());
+                row ("realtime", "prefault", portName, {}, RealtimeStatus::toString (sender.prefault.load()));
+            }
+
+            for (int ch = 0; ch < EngineTelemetry::numChannels; ++ch)
+            {
+                const auto& c = s.ports[(size_t) p][(size_t) ch];
+                if (c.messages == 0)
+                    continue;
+
+                const auto portName = telemetry.getPortName (p).replaceCharacter (',', ' ');
+                row ("output", "messages", portName, juce::String (ch + 1), (juce::int64) c.messages);
+                row ("output", "bytes",    portName, juce::String (ch + 1), (juce::int64) c.bytes);
+            }
+        }
+
+        return csv;
+    }
+
+private:
+    // ============================================================
+    // CONTENT
+    // ============================================================
+    struct Content : public juce::Component
+    {
+        explicit Content (TelemetryWindow& o) : owner (o)
+        {
+            report.setMultiLine (true);
+            report.setReadOnly (true);
+            report.setScrollbarsShown (true);
+            report.setFont (juce::FontOptions (juce::Font::getDefaultMonospacedFontName(), 13.0f, juce::Font::plain));
+            addAndMakeVisible (report);
+
+            exportButton.onClick = [this] { owner.exportCsv(); };
+            addAndMakeVisible (exportButton);
+
+            resetButton.onClick = [this] { owner.telemetry.reset(); owner.previous = owner.telemetry.snapshot(); };
+            addAndMakeVisible (resetButton);
+
+            setSize (560, 420);
+        }
+
+        void resized() override
+        {
+            auto area = getLocalBounds().reduced (6);
+            auto buttons = area.removeFromBottom (26);
+            exportButton.setBounds (buttons.removeFromRight (110));
+            buttons.removeFromRight (6);
+            resetButton.setBounds (buttons.removeFromRight (80));
+            area.removeFromBottom (6);
+            report.setBounds (area);
+        }
+
+        TelemetryWindow& owner;
+        juce::TextEditor report;
+        juce::TextButton exportButton { "Export CSV..." };
+        juce::TextButton resetButton { "Reset" };
+    };
+
+    // ============================================================
+    // TIMER (UI THREAD)
+    // ============================================================
+    void timerCallback() override
+    {
+        const auto now = telemetry.snapshot();
+        const double seconds = juce::jmax (1.0e-3, (now.timeMs - previous.timeMs) * 0.001);
+
+        auto rate = [seconds] (juce::uint64 a, juce::uint64 b)
+        {
+            return juce::String ((double) (a - b) / seconds, 1);
+        };
+
+        auto histogramLine = [] (const char* name, const TelemetryHistogram& h)
+        {
+            return juce::String (name).paddedRight (' ', 16)
+                 + "mean " + juce::String (h.getMean() * 0.001, 3)
+                 + "  p50 " + juce::String (h.getPercentile (50.0) * 0.001, 3)
+                 + "  p99 " + juce::String (h.getPercentile (99.0) * 0.001, 3)
+                 + "  max " + juce::String (h.getMax() * 0.001, 3) + " ms\n";
+        };
+
+        juce::String text;
+        text << "Ticks: " << (juce::int64) now.ticks << "  (" << rate (now.ticks, previous.ticks) << " Hz)"
+             << "  | wakeups " << rate (now.engineWakeups, previous.engineWakeups) << " /s"
+             << (now.engineIdle ? "  | idle (asleep)" : "") << "\n\n";
+
+        // scheduling and pinning of one thread
+        auto threadRealtime = [] (const RealtimeStatus& status)
+        {
+            juce::String line;
+            line << "SCHED_FIFO " << RealtimeStatus::toString (status.scheduling.load());
+
+            if (status.priority.load() > 0)
+                line << " (prio " << status.priority.load() << ")";
+
+            line << "  | CPU pin " << RealtimeStatus::toString (status.affinity.load());
+
+            if (status.cpuCore.load() >= 0)
+                line << " (core " << status.cpuCore.load() << ")";
+
+            return line;
+        };
+
+        const auto& rt = telemetry.engineRealtime;
+        text << "Realtime:  " << threadRealtime (rt)
+             << "  | mlockall " << RealtimeStatus::toString (rt.memoryLock.load())
+             << "  | prefault " << RealtimeStatus::toString (rt.prefault.load()) << "\n";
+
+        const auto& st = startup;
+        auto phase = [&st] (double phaseMs)
+        {
+            const auto ms = st.elapsed (phaseMs);
+            return ms < 0.0 ? juce::String ("--") : juce::String (ms, 1) + " ms";
+        };
+
+        text << "Startup:   window " << phase (st.windowBuiltMs)
+             << "  | first paint " << phase (st.firstPaintMs)
+             << "  | devices " << phase (st.devicesListedMs) << "\n\n";
+
+        text << histogramLine ("Tick interval", telemetry.tickInterval);
+        text << histogramLine ("Tick jitter",   telemetry.tickJitter);
+        text << histogramLine ("Tick compute",  telemetry.tickCompute);
+
+        text << "\nSuppressed (throttle):    " << (juce::int64) now.suppressedThreshold
+             << "  (" << rate (now.suppressedThreshold, previous.suppressedThreshold) << " /s)\n";
+        text << "Suppressed (rate limit):  " << (juce::int64) now.suppressedRateLimit
+             << "  (" << rate (now.suppressedRateLimit, previous.suppressedRateLimit) << " /s)\n";
+        text << "Suppressed (on device):   " << (juce::int64) now.suppressedShadow
+             << "  (" << rate (now.suppressedShadow, previous.suppressedShadow) << " /s)\n";
+        text << "Merged (matrix):          " << (juce::int64) now.mergedContributions
+             << "  (" << rate (now.mergedContributions, previous.mergedContributions) << " /s)\n";
+        text << "Deferred (schedule):      " << (juce::int64) now.scheduleDeferred
+             << "  (" << rate (now.scheduleDeferred, previous.scheduleDeferred) << " /s)\n";
+        text << "Update budget:            " << juce::String (now.budgetPlannedHz, 1) << " /s of "
+             << juce::String (now.budgetNominalHz, 0) << " /s at full rate\n";
+        text << "Input events received:    " << (juce::int64) now.inputEvents
+             << "  (" << rate (now.inputEvents, previous.inputEvents) << " /s)\n";
+        text << "Input events dropped:     " << (juce::int64) now.inputDrops << "\n";
+        text << "Input events reordered:   " << (juce::int64) now.inputReorders << "\n";
+        text << "Thru messages:            " << (juce::int64) now.thruMessages
+             << "  (" << rate (now.thruMessages, previous.thruMessages) << " /s), "
+             << (juce::int64) now.thruDrops << " dropped\n";
+
+        if (now.thruMessages > 0)
+            text << histogramLine ("Thru latency", telemetry.thruLatency);
+
+        if (now.clockMessages + now.clockDrops > 0)
+        {
+            text << "Clock messages:           " << (juce::int64) now.clockMessages
+                 << "  (" << rate (now.clockMessages, previous.clockMessages) << " /s), "
+                 << (juce::int64) now.clockDrops << " dropped\n";
+
+            if (telemetry.clockJitter.getCount() > 0)
+                text << histogramLine ("Clock jitter", telemetry.clockJitter);
+        }
+
+        if (now.controlBatches + now.controlRejects > 0)
+        {
+            text << "Control batches:          " << (juce::int64) now.controlBatches
+                 << "  (" << rate (now.controlBatches, previous.controlBatches) << " /s), "
+                 << (juce::int64) now.controlRejects << " rejected\n";
+
+            if (telemetry.controlLatency.getCount() > 0)
+                text << histogramLine ("Control to CC", telemetry.controlLatency);
+        }
+
+        text << "Output bytes dropped:     " << (juce::int64) now.outputBytesDropped << "\n";
+
+        for (int p = 0; p < EngineTelemetry::maxPorts; ++p)
+        {
+            const auto total     = now.portTotals (p);
+            const auto prevTotal = previous.portTotals (p);
+
+            if (total.messages == 0)
+                continue;
+
+            text << "\nPort " << (p + 1) << ": " << telemetry.getPortName (p) << "\n";
+            text << "  total  " << rate (total.messages, prevTotal.messages) << " msg/s  "
+                 << rate (total.bytes, prevTotal.bytes) << " B/s\n";
+
+            if (telemetry.portLatency[(size_t) p].getCount() > 0)
+            {
+                text << "  " << histogramLine ("sender latency", telemetry.portLatency[(size_t) p]);
+                text << "  backlog " << now.backlog[(size_t) p] << " packets (max "
+                     << now.backlogMax[(size_t) p] << ")\n";
+
+                const auto& sender = telemetry.portRealtime[(size_t) p];
+                text << "  sender " << threadRealtime (sender)
+                     << "  | prefault " << RealtimeStatus::toString (sender.prefault.load()) << "\n";
+            }
+
+            for (int ch = 0; ch < EngineTelemetry::numChannels; ++ch)
+            {
+                const auto& c  = now.ports[(size_t) p][(size_t) ch];
+                const auto& pc = previous.ports[(size_t) p][(size_t) ch];
+
+                if (c.messages == 0)
+                    continue;
+
+                text << "  ch " << juce::String (ch + 1).paddedLeft (' ', 2) << "  "
+                     << rate (c.messages, pc.messages) << " msg/s  "
+                     << rate (c.bytes, pc.bytes) << " B/s  ("
+                     << (juce::int64) c.messages << " msg, " << (juce::int64) c.bytes << " B)\n";
+            }
+        }
+
+        content->report.setText (text, false);
+        previous = now;
+    }
+
+    void exportCsv()
+    {
+        chooser = std::make_unique<juce::FileChooser> ("Export telemetry",
+                                                       juce::File::getSpecialLocation (juce::File::userHomeDirectory)
+                                                           .getChildFile ("modztakt_telemetry.csv"),
+                                                       "*.csv");
+
+        chooser->launchAsync (juce::FileBrowserComponent::saveMode
+                                | juce::FileBrowserComponent::canSelectFiles
+                                | juce::FileBrowserComponent::warnAboutOverwriting,
+                              [this] (const juce::FileChooser& fc)
+                              {
+                                  const auto file = fc.getResult();
+
+                                  if (file != juce::File())
+                                      file.replaceWithText (toCsv());
+                              });
+    }
+
+    // ============================================================
+    // DATA
+    // ============================================================
+    EngineTelemetry& telemetry;
+    const StartupTimes& startup;
+    std::unique_ptr<Content> content;
+    std::unique_ptr<juce::FileChooser> chooser;
+
+    EngineTelemetry::Snapshot previous;
+};
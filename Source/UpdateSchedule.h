@@ -0,0 +1,59 @@
+#pragma once
+#include <JuceHeader.h>
+
+// ==========================================
+// Adaptive update schedule
+// ==========================================
+// Per destination: how often its value needs to go out so the device never
+// lags the source by more than an error bound, in value steps. The interval
+// comes from the destination's slope in steps per ms, so it depends on the
+// parameter's range as much as on the source. A 0..7 switch under a slow LFO
+// moves a step every few hundred ms and gets a long interval. A 14-bit
+// NRPN under the same LFO moves hundreds of steps per tick and is due on
+// every tick.
+//
+// The interval is a prediction. A value already off by the bound (a square
+// edge, a note restart) goes out at once.
+struct UpdateSchedule
+{
+    // Evaluates the destination at nowMs; returns the interval it needs
+    double evaluate(double value, double nowMs, double errorBound, double minIntervalMs, double maxIntervalMs) noexcept
+    {
+        const double dt = nowMs - lastEvalMs;
+
+        // no usable previous evaluation (first one, or the source paused)
+        const bool slopeKnown = lastEvalMs >= 0.0 && dt > 0.0 && dt <= 3.0 * minIntervalMs;
+        const double slope = slopeKnown ? std::abs(value - lastValue) / dt : 0.0;
+
+        lastValue = value;
+        lastEvalMs = nowMs;
+
+        if (errorBound <= 0.0 || !slopeKnown)
+            intervalMs = minIntervalMs;
+        else
+            intervalMs = slope > 0.0 ? juce::jlimit(minIntervalMs, maxIntervalMs, errorBound / slope)
+                                     : maxIntervalMs;
+
+        return intervalMs;
+    }
+
+    // deviceValue: what the device holds, or < 0 if unknown
+    bool isDue(double value, int deviceValue, double nowMs, double errorBound) const noexcept
+    {
+        if (errorBound <= 0.0 || deviceValue < 0)
+            return true;
+
+        const double error = std::abs(value - deviceValue);
+
+        // small margin: tick times are not exact multiples of the interval
+        return error >= errorBound
+            || (error >= 0.5 && nowMs - lastSendMs >= intervalMs - 0.01);
+    }
+
+    void sent(double nowMs) noexcept   { lastSendMs = nowMs; }
+
+    double lastValue = 0.0;
+    double lastEvalMs = -1.0;
+    double lastSendMs = 0.0;
+    double intervalMs = 0.0;
+};